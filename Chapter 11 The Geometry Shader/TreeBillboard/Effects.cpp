@@ -1,10 +1,30 @@
 
 #include "Effects.h"
+#include "EffectArchive.h"
+
+// Archive the effects are created from while Effects::InitAll runs.  Null, or an
+// archive without the effect, falls back to the loose .fxo file.
+static const EffectArchive* gEffectArchive = 0;
 
 #pragma region Effect
 Effect::Effect(ID3D11Device* device, const std::wstring& filename)
 	: mFX(0)
 {
+	if(gEffectArchive)
+	{
+		// Archive names are ASCII paths.
+		std::string name;
+		for(size_t i = 0; i < filename.size(); ++i)
+			name += char(filename[i]);
+
+		EffectArchive::Blob blob;
+		if(gEffectArchive->Find(name.c_str(), blob))
+		{
+			HR(D3DX11CreateEffectFromMemory(blob.Data, blob.Size, 0, device, &mFX));
+			return;
+		}
+	}
+
 	std::ifstream fin(filename, std::ios::binary);
 
 	fin.seekg(0, std::ios_base::end);
@@ -25,6 +45,20 @@ Effect::~Effect()
 }
 #pragma endregion
 
+#pragma region EffectConstantBufferBackend
+void EffectConstantBufferBackend::Bind(uint32_t slot, ID3DX11EffectConstantBuffer* buffer)
+{
+	if(mBuffers.size() <= slot)
+		mBuffers.resize(slot + 1, 0);
+	mBuffers[slot] = buffer;
+}
+
+void EffectConstantBufferBackend::Upload(uint32_t slot, size_t offset, const void* data, size_t size)
+{
+	HR(mBuffers[slot]->SetRawValue(data, (uint32_t)offset, (uint32_t)size));
+}
+#pragma endregion
+
 #pragma region BasicEffect
 BasicEffect::BasicEffect(ID3D11Device* device, const std::wstring& filename)
 	: Effect(device, filename)
@@ -98,6 +132,18 @@ TreeSpriteEffect::~TreeSpriteEffect()
 }
 #pragma endregion
 
+#pragma region TreeBillboardEffect
+TreeBillboardEffect::TreeBillboardEffect(ID3D11Device* device, const std::wstring& filename)
+	: TreeSpriteEffect(device, filename)
+{
+	ImpostorMipBias = mFX->GetVariableByName("gImpostorMipBias")->AsScalar();
+}
+
+TreeBillboardEffect::~TreeBillboardEffect()
+{
+}
+#pragma endregion
+
 #pragma region BuildDensityEffect
 BuildDensityEffect::BuildDensityEffect(ID3D11Device* device, const std::wstring& filename)
 	: Effect(device, filename)
@@ -128,33 +174,91 @@ MarchingCubesEffect::MarchingCubesEffect(ID3D11Device* device, const std::wstrin
 	MaxCornerHeight = mFX->GetVariableByName("mCornerHeight")->AsScalar();
 	DirLights = mFX->GetVariableByName("gDirLights");
 	Mat = mFX->GetVariableByName("gMaterial");
+
+	// The constant structs must match the compiled effect byte for byte, each field in
+	// the cbuffer of its update frequency.
+	typedef TerrainEffectConstants TC;
+	static_assert(sizeof(DirectionalLight) == TC::LightSize, "cbPerFrame layout");
+	static_assert(sizeof(Material) == TC::MaterialSize, "cbStatic layout");
+	struct { const char* Name; TC::Slot Slot; size_t Offset; } layout[] =
+	{
+		{ "mTexTransform", TC::StaticSlot,    offsetof(TC::StaticConstants, TexTransform) },
+		{ "mCornerHeight", TC::StaticSlot,    offsetof(TC::StaticConstants, CornerHeight) },
+		{ "mVoxelSize",    TC::StaticSlot,    offsetof(TC::StaticConstants, VoxelSize) },
+		{ "gMaterial",     TC::StaticSlot,    offsetof(TC::StaticConstants, Material) },
+		{ "gDirLights",    TC::PerFrameSlot,  offsetof(TC::PerFrameConstants, DirLights) },
+		{ "gEyePosW",      TC::PerFrameSlot,  offsetof(TC::PerFrameConstants, EyePosW) },
+		{ "mViewProj",     TC::PerFrameSlot,  offsetof(TC::PerFrameConstants, ViewProj) },
+		{ "mWorld",        TC::PerObjectSlot, offsetof(TC::PerObjectConstants, World) },
+		{ "mWVP",          TC::PerObjectSlot, offsetof(TC::PerObjectConstants, WorldViewProj) },
+		{ "mChunkOrigin",  TC::PerObjectSlot, offsetof(TC::PerObjectConstants, Chunk) + offsetof(TC::ChunkConstants, Origin) },
+		{ "mChunkExtent",  TC::PerObjectSlot, offsetof(TC::PerObjectConstants, Chunk) + offsetof(TC::ChunkConstants, Extent) },
+	};
+	for(size_t i = 0; i < ARRAYSIZE(layout); ++i)
+	{
+		ID3DX11EffectVariable* variable = mFX->GetVariableByName(layout[i].Name);
+		D3DX11_EFFECT_VARIABLE_DESC desc;
+		HR(variable->GetDesc(&desc));
+		assert(desc.BufferOffset == layout[i].Offset);
+		assert(variable->GetParentConstantBuffer() == mFX->GetConstantBufferByName(TC::CBufferName(layout[i].Slot)));
+	}
+
+	D3DX11_EFFECT_TYPE_DESC worldType;
+	HR(World->GetType()->GetDesc(&worldType));
+	assert(worldType.Class == D3D_SVC_MATRIX_COLUMNS);
+
+	for(int slot = 0; slot < TC::SlotCount; ++slot)
+		mConstantBackend.Bind(slot, mFX->GetConstantBufferByName(TC::CBufferName(TC::Slot(slot))));
 }
 
 MarchingCubesEffect::~MarchingCubesEffect()
 {
 }
+
+Mat4 MarchingCubesEffect::ToMat4(CXMMATRIX M)
+{
+	// Mat4 shares XMFLOAT4X4's row-major layout; TerrainEffectConstants transposes.
+	Mat4 m;
+	XMStoreFloat4x4(reinterpret_cast<XMFLOAT4X4*>(&m.m[0][0]), M);
+	return m;
+}
 #pragma endregion
 
 #pragma region Effects
 
 BasicEffect*      Effects::BasicFX      = 0;
 TreeSpriteEffect* Effects::TreeSpriteFX = 0;
+TreeBillboardEffect* Effects::TreeBillboardFX = 0;
 BuildDensityEffect* Effects::BuildDensityFX = 0;
 MarchingCubesEffect* Effects::MarchingCubesFX = 0;
 
 void Effects::InitAll(ID3D11Device* device)
 {
+	// Release builds create every effect from FX/Effects.fxa, mapped once.  The
+	// Release post-build step repacks it from the .fxo files fxc just wrote (see
+	// Tools/EffectPack), and an effect missing from it is read from its loose .fxo.
+	// Debug builds read the loose .fxo files that fxc rebuilds with /Od /Zi.
+	EffectArchive archive;
+#if !defined(DEBUG) && !defined(_DEBUG)
+	if(archive.Open("FX/Effects.fxa"))
+		gEffectArchive = &archive;
+#endif
+
 	BasicFX = new BasicEffect(device, L"FX/Basic.fxo");
 	TreeSpriteFX = new TreeSpriteEffect(device, L"FX/TreeSprite.fxo");
+	TreeBillboardFX = new TreeBillboardEffect(device, L"FX/TreeBillboard.fxo");
 	BuildDensityFX = new BuildDensityEffect(device, L"FX/BuildDensity.fxo");
 	MarchingCubesFX = new MarchingCubesEffect(device, L"FX/MarchingCubes.fxo");
 
+	// D3DX11CreateEffectFromMemory copies what it needs; the mapping can go.
+	gEffectArchive = 0;
 }
 
 void Effects::DestroyAll()
 {
 	SafeDelete(BasicFX);
 	SafeDelete(TreeSpriteFX);
+	SafeDelete(TreeBillboardFX);
 	SafeDelete(BuildDensityFX);
 	SafeDelete(MarchingCubesFX);
 }
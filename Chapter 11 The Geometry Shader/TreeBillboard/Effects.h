@@ -2,6 +2,8 @@
 #define EFFECTS_H
 
 #include "d3dUtil.h"
+#include "ConstantBufferCache.h"
+#include "TerrainEffectConstants.h"
 using namespace DirectX;
 using namespace PackedVector;
 
@@ -21,6 +23,23 @@ protected:
 };
 #pragma endregion
 
+#pragma region EffectConstantBufferBackend
+///<summary>
+/// ConstantBufferCache backend that writes into an effect's constant buffers.  Effects11
+/// only re-uploads a constant buffer on Apply after it has been written, so a buffer
+/// the cache leaves alone costs nothing.
+///</summary>
+class EffectConstantBufferBackend : public IConstantBufferBackend
+{
+public:
+	void Bind(uint32_t slot, ID3DX11EffectConstantBuffer* buffer);
+	void Upload(uint32_t slot, size_t offset, const void* data, size_t size);
+
+private:
+	std::vector<ID3DX11EffectConstantBuffer*> mBuffers;
+};
+#pragma endregion
+
 #pragma region BasicEffect
 class BasicEffect : public Effect
 {
@@ -116,6 +135,23 @@ public:
 };
 #pragma endregion
 
+#pragma region TreeBillboardEffect
+///<summary>
+/// FX/TreeBillboard.fx: TreeSprite's variables and techniques plus the mip bias used by
+/// impostor LOD bands.
+///</summary>
+class TreeBillboardEffect : public TreeSpriteEffect
+{
+public:
+	TreeBillboardEffect(ID3D11Device* device, const std::wstring& filename);
+	~TreeBillboardEffect();
+
+	void SetImpostorMipBias(float f) { ImpostorMipBias->SetFloat(f); }
+
+	ID3DX11EffectScalarVariable* ImpostorMipBias;
+};
+#pragma endregion
+
 #pragma region BuildDensityEffect
 class BuildDensityEffect : public Effect
 {
@@ -140,17 +176,25 @@ public:
 	~MarchingCubesEffect();
 
 
-	void SetEyePosW(const XMFLOAT3& v) { EyePosW->SetRawValue(&v, 0, sizeof(XMFLOAT3)); }
-	void SetWorldViewProj(CXMMATRIX M) { WorldViewProj->SetMatrix(reinterpret_cast<const float*>(&M)); }
-	void SetWorld(CXMMATRIX M) { World->SetMatrix(reinterpret_cast<const float*>(&M)); }
-	void SetViewProj(CXMMATRIX M) { ViewProj->SetMatrix(reinterpret_cast<const float*>(&M)); }
+	// Constant setters write into shadow copies of cbStatic, cbPerFrame and cbPerObject
+	// (see TerrainEffectConstants) and only dirty what changed; call FlushConstants
+	// before applying a pass.
+	void SetEyePosW(const XMFLOAT3& v) { mConstants.SetEyePosW(Vec3(v.x, v.y, v.z)); }
+	void SetWorldViewProj(CXMMATRIX M) { mConstants.SetWorldViewProj(ToMat4(M)); }
+	void SetWorld(CXMMATRIX M) { mConstants.SetWorld(ToMat4(M)); }
+	void SetViewProj(CXMMATRIX M) { mConstants.SetViewProj(ToMat4(M)); }
 	void SetWorldInvTranspose(CXMMATRIX M) { WorldInvTranspose->SetMatrix(reinterpret_cast<const float*>(&M)); }
-	void SetTexTransform(CXMMATRIX M) { TexTransform->SetMatrix(reinterpret_cast<const float*>(&M)); }
-	void SetCornerHeight(UINT n) { MaxCornerHeight->SetInt(n); }
-	void SetVoxelSize(XMFLOAT3 n) { VoxelSize->SetRawValue(&n,0,sizeof(XMFLOAT3)); }
+	void SetTexTransform(CXMMATRIX M) { mConstants.SetTexTransform(ToMat4(M)); }
+	void SetCornerHeight(UINT n) { mConstants.SetCornerHeight(n); }
+	void SetVoxelSize(XMFLOAT3 n) { mConstants.SetVoxelSize(Vec3(n.x, n.y, n.z)); }
 	void SetNoiseTex(ID3D11ShaderResourceView* tex) { noiseTex->SetResource(tex); }
-	void SetDirLights(const DirectionalLight* lights) { DirLights->SetRawValue(lights, 0, 3 * sizeof(DirectionalLight)); }
-	void SetMaterial(const Material& mat) { Mat->SetRawValue(&mat, 0, sizeof(Material)); }
+	void SetDirLights(const DirectionalLight* lights) { mConstants.SetDirLights(lights); }
+	void SetMaterial(const Material& mat) { mConstants.SetMaterial(&mat); }
+
+	void FlushConstants() { mConstants.Flush(mConstantBackend); }
+	// Where the terrain draws' chunk boxes go (see D3D11DrawBackend::SetConstantBackend).
+	IConstantBufferBackend& ConstantBackend() { return mConstantBackend; }
+	const ConstantBufferCache::Stats& ConstantStats()const { return mConstants.Cache().GetStats(); }
 
 	ID3DX11EffectTechnique* MarchingCubes;
 
@@ -165,6 +209,12 @@ public:
 	ID3DX11EffectShaderResourceVariable* noiseTex;
 	ID3DX11EffectVariable* DirLights;
 	ID3DX11EffectVariable* Mat;
+
+private:
+	static Mat4 ToMat4(CXMMATRIX M);
+
+	TerrainEffectConstants mConstants;
+	EffectConstantBufferBackend mConstantBackend;
 };
 #pragma endregion
 
@@ -177,6 +227,7 @@ public:
 
 	static BasicEffect* BasicFX;
 	static TreeSpriteEffect* TreeSpriteFX;
+	static TreeBillboardEffect* TreeBillboardFX;
 	static BuildDensityEffect* BuildDensityFX;
 	static MarchingCubesEffect* MarchingCubesFX;
 };
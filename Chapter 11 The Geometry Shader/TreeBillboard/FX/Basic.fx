@@ -1,5 +1,6 @@
 
 #include "LightHelper.fx"
+#include "VertexCompression.fx"
  
 cbuffer cbPerFrame
 {
@@ -32,10 +33,11 @@ SamplerState samAnisotropic
 	AddressV = WRAP;
 };
 
+// Vertex::BasicCompact: the normal arrives octahedral, the uv as halves.
 struct VertexIn
 {
 	float3 PosL    : POSITION;
-	float3 NormalL : NORMAL;
+	float2 NormalL : NORMAL;
 	float2 Tex     : TEXCOORD;
 };
 
@@ -53,7 +55,7 @@ VertexOut VS(VertexIn vin)
 	
 	// Transform to world space space.
 	vout.PosW    = mul(float4(vin.PosL, 1.0f), gWorld).xyz;
-	vout.NormalW = mul(vin.NormalL, (float3x3)gWorldInvTranspose);
+	vout.NormalW = mul(OctDecode(vin.NormalL), (float3x3)gWorldInvTranspose);
 		
 	// Transform to homogeneous clip space.
 	vout.PosH = mul(float4(vin.PosL, 1.0f), gWorldViewProj);
@@ -0,0 +1,195 @@
+//***************************************************************************************
+// TreeBillboard.fx
+//
+// Same billboards as TreeSprite.fx without the geometry shader: a shared 4-vertex quad
+// is instanced over BillboardInstance data (see Common/BillboardBatch.h) and the vertex
+// shader builds the camera-facing corner itself.
+//
+// Each instance carries its LOD band (see Common/VegetationLod.h).  Mid-band impostors
+// sample gImpostorMipBias coarser mips, and instances changing band are dithered in or
+// out with a 4x4 ordered pattern so the two bands never cover the same pixel.
+//***************************************************************************************
+
+#include "LightHelper.fx"
+
+cbuffer cbPerFrame
+{
+	DirectionalLight gDirLights[3];
+	float3 gEyePosW;
+
+	float  gFogStart;
+	float  gFogRange;
+	float4 gFogColor;
+
+	float  gImpostorMipBias;
+};
+
+cbuffer cbPerObject
+{
+	float4x4 gViewProj;
+	Material gMaterial;
+};
+
+Texture2DArray gTreeMapArray;
+
+SamplerState samLinear
+{
+	Filter   = MIN_MAG_MIP_LINEAR;
+	AddressU = CLAMP;
+	AddressV = CLAMP;
+};
+
+struct VertexIn
+{
+	// Per vertex: x in [-0.5, 0.5] across the quad, y in [0, 1] up from the base.
+	float2 Corner : CORNER;
+
+	// Per instance.
+	float3 PosW   : POSITION;
+	float2 SizeW  : SIZE;
+	uint   Slice  : SLICE;
+	uint   Lod    : LOD;
+	float  Fade   : FADE;
+};
+
+struct VertexOut
+{
+	float4 PosH    : SV_POSITION;
+	float3 PosW    : POSITION;
+	float3 NormalW : NORMAL;
+	float2 Tex     : TEXCOORD;
+	nointerpolation uint Slice : SLICE;
+	nointerpolation uint Lod   : LOD;
+	nointerpolation float Fade : FADE;
+};
+
+// Band values and the fade-out flag, as in Common/VegetationLod.h and BillboardBatch.h.
+#define LOD_MID      1
+#define LOD_FADE_OUT 0x80
+
+static const float gDither[16] =
+{
+	 0.5f/16.0f,  8.5f/16.0f,  2.5f/16.0f, 10.5f/16.0f,
+	12.5f/16.0f,  4.5f/16.0f, 14.5f/16.0f,  6.5f/16.0f,
+	 3.5f/16.0f, 11.5f/16.0f,  1.5f/16.0f,  9.5f/16.0f,
+	15.5f/16.0f,  7.5f/16.0f, 13.5f/16.0f,  5.5f/16.0f
+};
+
+VertexOut VS(VertexIn vin)
+{
+	VertexOut vout;
+
+	// y-axis aligned and facing the eye, as the TreeSprite geometry shader does.
+	float3 up = float3(0.0f, 1.0f, 0.0f);
+	float3 look = gEyePosW - vin.PosW;
+	look.y = 0.0f;
+	look = normalize(look);
+	float3 right = cross(up, look);
+
+	float3 posW = vin.PosW + vin.Corner.x*vin.SizeW.x*right + vin.Corner.y*vin.SizeW.y*up;
+
+	vout.PosH    = mul(float4(posW, 1.0f), gViewProj);
+	vout.PosW    = posW;
+	vout.NormalW = look;
+	vout.Tex     = float2(0.5f - vin.Corner.x, 1.0f - vin.Corner.y);
+	vout.Slice   = vin.Slice;
+	vout.Lod     = vin.Lod;
+	vout.Fade    = vin.Fade;
+
+	return vout;
+}
+
+float4 PS(VertexOut pin, uniform int gLightCount, uniform bool gUseTexure, uniform bool gAlphaClip, uniform bool gFogEnabled) : SV_Target
+{
+	// The incoming band keeps the pixels whose threshold is below Fade, the outgoing
+	// band the rest.
+	uint2 pixel = (uint2)pin.PosH.xy & 3;
+	float threshold = gDither[pixel.y*4 + pixel.x];
+	if(pin.Lod & LOD_FADE_OUT)
+		clip(threshold - pin.Fade);
+	else
+		clip(pin.Fade - threshold);
+
+	// Interpolating normal can unnormalize it, so normalize it.
+	pin.NormalW = normalize(pin.NormalW);
+
+	float3 toEye = gEyePosW - pin.PosW;
+	float distToEye = length(toEye);
+	toEye /= distToEye;
+
+	float4 texColor = float4(1, 1, 1, 1);
+	if(gUseTexure)
+	{
+		if((pin.Lod & ~LOD_FADE_OUT) == LOD_MID)
+			texColor = gTreeMapArray.SampleBias( samLinear, float3(pin.Tex, pin.Slice), gImpostorMipBias );
+		else
+			texColor = gTreeMapArray.Sample( samLinear, float3(pin.Tex, pin.Slice) );
+
+		if(gAlphaClip)
+		{
+			clip(texColor.a - 0.05f);
+		}
+	}
+
+	float4 litColor = texColor;
+	if( gLightCount > 0  )
+	{
+		float4 ambient = float4(0.0f, 0.0f, 0.0f, 0.0f);
+		float4 diffuse = float4(0.0f, 0.0f, 0.0f, 0.0f);
+		float4 spec    = float4(0.0f, 0.0f, 0.0f, 0.0f);
+
+		[unroll]
+		for(int i = 0; i < gLightCount; ++i)
+		{
+			float4 A, D, S;
+			ComputeDirectionalLight(gMaterial, gDirLights[i], pin.NormalW, toEye,
+				A, D, S);
+
+			ambient += A;
+			diffuse += D;
+			spec    += S;
+		}
+
+		litColor = texColor*(ambient + diffuse) + spec;
+	}
+
+	if( gFogEnabled )
+	{
+		float fogLerp = saturate( (distToEye - gFogStart) / gFogRange );
+		litColor = lerp(litColor, gFogColor, fogLerp);
+	}
+
+	litColor.a = gMaterial.Diffuse.a * texColor.a;
+
+	return litColor;
+}
+
+technique11 Light3
+{
+    pass P0
+    {
+        SetVertexShader( CompileShader( vs_5_0, VS() ) );
+		SetGeometryShader( NULL );
+        SetPixelShader( CompileShader( ps_5_0, PS(3, false, false, false) ) );
+    }
+}
+
+technique11 Light3TexAlphaClip
+{
+    pass P0
+    {
+        SetVertexShader( CompileShader( vs_5_0, VS() ) );
+		SetGeometryShader( NULL );
+        SetPixelShader( CompileShader( ps_5_0, PS(3, true, true, false) ) );
+    }
+}
+
+technique11 Light3TexAlphaClipFog
+{
+    pass P0
+    {
+        SetVertexShader( CompileShader( vs_5_0, VS() ) );
+		SetGeometryShader( NULL );
+        SetPixelShader( CompileShader( ps_5_0, PS(3, true, true, true) ) );
+    }
+}
@@ -0,0 +1,25 @@
+//=============================================================================
+// VertexCompression.fx
+//
+// Decoders for the compact vertex formats written by VertexCompression on the
+// CPU.  The input assembler already expands UNORM/SNORM/FLOAT16 elements to
+// floats, so only the octahedral fold and the chunk transform remain.
+//=============================================================================
+
+// e is the NORMAL element of a R16G16_SNORM octahedral normal, in [-1,1]^2.
+float3 OctDecode(float2 e)
+{
+	float3 n = float3(e.x, e.y, 1.0f - abs(e.x) - abs(e.y));
+
+	// Unfold the lower hemisphere.
+	float t = saturate(-n.z);
+	n.xy += n.xy >= 0.0f ? -t : t;
+
+	return normalize(n);
+}
+
+// q is the POSITION element of a R16G16B16A16_UNORM chunk-relative position.
+float3 DequantizePosition(float3 q, float3 chunkOrigin, float3 chunkExtent)
+{
+	return chunkOrigin + q*chunkExtent;
+}
@@ -1,23 +1,31 @@
 #include "Table.h"
 #include "LightHelper.fx"
+#include "VertexCompression.fx"
 
 #define wsToUvw(ws) (float3(ws.x/160.0f+0.5f, ws.z/160.0f+0.5f,ws.y/160.0f))
 
+// Split by how often they change; TerrainEffectConstants mirrors the layouts.
+cbuffer cbStatic
+{
+	float4x4 mTexTransform;
+	uint mCornerHeight;//33
+	float3 mVoxelSize;
+	Material gMaterial;
+};
 cbuffer cbPerFrame
 {
 	DirectionalLight gDirLights[3];
 	float3 gEyePosW;
+	float4x4 mViewProj;
 };
 cbuffer cbPerObject
 {
 	float4x4 mWorld;
 	//float4x4 mWorldInvTranspose;
 	float4x4 mWVP;
-	float4x4 mViewProj;
-	float4x4 mTexTransform;
-	uint mCornerHeight;//33
-	float3 mVoxelSize;
-	Material gMaterial;
+	// Box the drawn chunk's grid positions are quantized over (TerrainWorld::Chunk).
+	float3 mChunkOrigin;
+	float3 mChunkExtent;
 };
 Texture3D noiseTex;
 SamplerState Point
@@ -29,9 +37,12 @@ SamplerState Point
 	AddressW = CLAMP;
 };
 
+// Vertex::TerrainCompact; the normal is unused, the GS takes it from the density.
+// slab is the per-instance voxel layer: unlike SV_InstanceID it counts from the
+// draw's start instance, so draws can skip the hidden slabs at the bottom.
 struct vsIn {
-	float3 posL : POSITION;
-	float2 uv:TEXCOORD;
+	float4 posQ : POSITION;
+	uint slab : SLAB;
 };
 
 struct vsOutGsIn {
@@ -49,10 +60,11 @@ struct psInGsOut
 	float3 normal: NORMAL;
 	//uint instanceID : SV_RenderTargetArrayIndex;
 };
-vsOutGsIn VS(vsIn vin, uint instanceID:SV_InstanceID) {
+vsOutGsIn VS(vsIn vin) {
 	vsOutGsIn vout;
-	vout.posW = mul(float4(vin.posL, 1.0f), mWorld).xyz;
-	vout.posW.y = instanceID*mVoxelSize.y;
+	float3 posL = DequantizePosition(vin.posQ.xyz, mChunkOrigin, mChunkExtent);
+	vout.posW = mul(float4(posL, 1.0f), mWorld).xyz;
+	vout.posW.y = vin.slab*mVoxelSize.y;
 	float3 uvw = wsToUvw(vout.posW);
 	float2 step = float2(1.0f / 32, 0);
 	vout.f0123 = float4(noiseTex.SampleLevel(Point, uvw + step.yyy, 0).x,
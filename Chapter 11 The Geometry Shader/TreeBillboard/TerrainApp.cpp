@@ -1,4 +1,4 @@
-
+﻿
 #include "d3dApp.h"
 #include "d3dx11Effect.h"
 #include "GeometryGenerator.h"
@@ -7,18 +7,41 @@
 #include "Effects.h"
 #include "Vertex.h"
 #include "RenderStates.h"
-#include "Waves.h"
 #include <string>
-#include "FastNoise.h"
+#include <memory>
+#include "TextureStreamer.h"
+#include "D3D11TextureDevice.h"
+#include "TerrainWorld.h"
+#include "ParallelFor.h"
+#include "FrameGraph.h"
+#include "VertexCompression.h"
 using namespace DirectX;
 
-const int cornerWidth = 33;
-const int cornerDepth = 33;
-const int cornerHeight = 33;
-const int voxelWidth = cornerWidth - 1;
-const int voxelDepth = cornerDepth - 1;
-const int voxelHeight = cornerHeight - 1;
+// The world packs the grid and the waves in the layouts the shaders read.
+static_assert(sizeof(TerrainGridCompactVertex) == sizeof(Vertex::TerrainCompact), "TerrainGridCompactVertex must match Vertex::TerrainCompact");
+static_assert(sizeof(WaveCompactVertex) == sizeof(Vertex::BasicCompact), "WaveCompactVertex must match Vertex::BasicCompact");
+
+// Position, octahedral normal and half uv of each generated vertex.
+static void PackBasicVertices(const GeometryGenerator::MeshData& mesh, std::vector<Vertex::BasicCompact>& vertices)
+{
+	const size_t count = mesh.Vertices.size();
+	const size_t srcStride = sizeof(GeometryGenerator::Vertex);
+	const size_t dstStride = sizeof(Vertex::BasicCompact);
 
+	vertices.resize(count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		const Vec3& p = mesh.Vertices[i].Position;
+		vertices[i].pos = XMFLOAT3(p.x, p.y, p.z);
+	}
+	VertexCompression::EncodeOctNormals(&mesh.Vertices[0].Normal.x, srcStride, count, &vertices[0].Normal, dstStride);
+	VertexCompression::EncodeHalf2(&mesh.Vertices[0].TexC.x, srcStride, count, &vertices[0].uv, dstStride);
+}
+
+static XMMATRIX ToXMMatrix(const Mat4& m)
+{
+	return XMLoadFloat4x4(reinterpret_cast<const XMFLOAT4X4*>(m.Data()));
+}
 
 enum RenderOptions
 {
@@ -50,8 +73,18 @@ private:
 	void BuildCrateGeometryBuffers();
 	void InitDensitySRV();
 	void BuildTerrainGeometryBuffers();
-	void DrawDensityFX(CXMMATRIX viewProj);
+	void BuildTreeBillboardBuffers();
+	void BuildFrameGraph();
+	void SetTerrainConstants();
+	void RecordScene();
+	void RecordTreeBillboards(CXMMATRIX viewProj);
+	void DrawTerrain();
+	void DrawTrees();
+	void DrawDensityFX();
+	void DrawLandAndWaves();
 	void HandleImGui();
+	void UpdateTextureStreaming();
+	void DrawProfilerOverlay();
 
 private:
 	ID3D11Buffer* mLandVB;
@@ -63,15 +96,44 @@ private:
 	ID3D11Buffer* mBoxVB;
 	ID3D11Buffer* mBoxIB;
 
-	ID3D11Buffer* mTerrainVB;
-	ID3D11Buffer* mTerrainIB;
-
+	// Owned by mTextureStreamer; refreshed every frame as finer mips arrive.
 	ID3D11ShaderResourceView* mGrassMapSRV;
 	ID3D11ShaderResourceView* mWavesMapSRV;
 	ID3D11ShaderResourceView* mBoxMapSRV;
+	ID3D11ShaderResourceView* mTreeMapSRV;
 	ID3D11ShaderResourceView* mDensitySRV;
 
-	Waves mWaves;
+	std::unique_ptr<TextureStreamer> mTextureStreamer;
+	TextureStreamer::TextureId mGrassTex;
+	TextureStreamer::TextureId mWavesTex;
+	TextureStreamer::TextureId mBoxTex;
+	TextureStreamer::TextureId mTreeTex;
+
+	// Everything simulated and culled on the CPU: the density field, the chunked grid,
+	// the occluders, the trees and their LOD, the waves and the camera.
+	TerrainWorld mWorld;
+
+	// The terrain's draws are recorded on the worker threads into mTerrainLists, one
+	// chunk range each, and the trees' into mTreeList; mDrawQueue merges them in that
+	// order, sorts and submits through mRenderDevice.  The terrain and tree buffers are
+	// created through mRenderDevice; the terrain and tree instance buffers are filled
+	// from mWorld.
+	std::vector<DrawCommandList> mTerrainLists;
+	DrawCommandList mTreeList;
+	std::vector<const DrawCommandList*> mDrawLists;
+	DrawQueue mDrawQueue;
+	DrawState mTerrainDrawState;
+	DrawState mTreeDrawState;
+	DrawHandle mTreePipelines[3];   // Indexed by RenderOptions.
+	size_t mTerrainDraws;
+
+	// DrawScene runs the live passes of mFrameGraph.  The density slices and the old
+	// sine land and waves are passes that start disabled; the profiler window toggles
+	// them.
+	FrameGraph mFrameGraph;
+	FrameGraph::PassId mDensityPass;
+	FrameGraph::PassId mLandAndWavesPass;
+	std::string mFrameGraphError;
 
 	DirectionalLight mDirLights[3];
 	Material mLandMat;
@@ -88,11 +150,15 @@ private:
 
 	XMFLOAT4X4 mTerrainWorld;
 
-	XMFLOAT4X4 mView;
-	XMFLOAT4X4 mProj;
-
 	UINT mLandIndexCount;
-	UINT mTerrainIndexCount;
+
+	// Trees are drawn as instanced billboards, one draw per texture array slice.
+	static const float TreeImpostorMipBias;
+
+	std::vector<uint32_t> mFrameHistogram;
+	std::string mProfilerStatus;
+	// The CPU side of the marching cubes pass, which extracts the surface on the GPU.
+	FrameProfiler::ScopeId mExtractionScope;
 
 	static const UINT NoiseQuadPointCount = 28;
 
@@ -104,22 +170,14 @@ private:
 
 	XMFLOAT3 mEyePosW;
 
-	float mTheta;
-	float mPhi;
-	float mRadius;
-	float mTargetX;
-	float mTargetY;
-
 	POINT mLastMousePos;
 
 	ID3D11Texture3D* mDensityTexture3d;
 	ID3D11RenderTargetView* mDensityRTV;
-
-
-	float noiseMap[cornerWidth * cornerDepth * cornerHeight];
-
 };
 
+const float TerrainApp::TreeImpostorMipBias = 2.0f;
+
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance,
 	PSTR cmdLine, int showCmd)
 {
@@ -136,10 +194,11 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance,
 }
 
 TerrainApp::TerrainApp(HINSTANCE hInstance)
-	: D3DApp(hInstance), mLandVB(0), mLandIB(0), mWavesVB(0), mWavesIB(0), mBoxVB(0), mBoxIB(0), mTerrainVB(0), mTerrainIB(0),
-	mGrassMapSRV(0), mWavesMapSRV(0), mBoxMapSRV(0), mAlphaToCoverageOn(true),
-	mWaterTexOffset(0.0f, 0.0f), mEyePosW(0.0f, 0.0f, 0.0f), mLandIndexCount(0), mTerrainIndexCount(0), mRenderOptions(RenderOptions::TexturesAndFog),
-	mTheta(1.3f*MathHelper::Pi), mPhi(0.4f*MathHelper::Pi), mRadius(80.0f), mTargetX(0), mTargetY(0)
+	: D3DApp(hInstance), mLandVB(0), mLandIB(0), mWavesVB(0), mWavesIB(0), mBoxVB(0), mBoxIB(0),
+	mGrassMapSRV(0), mWavesMapSRV(0), mBoxMapSRV(0), mTreeMapSRV(0), mGrassTex(TextureStreamer::InvalidTexture),
+	mWavesTex(TextureStreamer::InvalidTexture), mBoxTex(TextureStreamer::InvalidTexture), mTreeTex(TextureStreamer::InvalidTexture),
+	mTerrainDraws(0), mDensityPass(0), mLandAndWavesPass(0), mAlphaToCoverageOn(true),
+	mWaterTexOffset(0.0f, 0.0f), mEyePosW(0.0f, 0.0f, 0.0f), mLandIndexCount(0), mRenderOptions(RenderOptions::TexturesAndFog)
 {
 	mMainWndCaption = L"Terrain Demo";
 	mEnable4xMsaa = true;
@@ -147,12 +206,18 @@ TerrainApp::TerrainApp(HINSTANCE hInstance)
 	mLastMousePos.x = 0;
 	mLastMousePos.y = 0;
 
+	mWorld.SetProfiler(&mProfiler);
+	mExtractionScope = mProfiler.AddScope("Terrain extraction");
+
+	mTerrainLists.resize(ParallelForPool::Instance().ThreadCount());
+	for (size_t i = 0; i < mTerrainLists.size(); ++i)
+		mDrawLists.push_back(&mTerrainLists[i]);
+	mDrawLists.push_back(&mTreeList);
+
 	XMMATRIX I = XMMatrixIdentity();
 	XMStoreFloat4x4(&mLandWorld, I);
 	XMStoreFloat4x4(&mTerrainWorld, I);
 	XMStoreFloat4x4(&mWavesWorld, I);
-	XMStoreFloat4x4(&mView, I);
-	XMStoreFloat4x4(&mProj, I);
 	XMStoreFloat4x4(&mTerrainTexTransform, I);
 
 	XMMATRIX boxScale = XMMatrixScaling(15.0f, 15.0f, 15.0f);
@@ -203,11 +268,7 @@ TerrainApp::~TerrainApp()
 	ReleaseCOM(mWavesIB);
 	ReleaseCOM(mBoxVB);
 	ReleaseCOM(mBoxIB);
-	ReleaseCOM(mTerrainVB);
-	ReleaseCOM(mTerrainIB);
-	ReleaseCOM(mGrassMapSRV);
-	ReleaseCOM(mWavesMapSRV);
-	ReleaseCOM(mBoxMapSRV);
+	mTextureStreamer.reset();
 	ReleaseCOM(mDensityRTV);
 	ReleaseCOM(mDensitySRV);
 	ReleaseCOM(mDensityTexture3d);
@@ -222,30 +283,20 @@ bool TerrainApp::Init()
 	if (!D3DApp::Init())
 		return false;
 
-
-	mWaves.Init(160, 160, 1.0f, 0.03f, 5.0f, 0.3f);
+	mWorld.Build();
 
 	// Must init Effects first since InputLayouts depend on shader signatures.
 	Effects::InitAll(md3dDevice);
 	InputLayouts::InitAll(md3dDevice);
 	RenderStates::InitAll(md3dDevice);
-	ID3D11Resource* texResource = nullptr;
-	HR(DirectX::CreateDDSTextureFromFile(md3dDevice,
-		L"Textures/grass.dds", &texResource, &mGrassMapSRV));
-	ReleaseCOM(texResource); // view saves reference
-
-	HR(DirectX::CreateDDSTextureFromFile(md3dDevice,
-		L"Textures/water2.dds", &texResource, &mWavesMapSRV));
-	ReleaseCOM(texResource); // view saves reference
-
-	HR(DirectX::CreateDDSTextureFromFile(md3dDevice,
-		L"Textures/WireFence.dds", &texResource, &mBoxMapSRV));
-	ReleaseCOM(texResource); // view saves reference
-
-	HR(DirectX::CreateDDSTextureFromFile(md3dDevice,
-		L"Textures/volTex.dds", &texResource, &mDensitySRV));
-	ReleaseCOM(texResource); // view saves reference
 
+	// Textures stream in the background, coarsest mips first; the SRVs are picked up
+	// in UpdateTextureStreaming.  The density volume is uploaded by InitDensitySRV.
+	mTextureStreamer.reset(new TextureStreamer(mRenderDevice->TextureDevice()));
+	mGrassTex = mTextureStreamer->Load("Textures/grass.dds");
+	mWavesTex = mTextureStreamer->Load("Textures/water2.dds");
+	mBoxTex = mTextureStreamer->Load("Textures/WireFence.dds");
+	mTreeTex = mTextureStreamer->Load("Textures/arrayTex.dds");
 
 	InitDensitySRV();
 
@@ -254,72 +305,88 @@ bool TerrainApp::Init()
 	BuildWaveGeometryBuffers();
 	BuildCrateGeometryBuffers();
 	BuildTerrainGeometryBuffers();
+	BuildTreeBillboardBuffers();
+
+	// The terrain draws carry their chunk's box for the marching cubes cbPerObject.
+	D3D11DrawBackend& backend = mRenderDevice->Backend();
+	backend.SetConstantBackend(&Effects::MarchingCubesFX->ConstantBackend());
+	mTerrainDrawState.Pipeline = backend.AddPipeline(Effects::MarchingCubesFX->MarchingCubes->GetPassByIndex(0));
+	mTerrainDrawState.InputLayout = backend.AddInputLayout(InputLayouts::MarchingCubes);
+	mTerrainDrawState.Topology = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+
+	// Trees go in a later layer so they are submitted after the terrain, with their
+	// own blend state.
+	mTreePipelines[RenderOptions::Lighting] = backend.AddPipeline(Effects::TreeBillboardFX->Light3Tech->GetPassByIndex(0));
+	mTreePipelines[RenderOptions::Textures] = backend.AddPipeline(Effects::TreeBillboardFX->Light3TexAlphaClipTech->GetPassByIndex(0));
+	mTreePipelines[RenderOptions::TexturesAndFog] = backend.AddPipeline(Effects::TreeBillboardFX->Light3TexAlphaClipFogTech->GetPassByIndex(0));
+	mTreeDrawState.Layer = 1;
+	mTreeDrawState.InputLayout = backend.AddInputLayout(InputLayouts::TreeBillboard);
+	mTreeDrawState.Topology = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP;
+
+	BuildFrameGraph();
+	if (!mFrameGraph.Compile(&mFrameGraphError))
+	{
+		std::wstring message(mFrameGraphError.begin(), mFrameGraphError.end());
+		MessageBox(0, message.c_str(), L"Frame graph", MB_OK);
+		return false;
+	}
 
 	return true;
 }
 
-void TerrainApp::OnResize()
+void TerrainApp::BuildFrameGraph()
 {
-	D3DApp::OnResize();
-
-	XMMATRIX P = XMMatrixPerspectiveFovLH(0.25f*MathHelper::Pi, AspectRatio(), 1.0f, 1000.0f);
-	XMStoreFloat4x4(&mProj, P);
-}
+	// Passes run in this order.  "Visible draws" is the CPU culling result, so the
+	// culling and recording go away with the last pass that submits them.
+	FrameGraph::ResourceId backBuffer = mFrameGraph.Import("Back buffer", true);
+	FrameGraph::ResourceId density = mFrameGraph.Import("Density volume");
+	FrameGraph::ResourceId draws = mFrameGraph.Import("Visible draws");
 
-void TerrainApp::UpdateScene(float dt)
-{
-	// Convert Spherical to Cartesian coordinates.
-	float x = mRadius*sinf(mPhi)*cosf(mTheta);
-	float z = mRadius*sinf(mPhi)*sinf(mTheta);
-	float y = mRadius*cosf(mPhi);
-
-	mEyePosW = XMFLOAT3(x, y, z);
-
-	// Build the view matrix.
-	XMVECTOR pos = XMVectorSet(x+ mTargetX*sinf(mTheta), y+ mTargetY, z-mTargetX*cosf(mTheta), 1.0f);
-	XMVECTOR target = XMVectorSet(+mTargetX*sinf(mTheta),+mTargetY, -mTargetX*cosf(mTheta), 1.0f);
-	XMVECTOR up = XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
-
-	XMMATRIX V = XMMatrixLookAtLH(pos, target, up);
-	XMStoreFloat4x4(&mView, V);
-
-	//
-	// Every quarter second, generate a random wave.
-	//
-	static float t_base = 0.0f;
-	if ((mTimer.TotalTime() - t_base) >= 0.1f)
+	FrameGraph::PassId clear = mFrameGraph.AddPass("Clear", [this]()
 	{
-		t_base += 0.1f;
+		mRenderDevice->Clear(reinterpret_cast<const float*>(&Colors::Black));
+	});
+	mFrameGraph.Write(clear, backBuffer);
 
-		DWORD i = 5 + rand() % (mWaves.RowCount() - 10);
-		DWORD j = 5 + rand() % (mWaves.ColumnCount() - 10);
+	FrameGraph::PassId cull = mFrameGraph.AddPass("Cull and record", [this]() { RecordScene(); });
+	mFrameGraph.Write(cull, draws);
 
-		float r = MathHelper::RandF(0.5f, 1.0f);
+	FrameGraph::PassId terrain = mFrameGraph.AddPass("Marching cubes", [this]() { DrawTerrain(); });
+	mFrameGraph.Read(terrain, density);
+	mFrameGraph.Read(terrain, draws);
+	mFrameGraph.Write(terrain, backBuffer);
 
-		mWaves.Disturb(i, j, r);
-	}
+	FrameGraph::PassId trees = mFrameGraph.AddPass("Tree billboards", [this]() { DrawTrees(); });
+	mFrameGraph.Read(trees, draws);
+	mFrameGraph.Write(trees, backBuffer);
 
-	mWaves.Update(dt);
+	mDensityPass = mFrameGraph.AddPass("Density slices", [this]() { DrawDensityFX(); });
+	mFrameGraph.Read(mDensityPass, density);
+	mFrameGraph.Write(mDensityPass, backBuffer);
+	mFrameGraph.SetEnabled(mDensityPass, false);
 
-	//
-	// Update the wave vertex buffer with the new solution.
-	//
+	mLandAndWavesPass = mFrameGraph.AddPass("Sine land and waves", [this]() { DrawLandAndWaves(); });
+	mFrameGraph.Write(mLandAndWavesPass, backBuffer);
+	mFrameGraph.SetEnabled(mLandAndWavesPass, false);
 
-	D3D11_MAPPED_SUBRESOURCE mappedData;
-	HR(md3dImmediateContext->Map(mWavesVB, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedData));
+	FrameGraph::PassId gui = mFrameGraph.AddPass("ImGui", []() { ImGui::Render(); });
+	mFrameGraph.Write(gui, backBuffer);
+}
 
-	Vertex::Basic32* v = reinterpret_cast<Vertex::Basic32*>(mappedData.pData);
-	for (UINT i = 0; i < mWaves.VertexCount(); ++i)
-	{
-		v[i].pos = mWaves[i];
-		//v[i].Normal = mWaves.Normal(i);
+void TerrainApp::OnResize()
+{
+	D3DApp::OnResize();
 
-		// Derive tex-coords in [0,1] from position.
-		v[i].uv.x = 0.5f + mWaves[i].x / mWaves.Width();
-		v[i].uv.y = 0.5f - mWaves[i].z / mWaves.Depth();
-	}
+	mWorld.Camera().Aspect = AspectRatio();
+}
 
-	md3dImmediateContext->Unmap(mWavesVB, 0);
+void TerrainApp::UpdateScene(float dt)
+{
+	Vec3 eye = mWorld.Camera().Eye();
+	mEyePosW = XMFLOAT3(eye.x, eye.y, eye.z);
+
+	// Disturbs and steps the waves and updates the tree LOD bands.
+	mWorld.Update(dt);
 
 	//
 	// Animate water texture coordinates.
@@ -353,194 +420,203 @@ void TerrainApp::UpdateScene(float dt)
 
 	if (GetAsyncKeyState('T') & 0x8000)
 		mAlphaToCoverageOn = false;
+
+	UpdateTextureStreaming();
+}
+
+void TerrainApp::UpdateTextureStreaming()
+{
+	// Priority approximates on-screen size: inverse distance from the eye to the
+	// object using the texture.  In lighting-only mode nothing is sampled, so the
+	// textures stop refining and become the first to give up memory.
+	float texturesVisible = mRenderOptions == RenderOptions::Lighting ? 0.0f : 1.0f;
+
+	XMVECTOR eye = XMLoadFloat3(&mEyePosW);
+	XMVECTOR landCenter = XMVector3Transform(XMVectorZero(), XMLoadFloat4x4(&mLandWorld));
+	XMVECTOR wavesCenter = XMVector3Transform(XMVectorZero(), XMLoadFloat4x4(&mWavesWorld));
+	XMVECTOR boxCenter = XMVector3Transform(XMVectorZero(), XMLoadFloat4x4(&mBoxWorld));
+
+	float landDist = XMVectorGetX(XMVector3Length(landCenter - eye));
+	float wavesDist = XMVectorGetX(XMVector3Length(wavesCenter - eye));
+	float boxDist = XMVectorGetX(XMVector3Length(boxCenter - eye));
+
+	mTextureStreamer->SetPriority(mGrassTex, texturesVisible / MathHelper::Max(1.0f, landDist));
+	mTextureStreamer->SetPriority(mWavesTex, texturesVisible / MathHelper::Max(1.0f, wavesDist));
+	mTextureStreamer->SetPriority(mBoxTex, texturesVisible / MathHelper::Max(1.0f, boxDist));
+	mTextureStreamer->SetPriority(mTreeTex, texturesVisible / MathHelper::Max(1.0f, landDist));
+
+	mTextureStreamer->Update();
+
+	mGrassMapSRV = D3D11TextureDevice::ToSRV(mTextureStreamer->GetTexture(mGrassTex));
+	mWavesMapSRV = D3D11TextureDevice::ToSRV(mTextureStreamer->GetTexture(mWavesTex));
+	mBoxMapSRV = D3D11TextureDevice::ToSRV(mTextureStreamer->GetTexture(mBoxTex));
+	mTreeMapSRV = D3D11TextureDevice::ToSRV(mTextureStreamer->GetTexture(mTreeTex));
 }
 
 void TerrainApp::DrawScene()
 {
 	//gui
 	HandleImGui();
-	//background
-	md3dImmediateContext->ClearRenderTargetView(mRenderTargetView, reinterpret_cast<const float*>(&Colors::Black));
-	md3dImmediateContext->ClearDepthStencilView(mDepthStencilView, D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.0f, 0);
-	//basic reference
-	float blendFactor[] = { 0.0f, 0.0f, 0.0f, 0.0f };
-
-	XMMATRIX view = XMLoadFloat4x4(&mView);
-	XMMATRIX proj = XMLoadFloat4x4(&mProj);
-	XMMATRIX viewProj = view*proj;  
 
-	md3dImmediateContext->RSSetState(RenderStates::NoCullRS);
-
-	md3dImmediateContext->IASetInputLayout(InputLayouts::MarchingCubes);
-	md3dImmediateContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-	UINT stride = sizeof(Vertex::TerrainVertex);
-	UINT offset = 0;
-
-	//begin to draw
-	D3DX11_TECHNIQUE_DESC techDesc;
-	Effects::MarchingCubesFX->MarchingCubes->GetDesc(&techDesc);
+	// A graph that stops compiling after a toggle draws nothing; the profiler window
+	// shows why.
+	mFrameGraphError.clear();
+	mFrameGraph.Execute(&mFrameGraphError);
+	mRenderDevice->Present();
+}
 
-	//
-	// Draw the hills.
-	//
-	md3dImmediateContext->IASetVertexBuffers(0, 1, &mTerrainVB, &stride, &offset);
-	md3dImmediateContext->IASetIndexBuffer(mTerrainIB, DXGI_FORMAT_R32_UINT, 0);
+void TerrainApp::SetTerrainConstants()
+{
+	XMMATRIX view = ToXMMatrix(mWorld.Camera().View());
+	XMMATRIX proj = ToXMMatrix(mWorld.Camera().Proj());
+	XMMATRIX viewProj = view*proj;
 
 	// Set per object constants.
 	XMMATRIX world = XMLoadFloat4x4(&mTerrainWorld);
 	XMMATRIX worldInvTranspose = MathHelper::InverseTranspose(world);
 	XMMATRIX worldViewProj = world*view*proj;
-	XMFLOAT3 voxelSize = XMFLOAT3(160.0f / (voxelWidth), 160.0f / (voxelDepth), 160.0f / (voxelHeight));//cracks
+	Vec3 voxel = mWorld.VoxelSize();
+	XMFLOAT3 voxelSize = XMFLOAT3(voxel.x, voxel.y, voxel.z);//cracks
 
 	Effects::MarchingCubesFX->SetWorld(world);
 	Effects::MarchingCubesFX->SetWorldInvTranspose(worldInvTranspose);
 	Effects::MarchingCubesFX->SetWorldViewProj(worldViewProj);
 	Effects::MarchingCubesFX->SetViewProj(viewProj);
 	Effects::MarchingCubesFX->SetTexTransform(XMLoadFloat4x4(&mTerrainTexTransform));
-	Effects::MarchingCubesFX->SetCornerHeight(cornerHeight);
+	Effects::MarchingCubesFX->SetCornerHeight(mWorld.GetSettings().Corners);
 	Effects::MarchingCubesFX->SetVoxelSize(voxelSize);
 	Effects::MarchingCubesFX->SetNoiseTex(mDensitySRV);
 	Effects::MarchingCubesFX->SetDirLights(mDirLights);
 	Effects::MarchingCubesFX->SetEyePosW(mEyePosW);
 	Effects::MarchingCubesFX->SetMaterial(mLandMat);
 
-	Effects::MarchingCubesFX->MarchingCubes->GetPassByIndex(0)->Apply(0, md3dImmediateContext);
+	// Only the ranges that changed since last frame reach the effect: the static
+	// constants once, the camera's when it moves.  With a still camera nothing is
+	// written and Apply skips the constant buffer updates.
+	Effects::MarchingCubesFX->FlushConstants();
+}
+
+void TerrainApp::RecordScene()
+{
+	// Cull every chunk's slabs against the view frustum and then the nearby terrain.
+	// Chunks with no visible slab cost nothing.
+	mWorld.Cull();
 
-	md3dImmediateContext->DrawIndexedInstanced(mTerrainIndexCount, voxelHeight, 0, 0,0);
+	for (size_t i = 0; i < mTerrainLists.size(); ++i)
+		mTerrainLists[i].Clear();
+	mTerrainDraws = mWorld.RecordTerrain(mTerrainLists.data(), mTerrainLists.size(), mTerrainDrawState);
 
-	//md3dImmediateContext->OMSetBlendState(0, blendFactor, 0xffffffff);
+	mTreeList.Clear();
+	RecordTreeBillboards(ToXMMatrix(mWorld.ViewProj()));
+
+	mDrawQueue.Gather(mDrawLists.data(), mDrawLists.size());
+}
+
+void TerrainApp::DrawTerrain()
+{
+	FrameProfiler::Scope scope(mProfiler, mExtractionScope);
+	SetTerrainConstants();
+
+	md3dImmediateContext->RSSetState(RenderStates::NoCullRS);
+	mDrawQueue.Submit(mRenderDevice->DrawBackend(), 0, mTerrainDraws);
+}
+
+void TerrainApp::DrawTrees()
+{
+	float blendFactor[] = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+	md3dImmediateContext->RSSetState(RenderStates::NoCullRS);
+	if (mAlphaToCoverageOn)
+		md3dImmediateContext->OMSetBlendState(RenderStates::AlphaToCoverageBS, blendFactor, 0xffffffff);
+	mDrawQueue.Submit(mRenderDevice->DrawBackend(), mTerrainDraws, mDrawQueue.Count());
+	md3dImmediateContext->OMSetBlendState(0, blendFactor, 0xffffffff);
+}
 
+void TerrainApp::DrawLandAndWaves()
+{
 	//
-	// Draw the density texture3d
+	// Update the wave vertex buffer with the new solution.
 	//
 
-	//DrawDensityFX(viewProj);
+	D3D11_MAPPED_SUBRESOURCE mappedData;
+	HR(md3dImmediateContext->Map(mWavesVB, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedData));
 
+	mWorld.PackWaveVertices(reinterpret_cast<WaveCompactVertex*>(mappedData.pData));
 
-#pragma region drawSinLand  
-	//md3dImmediateContext->IASetInputLayout(InputLayouts::Basic32);
-	//md3dImmediateContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-	//stride = sizeof(Vertex::Basic32);
-	//offset = 0;
+	md3dImmediateContext->Unmap(mWavesVB, 0);
 
-	////
-	//// Set per frame constants for the rest of the objects.
-	////
-	//Effects::BasicFX->SetDirLights(mDirLights);
-	//Effects::BasicFX->SetEyePosW(mEyePosW);
-	//Effects::BasicFX->SetFogColor(Colors::Silver);
-	//Effects::BasicFX->SetFogStart(15.0f);
-	//Effects::BasicFX->SetFogRange(175.0f);
+	XMMATRIX view = ToXMMatrix(mWorld.Camera().View());
+	XMMATRIX proj = ToXMMatrix(mWorld.Camera().Proj());
+	float blendFactor[] = { 0.0f, 0.0f, 0.0f, 0.0f };
 
-	////
-	//// Figure out which technique to use.
-	////
-	//ID3DX11EffectTechnique* boxTech;
-	//ID3DX11EffectTechnique* landAndWavesTech;
+	md3dImmediateContext->IASetInputLayout(InputLayouts::BasicCompact);
+	md3dImmediateContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	UINT stride = sizeof(Vertex::BasicCompact);
+	UINT offset = 0;
 
-	//switch (mRenderOptions)
-	//{
-	//case RenderOptions::Lighting:
-	//	boxTech = Effects::BasicFX->Light3Tech;
-	//	landAndWavesTech = Effects::BasicFX->Light3Tech;
-	//	break;
-	//case RenderOptions::Textures:
-	//	boxTech = Effects::BasicFX->Light3TexAlphaClipTech;
-	//	landAndWavesTech = Effects::BasicFX->Light3TexTech;
-	//	break;
-	//case RenderOptions::TexturesAndFog:
-	//	boxTech = Effects::BasicFX->Light3TexAlphaClipFogTech;
-	//	landAndWavesTech = Effects::BasicFX->Light3TexFogTech;
-	//	break;
-	//}
+	//
+	// Set per frame constants for the rest of the objects.
+	//
+	Effects::BasicFX->SetDirLights(mDirLights);
+	Effects::BasicFX->SetEyePosW(mEyePosW);
+	Effects::BasicFX->SetFogColor(Colors::Silver);
+	Effects::BasicFX->SetFogStart(15.0f);
+	Effects::BasicFX->SetFogRange(175.0f);
 
+	//
+	// Figure out which technique to use.
+	//
+	ID3DX11EffectTechnique* landAndWavesTech = Effects::BasicFX->Light3Tech;
+	switch (mRenderOptions)
+	{
+	case RenderOptions::Lighting:
+		landAndWavesTech = Effects::BasicFX->Light3Tech;
+		break;
+	case RenderOptions::Textures:
+		landAndWavesTech = Effects::BasicFX->Light3TexTech;
+		break;
+	case RenderOptions::TexturesAndFog:
+		landAndWavesTech = Effects::BasicFX->Light3TexFogTech;
+		break;
+	}
 
-	////
-	//// Draw the box.
-	//// 
-
-	////boxTech->GetDesc(&techDesc);
-	/////*for (UINT p = 0; p < techDesc.Passes; ++p)
-	////{*/
-	////UINT p = 0;
-	////	md3dImmediateContext->IASetVertexBuffers(0, 1, &mBoxVB, &stride, &offset);
-	////	md3dImmediateContext->IASetIndexBuffer(mBoxIB, DXGI_FORMAT_R32_UINT, 0);
-
-	////	// Set per object constants.
-	////	XMMATRIX world = XMLoadFloat4x4(&mBoxWorld);
-	////	XMMATRIX worldInvTranspose = MathHelper::InverseTranspose(world);
-	////	XMMATRIX worldViewProj = world*view*proj;
-
-	////	Effects::BasicFX->SetWorld(world);
-	////	Effects::BasicFX->SetWorldInvTranspose(worldInvTranspose);
-	////	Effects::BasicFX->SetWorldViewProj(worldViewProj);
-	////	Effects::BasicFX->SetTexTransform(XMMatrixIdentity());
-	////	//Effects::BasicFX->SetMaterial(mBoxMat);
-	////	//Effects::BasicFX->SetDiffuseMap(mBoxMapSRV);
-
-	////	//md3dImmediateContext->OMSetBlendState(RenderStates::AlphaToCoverageBS, blendFactor, 0xffffffff);
-	////	md3dImmediateContext->RSSetState(RenderStates::NoCullRS);
-	////	boxTech->GetPassByIndex(p)->Apply(0, md3dImmediateContext);
-	////	md3dImmediateContext->DrawIndexed(36, 0, 0);
-
-	////	// Restore default render state.
-	////	md3dImmediateContext->RSSetState(0);
-	//////}
-
-	////
-	//// Draw the hills and water with texture and fog (no alpha clipping needed).
-	////
-
-	//landAndWavesTech->GetDesc(&techDesc);
-	//UINT p = 0;
-	//	
-	//	md3dImmediateContext->IASetVertexBuffers(0, 1, &mLandVB, &stride, &offset);
-	//	md3dImmediateContext->IASetIndexBuffer(mLandIB, DXGI_FORMAT_R32_UINT, 0);
-
-	//	world = XMLoadFloat4x4(&mLandWorld);
-	//	worldInvTranspose = MathHelper::InverseTranspose(world);
-	//	worldViewProj = world*view*proj;
-
-	//	Effects::BasicFX->SetWorld(world);
-	//	Effects::BasicFX->SetWorldInvTranspose(worldInvTranspose);
-	//	Effects::BasicFX->SetWorldViewProj(worldViewProj);
-	//	Effects::BasicFX->SetTexTransform(XMLoadFloat4x4(&mGrassTexTransform));
-	//	Effects::BasicFX->SetMaterial(mLandMat);
-	//	Effects::BasicFX->SetDiffuseMap(mGrassMapSRV);
-
-	//	landAndWavesTech->GetPassByIndex(p)->Apply(0, md3dImmediateContext);
-	//	md3dImmediateContext->DrawInstanced(mLandIndexCount, 1,0, 0);
-
-	////}
-	//	//
-	//	// Draw the waves.
-	//	//
-	//	md3dImmediateContext->IASetVertexBuffers(0, 1, &mWavesVB, &stride, &offset);
-	//	md3dImmediateContext->IASetIndexBuffer(mWavesIB, DXGI_FORMAT_R32_UINT, 0);
-
-	//	// Set per object constants.
-	//	world = XMLoadFloat4x4(&mWavesWorld);
-	//	worldInvTranspose = MathHelper::InverseTranspose(world);
-	//	worldViewProj = world*view*proj;
-
-	//	Effects::BasicFX->SetWorld(world);
-	//	Effects::BasicFX->SetWorldInvTranspose(worldInvTranspose);
-	//	Effects::BasicFX->SetWorldViewProj(worldViewProj);
-	//	Effects::BasicFX->SetTexTransform(XMLoadFloat4x4(&mWaterTexTransform));
-	//	Effects::BasicFX->SetMaterial(mWavesMat);
-	//	Effects::BasicFX->SetDiffuseMap(mWavesMapSRV);
-
-	//	md3dImmediateContext->OMSetBlendState(RenderStates::TransparentBS, blendFactor, 0xffffffff);
-	//	landAndWavesTech->GetPassByIndex(p)->Apply(0, md3dImmediateContext);
-	//	md3dImmediateContext->DrawIndexed(3 * mWaves.TriangleCount(), 0, 0);
-
-	//	// Restore default blend state
-	//md3dImmediateContext->OMSetBlendState(0, blendFactor, 0xffffffff);
-	//}
+	//
+	// Draw the hills with texture and fog (no alpha clipping needed).
+	//
+	md3dImmediateContext->IASetVertexBuffers(0, 1, &mLandVB, &stride, &offset);
+	md3dImmediateContext->IASetIndexBuffer(mLandIB, DXGI_FORMAT_R32_UINT, 0);
+
+	XMMATRIX world = XMLoadFloat4x4(&mLandWorld);
+	Effects::BasicFX->SetWorld(world);
+	Effects::BasicFX->SetWorldInvTranspose(MathHelper::InverseTranspose(world));
+	Effects::BasicFX->SetWorldViewProj(world*view*proj);
+	Effects::BasicFX->SetTexTransform(XMLoadFloat4x4(&mGrassTexTransform));
+	Effects::BasicFX->SetMaterial(mLandMat);
+	Effects::BasicFX->SetDiffuseMap(mGrassMapSRV);
+
+	landAndWavesTech->GetPassByIndex(0)->Apply(0, md3dImmediateContext);
+	md3dImmediateContext->DrawIndexed(mLandIndexCount, 0, 0);
 
-#pragma endregion drawSinLand  
- 	ImGui::Render();
-	HR(mSwapChain->Present(0, 0));
+	//
+	// Draw the waves.
+	//
+	md3dImmediateContext->IASetVertexBuffers(0, 1, &mWavesVB, &stride, &offset);
+	md3dImmediateContext->IASetIndexBuffer(mWavesIB, DXGI_FORMAT_R32_UINT, 0);
+
+	world = XMLoadFloat4x4(&mWavesWorld);
+	Effects::BasicFX->SetWorld(world);
+	Effects::BasicFX->SetWorldInvTranspose(MathHelper::InverseTranspose(world));
+	Effects::BasicFX->SetWorldViewProj(world*view*proj);
+	Effects::BasicFX->SetTexTransform(XMLoadFloat4x4(&mWaterTexTransform));
+	Effects::BasicFX->SetMaterial(mWavesMat);
+	Effects::BasicFX->SetDiffuseMap(mWavesMapSRV);
+
+	md3dImmediateContext->OMSetBlendState(RenderStates::TransparentBS, blendFactor, 0xffffffff);
+	landAndWavesTech->GetPassByIndex(0)->Apply(0, md3dImmediateContext);
+	md3dImmediateContext->DrawIndexed(3 * mWorld.GetWaves().TriangleCount(), 0, 0);
+
+	// Restore default blend state
+	md3dImmediateContext->OMSetBlendState(0, blendFactor, 0xffffffff);
 }
 
 void TerrainApp::OnMouseDown(WPARAM btnState, int x, int y)
@@ -565,11 +641,12 @@ void TerrainApp::OnMouseMove(WPARAM btnState, int x, int y)
 		float dy = XMConvertToRadians(0.25f*static_cast<float>(y - mLastMousePos.y));
 
 		// Update angles based on input to orbit camera around box.
-		mTheta += dx;
-		mPhi += dy;
+		OrbitCamera& camera = mWorld.Camera();
+		camera.Theta += dx;
+		camera.Phi += dy;
 
-		// Restrict the angle mPhi.
-		mPhi = MathHelper::Clamp(mPhi, 0.1f, MathHelper::Pi - 0.1f);
+		// Restrict the angle Phi.
+		camera.Phi = MathHelper::Clamp(camera.Phi, 0.1f, MathHelper::Pi - 0.1f);
 	}
 	else if ((btnState & MK_RBUTTON) != 0)
 	{
@@ -578,10 +655,11 @@ void TerrainApp::OnMouseMove(WPARAM btnState, int x, int y)
 		float dy = 0.1f*static_cast<float>(y - mLastMousePos.y);
 
 		// Update the camera radius based on input.
-		mRadius += dx - dy;
+		OrbitCamera& camera = mWorld.Camera();
+		camera.Radius += dx - dy;
 
 		// Restrict the radius.
-		mRadius = MathHelper::Clamp(mRadius, 20.0f, 500.0f);
+		camera.Radius = MathHelper::Clamp(camera.Radius, 20.0f, 500.0f);
 	}
 	else if ((btnState & MK_MBUTTON) != 0)
 	{
@@ -590,8 +668,8 @@ void TerrainApp::OnMouseMove(WPARAM btnState, int x, int y)
 		float dy = 0.1f*static_cast<float>(y - mLastMousePos.y);
 
 		// Update the camera radius based on input.
-		mTargetX += dx;
-		mTargetY += dy;
+		mWorld.Camera().TargetX += dx;
+		mWorld.Camera().TargetY += dy;
 	}
 
 	mLastMousePos.x = x;
@@ -624,29 +702,20 @@ void TerrainApp::BuildLandGeometryBuffers()
 	GeometryGenerator geoGen;
 
 	geoGen.CreateGrid(160.0f, 160.0f, 50, 50, grid);
+	geoGen.OptimizeMesh(grid);
 
 	mLandIndexCount = grid.Indices.size();
 
 	//
-	// Extract the vertex elements we are interested and apply the height function to
-	// each vertex.  
+	// Extract the vertex elements we are interested in, packed.
 	//
 
-	std::vector<Vertex::Basic32> vertices(grid.Vertices.size());
-	for (UINT i = 0; i < grid.Vertices.size(); ++i)
-	{
-		XMFLOAT3 p = grid.Vertices[i].Position;
-
-		//p.y = GetHillHeight(p.x, p.z);
-
-		vertices[i].pos = p;
-		//vertices[i].Normal = GetHillNormal(p.x, p.z);
-		vertices[i].uv = grid.Vertices[i].TexC;
-	}
+	std::vector<Vertex::BasicCompact> vertices;
+	PackBasicVertices(grid, vertices);
 
 	D3D11_BUFFER_DESC vbd;
 	vbd.Usage = D3D11_USAGE_IMMUTABLE;
-	vbd.ByteWidth = sizeof(Vertex::Basic32) * grid.Vertices.size();
+	vbd.ByteWidth = sizeof(Vertex::BasicCompact) * vertices.size();
 	vbd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
 	vbd.CPUAccessFlags = 0;
 	vbd.MiscFlags = 0;
@@ -676,7 +745,7 @@ void TerrainApp::BuildWaveGeometryBuffers()
 
 	D3D11_BUFFER_DESC vbd;
 	vbd.Usage = D3D11_USAGE_DYNAMIC;
-	vbd.ByteWidth = sizeof(Vertex::Basic32) * mWaves.VertexCount();
+	vbd.ByteWidth = sizeof(Vertex::BasicCompact) * mWorld.GetWaves().VertexCount();
 	vbd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
 	vbd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
 	vbd.MiscFlags = 0;
@@ -686,11 +755,12 @@ void TerrainApp::BuildWaveGeometryBuffers()
 	// Create the index buffer.  The index buffer is fixed, so we only 
 	// need to create and set once.
 
-	std::vector<UINT> indices(3 * mWaves.TriangleCount()); // 3 indices per face
+	const Waves& waves = mWorld.GetWaves();
+	std::vector<UINT> indices(3 * waves.TriangleCount()); // 3 indices per face
 
 	// Iterate over each quad.
-	UINT m = mWaves.RowCount();
-	UINT n = mWaves.ColumnCount();
+	UINT m = waves.RowCount();
+	UINT n = waves.ColumnCount();
 	int k = 0;
 	for (UINT i = 0; i < m - 1; ++i)
 	{
@@ -731,18 +801,12 @@ void TerrainApp::BuildCrateGeometryBuffers()
 	// vertices of all the meshes into one vertex buffer.
 	//
 
-	std::vector<Vertex::Basic32> vertices(box.Vertices.size());
-
-	for (UINT i = 0; i < box.Vertices.size(); ++i)
-	{
-		vertices[i].pos = box.Vertices[i].Position;
-		//vertices[i].Normal = box.Vertices[i].Normal;
-		vertices[i].uv = box.Vertices[i].TexC;
-	}
+	std::vector<Vertex::BasicCompact> vertices;
+	PackBasicVertices(box, vertices);
 
 	D3D11_BUFFER_DESC vbd;
 	vbd.Usage = D3D11_USAGE_IMMUTABLE;
-	vbd.ByteWidth = sizeof(Vertex::Basic32) * box.Vertices.size();
+	vbd.ByteWidth = sizeof(Vertex::BasicCompact) * vertices.size();
 	vbd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
 	vbd.CPUAccessFlags = 0;
 	vbd.MiscFlags = 0;
@@ -767,34 +831,20 @@ void TerrainApp::BuildCrateGeometryBuffers()
 
 void TerrainApp::InitDensitySRV()
 {
-
-	FastNoise myNoise; // Create a FastNoise object
-	myNoise.SetSeed(24);
-	myNoise.SetFrequency(0.03f);
-	myNoise.SetNoiseType(FastNoise::SimplexFractal); // Set the desired noise type
-	float noiseScale = 1;
-	for (int y = 0; y < cornerHeight; y++)
-	{
-		for (int z = 0; z < cornerDepth; z++)
-		{
-			for (int x = 0; x < cornerWidth; x++)
-			{
-				//noiseMap[y*cornerDepth*cornerWidth + z * cornerWidth + x] = (myNoise.GetNoise(x*noiseScale, z*noiseScale, y*noiseScale) + 1.0f)*0.5f;  //0~1
-				noiseMap[y*cornerDepth*cornerWidth + z * cornerWidth + x] = myNoise.GetNoise(x*noiseScale, z*noiseScale, y*noiseScale);//-1~1
-			}
-		}
-	}
+	// TerrainWorld generated the field; its layout is x fastest, then z, then y, so z
+	// runs down the texture rows and y through the slices.
+	const DensityField& density = mWorld.Density();
 
 	D3D11_SUBRESOURCE_DATA noiseData;
-	noiseData.pSysMem = noiseMap;
-	noiseData.SysMemPitch = sizeof(float)*cornerWidth;
-	noiseData.SysMemSlicePitch = sizeof(float)*cornerWidth*cornerDepth;
+	noiseData.pSysMem = density.Data();
+	noiseData.SysMemPitch = sizeof(float)*density.SizeX();
+	noiseData.SysMemSlicePitch = sizeof(float)*density.SizeX()*density.SizeZ();
 
 	//init texture3d and rendertargetview for render to texture
 	D3D11_TEXTURE3D_DESC textureDesc;
-	textureDesc.Width = cornerWidth;
-	textureDesc.Height = cornerDepth;
-	textureDesc.Depth = cornerHeight;
+	textureDesc.Width = density.SizeX();
+	textureDesc.Height = density.SizeZ();
+	textureDesc.Depth = density.SizeY();
 	textureDesc.MipLevels = 1;
 	textureDesc.Format = DXGI_FORMAT_R32_FLOAT;
 	textureDesc.Usage = D3D11_USAGE_DEFAULT;
@@ -823,47 +873,70 @@ void TerrainApp::InitDensitySRV()
 
 void TerrainApp::BuildTerrainGeometryBuffers()
 {
-	GeometryGenerator::MeshData grid;
-
-	GeometryGenerator geoGen;
-
-	geoGen.CreateGrid(160.0f, 160.0f, voxelWidth+1, voxelDepth+1, grid);//crack
-
+	// mWorld built the grid with its quads grouped into chunks; the terrain world
+	// matrix is the identity, so the grid positions are world positions, each chunk's
+	// quantized over its own box.
+	std::vector<TerrainGridCompactVertex> vertices;
+	mWorld.PackGridVertices(vertices);
+	const std::vector<uint32_t>& indices = mWorld.GridIndices();
+
+	mTerrainDrawState.VertexBuffer = mRenderDevice->CreateVertexBuffer(&vertices[0],
+		(UINT)(sizeof(TerrainGridCompactVertex) * vertices.size()), false);
+	mTerrainDrawState.VertexStride = sizeof(Vertex::TerrainCompact);
+	mTerrainDrawState.IndexBuffer = mRenderDevice->CreateIndexBuffer(&indices[0], (UINT)indices.size());
+
+	std::vector<uint32_t> slabs;
+	mWorld.PackSlabInstances(slabs);
+	mTerrainDrawState.InstanceBuffer = mRenderDevice->CreateVertexBuffer(&slabs[0],
+		(UINT)(sizeof(uint32_t) * slabs.size()), false);
+	mTerrainDrawState.InstanceStride = sizeof(uint32_t);
+}
 
-	mTerrainIndexCount = grid.Indices.size();
-	std::vector<Vertex::TerrainVertex> vertices(grid.Vertices.size());
-	for (UINT i = 0; i < grid.Vertices.size(); ++i)
+void TerrainApp::BuildTreeBillboardBuffers()
+{
+	// One quad shared by every tree, as a strip: x across, y up from the base.
+	Vertex::BillboardCorner corners[4] =
 	{
-		vertices[i].pos = grid.Vertices[i].Position;
-		vertices[i].uv = grid.Vertices[i].TexC;
-	}
-
-	D3D11_BUFFER_DESC vbd;
-	vbd.Usage = D3D11_USAGE_IMMUTABLE;
-	vbd.ByteWidth = sizeof(Vertex::TerrainVertex) * grid.Vertices.size();
-	vbd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-	vbd.CPUAccessFlags = 0;
-	vbd.MiscFlags = 0;
-	D3D11_SUBRESOURCE_DATA vinitData;
-	vinitData.pSysMem = &vertices[0];
-	HR(md3dDevice->CreateBuffer(&vbd, &vinitData, &mTerrainVB));
-
-	//
-	// Pack the indices of all the meshes into one index buffer.
-	//
-
-	D3D11_BUFFER_DESC ibd;
-	ibd.Usage = D3D11_USAGE_IMMUTABLE;
-	ibd.ByteWidth = sizeof(UINT) *  grid.Indices.size();
-	ibd.BindFlags = D3D11_BIND_INDEX_BUFFER;
-	ibd.CPUAccessFlags = 0;
-	ibd.MiscFlags = 0;
-	D3D11_SUBRESOURCE_DATA iinitData;
-	iinitData.pSysMem = &grid.Indices[0];
-	HR(md3dDevice->CreateBuffer(&ibd, &iinitData, &mTerrainIB));
+		{ XMFLOAT2(+0.5f, 0.0f) },
+		{ XMFLOAT2(+0.5f, 1.0f) },
+		{ XMFLOAT2(-0.5f, 0.0f) },
+		{ XMFLOAT2(-0.5f, 1.0f) }
+	};
+
+	mTreeDrawState.VertexBuffer = mRenderDevice->CreateVertexBuffer(corners, sizeof(corners), false);
+	mTreeDrawState.VertexStride = sizeof(Vertex::BillboardCorner);
+
+	// Rewritten every frame with the visible trees.  A chunk changing LOD band is
+	// emitted twice, so the worst case is every tree twice.
+	UINT capacity = MathHelper::Max((UINT)mWorld.MaxTreeInstances(), 1u);
+	mTreeDrawState.InstanceBuffer = mRenderDevice->CreateVertexBuffer(0, sizeof(BillboardInstance) * capacity, true);
+	mTreeDrawState.InstanceStride = sizeof(BillboardInstance);
+}
 
+void TerrainApp::RecordTreeBillboards(CXMMATRIX viewProj)
+{
+	mTreeDrawState.Pipeline = mTreePipelines[mRenderOptions];
+	mWorld.RecordTrees(mTreeList, mTreeDrawState);
+
+	const std::vector<BillboardInstance>& instances = mWorld.TreeBatches().Instances();
+	if (instances.empty())
+		return;
+
+	mRenderDevice->WriteVertexBuffer(mTreeDrawState.InstanceBuffer, instances.data(),
+		(UINT)(instances.size() * sizeof(BillboardInstance)));
+
+	Effects::TreeBillboardFX->SetDirLights(mDirLights);
+	Effects::TreeBillboardFX->SetEyePosW(mEyePosW);
+	Effects::TreeBillboardFX->SetFogColor(Colors::Silver);
+	Effects::TreeBillboardFX->SetFogStart(15.0f);
+	Effects::TreeBillboardFX->SetFogRange(175.0f);
+	Effects::TreeBillboardFX->SetViewProj(viewProj);
+	Effects::TreeBillboardFX->SetMaterial(mTreeMat);
+	Effects::TreeBillboardFX->SetTreeTextureMapArray(mTreeMapSRV);
+	Effects::TreeBillboardFX->SetImpostorMipBias(TreeImpostorMipBias);
 }
-void TerrainApp::DrawDensityFX(CXMMATRIX viewProj)
+
+void TerrainApp::DrawDensityFX()
 {
 	Effects::BuildDensityFX->SetNoiseTex(mDensitySRV);
 
@@ -875,9 +948,82 @@ void TerrainApp::DrawDensityFX(CXMMATRIX viewProj)
 
 	ID3DX11EffectTechnique * pTech = NULL;
 	Effects::BuildDensityFX->Test->GetPassByIndex(0)->Apply(0, md3dImmediateContext);
-	md3dImmediateContext->DrawInstanced(4, cornerHeight, 0, 0);
+	md3dImmediateContext->DrawInstanced(4, mWorld.GetSettings().Corners, 0, 0);
 
 }
+static float ProfilerFrameMs(void* data, int idx)
+{
+	return (float)static_cast<const FrameProfiler*>(data)->FrameMs(idx);
+}
+
+static float ProfilerHistogramBin(void* data, int idx)
+{
+	return (float)(*static_cast<const std::vector<uint32_t>*>(data))[idx];
+}
+
+void TerrainApp::DrawProfilerOverlay()
+{
+	ImGui::SetNextWindowPos(ImVec2(10, 10), ImGuiSetCond_FirstUseEver);
+	ImGui::Begin("Frame profiler");
+
+	FrameProfiler::Summary frame = mProfiler.FrameSummary();
+	ImGui::Text("%u frames  mean %.2f  p50 %.2f  p95 %.2f  p99 %.2f  max %.2f ms", (unsigned)frame.Frames,
+		frame.Mean, frame.P50, frame.P95, frame.P99, frame.Max);
+
+	if (mProfiler.FrameCount() > 0)
+	{
+		ImGui::PlotLines("Frame ms", ProfilerFrameMs, &mProfiler, (int)mProfiler.FrameCount(), 0, 0, 0.0f, 50.0f, ImVec2(0, 60));
+
+		// 2 ms bins up to 50 ms; the last bin holds every longer frame.
+		mProfiler.Histogram(2.0, 25, mFrameHistogram);
+		ImGui::PlotHistogram("Histogram", ProfilerHistogramBin, &mFrameHistogram, (int)mFrameHistogram.size(), 0, "0-50 ms", 0.0f, FLT_MAX, ImVec2(0, 60));
+	}
+
+	for (size_t i = 0; i < mProfiler.ScopeCount(); ++i)
+	{
+		FrameProfiler::Summary scope = mProfiler.ScopeSummary((FrameProfiler::ScopeId)i);
+		ImGui::Text("%-16s p50 %.2f  p95 %.2f  p99 %.2f  max %.2f ms", mProfiler.ScopeName((FrameProfiler::ScopeId)i).c_str(),
+			scope.P50, scope.P95, scope.P99, scope.Max);
+	}
+
+	const OcclusionBuffer::Stats& occlusion = mWorld.Occlusion().GetStats();
+	ImGui::Text("Occlusion: %u occluders, %u triangles, %u of %u slabs hidden", (unsigned)occlusion.Occluders,
+		(unsigned)occlusion.TrianglesBinned, (unsigned)occlusion.BoxesOccluded, (unsigned)occlusion.BoxesTested);
+
+	ImGui::Text("Vegetation: %u instances", (unsigned)mWorld.TreeCount());
+
+	const VegetationLod::Stats& lod = mWorld.TreeLod().GetStats();
+	ImGui::Text("Tree chunks: near %u  mid %u  far %u  culled %u  fading %u", (unsigned)lod.Chunks[VegetationNear],
+		(unsigned)lod.Chunks[VegetationMid], (unsigned)lod.Chunks[VegetationFar], (unsigned)lod.Chunks[VegetationCulled],
+		(unsigned)lod.Transitions);
+	ImGui::Text("Tree billboards: near %u  mid %u  far %u", (unsigned)lod.Instances[VegetationNear],
+		(unsigned)lod.Instances[VegetationMid], (unsigned)lod.Instances[VegetationFar]);
+
+	bool densityOn = mFrameGraph.Enabled(mDensityPass);
+	if (ImGui::Checkbox("Density slices", &densityOn))
+		mFrameGraph.SetEnabled(mDensityPass, densityOn);
+	ImGui::SameLine();
+	bool landOn = mFrameGraph.Enabled(mLandAndWavesPass);
+	if (ImGui::Checkbox("Sine land and waves", &landOn))
+		mFrameGraph.SetEnabled(mLandAndWavesPass, landOn);
+
+	const FrameGraph::Stats& graph = mFrameGraph.GetStats();
+	ImGui::Text("Frame graph: %u passes live, %u culled", (unsigned)graph.LivePasses, (unsigned)graph.CulledPasses);
+	if (!mFrameGraphError.empty())
+		ImGui::Text("%s", mFrameGraphError.c_str());
+
+	std::string error;
+	if (ImGui::Button("Export CSV"))
+		mProfilerStatus = mProfiler.WriteCSV("frame_profile.csv", &error) ? "Wrote frame_profile.csv" : "CSV export failed: " + error;
+	ImGui::SameLine();
+	if (ImGui::Button("Export JSON"))
+		mProfilerStatus = mProfiler.WriteJSON("frame_profile.json", &error) ? "Wrote frame_profile.json" : "JSON export failed: " + error;
+	if (!mProfilerStatus.empty())
+		ImGui::Text("%s", mProfilerStatus.c_str());
+
+	ImGui::End();
+}
+
 void TerrainApp::HandleImGui() {
 	ImGui_ImplDX11_NewFrame();
 
@@ -895,7 +1041,7 @@ void TerrainApp::HandleImGui() {
 		//		{
 		//			//ImGui::Text(std::to_string(myNoise.GetNoise(x, y, z)).c_str());
 
-		//			ImGui::Text(std::to_string(noiseMap[z*cornerDepth*cornerWidth + y * cornerWidth + x]).c_str());
+		//			ImGui::Text(std::to_string(mWorld.Density().At(x, z, y)).c_str());
 
 		//		}
 		//	}
@@ -918,6 +1064,8 @@ void TerrainApp::HandleImGui() {
 		//ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
 	}
 
+	DrawProfilerOverlay();
+
 	//// 2. Show another simple window, this time using an explicit Begin/End pair
 	//if (show_another_window)
 	//{
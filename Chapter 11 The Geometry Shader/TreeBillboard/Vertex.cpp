@@ -19,18 +19,40 @@ const D3D11_INPUT_ELEMENT_DESC InputLayoutDesc::BuildDensity[1] =
 {
 	{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
 };
-const D3D11_INPUT_ELEMENT_DESC InputLayoutDesc::MarchingCubes[2] =
+
+// Compact formats; decode with FX/VertexCompression.fx.
+const D3D11_INPUT_ELEMENT_DESC InputLayoutDesc::BasicCompact[3] =
 {
 	{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-	{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0 }
+	{ "NORMAL",   0, DXGI_FORMAT_R16G16_SNORM, 0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	{ "TEXCOORD", 0, DXGI_FORMAT_R16G16_FLOAT, 0, 16, D3D11_INPUT_PER_VERTEX_DATA, 0 }
+};
+// Slot 1 is the slab's voxel layer, per instance, so it follows the start instance.
+const D3D11_INPUT_ELEMENT_DESC InputLayoutDesc::TerrainCompact[3] =
+{
+	{ "POSITION", 0, DXGI_FORMAT_R16G16B16A16_UNORM, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	{ "NORMAL",   0, DXGI_FORMAT_R16G16_SNORM, 0, 8, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	{ "SLAB",     0, DXGI_FORMAT_R32_UINT, 1, 0, D3D11_INPUT_PER_INSTANCE_DATA, 1 }
+};
+
+// Slot 0 is the shared quad, slot 1 one BillboardInstance per tree.
+const D3D11_INPUT_ELEMENT_DESC InputLayoutDesc::TreeBillboard[6] =
+{
+	{ "CORNER",   0, DXGI_FORMAT_R32G32_FLOAT,    0, 0,  D3D11_INPUT_PER_VERTEX_DATA,   0 },
+	{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 1, 0,  D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+	{ "SIZE",     0, DXGI_FORMAT_R16G16_FLOAT,    1, 12, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+	{ "SLICE",    0, DXGI_FORMAT_R16_UINT,        1, 16, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+	{ "LOD",      0, DXGI_FORMAT_R8_UINT,         1, 18, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+	{ "FADE",     0, DXGI_FORMAT_R8_UNORM,        1, 19, D3D11_INPUT_PER_INSTANCE_DATA, 1 }
 };
 
 #pragma endregion
 
 #pragma region InputLayouts
 
-ID3D11InputLayout* InputLayouts::Basic32         = 0;
+ID3D11InputLayout* InputLayouts::BasicCompact    = 0;
 ID3D11InputLayout* InputLayouts::TreePointSprite = 0;
+ID3D11InputLayout* InputLayouts::TreeBillboard   = 0;
 ID3D11InputLayout* InputLayouts::MarchingCubes = 0;
 
 void InputLayouts::InitAll(ID3D11Device* device)
@@ -38,12 +60,12 @@ void InputLayouts::InitAll(ID3D11Device* device)
 	D3DX11_PASS_DESC passDesc;
 
 	//
-	// Basic32
+	// BasicCompact
 	//
 
 	Effects::BasicFX->Light1Tech->GetPassByIndex(0)->GetDesc(&passDesc);
-	HR(device->CreateInputLayout(InputLayoutDesc::Basic32, 3, passDesc.pIAInputSignature, 
-		passDesc.IAInputSignatureSize, &Basic32));
+	HR(device->CreateInputLayout(InputLayoutDesc::BasicCompact, 3, passDesc.pIAInputSignature, 
+		passDesc.IAInputSignatureSize, &BasicCompact));
 
 	//
 	// TreePointSprite
@@ -53,17 +75,30 @@ void InputLayouts::InitAll(ID3D11Device* device)
 	HR(device->CreateInputLayout(InputLayoutDesc::TreePointSprite, 2, passDesc.pIAInputSignature, 
 		passDesc.IAInputSignatureSize, &TreePointSprite));
 
+	//
+	// TreeBillboard
+	//
+
+	Effects::TreeBillboardFX->Light3Tech->GetPassByIndex(0)->GetDesc(&passDesc);
+	HR(device->CreateInputLayout(InputLayoutDesc::TreeBillboard, 6, passDesc.pIAInputSignature,
+		passDesc.IAInputSignatureSize, &TreeBillboard));
+
 
 
+	//
+	// MarchingCubes: the terrain grid as TerrainCompact
+	//
+
 	Effects::MarchingCubesFX->MarchingCubes->GetPassByIndex(0)->GetDesc(&passDesc);
-	HR(device->CreateInputLayout(InputLayoutDesc::MarchingCubes, 2, passDesc.pIAInputSignature,
+	HR(device->CreateInputLayout(InputLayoutDesc::TerrainCompact, 3, passDesc.pIAInputSignature,
 		passDesc.IAInputSignatureSize, &MarchingCubes));
 }
 
 void InputLayouts::DestroyAll()
 {
-	ReleaseCOM(Basic32);
+	ReleaseCOM(BasicCompact);
 	ReleaseCOM(TreePointSprite);
+	ReleaseCOM(TreeBillboard);
 	ReleaseCOM(MarchingCubes);
 }
 
@@ -23,13 +23,37 @@ namespace Vertex
 	{
 		XMFLOAT3 Pos;
 	};
-	struct TerrainVertex {
-		TerrainVertex() :pos(0.0f, 0.0f, 0.0f), uv(0.0f, 0.0f){}	
-		TerrainVertex(const XMFLOAT3& p, const XMFLOAT2& t): pos(p),uv(t) {}
-		TerrainVertex(float px, float py, float pz,  float u, float v): pos(px, py, pz),uv(u, v) {}
+
+	// 20-byte counterpart of Basic32: octahedral SNORM16 normal and half uv.
+	// Fill with VertexCompression::EncodeOctNormals/EncodeHalf2.
+	struct BasicCompact
+	{
 		XMFLOAT3 pos;
-		XMFLOAT2 uv;
+		XMSHORTN2 Normal;
+		XMHALF2 uv;
+	};
+
+	// 12-byte terrain vertex.  The position is UNORM16 relative to the owning
+	// chunk's box, which each draw sets as cbPerObject's mChunkOrigin/mChunkExtent
+	// (w is spare), and the normal is octahedral SNORM16; texture
+	// coordinates are derived from the position in the shader.  Fill with
+	// VertexCompression::QuantizePositions/EncodeOctNormals.  Slot 1 holds one
+	// uint32_t voxel layer per instance (TerrainWorld::PackSlabInstances).
+	struct TerrainCompact
+	{
+		XMUSHORTN4 pos;
+		XMSHORTN2 Normal;
 	};
+
+	// Shared quad for instanced billboards; x in [-0.5, 0.5], y in [0, 1].  The
+	// per-instance stream is BillboardInstance (Common/BillboardBatch.h).
+	struct BillboardCorner
+	{
+		XMFLOAT2 Corner;
+	};
+
+	static_assert(sizeof(BasicCompact) == 20, "BasicCompact must match InputLayoutDesc::BasicCompact");
+	static_assert(sizeof(TerrainCompact) == 12, "TerrainCompact must match InputLayoutDesc::TerrainCompact");
 }
 
 class InputLayoutDesc
@@ -39,7 +63,9 @@ public:
 	static const D3D11_INPUT_ELEMENT_DESC Basic32[3];
 	static const D3D11_INPUT_ELEMENT_DESC TreePointSprite[2];
 	static const D3D11_INPUT_ELEMENT_DESC BuildDensity[1];
-	static const D3D11_INPUT_ELEMENT_DESC MarchingCubes[2];
+	static const D3D11_INPUT_ELEMENT_DESC BasicCompact[3];
+	static const D3D11_INPUT_ELEMENT_DESC TerrainCompact[3];
+	static const D3D11_INPUT_ELEMENT_DESC TreeBillboard[6];
 };
 
 class InputLayouts
@@ -48,8 +74,9 @@ public:
 	static void InitAll(ID3D11Device* device);
 	static void DestroyAll();
 
-	static ID3D11InputLayout* Basic32;
+	static ID3D11InputLayout* BasicCompact;
 	static ID3D11InputLayout* TreePointSprite;
+	static ID3D11InputLayout* TreeBillboard;
 	static ID3D11InputLayout* MarchingCubes;
 };
 
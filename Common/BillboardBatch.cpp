@@ -0,0 +1,67 @@
+#include "BillboardBatch.h"
+#include "VertexCompression.h"
+
+#include <algorithm>
+#include <cstring>
+
+void BillboardBatchBuilder::Clear()
+{
+	mPending.clear();
+	mInstances.clear();
+	mBatches.clear();
+}
+
+size_t BillboardBatchBuilder::Add(const VegetationInstance* instances, size_t count, uint32_t sliceCount,
+	const BillboardLod& lod)
+{
+	size_t keepEvery = (std::max)(lod.KeepEvery, 1u);
+	size_t kept = (count + keepEvery - 1) / keepEvery;
+
+	uint8_t band = (uint8_t)((lod.Band & ~BillboardFadeOut) | (lod.FadeOut ? BillboardFadeOut : 0));
+	uint8_t fade = (uint8_t)((std::min)((std::max)(lod.Fade, 0.0f), 1.0f)*255.0f + 0.5f);
+
+	size_t first = mPending.size();
+	mPending.resize(first + kept);
+	for(size_t i = 0; i < kept; ++i)
+	{
+		const VegetationInstance& v = instances[i*keepEvery];
+		BillboardInstance& b = mPending[first + i];
+		b.Position = v.Position;
+		b.Size[0] = VertexCompression::FloatToHalf(v.Width*lod.SizeScale);
+		b.Size[1] = VertexCompression::FloatToHalf(v.Height*lod.SizeScale);
+		b.Slice = (uint16_t)(sliceCount > 0 ? v.Variant % sliceCount : 0);
+		b.Lod = band;
+		b.Fade = fade;
+	}
+	return kept;
+}
+
+void BillboardBatchBuilder::Build(const Vec3& eye)
+{
+	// Squared distances are non-negative, so their bit patterns sort like the values.
+	mOrder.resize(mPending.size());
+	for(size_t i = 0; i < mPending.size(); ++i)
+	{
+		float distSq = LengthSq(mPending[i].Position - eye);
+		uint32_t bits;
+		std::memcpy(&bits, &distSq, sizeof(bits));
+		mOrder[i] = std::make_pair((uint64_t(mPending[i].Slice) << 32) | bits, (uint32_t)i);
+	}
+	std::sort(mOrder.begin(), mOrder.end());
+
+	mInstances.resize(mPending.size());
+	mBatches.clear();
+	for(size_t i = 0; i < mOrder.size(); ++i)
+	{
+		const BillboardInstance& b = mPending[mOrder[i].second];
+		mInstances[i] = b;
+
+		if(mBatches.empty() || mBatches.back().Slice != b.Slice)
+		{
+			BillboardBatch batch = { b.Slice, (uint32_t)i, 0 };
+			mBatches.push_back(batch);
+		}
+		++mBatches.back().InstanceCount;
+	}
+	mPending.clear();
+}
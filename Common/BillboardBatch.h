@@ -0,0 +1,91 @@
+#ifndef BILLBOARDBATCH_H
+#define BILLBOARDBATCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "VecMath.h"
+#include "VegetationScatter.h"
+
+///<summary>
+/// Per-instance vertex data for camera-facing billboards drawn by instancing a shared
+/// quad (FX/TreeBillboard.fx), 20 bytes:
+///   Position  R32G32B32_FLOAT  base of the billboard, on the ground,
+///   Size      R16G16_FLOAT     width and height,
+///   Slice     R16_UINT         texture array slice,
+///   Lod       R8_UINT          LOD band, plus BillboardFadeOut,
+///   Fade      R8_UNORM         dithered transition progress, 255 when not fading.
+///</summary>
+struct BillboardInstance
+{
+	Vec3 Position;
+	uint16_t Size[2];
+	uint16_t Slice;
+	uint8_t Lod;
+	uint8_t Fade;
+};
+
+static_assert(sizeof(BillboardInstance) == 20, "BillboardInstance must match InputLayoutDesc::TreeBillboard");
+
+// Set in BillboardInstance::Lod for the outgoing band of a transition.  It is drawn in
+// exactly the pixels of the dither pattern that the incoming band, at the same Fade,
+// leaves out.
+const uint8_t BillboardFadeOut = 0x80;
+
+///<summary>
+/// How a run of added instances is drawn.  Only one in KeepEvery instances is kept,
+/// scaled by SizeScale, so distant clusters cost fewer, larger quads.
+///</summary>
+struct BillboardLod
+{
+	BillboardLod() : Band(0), Fade(1.0f), FadeOut(false), KeepEvery(1), SizeScale(1.0f) {}
+
+	uint32_t Band;
+	float Fade;
+	bool FadeOut;
+	uint32_t KeepEvery;
+	float SizeScale;
+};
+
+///<summary>
+/// A run of instances sharing a texture array slice: one instanced draw.
+///</summary>
+struct BillboardBatch
+{
+	uint32_t Slice;
+	uint32_t StartInstance;
+	uint32_t InstanceCount;
+};
+
+///<summary>
+/// Builds the instance buffer contents for a frame.  Add the instances of every visible
+/// chunk, then Build sorts them by slice and, within a slice, nearest first so alpha
+/// tested trees in front reject the ones behind early, and splits them into batches.
+/// No device is involved; the caller copies Instances() into its buffer.
+///</summary>
+class BillboardBatchBuilder
+{
+public:
+	void Clear();
+
+	// Slices are Variant % sliceCount.  Returns the number of instances kept.
+	size_t Add(const VegetationInstance* instances, size_t count, uint32_t sliceCount,
+		const BillboardLod& lod = BillboardLod());
+
+	void Build(const Vec3& eye);
+
+	const std::vector<BillboardInstance>& Instances()const { return mInstances; }
+	const std::vector<BillboardBatch>& Batches()const { return mBatches; }
+
+private:
+	std::vector<BillboardInstance> mPending;
+	std::vector<BillboardInstance> mInstances;
+	std::vector<BillboardBatch> mBatches;
+
+	// (slice << 32 | distance bits, pending index) pairs.
+	std::vector<std::pair<uint64_t, uint32_t> > mOrder;
+};
+
+#endif // BILLBOARDBATCH_H
@@ -0,0 +1,306 @@
+#include "ChunkOctree.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+// Children in order of how many axes they differ from the eye's octant, so XOR with
+// the eye octant visits the nearest child first and the opposite one last.
+static const int gNearFirst[8] = { 0, 1, 2, 4, 3, 5, 6, 7 };
+
+// Item::Node of a removed item.
+static const int32_t FreeNode = -2;
+
+static float MaxExtent(const AABB& bounds)
+{
+	Vec3 e = bounds.Extents();
+	return (std::max)(e.x, (std::max)(e.y, e.z));
+}
+
+static int Octant(const Vec3& p, const Vec3& center)
+{
+	return (p.x >= center.x ? 1 : 0) | (p.y >= center.y ? 2 : 0) | (p.z >= center.z ? 4 : 0);
+}
+
+ChunkOctree::CullStats::CullStats()
+	: NodesVisited(0), NodesCulled(0), ItemsTested(0), ItemsAccepted(0), PlaneTests(0)
+{
+}
+
+ChunkOctree::ChunkOctree(const Vec3& worldCenter, float worldHalfSize, int maxDepth)
+	: mItemCount(0), mMaxDepth(maxDepth)
+{
+	AllocNode(worldCenter, worldHalfSize, -1);
+}
+
+int32_t ChunkOctree::AllocNode(const Vec3& center, float halfSize, int32_t parent)
+{
+	int32_t index;
+	if(!mFreeNodes.empty())
+	{
+		index = mFreeNodes.back();
+		mFreeNodes.pop_back();
+	}
+	else
+	{
+		index = (int32_t)mNodes.size();
+		mNodes.push_back(Node());
+	}
+
+	Node& node = mNodes[index];
+	node.Center = center;
+	node.HalfSize = halfSize;
+	node.Depth = parent < 0 ? 0 : mNodes[parent].Depth + 1;
+	node.Parent = parent;
+	for(int c = 0; c < 8; ++c)
+		node.Children[c] = -1;
+	node.SubtreeItems = 0;
+	node.Items.clear();
+	node.UserData.clear();
+	node.Boxes.Clear();
+	return index;
+}
+
+bool ChunkOctree::Fits(int32_t node, const AABB& bounds)const
+{
+	const Node& n = mNodes[node];
+	Vec3 c = bounds.Center();
+	float e = MaxExtent(bounds);
+
+	// The center has to be in the cell (not just the loose bounds) and the item no
+	// larger than the cell, which together keep it inside the loose bounds.
+	if(e > n.HalfSize)
+		return false;
+	for(int a = 0; a < 3; ++a)
+	{
+		if(c[a] < n.Center[a] - n.HalfSize || c[a] > n.Center[a] + n.HalfSize)
+			return false;
+	}
+	return true;
+}
+
+int32_t ChunkOctree::FindNode(const AABB& bounds)
+{
+	if(!Fits(0, bounds))
+		return -1;
+
+	Vec3 c = bounds.Center();
+	float e = MaxExtent(bounds);
+
+	int32_t node = 0;
+	while(mNodes[node].Depth < mMaxDepth)
+	{
+		float childHalf = 0.5f*mNodes[node].HalfSize;
+		if(e > childHalf)
+			break;
+
+		int octant = Octant(c, mNodes[node].Center);
+		int32_t child = mNodes[node].Children[octant];
+		if(child < 0)
+		{
+			Vec3 offset((octant & 1) ? childHalf : -childHalf,
+			            (octant & 2) ? childHalf : -childHalf,
+			            (octant & 4) ? childHalf : -childHalf);
+			child = AllocNode(mNodes[node].Center + offset, childHalf, node);
+			mNodes[node].Children[octant] = child;
+		}
+		node = child;
+	}
+	return node;
+}
+
+void ChunkOctree::Attach(ItemId item, int32_t node)
+{
+	Item& it = mItems[item];
+	it.Node = node;
+
+	if(node < 0)
+	{
+		it.Slot = (uint32_t)mOverflow.size();
+		mOverflow.push_back(item);
+		return;
+	}
+
+	it.Slot = (uint32_t)mNodes[node].Items.size();
+	mNodes[node].Items.push_back(item);
+	mNodes[node].UserData.push_back(it.UserData);
+	mNodes[node].Boxes.Add(it.Bounds);
+	for(int32_t n = node; n >= 0; n = mNodes[n].Parent)
+		++mNodes[n].SubtreeItems;
+}
+
+void ChunkOctree::Detach(ItemId item)
+{
+	Item& it = mItems[item];
+	std::vector<ItemId>& list = it.Node < 0 ? mOverflow : mNodes[it.Node].Items;
+
+	// Swap-remove, fixing up the slot of the item that moved.
+	ItemId last = list.back();
+	list[it.Slot] = last;
+	mItems[last].Slot = it.Slot;
+	list.pop_back();
+
+	int32_t node = it.Node;
+	it.Node = -1;
+	if(node < 0)
+		return;
+
+	std::vector<uint32_t>& userData = mNodes[node].UserData;
+	userData[it.Slot] = userData.back();
+	userData.pop_back();
+	mNodes[node].Boxes.RemoveSwap(it.Slot);
+
+	for(int32_t n = node; n >= 0; n = mNodes[n].Parent)
+		--mNodes[n].SubtreeItems;
+
+	// Prune the branch that became empty; the root always stays.
+	for(int32_t n = node; n > 0 && mNodes[n].SubtreeItems == 0; )
+	{
+		int32_t parent = mNodes[n].Parent;
+		for(int c = 0; c < 8; ++c)
+		{
+			if(mNodes[parent].Children[c] == n)
+				mNodes[parent].Children[c] = -1;
+		}
+		mFreeNodes.push_back(n);
+		n = parent;
+	}
+}
+
+ChunkOctree::ItemId ChunkOctree::Insert(const AABB& bounds, uint32_t userData)
+{
+	ItemId id;
+	if(!mFreeItems.empty())
+	{
+		id = mFreeItems.back();
+		mFreeItems.pop_back();
+	}
+	else
+	{
+		id = (ItemId)mItems.size();
+		mItems.push_back(Item());
+	}
+
+	mItems[id].Bounds = bounds;
+	mItems[id].UserData = userData;
+	Attach(id, FindNode(bounds));
+	++mItemCount;
+	return id;
+}
+
+void ChunkOctree::Remove(ItemId item)
+{
+	assert(item < mItems.size() && mItems[item].Node != FreeNode);
+	Detach(item);
+	mItems[item].Node = FreeNode;
+	mFreeItems.push_back(item);
+	--mItemCount;
+}
+
+void ChunkOctree::Update(ItemId item, const AABB& bounds)
+{
+	Item& it = mItems[item];
+
+	// Still in the same cell, and too big for the child it would otherwise drop into:
+	// nothing to relink.
+	if(it.Node >= 0 && Fits(it.Node, bounds))
+	{
+		const Node& n = mNodes[it.Node];
+		if(n.Depth == mMaxDepth || MaxExtent(bounds) > 0.5f*n.HalfSize)
+		{
+			it.Bounds = bounds;
+			mNodes[it.Node].Boxes.Set(it.Slot, bounds);
+			return;
+		}
+	}
+
+	Detach(item);
+	mItems[item].Bounds = bounds;
+	Attach(item, FindNode(bounds));
+}
+
+//
+// A box (center c, half extents e) is outside plane (n, w) when n.c + w + |n|.e < 0
+// and inside it when n.c + w - |n|.e >= 0.  Planes the box is inside of are cleared
+// from the mask so nothing below tests them again.
+//
+
+static bool TestBox(const Frustum& frustum, const Vec3& c, const Vec3& e, uint32_t& planeMask, size_t& planeTests)
+{
+	for(int p = 0; p < 6; ++p)
+	{
+		if(!(planeMask & (1u << p)))
+			continue;
+
+		const Vec4& pl = frustum.Planes[p];
+		float d = ((pl.x*c.x + pl.y*c.y) + pl.z*c.z) + pl.w;
+		float r = (std::fabs(pl.x)*e.x + std::fabs(pl.y)*e.y) + std::fabs(pl.z)*e.z;
+		++planeTests;
+
+		if(d + r < 0.0f)
+			return false;
+		if(d - r >= 0.0f)
+			planeMask &= ~(1u << p);
+	}
+	return true;
+}
+
+void ChunkOctree::Cull(const Frustum& frustum, const Vec3& eye, std::vector<uint32_t>& visible, CullStats* stats)const
+{
+	CullStats local;
+	CullStats& s = stats ? *stats : local;
+
+	for(size_t i = 0; i < mOverflow.size(); ++i)
+	{
+		const Item& it = mItems[mOverflow[i]];
+		uint32_t mask = 0x3f;
+		++s.ItemsTested;
+		if(TestBox(frustum, it.Bounds.Center(), it.Bounds.Extents(), mask, s.PlaneTests))
+			visible.push_back(it.UserData);
+	}
+
+	if(mNodes[0].SubtreeItems > 0)
+		CullNode(0, frustum, eye, 0x3f, visible, s);
+}
+
+void ChunkOctree::CullNode(int32_t node, const Frustum& frustum, const Vec3& eye, uint32_t planeMask,
+	std::vector<uint32_t>& visible, CullStats& stats)const
+{
+	const Node& n = mNodes[node];
+	++stats.NodesVisited;
+
+	if(planeMask)
+	{
+		float loose = 2.0f*n.HalfSize;
+		if(!TestBox(frustum, n.Center, Vec3(loose, loose, loose), planeMask, stats.PlaneTests))
+		{
+			++stats.NodesCulled;
+			return;
+		}
+	}
+
+	if(planeMask == 0)
+	{
+		visible.insert(visible.end(), n.UserData.begin(), n.UserData.end());
+		stats.ItemsAccepted += n.Items.size();
+	}
+	else if(!n.Items.empty())
+	{
+		mVisibleScratch.resize(n.Items.size());
+		FrustumCulling::Cull(frustum, n.Boxes, mVisibleScratch.data());
+		for(size_t i = 0; i < n.Items.size(); ++i)
+		{
+			if(mVisibleScratch[i])
+				visible.push_back(n.UserData[i]);
+		}
+		stats.ItemsTested += n.Items.size();
+	}
+
+	int eyeOctant = Octant(eye, n.Center);
+	for(int k = 0; k < 8; ++k)
+	{
+		int32_t child = n.Children[eyeOctant ^ gNearFirst[k]];
+		if(child >= 0)
+			CullNode(child, frustum, eye, planeMask, visible, stats);
+	}
+}
@@ -0,0 +1,106 @@
+#ifndef CHUNKOCTREE_H
+#define CHUNKOCTREE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "FrustumCulling.h"
+#include "VecMath.h"
+
+///<summary>
+/// Loose octree over chunk bounds, for worlds with more chunks than a flat
+/// FrustumCulling::Cull sweep handles well.  Each node's bounds are its cell grown by
+/// a factor of two, so an item goes to the deepest cell whose size is at least the
+/// item's largest extent and that holds its center; insert, remove and move never
+/// touch more than one node's list, which suits chunks streaming in and out.
+///
+/// Cull walks the tree with a mask of the planes that still cut the current node.  A
+/// node fully inside a plane drops it for the whole subtree, so items under a node
+/// inside every plane are accepted without a test; the items of a node that is cut
+/// go through FrustumCulling::Cull as one batch.  Children are visited nearest the
+/// eye first, which gives a front-to-back order (at node granularity) for early-Z.
+/// Items that do not fit in the root's loose bounds are kept in an overflow list that
+/// is tested flat.
+///</summary>
+class ChunkOctree
+{
+public:
+	typedef uint32_t ItemId;
+
+	static const ItemId InvalidItem = 0xffffffff;
+
+	struct CullStats
+	{
+		CullStats();
+
+		size_t NodesVisited;
+		size_t NodesCulled;
+		size_t ItemsTested;
+		size_t ItemsAccepted;   // Accepted without a test because their node was inside.
+		size_t PlaneTests;
+	};
+
+	// worldCenter and worldHalfSize give the root cell; maxDepth limits subdivision.
+	// Leaf cells a few chunks across keep the node count low and the batches wide.
+	ChunkOctree(const Vec3& worldCenter, float worldHalfSize, int maxDepth = 8);
+
+	// userData is what Cull reports for the item.
+	ItemId Insert(const AABB& bounds, uint32_t userData);
+	void Remove(ItemId item);
+
+	// Moves an item to new bounds.  Cheap when it stays in the same cell.
+	void Update(ItemId item, const AABB& bounds);
+
+	const AABB& Bounds(ItemId item)const { return mItems[item].Bounds; }
+	uint32_t UserData(ItemId item)const { return mItems[item].UserData; }
+
+	size_t ItemCount()const { return mItemCount; }
+	size_t NodeCount()const { return mNodes.size() - mFreeNodes.size(); }
+
+	// Appends the userData of every item that may be visible, roughly front to back
+	// from eye.  Not safe to call from several threads on the same tree.
+	void Cull(const Frustum& frustum, const Vec3& eye, std::vector<uint32_t>& visible, CullStats* stats = 0)const;
+
+private:
+	struct Item
+	{
+		AABB Bounds;
+		uint32_t UserData;
+		int32_t Node;       // -1 for the overflow list, -2 when free.
+		uint32_t Slot;      // Index in the node's (or overflow) item list.
+	};
+
+	struct Node
+	{
+		Vec3 Center;
+		float HalfSize;     // Of the cell; the loose bounds are twice this.
+		int Depth;
+		int32_t Parent;
+		int32_t Children[8];
+		uint32_t SubtreeItems;
+		std::vector<ItemId> Items;
+		std::vector<uint32_t> UserData;   // Of Items, so Cull does not chase ids.
+		CullBoxes Boxes;                  // Bounds of Items, for the SIMD test.
+	};
+
+	bool Fits(int32_t node, const AABB& bounds)const;
+	int32_t FindNode(const AABB& bounds);
+	int32_t AllocNode(const Vec3& center, float halfSize, int32_t parent);
+	void Attach(ItemId item, int32_t node);
+	void Detach(ItemId item);
+
+	void CullNode(int32_t node, const Frustum& frustum, const Vec3& eye, uint32_t planeMask,
+		std::vector<uint32_t>& visible, CullStats& stats)const;
+
+	std::vector<Item> mItems;
+	std::vector<ItemId> mFreeItems;
+	std::vector<Node> mNodes;
+	std::vector<int32_t> mFreeNodes;
+	std::vector<ItemId> mOverflow;
+	mutable std::vector<uint8_t> mVisibleScratch;
+	size_t mItemCount;
+	int mMaxDepth;
+};
+
+#endif // CHUNKOCTREE_H
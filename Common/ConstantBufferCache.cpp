@@ -0,0 +1,99 @@
+#include "ConstantBufferCache.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+ConstantBufferCache::Stats::Stats()
+	: Sets(0), RedundantSets(0), Uploads(0), UploadedBytes(0)
+{
+	for(int i = 0; i < FrequencyCount; ++i)
+		UploadsByFrequency[i] = 0;
+}
+
+ConstantBufferCache::BlockId ConstantBufferCache::AddBlock(size_t size, Frequency frequency, uint32_t slot)
+{
+	Block block;
+	block.Data.assign(size, 0);
+	block.Freq = frequency;
+	block.Slot = slot;
+	block.DirtyBegin = 0;
+	block.DirtyEnd = size;
+
+	mBlocks.push_back(block);
+	return BlockId(mBlocks.size() - 1);
+}
+
+bool ConstantBufferCache::Set(BlockId id, size_t offset, const void* data, size_t size)
+{
+	Block& block = mBlocks[id];
+	assert(offset <= block.Data.size() && size <= block.Data.size() - offset);
+
+	++mStats.Sets;
+
+	// Narrow the write to the bytes that actually differ so a large struct with one
+	// changed field only dirties that field.
+	const uint8_t* src = static_cast<const uint8_t*>(data);
+	uint8_t* dst = block.Data.data() + offset;
+
+	size_t first = 0;
+	while(first < size && src[first] == dst[first])
+		++first;
+
+	if(first == size)
+	{
+		++mStats.RedundantSets;
+		return false;
+	}
+
+	size_t last = size;
+	while(last > first && src[last - 1] == dst[last - 1])
+		--last;
+
+	std::memcpy(dst + first, src + first, last - first);
+
+	block.DirtyBegin = std::min(block.DirtyBegin, offset + first);
+	block.DirtyEnd = std::max(block.DirtyEnd, offset + last);
+	return true;
+}
+
+void ConstantBufferCache::Invalidate(BlockId id)
+{
+	mBlocks[id].DirtyBegin = 0;
+	mBlocks[id].DirtyEnd = mBlocks[id].Data.size();
+}
+
+void ConstantBufferCache::Flush(IConstantBufferBackend& backend)
+{
+	for(size_t i = 0; i < mBlocks.size(); ++i)
+	{
+		Block& block = mBlocks[i];
+		if(block.DirtyBegin >= block.DirtyEnd)
+			continue;
+
+		size_t size = block.DirtyEnd - block.DirtyBegin;
+		backend.Upload(block.Slot, block.DirtyBegin, block.Data.data() + block.DirtyBegin, size);
+
+		++mStats.Uploads;
+		++mStats.UploadsByFrequency[block.Freq];
+		mStats.UploadedBytes += size;
+
+		block.DirtyBegin = block.Data.size();
+		block.DirtyEnd = 0;
+	}
+}
+
+void RecordingConstantBufferBackend::Upload(uint32_t slot, size_t offset, const void* data, size_t size)
+{
+	Record record;
+	record.Slot = slot;
+	record.Offset = offset;
+	record.Size = size;
+	Records.push_back(record);
+
+	if(Contents.size() <= slot)
+		Contents.resize(slot + 1);
+	if(Contents[slot].size() < offset + size)
+		Contents[slot].resize(offset + size);
+	std::memcpy(Contents[slot].data() + offset, data, size);
+}
@@ -0,0 +1,116 @@
+#ifndef CONSTANTBUFFERCACHE_H
+#define CONSTANTBUFFERCACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+///<summary>
+/// Receives the byte ranges of constant buffers that changed.  The D3D backend writes
+/// them into an effect's constant buffers; RecordingConstantBufferBackend keeps them
+/// for tests and tools.
+///</summary>
+class IConstantBufferBackend
+{
+public:
+	virtual ~IConstantBufferBackend() {}
+
+	virtual void Upload(uint32_t slot, size_t offset, const void* data, size_t size) = 0;
+};
+
+///<summary>
+/// CPU shadow copies of constant buffers with dirty-range tracking.  Set compares the
+/// new bytes with the shadow and only marks the range dirty when they differ, so
+/// values that are re-set every frame but rarely change (lights, material, a camera
+/// that is not moving) cost a memcmp instead of a buffer upload.  Flush hands each
+/// block's single dirty range [first changed byte, last changed byte] to the backend.
+///
+/// Blocks are tagged with how often their contents are expected to change; the tag
+/// only feeds the statistics, so a Static block that keeps uploading shows up.
+///</summary>
+class ConstantBufferCache
+{
+public:
+	enum Frequency
+	{
+		Static,
+		PerFrame,
+		PerObject,
+		FrequencyCount
+	};
+
+	typedef uint32_t BlockId;
+
+	struct Stats
+	{
+		Stats();
+
+		size_t Sets;
+		size_t RedundantSets;      // Sets that matched the shadow copy.
+		size_t Uploads;
+		size_t UploadedBytes;
+		size_t UploadsByFrequency[FrequencyCount];
+	};
+
+	// Adds a block of size bytes, zero filled and dirty so the first Flush uploads it
+	// whole.  slot is passed through to the backend.
+	BlockId AddBlock(size_t size, Frequency frequency, uint32_t slot);
+
+	// Copies size bytes at offset into the block.  Returns true if anything changed.
+	bool Set(BlockId block, size_t offset, const void* data, size_t size);
+
+	template<typename T>
+	bool Set(BlockId block, size_t offset, const T& value)
+	{
+		return Set(block, offset, &value, sizeof(T));
+	}
+
+	// Marks the whole block dirty, for example after the device lost its buffers.
+	void Invalidate(BlockId block);
+
+	// Uploads the dirty range of every block and clears it.
+	void Flush(IConstantBufferBackend& backend);
+
+	bool IsDirty(BlockId block)const { return mBlocks[block].DirtyBegin < mBlocks[block].DirtyEnd; }
+	const uint8_t* Data(BlockId block)const { return mBlocks[block].Data.data(); }
+	size_t Size(BlockId block)const { return mBlocks[block].Data.size(); }
+
+	const Stats& GetStats()const { return mStats; }
+	void ResetStats() { mStats = Stats(); }
+
+private:
+	struct Block
+	{
+		std::vector<uint8_t> Data;
+		Frequency Freq;
+		uint32_t Slot;
+		size_t DirtyBegin;
+		size_t DirtyEnd;
+	};
+
+	std::vector<Block> mBlocks;
+	Stats mStats;
+};
+
+///<summary>
+/// Backend that records every upload and keeps a copy of each slot's contents.
+///</summary>
+class RecordingConstantBufferBackend : public IConstantBufferBackend
+{
+public:
+	struct Record
+	{
+		uint32_t Slot;
+		size_t Offset;
+		size_t Size;
+	};
+
+	void Upload(uint32_t slot, size_t offset, const void* data, size_t size);
+
+	void Clear() { Records.clear(); }
+
+	std::vector<Record> Records;
+	std::vector<std::vector<uint8_t> > Contents; // Indexed by slot.
+};
+
+#endif // CONSTANTBUFFERCACHE_H
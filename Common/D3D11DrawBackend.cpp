@@ -0,0 +1,91 @@
+#include "D3D11DrawBackend.h"
+
+#include <cassert>
+
+D3D11DrawBackend::D3D11DrawBackend(ID3D11DeviceContext* context, IConstantBufferBackend* constants)
+	: mContext(context), mConstants(constants), mPass(0), mApplyPending(false)
+{
+}
+
+DrawHandle D3D11DrawBackend::AddPipeline(ID3DX11EffectPass* pass)
+{
+	mPipelines.push_back(pass);
+	return DrawHandle(mPipelines.size() - 1);
+}
+
+DrawHandle D3D11DrawBackend::AddInputLayout(ID3D11InputLayout* layout)
+{
+	mInputLayouts.push_back(layout);
+	return DrawHandle(mInputLayouts.size() - 1);
+}
+
+DrawHandle D3D11DrawBackend::AddVertexBuffer(ID3D11Buffer* buffer)
+{
+	mVertexBuffers.push_back(buffer);
+	return DrawHandle(mVertexBuffers.size() - 1);
+}
+
+DrawHandle D3D11DrawBackend::AddIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format)
+{
+	IndexBuffer ib = { buffer, format };
+	mIndexBuffers.push_back(ib);
+	return DrawHandle(mIndexBuffers.size() - 1);
+}
+
+void D3D11DrawBackend::SetPipeline(DrawHandle pipeline)
+{
+	mPass = mPipelines[pipeline];
+	mApplyPending = true;
+}
+
+void D3D11DrawBackend::SetInputLayout(DrawHandle layout)
+{
+	mContext->IASetInputLayout(layout == NoDrawHandle ? 0 : mInputLayouts[layout]);
+}
+
+void D3D11DrawBackend::SetTopology(uint32_t topology)
+{
+	mContext->IASetPrimitiveTopology((D3D11_PRIMITIVE_TOPOLOGY)topology);
+}
+
+void D3D11DrawBackend::SetVertexBuffer(DrawHandle buffer, uint32_t stride)
+{
+	ID3D11Buffer* vb = buffer == NoDrawHandle ? 0 : mVertexBuffers[buffer];
+	UINT offset = 0;
+	mContext->IASetVertexBuffers(0, 1, &vb, &stride, &offset);
+}
+
+void D3D11DrawBackend::SetIndexBuffer(DrawHandle buffer)
+{
+	const IndexBuffer& ib = mIndexBuffers[buffer];
+	mContext->IASetIndexBuffer(ib.Buffer, ib.Format, 0);
+}
+
+void D3D11DrawBackend::SetInstanceBuffer(DrawHandle buffer, uint32_t stride)
+{
+	// Instance buffers come from the vertex buffer handles and bind to slot 1.
+	ID3D11Buffer* vb = mVertexBuffers[buffer];
+	UINT offset = 0;
+	mContext->IASetVertexBuffers(1, 1, &vb, &stride, &offset);
+}
+
+void D3D11DrawBackend::SetConstants(uint32_t slot, uint32_t offset, const void* data, uint32_t size)
+{
+	assert(mConstants);
+	mConstants->Upload(slot, offset, data, size);
+	mApplyPending = true;
+}
+
+void D3D11DrawBackend::Draw(const DrawArgs& args, bool indexed)
+{
+	if(mApplyPending && mPass)
+	{
+		mPass->Apply(0, mContext);
+		mApplyPending = false;
+	}
+
+	if(indexed)
+		mContext->DrawIndexedInstanced(args.Count, args.InstanceCount, args.StartIndex, args.BaseVertex, args.StartInstance);
+	else
+		mContext->DrawInstanced(args.Count, args.InstanceCount, args.StartIndex, args.StartInstance);
+}
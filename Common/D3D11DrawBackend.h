@@ -0,0 +1,64 @@
+#ifndef D3D11DRAWBACKEND_H
+#define D3D11DRAWBACKEND_H
+
+#include <d3d11.h>
+#include <vector>
+
+#include "d3dx11effect.h"
+#include "ConstantBufferCache.h"
+#include "DrawCommandList.h"
+
+///<summary>
+/// Submits a DrawQueue to a D3D11 context.  Pipelines are effect passes, and per-draw
+/// constants go through an IConstantBufferBackend (for example the effect's own
+/// constant buffers); the pass is re-applied before the next draw whenever either
+/// changes, which is when Effects11 commits its buffers.
+///
+/// The context can be immediate or deferred.  Effect passes share their constant
+/// buffers, so replaying onto several deferred contexts at once needs one backend per
+/// context registered with cloned effects.
+///</summary>
+class D3D11DrawBackend : public IDrawBackend
+{
+public:
+	D3D11DrawBackend(ID3D11DeviceContext* context, IConstantBufferBackend* constants);
+
+	void SetContext(ID3D11DeviceContext* context) { mContext = context; }
+	// Where DrawConstants go; one backend serves every pipeline that has any.
+	void SetConstantBackend(IConstantBufferBackend* constants) { mConstants = constants; }
+
+	// Registration does not add references; the objects must outlive the backend.
+	DrawHandle AddPipeline(ID3DX11EffectPass* pass);
+	DrawHandle AddInputLayout(ID3D11InputLayout* layout);
+	DrawHandle AddVertexBuffer(ID3D11Buffer* buffer);
+	DrawHandle AddIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format);
+
+	void SetPipeline(DrawHandle pipeline);
+	void SetInputLayout(DrawHandle layout);
+	void SetTopology(uint32_t topology);
+	void SetVertexBuffer(DrawHandle buffer, uint32_t stride);
+	void SetIndexBuffer(DrawHandle buffer);
+	void SetInstanceBuffer(DrawHandle buffer, uint32_t stride);
+	void SetConstants(uint32_t slot, uint32_t offset, const void* data, uint32_t size);
+	void Draw(const DrawArgs& args, bool indexed);
+
+private:
+	struct IndexBuffer
+	{
+		ID3D11Buffer* Buffer;
+		DXGI_FORMAT Format;
+	};
+
+	ID3D11DeviceContext* mContext;
+	IConstantBufferBackend* mConstants;
+
+	std::vector<ID3DX11EffectPass*> mPipelines;
+	std::vector<ID3D11InputLayout*> mInputLayouts;
+	std::vector<ID3D11Buffer*> mVertexBuffers;
+	std::vector<IndexBuffer> mIndexBuffers;
+
+	ID3DX11EffectPass* mPass;
+	bool mApplyPending;
+};
+
+#endif // D3D11DRAWBACKEND_H
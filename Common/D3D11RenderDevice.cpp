@@ -0,0 +1,101 @@
+#include "D3D11RenderDevice.h"
+
+#include <cassert>
+#include <cstring>
+
+D3D11RenderDevice::D3D11RenderDevice(ID3D11Device* device, ID3D11DeviceContext* context, IDXGISwapChain* swapChain)
+	: mDevice(device), mContext(context), mSwapChain(swapChain), mRenderTarget(0), mDepthStencil(0),
+	mWidth(0), mHeight(0), mDrawBackend(context, 0), mTextureDevice(device)
+{
+}
+
+D3D11RenderDevice::~D3D11RenderDevice()
+{
+	for(size_t i = 0; i < mVertexBuffers.size(); ++i)
+	{
+		if(mVertexBuffers[i])
+			mVertexBuffers[i]->Release();
+	}
+	for(size_t i = 0; i < mIndexBuffers.size(); ++i)
+		mIndexBuffers[i]->Release();
+}
+
+void D3D11RenderDevice::SetTargets(ID3D11RenderTargetView* renderTarget, ID3D11DepthStencilView* depthStencil,
+	int width, int height)
+{
+	mRenderTarget = renderTarget;
+	mDepthStencil = depthStencil;
+	mWidth = width;
+	mHeight = height;
+}
+
+DrawHandle D3D11RenderDevice::CreateVertexBuffer(const void* data, uint32_t bytes, bool dynamic)
+{
+	D3D11_BUFFER_DESC desc;
+	desc.Usage = dynamic ? D3D11_USAGE_DYNAMIC : D3D11_USAGE_IMMUTABLE;
+	desc.ByteWidth = bytes;
+	desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+	desc.CPUAccessFlags = dynamic ? D3D11_CPU_ACCESS_WRITE : 0;
+	desc.MiscFlags = 0;
+	desc.StructureByteStride = 0;
+
+	D3D11_SUBRESOURCE_DATA initData;
+	initData.pSysMem = data;
+	initData.SysMemPitch = 0;
+	initData.SysMemSlicePitch = 0;
+
+	ID3D11Buffer* buffer = 0;
+	if(FAILED(mDevice->CreateBuffer(&desc, dynamic ? 0 : &initData, &buffer)))
+		return NoDrawHandle;
+
+	DrawHandle handle = mDrawBackend.AddVertexBuffer(buffer);
+	if(mVertexBuffers.size() <= handle)
+		mVertexBuffers.resize(handle + 1, 0);
+	mVertexBuffers[handle] = buffer;
+	return handle;
+}
+
+DrawHandle D3D11RenderDevice::CreateIndexBuffer(const uint32_t* indices, uint32_t count)
+{
+	D3D11_BUFFER_DESC desc;
+	desc.Usage = D3D11_USAGE_IMMUTABLE;
+	desc.ByteWidth = count*sizeof(uint32_t);
+	desc.BindFlags = D3D11_BIND_INDEX_BUFFER;
+	desc.CPUAccessFlags = 0;
+	desc.MiscFlags = 0;
+	desc.StructureByteStride = 0;
+
+	D3D11_SUBRESOURCE_DATA initData;
+	initData.pSysMem = indices;
+	initData.SysMemPitch = 0;
+	initData.SysMemSlicePitch = 0;
+
+	ID3D11Buffer* buffer = 0;
+	if(FAILED(mDevice->CreateBuffer(&desc, &initData, &buffer)))
+		return NoDrawHandle;
+
+	mIndexBuffers.push_back(buffer);
+	return mDrawBackend.AddIndexBuffer(buffer, DXGI_FORMAT_R32_UINT);
+}
+
+void D3D11RenderDevice::WriteVertexBuffer(DrawHandle buffer, const void* data, uint32_t bytes)
+{
+	assert(buffer < mVertexBuffers.size() && mVertexBuffers[buffer]);
+
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	if(FAILED(mContext->Map(mVertexBuffers[buffer], 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+		return;
+	std::memcpy(mapped.pData, data, bytes);
+	mContext->Unmap(mVertexBuffers[buffer], 0);
+}
+
+void D3D11RenderDevice::Clear(const float color[4])
+{
+	mContext->ClearRenderTargetView(mRenderTarget, color);
+	mContext->ClearDepthStencilView(mDepthStencil, D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.0f, 0);
+}
+
+void D3D11RenderDevice::Present()
+{
+	mSwapChain->Present(0, 0);
+}
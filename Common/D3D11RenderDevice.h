@@ -0,0 +1,63 @@
+#ifndef D3D11RENDERDEVICE_H
+#define D3D11RENDERDEVICE_H
+
+#include <d3d11.h>
+#include <vector>
+
+#include "D3D11DrawBackend.h"
+#include "D3D11TextureDevice.h"
+#include "RenderDevice.h"
+
+///<summary>
+/// IRenderDevice over a D3D11 device, its immediate context and a swap chain, which
+/// D3DApp creates and keeps.  The render target and depth views are rebuilt by the
+/// application on resize and handed over with SetTargets.  Buffers created here are
+/// registered with Backend() and released with the device; creation failures return
+/// NoDrawHandle.
+///</summary>
+class D3D11RenderDevice : public IRenderDevice
+{
+public:
+	D3D11RenderDevice(ID3D11Device* device, ID3D11DeviceContext* context, IDXGISwapChain* swapChain);
+	~D3D11RenderDevice();
+
+	void SetTargets(ID3D11RenderTargetView* renderTarget, ID3D11DepthStencilView* depthStencil, int width, int height);
+
+	int Width()const { return mWidth; }
+	int Height()const { return mHeight; }
+
+	DrawHandle CreateVertexBuffer(const void* data, uint32_t bytes, bool dynamic);
+	DrawHandle CreateIndexBuffer(const uint32_t* indices, uint32_t count);
+	void WriteVertexBuffer(DrawHandle buffer, const void* data, uint32_t bytes);
+
+	IDrawBackend& DrawBackend() { return mDrawBackend; }
+	ITextureDevice& TextureDevice() { return mTextureDevice; }
+
+	void Clear(const float color[4]);
+	void Present();
+
+	// For registering pipelines, input layouts and buffers created elsewhere.
+	D3D11DrawBackend& Backend() { return mDrawBackend; }
+
+private:
+	D3D11RenderDevice(const D3D11RenderDevice& rhs);
+	D3D11RenderDevice& operator=(const D3D11RenderDevice& rhs);
+
+	ID3D11Device* mDevice;
+	ID3D11DeviceContext* mContext;
+	IDXGISwapChain* mSwapChain;
+	ID3D11RenderTargetView* mRenderTarget;
+	ID3D11DepthStencilView* mDepthStencil;
+	int mWidth;
+	int mHeight;
+
+	D3D11DrawBackend mDrawBackend;
+	D3D11TextureDevice mTextureDevice;
+
+	// Buffers owned by the device.  mVertexBuffers is indexed by vertex buffer handle
+	// and has holes for buffers registered with Backend() directly.
+	std::vector<ID3D11Buffer*> mVertexBuffers;
+	std::vector<ID3D11Buffer*> mIndexBuffers;
+};
+
+#endif // D3D11RENDERDEVICE_H
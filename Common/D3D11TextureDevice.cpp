@@ -0,0 +1,16 @@
+#include "D3D11TextureDevice.h"
+#include "DDSTextureLoader.h"
+
+void* D3D11TextureDevice::CreateTexture(const DDSCore::TextureDesc& desc, size_t topMip,
+	const DDSCore::Subresource* subresources)
+{
+	ID3D11ShaderResourceView* srv = 0;
+	HRESULT hr = DirectX::CreateDDSTextureFromSubresources(mDevice, desc, topMip, subresources, 0, &srv);
+	return SUCCEEDED(hr) ? srv : 0;
+}
+
+void D3D11TextureDevice::ReleaseTexture(void* texture)
+{
+	if(texture)
+		ToSRV(texture)->Release();
+}
@@ -0,0 +1,30 @@
+#ifndef D3D11TEXTUREDEVICE_H
+#define D3D11TEXTUREDEVICE_H
+
+#include <d3d11.h>
+
+#include "TextureStreamer.h"
+
+///<summary>
+/// TextureStreamer device backed by D3D11.  Handles are ID3D11ShaderResourceView
+/// pointers; the view holds the only reference to its texture.
+///</summary>
+class D3D11TextureDevice : public ITextureDevice
+{
+public:
+	explicit D3D11TextureDevice(ID3D11Device* device) : mDevice(device) {}
+
+	void* CreateTexture(const DDSCore::TextureDesc& desc, size_t topMip,
+		const DDSCore::Subresource* subresources);
+	void ReleaseTexture(void* texture);
+
+	static ID3D11ShaderResourceView* ToSRV(void* texture)
+	{
+		return static_cast<ID3D11ShaderResourceView*>(texture);
+	}
+
+private:
+	ID3D11Device* mDevice;
+};
+
+#endif // D3D11TEXTUREDEVICE_H
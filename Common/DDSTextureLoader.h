@@ -29,6 +29,9 @@
 #include <stdint.h>
 #pragma warning(pop)
 
+// DDS_ALPHA_MODE and the file structures live in the platform-neutral parser.
+#include "DDSCore.h"
+
 #if defined(_MSC_VER) && (_MSC_VER<1610) && !defined(_In_reads_)
 #define _In_reads_(exp)
 #define _Out_writes_(exp)
@@ -43,15 +46,6 @@
 
 namespace DirectX
 {
-    enum DDS_ALPHA_MODE
-    {
-        DDS_ALPHA_MODE_UNKNOWN       = 0,
-        DDS_ALPHA_MODE_STRAIGHT      = 1,
-        DDS_ALPHA_MODE_PREMULTIPLIED = 2,
-        DDS_ALPHA_MODE_OPAQUE        = 3,
-        DDS_ALPHA_MODE_CUSTOM        = 4,
-    };
-
     // Standard version
     HRESULT CreateDDSTextureFromMemory( _In_ ID3D11Device* d3dDevice,
                                         _In_reads_bytes_(ddsDataSize) const uint8_t* ddsData,
@@ -147,4 +141,16 @@ namespace DirectX
                                         _Outptr_opt_ ID3D11ShaderResourceView** textureView,
                                         _Out_opt_ DDS_ALPHA_MODE* alphaMode = nullptr
                                     );
+
+    // Creates a texture and view from an already parsed DDS, starting at mip topMip.
+    // initData holds (dds.mipCount - topMip) subresources per array slice, slice-major.
+    // Used by TextureStreamer, which keeps the file mapped and re-creates textures as
+    // finer mips become resident.
+    HRESULT CreateDDSTextureFromSubresources( _In_ ID3D11Device* d3dDevice,
+                                              _In_ const DDSCore::TextureDesc& dds,
+                                              _In_ size_t topMip,
+                                              _In_ const DDSCore::Subresource* initData,
+                                              _Outptr_opt_ ID3D11Resource** texture,
+                                              _Outptr_opt_ ID3D11ShaderResourceView** textureView
+                                            );
 }
\ No newline at end of file
@@ -0,0 +1,242 @@
+#include "DrawCommandList.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+DrawState::DrawState()
+	: Layer(0), Pipeline(NoDrawHandle), InputLayout(NoDrawHandle), Topology(0),
+	  VertexBuffer(NoDrawHandle), VertexStride(0), IndexBuffer(NoDrawHandle),
+	  InstanceBuffer(NoDrawHandle), InstanceStride(0)
+{
+}
+
+uint64_t DrawState::SortKey()const
+{
+	return (uint64_t(Layer        & 0xf)     << 60) |
+	       (uint64_t(Pipeline     & 0xfff)   << 48) |
+	       (uint64_t(InputLayout  & 0xff)    << 40) |
+	       (uint64_t(Topology     & 0x3f)    << 34) |
+	       (uint64_t(VertexBuffer & 0x3ffff) << 16) |
+	        uint64_t(IndexBuffer  & 0xffff);
+}
+
+DrawArgs::DrawArgs()
+	: Count(0), InstanceCount(1), StartIndex(0), BaseVertex(0), StartInstance(0)
+{
+}
+
+void DrawCommandList::Clear()
+{
+	mCommands.clear();
+	mConstants.clear();
+}
+
+void DrawCommandList::Draw(const DrawState& state, const DrawArgs& args)
+{
+	Draw(state, args, DrawConstants());
+}
+
+void DrawCommandList::Draw(const DrawState& state, const DrawArgs& args, const DrawConstants& constants)
+{
+	DrawCommand cmd;
+	cmd.Key = state.SortKey();
+	cmd.State = state;
+	cmd.Args = args;
+	cmd.ConstantSlot = constants.Slot;
+	cmd.ConstantOffset = constants.Offset;
+	cmd.ConstantSize = constants.Size;
+	cmd.ConstantData = 0;
+
+	if(constants.Size > 0)
+	{
+		// Keep each block 16-byte aligned so backends can copy whole registers.
+		size_t at = (mConstants.size() + 15) & ~size_t(15);
+		mConstants.resize(at + constants.Size);
+		std::memcpy(&mConstants[at], constants.Data, constants.Size);
+		cmd.ConstantData = (uint32_t)at;
+	}
+
+	mCommands.push_back(cmd);
+}
+
+DrawQueue::Stats::Stats()
+	: Draws(0), PipelineChanges(0), InputLayoutChanges(0), TopologyChanges(0),
+	  VertexBufferChanges(0), IndexBufferChanges(0), InstanceBufferChanges(0), ConstantUploads(0),
+	  RedundantConstants(0)
+{
+}
+
+void DrawQueue::Gather(const DrawCommandList* const* lists, size_t listCount)
+{
+	mLists.assign(lists, lists + listCount);
+	mOrder.clear();
+
+	size_t total = 0;
+	for(size_t l = 0; l < listCount; ++l)
+		total += lists[l]->Count();
+	mOrder.reserve(total);
+
+	for(size_t l = 0; l < listCount; ++l)
+	{
+		for(size_t c = 0; c < lists[l]->Count(); ++c)
+		{
+			Entry e = { lists[l]->Command(c).Key, (uint32_t)l, (uint32_t)c };
+			mOrder.push_back(e);
+		}
+	}
+
+	// (list, command) breaks ties, which makes the order deterministic without
+	// paying for a stable sort.
+	std::sort(mOrder.begin(), mOrder.end(), [](const Entry& a, const Entry& b)
+	{
+		if(a.Key != b.Key)
+			return a.Key < b.Key;
+		if(a.List != b.List)
+			return a.List < b.List;
+		return a.Command < b.Command;
+	});
+}
+
+void DrawQueue::Submit(IDrawBackend& backend, size_t begin, size_t end)
+{
+	assert(begin <= end && end <= mOrder.size());
+
+	const DrawState* last = 0;
+
+	// Non-indexed draws leave the bound index buffer alone, so it is tracked apart
+	// from the previous draw's state.  Likewise the instance buffer.
+	DrawHandle indexBuffer = NoDrawHandle;
+	DrawHandle instanceBuffer = NoDrawHandle;
+	uint32_t instanceStride = 0;
+
+	// Last constants written to each slot, to skip re-uploading identical bytes.
+	struct SlotContents
+	{
+		const void* Data;
+		uint32_t Offset;
+		uint32_t Size;
+	};
+	std::vector<SlotContents> slots;
+
+	for(size_t i = begin; i < end; ++i)
+	{
+		const DrawCommandList& list = *mLists[mOrder[i].List];
+		const DrawCommand& cmd = list.Command(mOrder[i].Command);
+		const DrawState& s = cmd.State;
+
+		if(!last || s.Pipeline != last->Pipeline)
+		{
+			backend.SetPipeline(s.Pipeline);
+			++mStats.PipelineChanges;
+		}
+		if(!last || s.InputLayout != last->InputLayout)
+		{
+			backend.SetInputLayout(s.InputLayout);
+			++mStats.InputLayoutChanges;
+		}
+		if(!last || s.Topology != last->Topology)
+		{
+			backend.SetTopology(s.Topology);
+			++mStats.TopologyChanges;
+		}
+		if(!last || s.VertexBuffer != last->VertexBuffer || s.VertexStride != last->VertexStride)
+		{
+			backend.SetVertexBuffer(s.VertexBuffer, s.VertexStride);
+			++mStats.VertexBufferChanges;
+		}
+		if(s.Indexed() && s.IndexBuffer != indexBuffer)
+		{
+			indexBuffer = s.IndexBuffer;
+			backend.SetIndexBuffer(s.IndexBuffer);
+			++mStats.IndexBufferChanges;
+		}
+		if(s.HasInstanceBuffer() && (s.InstanceBuffer != instanceBuffer || s.InstanceStride != instanceStride))
+		{
+			instanceBuffer = s.InstanceBuffer;
+			instanceStride = s.InstanceStride;
+			backend.SetInstanceBuffer(s.InstanceBuffer, s.InstanceStride);
+			++mStats.InstanceBufferChanges;
+		}
+
+		if(cmd.ConstantSize > 0)
+		{
+			const void* data = list.ConstantData(cmd);
+
+			if(slots.size() <= cmd.ConstantSlot)
+			{
+				SlotContents empty = { 0, 0, 0 };
+				slots.resize(cmd.ConstantSlot + 1, empty);
+			}
+
+			SlotContents& prev = slots[cmd.ConstantSlot];
+			if(prev.Data && prev.Offset == cmd.ConstantOffset && prev.Size == cmd.ConstantSize &&
+				std::memcmp(prev.Data, data, cmd.ConstantSize) == 0)
+			{
+				++mStats.RedundantConstants;
+			}
+			else
+			{
+				backend.SetConstants(cmd.ConstantSlot, cmd.ConstantOffset, data, cmd.ConstantSize);
+				++mStats.ConstantUploads;
+				prev.Data = data;
+				prev.Offset = cmd.ConstantOffset;
+				prev.Size = cmd.ConstantSize;
+			}
+		}
+
+		backend.Draw(cmd.Args, s.Indexed());
+		++mStats.Draws;
+		last = &s;
+	}
+}
+
+void RecordingDrawBackend::SetPipeline(DrawHandle pipeline)
+{
+	Call c = { CallPipeline, pipeline, 0, 0, 0, false };
+	Calls.push_back(c);
+}
+
+void RecordingDrawBackend::SetInputLayout(DrawHandle layout)
+{
+	Call c = { CallInputLayout, layout, 0, 0, 0, false };
+	Calls.push_back(c);
+}
+
+void RecordingDrawBackend::SetTopology(uint32_t topology)
+{
+	Call c = { CallTopology, topology, 0, 0, 0, false };
+	Calls.push_back(c);
+}
+
+void RecordingDrawBackend::SetVertexBuffer(DrawHandle buffer, uint32_t stride)
+{
+	Call c = { CallVertexBuffer, buffer, stride, 0, 0, false };
+	Calls.push_back(c);
+}
+
+void RecordingDrawBackend::SetIndexBuffer(DrawHandle buffer)
+{
+	Call c = { CallIndexBuffer, buffer, 0, 0, 0, false };
+	Calls.push_back(c);
+}
+
+void RecordingDrawBackend::SetInstanceBuffer(DrawHandle buffer, uint32_t stride)
+{
+	Call c = { CallInstanceBuffer, buffer, stride, 0, 0, false };
+	Calls.push_back(c);
+}
+
+void RecordingDrawBackend::SetConstants(uint32_t slot, uint32_t offset, const void* data, uint32_t size)
+{
+	Call c = { CallConstants, slot, size, offset, 0, false };
+	Calls.push_back(c);
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	Constants.insert(Constants.end(), bytes, bytes + size);
+}
+
+void RecordingDrawBackend::Draw(const DrawArgs& args, bool indexed)
+{
+	Call c = { CallDraw, args.Count, args.InstanceCount, args.StartIndex, args.StartInstance, indexed };
+	Calls.push_back(c);
+}
@@ -0,0 +1,212 @@
+#ifndef DRAWCOMMANDLIST_H
+#define DRAWCOMMANDLIST_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//---------------------------------------------------------------------------------------
+// Backend-neutral draw recording.  Worker threads each fill their own DrawCommandList
+// (a list is not thread safe, but lists share nothing), then the render thread gathers
+// them into a DrawQueue, sorts by state and submits through an IDrawBackend.  Pipelines,
+// input layouts and buffers are plain handles the backend hands out, so recording and
+// sorting build and run without a device.
+//---------------------------------------------------------------------------------------
+
+typedef uint32_t DrawHandle;
+
+static const DrawHandle NoDrawHandle = 0xffffffff;
+
+struct DrawState
+{
+	DrawState();
+
+	uint32_t Layer;             // Submission order bucket, e.g. opaque before transparent.
+	DrawHandle Pipeline;        // Shaders and render states, e.g. an effect pass.
+	DrawHandle InputLayout;
+	uint32_t Topology;          // Backend primitive topology value.
+	DrawHandle VertexBuffer;
+	uint32_t VertexStride;
+	DrawHandle IndexBuffer;     // NoDrawHandle for non-indexed draws.
+	DrawHandle InstanceBuffer;  // Per-instance vertex data for slot 1, or NoDrawHandle.
+	uint32_t InstanceStride;
+
+	// Layer | Pipeline | InputLayout | Topology | VertexBuffer | IndexBuffer, most
+	// expensive change first.  Handles wider than their field still draw correctly,
+	// they only sort less tightly.  Instance buffers are not part of the key.
+	uint64_t SortKey()const;
+
+	bool Indexed()const { return IndexBuffer != NoDrawHandle; }
+	bool HasInstanceBuffer()const { return InstanceBuffer != NoDrawHandle; }
+};
+
+struct DrawArgs
+{
+	DrawArgs();
+
+	uint32_t Count;          // Index count for indexed draws, vertex count otherwise.
+	uint32_t InstanceCount;
+	uint32_t StartIndex;     // Or start vertex for non-indexed draws.
+	int32_t  BaseVertex;
+	uint32_t StartInstance;
+};
+
+// Constants written into a backend constant buffer slot before the draw.
+struct DrawConstants
+{
+	DrawConstants() : Slot(0), Offset(0), Data(0), Size(0) {}
+	DrawConstants(uint32_t slot, uint32_t offset, const void* data, uint32_t size)
+		: Slot(slot), Offset(offset), Data(data), Size(size) {}
+
+	uint32_t Slot;
+	uint32_t Offset;
+	const void* Data;
+	uint32_t Size;
+};
+
+struct DrawCommand
+{
+	uint64_t Key;
+	DrawState State;
+	DrawArgs Args;
+	uint32_t ConstantSlot;
+	uint32_t ConstantOffset;
+	uint32_t ConstantData;   // Byte offset into the list's constant storage.
+	uint32_t ConstantSize;   // 0 if the draw has no constants.
+};
+
+///<summary>
+/// Draws recorded by one thread.  Constants are copied into the list, so the caller's
+/// data only has to live until Draw returns.  Clear keeps the memory for the next frame.
+///</summary>
+class DrawCommandList
+{
+public:
+	void Clear();
+
+	void Draw(const DrawState& state, const DrawArgs& args);
+	void Draw(const DrawState& state, const DrawArgs& args, const DrawConstants& constants);
+
+	size_t Count()const { return mCommands.size(); }
+	const DrawCommand& Command(size_t i)const { return mCommands[i]; }
+	const void* ConstantData(const DrawCommand& cmd)const { return mConstants.data() + cmd.ConstantData; }
+
+private:
+	std::vector<DrawCommand> mCommands;
+	std::vector<uint8_t> mConstants;
+};
+
+///<summary>
+/// Receives sorted draws.  DrawQueue::Submit only calls a setter when its value differs
+/// from the previous draw, so backends can forward every call to the API.
+///</summary>
+class IDrawBackend
+{
+public:
+	virtual ~IDrawBackend() {}
+
+	virtual void SetPipeline(DrawHandle pipeline) = 0;
+	virtual void SetInputLayout(DrawHandle layout) = 0;
+	virtual void SetTopology(uint32_t topology) = 0;
+	virtual void SetVertexBuffer(DrawHandle buffer, uint32_t stride) = 0;
+	virtual void SetIndexBuffer(DrawHandle buffer) = 0;
+	virtual void SetInstanceBuffer(DrawHandle buffer, uint32_t stride) = 0;
+	virtual void SetConstants(uint32_t slot, uint32_t offset, const void* data, uint32_t size) = 0;
+	virtual void Draw(const DrawArgs& args, bool indexed) = 0;
+};
+
+///<summary>
+/// Merges the lists recorded for a frame and submits them in state order.  Draws with
+/// equal keys keep their (list, recording) order, so the result does not depend on
+/// which worker finished first.  The sorted range can be split, for example to replay
+/// parts of it onto deferred contexts.
+///</summary>
+class DrawQueue
+{
+public:
+	struct Stats
+	{
+		Stats();
+
+		size_t Draws;
+		size_t PipelineChanges;
+		size_t InputLayoutChanges;
+		size_t TopologyChanges;
+		size_t VertexBufferChanges;
+		size_t IndexBufferChanges;
+		size_t InstanceBufferChanges;
+		size_t ConstantUploads;
+		size_t RedundantConstants;   // Same bytes as the previous upload to that slot.
+	};
+
+	// Sorts every command of the given lists.  The lists must stay alive and unchanged
+	// until the last Submit.
+	void Gather(const DrawCommandList* const* lists, size_t listCount);
+
+	size_t Count()const { return mOrder.size(); }
+
+	// Submits sorted draws [begin, end).  State filtering starts fresh on every call,
+	// since each call may target a different context.
+	void Submit(IDrawBackend& backend, size_t begin, size_t end);
+	void Submit(IDrawBackend& backend) { Submit(backend, 0, mOrder.size()); }
+
+	const Stats& GetStats()const { return mStats; }
+	void ResetStats() { mStats = Stats(); }
+
+private:
+	struct Entry
+	{
+		uint64_t Key;
+		uint32_t List;
+		uint32_t Command;
+	};
+
+	std::vector<const DrawCommandList*> mLists;
+	std::vector<Entry> mOrder;
+	Stats mStats;
+};
+
+///<summary>
+/// Backend that records every call, for tests and tools.
+///</summary>
+class RecordingDrawBackend : public IDrawBackend
+{
+public:
+	enum CallType
+	{
+		CallPipeline,
+		CallInputLayout,
+		CallTopology,
+		CallVertexBuffer,
+		CallIndexBuffer,
+		CallInstanceBuffer,
+		CallConstants,
+		CallDraw
+	};
+
+	struct Call
+	{
+		CallType Type;
+		uint32_t A;   // Handle, topology, constant slot, or draw count.
+		uint32_t B;   // Stride, constant size, or instance count.
+		uint32_t C;   // Constant offset, or start index (start vertex if not indexed).
+		uint32_t D;   // Start instance.
+		bool Indexed;
+	};
+
+	void SetPipeline(DrawHandle pipeline);
+	void SetInputLayout(DrawHandle layout);
+	void SetTopology(uint32_t topology);
+	void SetVertexBuffer(DrawHandle buffer, uint32_t stride);
+	void SetIndexBuffer(DrawHandle buffer);
+	void SetInstanceBuffer(DrawHandle buffer, uint32_t stride);
+	void SetConstants(uint32_t slot, uint32_t offset, const void* data, uint32_t size);
+	void Draw(const DrawArgs& args, bool indexed);
+
+	void Clear() { Calls.clear(); Constants.clear(); }
+
+	std::vector<Call> Calls;
+	std::vector<uint8_t> Constants;   // The bytes of every SetConstants call, in order.
+};
+
+#endif // DRAWCOMMANDLIST_H
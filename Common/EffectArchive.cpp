@@ -0,0 +1,233 @@
+#include "EffectArchive.h"
+
+#include <cstdio>
+#include <cstring>
+
+static_assert(sizeof(EffectArchiveHeader) == 16, "EffectArchiveHeader is part of the file format");
+static_assert(sizeof(EffectArchiveEntry) == 32, "EffectArchiveEntry is part of the file format");
+
+const uint32_t EffectArchive::Magic;
+const uint32_t EffectArchive::Version;
+const uint32_t EffectArchive::BlobAlignment;
+
+namespace
+{
+	bool Fail(std::string* error, const std::string& message)
+	{
+		if(error)
+			*error = message;
+		return false;
+	}
+
+	size_t AlignUp(size_t value, size_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+}
+
+EffectArchive::EffectArchive()
+	: mData(0), mEntryCount(0)
+{
+}
+
+bool EffectArchive::Open(const char* path, std::string* error)
+{
+	Close();
+
+	if(!mFile.Open(path))
+		return Fail(error, "cannot open file");
+
+	if(!LoadFromMemory(mFile.Data(), mFile.Size(), error))
+	{
+		mFile.Close();
+		return false;
+	}
+	return true;
+}
+
+bool EffectArchive::LoadFromMemory(const uint8_t* data, size_t size, std::string* error)
+{
+	mData = 0;
+	mEntryCount = 0;
+
+	if(size < sizeof(EffectArchiveHeader))
+		return Fail(error, "file too small for header");
+
+	EffectArchiveHeader header;
+	std::memcpy(&header, data, sizeof(header));
+
+	if(header.Magic != Magic)
+		return Fail(error, "not an effect archive");
+	if(header.Version != Version)
+		return Fail(error, "unsupported effect archive version");
+
+	uint64_t tocEnd = sizeof(EffectArchiveHeader) + uint64_t(header.EntryCount) * sizeof(EffectArchiveEntry);
+	if(tocEnd > size)
+		return Fail(error, "table of contents out of bounds");
+
+	for(uint32_t i = 0; i < header.EntryCount; ++i)
+	{
+		EffectArchiveEntry entry;
+		std::memcpy(&entry, data + sizeof(EffectArchiveHeader) + i*sizeof(EffectArchiveEntry), sizeof(entry));
+
+		if(entry.NameLength == 0 || entry.NameOffset < tocEnd || entry.NameOffset > size || entry.NameLength > size - entry.NameOffset)
+			return Fail(error, "entry name out of bounds");
+
+		std::string name(reinterpret_cast<const char*>(data + entry.NameOffset), entry.NameLength);
+		if(entry.Offset % BlobAlignment != 0)
+			return Fail(error, "misaligned blob for " + name);
+		if(entry.Offset < tocEnd || entry.Offset > size || entry.Size > size - entry.Offset)
+			return Fail(error, "blob out of bounds for " + name);
+		if(Hash(data + entry.Offset, size_t(entry.Size)) != entry.Hash)
+			return Fail(error, "hash mismatch for " + name);
+	}
+
+	mData = data;
+	mEntryCount = header.EntryCount;
+	return true;
+}
+
+void EffectArchive::Close()
+{
+	mFile.Close();
+	mData = 0;
+	mEntryCount = 0;
+}
+
+EffectArchiveEntry EffectArchive::Entry(size_t i)const
+{
+	EffectArchiveEntry entry;
+	std::memcpy(&entry, mData + sizeof(EffectArchiveHeader) + i*sizeof(EffectArchiveEntry), sizeof(entry));
+	return entry;
+}
+
+std::string EffectArchive::Name(size_t i)const
+{
+	EffectArchiveEntry entry = Entry(i);
+	return std::string(reinterpret_cast<const char*>(mData + entry.NameOffset), entry.NameLength);
+}
+
+EffectArchive::Blob EffectArchive::Get(size_t i)const
+{
+	EffectArchiveEntry entry = Entry(i);
+
+	Blob blob;
+	blob.Data = mData + entry.Offset;
+	blob.Size = size_t(entry.Size);
+	return blob;
+}
+
+bool EffectArchive::Find(const char* name, Blob& blob)const
+{
+	std::string key = NormalizeName(name);
+
+	for(size_t i = 0; i < mEntryCount; ++i)
+	{
+		EffectArchiveEntry entry = Entry(i);
+		if(entry.NameLength == key.size() && std::memcmp(mData + entry.NameOffset, key.data(), key.size()) == 0)
+		{
+			blob.Data = mData + entry.Offset;
+			blob.Size = size_t(entry.Size);
+			return true;
+		}
+	}
+	return false;
+}
+
+uint64_t EffectArchive::Hash(const uint8_t* data, size_t size)
+{
+	uint64_t hash = 14695981039346656037ull;
+	for(size_t i = 0; i < size; ++i)
+	{
+		hash ^= data[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+std::string EffectArchive::NormalizeName(const char* name)
+{
+	std::string result(name ? name : "");
+	for(size_t i = 0; i < result.size(); ++i)
+	{
+		char c = result[i];
+		if(c == '\\')
+			c = '/';
+		else if(c >= 'A' && c <= 'Z')
+			c = char(c - 'A' + 'a');
+		result[i] = c;
+	}
+	return result;
+}
+
+bool EffectArchive::Build(const std::vector<Input>& inputs, std::vector<uint8_t>& image, std::string* error)
+{
+	image.clear();
+
+	std::vector<std::string> names(inputs.size());
+	size_t nameBytes = 0;
+	for(size_t i = 0; i < inputs.size(); ++i)
+	{
+		names[i] = NormalizeName(inputs[i].Name.c_str());
+		if(names[i].empty())
+			return Fail(error, "empty entry name");
+		for(size_t j = 0; j < i; ++j)
+		{
+			if(names[j] == names[i])
+				return Fail(error, "duplicate entry " + names[i]);
+		}
+		nameBytes += names[i].size();
+	}
+
+	size_t tocEnd = sizeof(EffectArchiveHeader) + inputs.size()*sizeof(EffectArchiveEntry);
+	size_t offset = AlignUp(tocEnd + nameBytes, BlobAlignment);
+
+	std::vector<EffectArchiveEntry> entries(inputs.size());
+	size_t nameOffset = tocEnd;
+	for(size_t i = 0; i < inputs.size(); ++i)
+	{
+		EffectArchiveEntry& entry = entries[i];
+		entry.Offset = offset;
+		entry.Size = inputs[i].Data.size();
+		entry.Hash = Hash(inputs[i].Data.data(), inputs[i].Data.size());
+		entry.NameOffset = uint32_t(nameOffset);
+		entry.NameLength = uint32_t(names[i].size());
+
+		nameOffset += names[i].size();
+		offset = AlignUp(offset + inputs[i].Data.size(), BlobAlignment);
+	}
+
+	EffectArchiveHeader header;
+	header.Magic = Magic;
+	header.Version = Version;
+	header.EntryCount = uint32_t(inputs.size());
+	header.Reserved = 0;
+
+	image.assign(offset, 0);
+	std::memcpy(image.data(), &header, sizeof(header));
+	if(!entries.empty())
+		std::memcpy(image.data() + sizeof(header), entries.data(), entries.size()*sizeof(EffectArchiveEntry));
+	for(size_t i = 0; i < inputs.size(); ++i)
+	{
+		std::memcpy(image.data() + entries[i].NameOffset, names[i].data(), names[i].size());
+		if(!inputs[i].Data.empty())
+			std::memcpy(image.data() + size_t(entries[i].Offset), inputs[i].Data.data(), inputs[i].Data.size());
+	}
+	return true;
+}
+
+bool EffectArchive::Write(const char* path, const std::vector<Input>& inputs, std::string* error)
+{
+	std::vector<uint8_t> image;
+	if(!Build(inputs, image, error))
+		return false;
+
+	FILE* file = std::fopen(path, "wb");
+	if(!file)
+		return Fail(error, "cannot create file");
+
+	bool ok = std::fwrite(image.data(), image.size(), 1, file) == 1;
+	ok = (std::fclose(file) == 0) && ok;
+
+	return ok ? true : Fail(error, "write failed");
+}
@@ -0,0 +1,99 @@
+#ifndef EFFECTARCHIVE_H
+#define EFFECTARCHIVE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "MappedFile.h"
+
+//---------------------------------------------------------------------------------------
+// Packed effect archive (.fxa), little endian:
+//
+//   EffectArchiveHeader   16 bytes at offset 0
+//   EffectArchiveEntry    32 bytes per entry, directly after the header
+//   names                 entry names, not null terminated
+//   blobs                 compiled effects, each on a 16-byte boundary
+//
+// Names are stored lower case with '/' separators and looked up the same way, so
+// "FX\Basic.fxo" and "fx/basic.fxo" name the same entry, as they would on Windows.
+//---------------------------------------------------------------------------------------
+
+struct EffectArchiveHeader
+{
+	uint32_t Magic;
+	uint32_t Version;
+	uint32_t EntryCount;
+	uint32_t Reserved;
+};
+
+struct EffectArchiveEntry
+{
+	uint64_t Offset;
+	uint64_t Size;
+	uint64_t Hash;       // EffectArchive::Hash of the blob.
+	uint32_t NameOffset;
+	uint32_t NameLength;
+};
+
+///<summary>
+/// Reads and writes .fxa archives.  Open maps the whole archive and checks its table
+/// of contents and every blob's hash, which also pages the file in with one
+/// sequential pass.  Blobs point into the mapping and stay valid until Close or
+/// destruction.
+///</summary>
+class EffectArchive
+{
+public:
+	static const uint32_t Magic = 0x41584654; // "TFXA"
+	static const uint32_t Version = 1;
+	static const uint32_t BlobAlignment = 16;
+
+	struct Blob
+	{
+		const uint8_t* Data;
+		size_t Size;
+	};
+
+	struct Input
+	{
+		std::string Name;
+		std::vector<uint8_t> Data;
+	};
+
+	EffectArchive();
+
+	bool Open(const char* path, std::string* error = 0);
+
+	// Validates an archive image already in memory.  data must outlive the archive.
+	bool LoadFromMemory(const uint8_t* data, size_t size, std::string* error = 0);
+
+	void Close();
+
+	size_t Count()const { return mEntryCount; }
+	std::string Name(size_t i)const;
+	Blob Get(size_t i)const;
+
+	// Looks name up after normalizing it like the stored names.
+	bool Find(const char* name, Blob& blob)const;
+
+	// 64-bit FNV-1a.
+	static uint64_t Hash(const uint8_t* data, size_t size);
+
+	// Lower case, '/' separators.
+	static std::string NormalizeName(const char* name);
+
+	// Lays out an archive holding inputs.  Fails on empty or duplicate names.
+	static bool Build(const std::vector<Input>& inputs, std::vector<uint8_t>& image, std::string* error = 0);
+	static bool Write(const char* path, const std::vector<Input>& inputs, std::string* error = 0);
+
+private:
+	EffectArchiveEntry Entry(size_t i)const;
+
+	MappedFile mFile;
+	const uint8_t* mData;
+	size_t mEntryCount;
+};
+
+#endif // EFFECTARCHIVE_H
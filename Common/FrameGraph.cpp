@@ -0,0 +1,260 @@
+#include "FrameGraph.h"
+
+#include <algorithm>
+#include <cassert>
+
+FrameGraph::TextureDesc::TextureDesc()
+	: Width(0), Height(0), Depth(1), MipLevels(1), Format(0), BindFlags(0), BytesPerTexel(0)
+{
+}
+
+uint64_t FrameGraph::TextureDesc::Bytes()const
+{
+	// Each mip is at least a texel per axis.
+	uint64_t bytes = 0;
+	uint32_t w = Width, h = Height, d = Depth;
+	for(uint32_t mip = 0; mip < MipLevels; ++mip)
+	{
+		bytes += (uint64_t)w*h*d*BytesPerTexel;
+		w = (std::max)(w / 2, 1u);
+		h = (std::max)(h / 2, 1u);
+		d = (std::max)(d / 2, 1u);
+	}
+	return bytes;
+}
+
+bool FrameGraph::TextureDesc::operator==(const TextureDesc& rhs)const
+{
+	return Width == rhs.Width && Height == rhs.Height && Depth == rhs.Depth && MipLevels == rhs.MipLevels &&
+		Format == rhs.Format && BindFlags == rhs.BindFlags && BytesPerTexel == rhs.BytesPerTexel;
+}
+
+FrameGraph::Stats::Stats()
+	: LivePasses(0), CulledPasses(0), Transients(0), PhysicalTextures(0), TransientBytes(0), PhysicalBytes(0)
+{
+}
+
+FrameGraph::FrameGraph()
+	: mCompiled(false)
+{
+}
+
+FrameGraph::ResourceId FrameGraph::Import(const char* name, bool output)
+{
+	Resource r;
+	r.Name = name;
+	r.Transient = false;
+	r.Output = output;
+	r.Used = false;
+	r.Physical = NoPhysical;
+	r.FirstUse = 0;
+	r.LastUse = 0;
+	mResources.push_back(r);
+	mCompiled = false;
+	return (ResourceId)(mResources.size() - 1);
+}
+
+FrameGraph::ResourceId FrameGraph::CreateTransient(const char* name, const TextureDesc& desc)
+{
+	ResourceId id = Import(name);
+	mResources[id].Transient = true;
+	mResources[id].Desc = desc;
+	return id;
+}
+
+FrameGraph::PassId FrameGraph::AddPass(const char* name, const std::function<void()>& execute)
+{
+	Pass p;
+	p.Name = name;
+	p.Execute = execute;
+	p.Enabled = true;
+	p.Live = false;
+	mPasses.push_back(p);
+	mCompiled = false;
+	return (PassId)(mPasses.size() - 1);
+}
+
+void FrameGraph::Read(PassId pass, ResourceId resource)
+{
+	assert(pass < mPasses.size() && resource < mResources.size());
+	mPasses[pass].Reads.push_back(resource);
+	mCompiled = false;
+}
+
+void FrameGraph::Write(PassId pass, ResourceId resource)
+{
+	assert(pass < mPasses.size() && resource < mResources.size());
+	mPasses[pass].Writes.push_back(resource);
+	mCompiled = false;
+}
+
+void FrameGraph::SetEnabled(PassId pass, bool enabled)
+{
+	if(mPasses[pass].Enabled != enabled)
+	{
+		mPasses[pass].Enabled = enabled;
+		mCompiled = false;
+	}
+}
+
+bool FrameGraph::Compile(std::string* error)
+{
+	mStats = Stats();
+	mPhysical.clear();
+	mCompiled = false;
+
+	Cull();
+	if(!ComputeLifetimes(error))
+		return false;
+	Alias();
+
+	mCompiled = true;
+	return true;
+}
+
+bool FrameGraph::Execute(std::string* error)
+{
+	if(!mCompiled && !Compile(error))
+		return false;
+
+	for(size_t i = 0; i < mPasses.size(); ++i)
+	{
+		if(mPasses[i].Live && mPasses[i].Execute)
+			mPasses[i].Execute();
+	}
+	return true;
+}
+
+void FrameGraph::Cull()
+{
+	// Walk back from the last pass: a pass is live if it writes something needed, and
+	// then everything it reads is needed by an earlier writer.
+	std::vector<uint8_t> needed(mResources.size(), 0);
+	for(size_t r = 0; r < mResources.size(); ++r)
+		needed[r] = mResources[r].Output ? 1 : 0;
+
+	for(size_t i = mPasses.size(); i-- > 0; )
+	{
+		Pass& pass = mPasses[i];
+		pass.Live = false;
+		if(!pass.Enabled)
+			continue;
+
+		for(size_t w = 0; w < pass.Writes.size() && !pass.Live; ++w)
+			pass.Live = needed[pass.Writes[w]] != 0;
+		if(!pass.Live)
+			continue;
+
+		for(size_t r = 0; r < pass.Reads.size(); ++r)
+			needed[pass.Reads[r]] = 1;
+	}
+
+	for(size_t i = 0; i < mPasses.size(); ++i)
+	{
+		if(mPasses[i].Live)
+			++mStats.LivePasses;
+		else
+			++mStats.CulledPasses;
+	}
+}
+
+bool FrameGraph::ComputeLifetimes(std::string* error)
+{
+	std::vector<uint8_t> written(mResources.size(), 0);
+	for(size_t r = 0; r < mResources.size(); ++r)
+	{
+		mResources[r].Used = false;
+		mResources[r].Physical = NoPhysical;
+		mResources[r].FirstUse = mResources[r].LastUse = 0;
+	}
+
+	for(size_t i = 0; i < mPasses.size(); ++i)
+	{
+		const Pass& pass = mPasses[i];
+		if(!pass.Live)
+			continue;
+
+		for(size_t r = 0; r < pass.Reads.size(); ++r)
+		{
+			ResourceId id = pass.Reads[r];
+			if(mResources[id].Transient && !written[id])
+			{
+				if(error)
+					*error = "Pass \"" + pass.Name + "\" reads \"" + mResources[id].Name + "\" before any live pass writes it";
+				return false;
+			}
+		}
+
+		for(int access = 0; access < 2; ++access)
+		{
+			const std::vector<ResourceId>& ids = access == 0 ? pass.Reads : pass.Writes;
+			for(size_t r = 0; r < ids.size(); ++r)
+			{
+				Resource& res = mResources[ids[r]];
+				if(!res.Used)
+				{
+					res.Used = true;
+					res.FirstUse = (PassId)i;
+				}
+				res.LastUse = (PassId)i;
+			}
+		}
+		for(size_t w = 0; w < pass.Writes.size(); ++w)
+			written[pass.Writes[w]] = 1;
+	}
+
+	for(size_t r = 0; r < mResources.size(); ++r)
+	{
+		if(mResources[r].Transient && mResources[r].Used)
+		{
+			++mStats.Transients;
+			mStats.TransientBytes += mResources[r].Desc.Bytes();
+		}
+	}
+	return true;
+}
+
+void FrameGraph::Alias()
+{
+	// Greedy interval assignment in order of first use: take the first compatible
+	// texture whose previous owner's last use is over, else make a new one.  The
+	// texture is free again after the pass that last used it, so a transient can take
+	// over a texture that was read for the last time by an earlier pass.
+	std::vector<ResourceId> order;
+	for(size_t r = 0; r < mResources.size(); ++r)
+	{
+		if(mResources[r].Transient && mResources[r].Used)
+			order.push_back((ResourceId)r);
+	}
+	std::stable_sort(order.begin(), order.end(), [this](ResourceId a, ResourceId b)
+	{
+		return mResources[a].FirstUse < mResources[b].FirstUse;
+	});
+
+	std::vector<PassId> busyUntil;
+	for(size_t i = 0; i < order.size(); ++i)
+	{
+		Resource& res = mResources[order[i]];
+
+		uint32_t physical = NoPhysical;
+		for(size_t p = 0; p < mPhysical.size(); ++p)
+		{
+			if(busyUntil[p] < res.FirstUse && mPhysical[p] == res.Desc)
+			{
+				physical = (uint32_t)p;
+				break;
+			}
+		}
+		if(physical == NoPhysical)
+		{
+			physical = (uint32_t)mPhysical.size();
+			mPhysical.push_back(res.Desc);
+			busyUntil.push_back(0);
+			mStats.PhysicalBytes += res.Desc.Bytes();
+		}
+
+		res.Physical = physical;
+		busyUntil[physical] = res.LastUse;
+	}
+	mStats.PhysicalTextures = mPhysical.size();
+}
@@ -0,0 +1,151 @@
+#ifndef FRAMEGRAPH_H
+#define FRAMEGRAPH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+///<summary>
+/// Declarative frame: passes say which resources they read and write, the graph works
+/// out which passes matter and how long each transient resource lives.
+///
+///   ResourceId backBuffer = graph.Import("Back buffer", true);
+///   ResourceId density = graph.Import("Density volume");
+///   PassId terrain = graph.AddPass("Terrain", [&]() { ... });
+///   graph.Read(terrain, density);
+///   graph.Write(terrain, backBuffer);
+///   ...
+///   graph.Compile(&error);
+///   graph.Execute();
+///
+/// Passes run in the order they were added.  Compile culls every pass that is disabled
+/// or whose writes nothing live reads: a pass is live if it writes an output (an
+/// imported resource marked as one, like the back buffer) or a resource a later live
+/// pass reads.  Writes accumulate, so every live writer of a resource stays.
+///
+/// Imported resources are owned by the caller and persist across frames.  Transient
+/// resources exist only between the first and last live pass that uses them, and
+/// transients with the same description whose lifetimes do not overlap share one
+/// physical texture: D3D11 cannot place resources in shared memory, so aliasing is
+/// reuse of whole textures.  The caller creates PhysicalCount() textures from
+/// PhysicalDesc and binds resource r to Physical(r).
+///
+/// Nothing here touches a device, so scheduling and aliasing run headless.  Compile is
+/// only needed after the graph changes; Execute recompiles a changed graph itself.
+///</summary>
+class FrameGraph
+{
+public:
+	typedef uint32_t ResourceId;
+	typedef uint32_t PassId;
+
+	static const uint32_t NoPhysical = 0xffffffff;
+
+	// Backend values are opaque to the graph; they only decide which transients may
+	// share a texture.
+	struct TextureDesc
+	{
+		TextureDesc();
+
+		uint32_t Width;
+		uint32_t Height;
+		uint32_t Depth;          // 1 for 2D textures.
+		uint32_t MipLevels;
+		uint32_t Format;
+		uint32_t BindFlags;
+		uint32_t BytesPerTexel;  // For the memory statistics only.
+
+		uint64_t Bytes()const;
+		bool operator==(const TextureDesc& rhs)const;
+	};
+
+	struct Stats
+	{
+		Stats();
+
+		size_t LivePasses;
+		size_t CulledPasses;
+		size_t Transients;          // Used by live passes.
+		size_t PhysicalTextures;
+		uint64_t TransientBytes;    // Without aliasing.
+		uint64_t PhysicalBytes;     // With aliasing.
+	};
+
+	FrameGraph();
+
+	// An output is always needed, so its writers are never culled.
+	ResourceId Import(const char* name, bool output = false);
+	ResourceId CreateTransient(const char* name, const TextureDesc& desc);
+
+	PassId AddPass(const char* name, const std::function<void()>& execute);
+	void Read(PassId pass, ResourceId resource);
+	void Write(PassId pass, ResourceId resource);
+
+	// Disabled passes are culled as if nothing read their output.
+	void SetEnabled(PassId pass, bool enabled);
+	bool Enabled(PassId pass)const { return mPasses[pass].Enabled; }
+
+	// Culls passes and assigns transients to physical textures.  Fails if a live pass
+	// reads a transient before any live pass has written it.
+	bool Compile(std::string* error = 0);
+
+	// Runs the live passes in order.  Returns false, running nothing, if the graph
+	// changed and no longer compiles.
+	bool Execute(std::string* error = 0);
+
+	size_t PassCount()const { return mPasses.size(); }
+	const std::string& PassName(PassId pass)const { return mPasses[pass].Name; }
+	bool PassLive(PassId pass)const { return mPasses[pass].Live; }
+
+	size_t ResourceCount()const { return mResources.size(); }
+	const std::string& ResourceName(ResourceId resource)const { return mResources[resource].Name; }
+	bool Transient(ResourceId resource)const { return mResources[resource].Transient; }
+
+	// After Compile.  Lifetimes are pass ids; a transient no live pass uses has no
+	// physical texture.
+	uint32_t Physical(ResourceId resource)const { return mResources[resource].Physical; }
+	PassId FirstUse(ResourceId resource)const { return mResources[resource].FirstUse; }
+	PassId LastUse(ResourceId resource)const { return mResources[resource].LastUse; }
+	size_t PhysicalCount()const { return mPhysical.size(); }
+	const TextureDesc& PhysicalDesc(uint32_t physical)const { return mPhysical[physical]; }
+
+	const Stats& GetStats()const { return mStats; }
+
+private:
+	struct Resource
+	{
+		std::string Name;
+		bool Transient;
+		bool Output;
+		TextureDesc Desc;
+
+		bool Used;
+		uint32_t Physical;
+		PassId FirstUse;
+		PassId LastUse;
+	};
+
+	struct Pass
+	{
+		std::string Name;
+		std::function<void()> Execute;
+		std::vector<ResourceId> Reads;
+		std::vector<ResourceId> Writes;
+		bool Enabled;
+		bool Live;
+	};
+
+	void Cull();
+	bool ComputeLifetimes(std::string* error);
+	void Alias();
+
+	std::vector<Resource> mResources;
+	std::vector<Pass> mPasses;
+	std::vector<TextureDesc> mPhysical;
+	bool mCompiled;
+	Stats mStats;
+};
+
+#endif // FRAMEGRAPH_H
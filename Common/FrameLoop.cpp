@@ -0,0 +1,170 @@
+#include "FrameLoop.h"
+
+#include <cassert>
+
+FrameLoop::FrameLoop(FrameProfiler& profiler)
+	: mProfiler(profiler)
+{
+	mUpdateScope = mProfiler.AddScope("UpdateScene");
+	mDrawScope = mProfiler.AddScope("DrawScene");
+}
+
+void FrameLoop::Frame(IFrameClient& client, float dt)
+{
+	mProfiler.BeginFrame();
+	{
+		FrameProfiler::Scope scope(mProfiler, mUpdateScope);
+		client.UpdateScene(dt);
+	}
+	{
+		FrameProfiler::Scope scope(mProfiler, mDrawScope);
+		client.DrawScene();
+	}
+	mProfiler.EndFrame();
+}
+
+void FrameLoop::Run(IFrameClient& client, GameTimer& timer, size_t frameCount, float fixedDelta)
+{
+	timer.Reset();
+	for(size_t i = 0; i < frameCount; ++i)
+	{
+		timer.Tick();
+		Frame(client, fixedDelta > 0.0f ? fixedDelta : timer.DeltaTime());
+	}
+}
+
+PipelinedFrameLoop::PipelinedFrameLoop(FrameProfiler& renderProfiler, FrameProfiler& simProfiler)
+	: mRenderProfiler(renderProfiler), mSimProfiler(simProfiler), mClient(0), mSleepers(0), mStop(false),
+	mFinished(true), mSimulated(0), mRendered(0)
+{
+	mWaitSimScope = mRenderProfiler.AddScope("Wait for simulation");
+	mRenderScope = mRenderProfiler.AddScope("Render");
+	mSimulateScope = mSimProfiler.AddScope("Simulate");
+	mWaitRenderScope = mSimProfiler.AddScope("Wait for render");
+}
+
+PipelinedFrameLoop::~PipelinedFrameLoop()
+{
+	Stop();
+}
+
+void PipelinedFrameLoop::Start(IPipelinedFrameClient& client, size_t frameCount, float fixedDelta)
+{
+	assert(!Running());
+
+	// Drop whatever a previous run left published.
+	mSlots.Acquire();
+
+	mClient = &client;
+	mStop.store(false, std::memory_order_relaxed);
+	mFinished.store(false, std::memory_order_relaxed);
+	mSimulated.store(0, std::memory_order_relaxed);
+	mRendered = 0;
+	mThread = std::thread(&PipelinedFrameLoop::SimulationThread, this, frameCount, fixedDelta);
+}
+
+bool PipelinedFrameLoop::RenderFrame()
+{
+	mRenderProfiler.BeginFrame();
+	{
+		// The last snapshot is published before mFinished is set, so a failed Acquire
+		// after seeing it means there are no more.
+		FrameProfiler::Scope scope(mRenderProfiler, mWaitSimScope);
+		while(!mSlots.Acquire())
+		{
+			if(mFinished.load(std::memory_order_acquire))
+			{
+				if(mSlots.Acquire())
+					break;
+				mRenderProfiler.CancelFrame();
+				return false;
+			}
+			Sleep([this]() { return mSlots.Pending() || mFinished.load(std::memory_order_acquire); });
+		}
+		Wake();
+	}
+	{
+		FrameProfiler::Scope scope(mRenderProfiler, mRenderScope);
+		mClient->Render(mSlots.ReadSlot());
+	}
+	mRenderProfiler.EndFrame();
+	++mRendered;
+	return true;
+}
+
+void PipelinedFrameLoop::Stop()
+{
+	if(!mThread.joinable())
+		return;
+	mStop.store(true, std::memory_order_release);
+	Wake();
+	mThread.join();
+}
+
+void PipelinedFrameLoop::Run(IPipelinedFrameClient& client, size_t frameCount, float fixedDelta)
+{
+	Start(client, frameCount, fixedDelta);
+	while(RenderFrame())
+	{
+	}
+	Stop();
+}
+
+void PipelinedFrameLoop::SimulationThread(size_t frameCount, float fixedDelta)
+{
+	GameTimer timer;
+	timer.Reset();
+	for(size_t i = 0; frameCount == 0 || i < frameCount; ++i)
+	{
+		if(mStop.load(std::memory_order_acquire))
+			break;
+
+		timer.Tick();
+		mSimProfiler.BeginFrame();
+		{
+			FrameProfiler::Scope scope(mSimProfiler, mSimulateScope);
+			mClient->Simulate(fixedDelta > 0.0f ? fixedDelta : timer.DeltaTime(), mSlots.WriteSlot());
+		}
+		{
+			// Publishing now would replace a snapshot the renderer has not drawn.
+			FrameProfiler::Scope scope(mSimProfiler, mWaitRenderScope);
+			Sleep([this]() { return !mSlots.Pending() || mStop.load(std::memory_order_acquire); });
+		}
+		mSimProfiler.EndFrame();
+
+		mSlots.Publish();
+		mSimulated.fetch_add(1, std::memory_order_release);
+		Wake();
+	}
+
+	mFinished.store(true, std::memory_order_release);
+	Wake();
+}
+
+template<typename Ready>
+void PipelinedFrameLoop::Sleep(Ready ready)
+{
+	if(ready())
+		return;
+
+	// Counted as a sleeper before ready() is checked again, and Wake reads the count
+	// after its change, so one of the two always sees the other: either this check
+	// sees the change or Wake sees the sleeper and takes the lock to notify it.
+	std::unique_lock<std::mutex> lock(mMutex);
+	mSleepers.fetch_add(1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	while(!ready())
+		mChanged.wait(lock);
+	mSleepers.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void PipelinedFrameLoop::Wake()
+{
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if(mSleepers.load(std::memory_order_relaxed) == 0)
+		return;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+	}
+	mChanged.notify_all();
+}
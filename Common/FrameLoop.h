@@ -0,0 +1,146 @@
+#ifndef FRAMELOOP_H
+#define FRAMELOOP_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+#include "FrameProfiler.h"
+#include "GameTimer.h"
+#include "TripleBuffer.h"
+
+///<summary>
+/// What the frame loop drives each frame.  D3DApp implements it for the windowed
+/// application; headless runners implement it over TerrainWorld and a NullRenderDevice.
+///</summary>
+class IFrameClient
+{
+public:
+	virtual ~IFrameClient() {}
+
+	virtual void UpdateScene(float dt) = 0;
+	virtual void DrawScene() = 0;
+};
+
+///<summary>
+/// One frame is UpdateScene then DrawScene, recorded by the profiler as a frame with
+/// an "UpdateScene" and a "DrawScene" scope.  The windowed application pumps messages
+/// and ticks its timer around Frame; headless runs call Run, which has no platform
+/// dependency.
+///</summary>
+class FrameLoop
+{
+public:
+	explicit FrameLoop(FrameProfiler& profiler);
+
+	void Frame(IFrameClient& client, float dt);
+
+	// Runs frameCount frames.  With fixedDelta > 0 every frame advances the scene by
+	// exactly that much, so runs are repeatable whatever the machine; otherwise dt is
+	// the time the previous frame took.
+	void Run(IFrameClient& client, GameTimer& timer, size_t frameCount, float fixedDelta = 0.0f);
+
+	FrameProfiler::ScopeId UpdateScope()const { return mUpdateScope; }
+	FrameProfiler::ScopeId DrawScope()const { return mDrawScope; }
+
+private:
+	FrameLoop(const FrameLoop& rhs);
+	FrameLoop& operator=(const FrameLoop& rhs);
+
+	FrameProfiler& mProfiler;
+	FrameProfiler::ScopeId mUpdateScope;
+	FrameProfiler::ScopeId mDrawScope;
+};
+
+///<summary>
+/// What PipelinedFrameLoop drives.  Simulate runs on the simulation thread and writes
+/// everything a frame needs to draw into snapshot slot (0-2); Render runs on the
+/// calling thread and draws from a slot Simulate filled earlier.  The loop guarantees
+/// the two never touch the same slot at once, so the client keeps three snapshots and
+/// needs no locks, as long as Render reads nothing else Simulate writes.
+///</summary>
+class IPipelinedFrameClient
+{
+public:
+	virtual ~IPipelinedFrameClient() {}
+
+	virtual void Simulate(float dt, uint32_t slot) = 0;
+	virtual void Render(uint32_t slot) = 0;
+};
+
+///<summary>
+/// Runs simulation and rendering on two threads, so frame N+1 is simulated while frame
+/// N renders and a frame takes about the longer of the two instead of their sum.
+/// Snapshots are handed over through a TripleBufferIndex.  The simulation publishes
+/// each snapshot only once the renderer has taken the previous one, so every simulated
+/// frame is drawn, in order, and the simulation runs at most two frames ahead.  Slots
+/// change hands through the index's atomics alone; a side with nothing to do sleeps on
+/// a condition variable instead of spinning a core, and the lock is only taken to
+/// sleep or to wake a side that is asleep.
+///
+/// FrameProfiler is single threaded, so each thread records into its own: frames of
+/// renderProfiler span one rendered frame, with "Wait for simulation" and "Render"
+/// scopes, and frames of simProfiler one simulated frame, with "Simulate" and "Wait for
+/// render" scopes.  Scopes the client records from Simulate belong in simProfiler.
+///</summary>
+class PipelinedFrameLoop
+{
+public:
+	PipelinedFrameLoop(FrameProfiler& renderProfiler, FrameProfiler& simProfiler);
+	~PipelinedFrameLoop();
+
+	// Starts the simulation thread.  It simulates frameCount frames, or until Stop if
+	// frameCount is 0.  With fixedDelta > 0 every frame advances the scene by exactly
+	// that much; otherwise dt is the time the previous simulated frame took.
+	void Start(IPipelinedFrameClient& client, size_t frameCount = 0, float fixedDelta = 0.0f);
+
+	// Waits for the next snapshot and renders it.  Returns false, without rendering,
+	// once the simulation has finished and every snapshot has been rendered.
+	bool RenderFrame();
+
+	// Stops the simulation thread after its current frame.  Snapshots not yet rendered
+	// are dropped.
+	void Stop();
+
+	// Start, RenderFrame until the last frame, Stop.
+	void Run(IPipelinedFrameClient& client, size_t frameCount, float fixedDelta = 0.0f);
+
+	bool Running()const { return mThread.joinable(); }
+	uint64_t SimulatedFrames()const { return mSimulated.load(std::memory_order_acquire); }
+	uint64_t RenderedFrames()const { return mRendered; }
+
+private:
+	PipelinedFrameLoop(const PipelinedFrameLoop& rhs);
+	PipelinedFrameLoop& operator=(const PipelinedFrameLoop& rhs);
+
+	void SimulationThread(size_t frameCount, float fixedDelta);
+
+	// Blocks until ready() holds; ready() reads only atomics.  Wake follows every change
+	// another side may be sleeping on.
+	template<typename Ready> void Sleep(Ready ready);
+	void Wake();
+
+	FrameProfiler& mRenderProfiler;
+	FrameProfiler& mSimProfiler;
+	FrameProfiler::ScopeId mWaitSimScope;
+	FrameProfiler::ScopeId mRenderScope;
+	FrameProfiler::ScopeId mSimulateScope;
+	FrameProfiler::ScopeId mWaitRenderScope;
+
+	IPipelinedFrameClient* mClient;
+
+	TripleBufferIndex mSlots;
+	std::mutex mMutex;
+	std::condition_variable mChanged;
+	std::atomic<uint32_t> mSleepers;
+	std::thread mThread;
+	std::atomic<bool> mStop;
+	std::atomic<bool> mFinished;
+	std::atomic<uint64_t> mSimulated;
+	uint64_t mRendered;
+};
+
+#endif // FRAMELOOP_H
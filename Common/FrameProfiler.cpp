@@ -0,0 +1,264 @@
+#include "FrameProfiler.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+static const double NsPerMs = 1.0e6;
+
+static bool Fail(std::string* error, const char* message)
+{
+	if(error)
+		*error = message;
+	return false;
+}
+
+// Scope names are identifiers chosen by the caller, but keep the JSON valid anyway.
+static void WriteJSONString(FILE* file, const std::string& s)
+{
+	std::fputc('"', file);
+	for(size_t i = 0; i < s.size(); ++i)
+	{
+		char c = s[i];
+		if(c == '"' || c == '\\')
+			std::fputc('\\', file);
+		if((unsigned char)c >= 0x20)
+			std::fputc(c, file);
+	}
+	std::fputc('"', file);
+}
+
+// RFC 4180: a field in double quotes, with quotes inside it doubled, so a scope name
+// may hold commas.
+static void WriteCSVString(FILE* file, const std::string& s)
+{
+	std::fputc('"', file);
+	for(size_t i = 0; i < s.size(); ++i)
+	{
+		if(s[i] == '"')
+			std::fputc('"', file);
+		std::fputc(s[i], file);
+	}
+	std::fputc('"', file);
+}
+
+static void WriteJSONSummary(FILE* file, const FrameProfiler::Summary& s)
+{
+	std::fprintf(file, "{ \"frames\": %u, \"mean\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f }",
+		(unsigned)s.Frames, s.Mean, s.P50, s.P95, s.P99, s.Max);
+}
+
+// Nearest rank: the smallest value with at least p percent of the values at or below it.
+static double Percentile(const std::vector<double>& sorted, double p)
+{
+	size_t rank = (size_t)std::ceil(p / 100.0 * sorted.size());
+	return sorted[(std::min)((std::max)(rank, size_t(1)), sorted.size()) - 1];
+}
+
+const size_t FrameProfiler::MaxScopes;
+
+FrameProfiler::Summary::Summary()
+	: Frames(0), Mean(0.0), P50(0.0), P95(0.0), P99(0.0), Max(0.0)
+{
+}
+
+uint64_t FrameProfiler::SteadyClock()
+{
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+FrameProfiler::FrameProfiler(size_t capacity, ClockFn clock)
+	: mClock(clock), mCapacity((std::max)(capacity, size_t(1)))
+{
+	mFrameNs.resize(mCapacity);
+	mScopeNs.resize(mCapacity*MaxScopes);
+	Clear();
+}
+
+void FrameProfiler::Clear()
+{
+	mCount = 0;
+	mNext = 0;
+	mTotalFrames = 0;
+	mInFrame = false;
+	mFrameStart = 0;
+	std::memset(mCurrentScopeNs, 0, sizeof(mCurrentScopeNs));
+	std::memset(mScopeStart, 0, sizeof(mScopeStart));
+	std::memset(mScopeDepth, 0, sizeof(mScopeDepth));
+}
+
+FrameProfiler::ScopeId FrameProfiler::AddScope(const char* name)
+{
+	for(size_t i = 0; i < mScopeNames.size(); ++i)
+	{
+		if(mScopeNames[i] == name)
+			return (ScopeId)i;
+	}
+
+	assert(mScopeNames.size() < MaxScopes);
+	if(mScopeNames.size() == MaxScopes)
+		return MaxScopes - 1;
+
+	mScopeNames.push_back(name);
+	return (ScopeId)(mScopeNames.size() - 1);
+}
+
+void FrameProfiler::BeginFrame()
+{
+	mInFrame = true;
+	std::memset(mCurrentScopeNs, 0, sizeof(mCurrentScopeNs));
+	mFrameStart = mClock();
+}
+
+void FrameProfiler::EndFrame()
+{
+	if(!mInFrame)
+		return;
+
+	uint64_t now = mClock();
+	mInFrame = false;
+
+	mFrameNs[mNext] = now - mFrameStart;
+	std::memcpy(&mScopeNs[mNext*MaxScopes], mCurrentScopeNs, sizeof(mCurrentScopeNs));
+
+	mNext = (mNext + 1) % mCapacity;
+	mCount = (std::min)(mCount + 1, mCapacity);
+	++mTotalFrames;
+}
+
+void FrameProfiler::BeginScope(ScopeId id)
+{
+	// Only the outermost of nested runs of the same scope is timed.
+	if(mScopeDepth[id]++ == 0)
+		mScopeStart[id] = mClock();
+}
+
+void FrameProfiler::EndScope(ScopeId id)
+{
+	assert(mScopeDepth[id] > 0);
+	if(--mScopeDepth[id] == 0)
+		mCurrentScopeNs[id] += mClock() - mScopeStart[id];
+}
+
+size_t FrameProfiler::Slot(size_t frame)const
+{
+	assert(frame < mCount);
+	return (mNext + mCapacity - mCount + frame) % mCapacity;
+}
+
+double FrameProfiler::FrameMs(size_t frame)const
+{
+	return mFrameNs[Slot(frame)] / NsPerMs;
+}
+
+double FrameProfiler::ScopeMs(size_t frame, ScopeId id)const
+{
+	return mScopeNs[Slot(frame)*MaxScopes + id] / NsPerMs;
+}
+
+FrameProfiler::Summary FrameProfiler::Summarize(std::vector<double>& ms)const
+{
+	Summary s;
+	s.Frames = ms.size();
+	if(ms.empty())
+		return s;
+
+	double total = 0.0;
+	for(size_t i = 0; i < ms.size(); ++i)
+		total += ms[i];
+	s.Mean = total / ms.size();
+
+	std::sort(ms.begin(), ms.end());
+	s.P50 = Percentile(ms, 50.0);
+	s.P95 = Percentile(ms, 95.0);
+	s.P99 = Percentile(ms, 99.0);
+	s.Max = ms.back();
+	return s;
+}
+
+FrameProfiler::Summary FrameProfiler::FrameSummary()const
+{
+	std::vector<double> ms(mCount);
+	for(size_t i = 0; i < mCount; ++i)
+		ms[i] = FrameMs(i);
+	return Summarize(ms);
+}
+
+FrameProfiler::Summary FrameProfiler::ScopeSummary(ScopeId id)const
+{
+	std::vector<double> ms(mCount);
+	for(size_t i = 0; i < mCount; ++i)
+		ms[i] = ScopeMs(i, id);
+	return Summarize(ms);
+}
+
+void FrameProfiler::Histogram(double binMs, size_t binCount, std::vector<uint32_t>& counts)const
+{
+	counts.assign(binCount, 0);
+	if(binCount == 0 || binMs <= 0.0)
+		return;
+
+	for(size_t i = 0; i < mCount; ++i)
+	{
+		size_t bin = (size_t)(FrameMs(i) / binMs);
+		++counts[(std::min)(bin, binCount - 1)];
+	}
+}
+
+bool FrameProfiler::WriteCSV(const char* path, std::string* error)const
+{
+	FILE* file = std::fopen(path, "w");
+	if(!file)
+		return Fail(error, "cannot create file");
+
+	std::fprintf(file, "frame,frame_ms");
+	for(size_t s = 0; s < mScopeNames.size(); ++s)
+	{
+		std::fputc(',', file);
+		WriteCSVString(file, mScopeNames[s]);
+	}
+	std::fprintf(file, "\n");
+
+	uint64_t first = mTotalFrames - mCount;
+	for(size_t i = 0; i < mCount; ++i)
+	{
+		std::fprintf(file, "%llu,%.4f", (unsigned long long)(first + i), FrameMs(i));
+		for(size_t s = 0; s < mScopeNames.size(); ++s)
+			std::fprintf(file, ",%.4f", ScopeMs(i, (ScopeId)s));
+		std::fprintf(file, "\n");
+	}
+
+	bool ok = !std::ferror(file);
+	ok = (std::fclose(file) == 0) && ok;
+	return ok ? true : Fail(error, "write failed");
+}
+
+bool FrameProfiler::WriteJSON(const char* path, std::string* error)const
+{
+	FILE* file = std::fopen(path, "w");
+	if(!file)
+		return Fail(error, "cannot create file");
+
+	std::fprintf(file, "{\n  \"frame_ms\": ");
+	WriteJSONSummary(file, FrameSummary());
+	std::fprintf(file, ",\n  \"scopes\": {");
+	for(size_t s = 0; s < mScopeNames.size(); ++s)
+	{
+		std::fprintf(file, s ? ",\n    " : "\n    ");
+		WriteJSONString(file, mScopeNames[s]);
+		std::fprintf(file, ": ");
+		WriteJSONSummary(file, ScopeSummary((ScopeId)s));
+	}
+	std::fprintf(file, "\n  },\n  \"frames\": [");
+	for(size_t i = 0; i < mCount; ++i)
+		std::fprintf(file, i ? ", %.4f" : "%.4f", FrameMs(i));
+	std::fprintf(file, "]\n}\n");
+
+	bool ok = !std::ferror(file);
+	ok = (std::fclose(file) == 0) && ok;
+	return ok ? true : Fail(error, "write failed");
+}
@@ -0,0 +1,120 @@
+#ifndef FRAMEPROFILER_H
+#define FRAMEPROFILER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+///<summary>
+/// Records the duration of the last N frames and of named CPU scopes within them, so
+/// hitches show up in percentiles and histograms instead of vanishing into an average.
+///
+///   ScopeId draw = profiler.AddScope("DrawScene");
+///   profiler.BeginFrame();
+///   { FrameProfiler::Scope s(profiler, draw); ... }
+///   profiler.EndFrame();
+///
+/// A frame lasts from BeginFrame to EndFrame; a scope that runs several times in a
+/// frame accumulates.  Time comes from a clock function returning nanoseconds, by
+/// default std::chrono::steady_clock, so the profiler has no platform dependency and
+/// tests can drive it with a fake clock.  Not thread safe: call it from one thread.
+///</summary>
+class FrameProfiler
+{
+public:
+	typedef uint32_t ScopeId;
+	typedef uint64_t (*ClockFn)();
+
+	static const size_t MaxScopes = 16;
+
+	// Milliseconds over the frames held.  Percentiles use the nearest-rank method.
+	struct Summary
+	{
+		Summary();
+
+		size_t Frames;
+		double Mean;
+		double P50;
+		double P95;
+		double P99;
+		double Max;
+	};
+
+	// Times a scope for as long as it lives.
+	class Scope
+	{
+	public:
+		Scope(FrameProfiler& profiler, ScopeId id) : mProfiler(profiler), mId(id) { mProfiler.BeginScope(mId); }
+		~Scope() { mProfiler.EndScope(mId); }
+
+	private:
+		Scope(const Scope&);
+		Scope& operator=(const Scope&);
+
+		FrameProfiler& mProfiler;
+		ScopeId mId;
+	};
+
+	static uint64_t SteadyClock();
+
+	explicit FrameProfiler(size_t capacity = 1024, ClockFn clock = SteadyClock);
+
+	// Registers a scope name, or returns the id it already has.  Frames recorded
+	// before a scope existed read 0 for it.
+	ScopeId AddScope(const char* name);
+	size_t ScopeCount()const { return mScopeNames.size(); }
+	const std::string& ScopeName(ScopeId id)const { return mScopeNames[id]; }
+
+	void BeginFrame();
+	void EndFrame();
+	// Drops the frame being recorded, e.g. one that turned out to have nothing to do.
+	void CancelFrame() { mInFrame = false; }
+	void BeginScope(ScopeId id);
+	void EndScope(ScopeId id);
+
+	// Frames held, oldest first; at most the capacity.
+	size_t FrameCount()const { return mCount; }
+	uint64_t TotalFrames()const { return mTotalFrames; }
+	double FrameMs(size_t frame)const;
+	double ScopeMs(size_t frame, ScopeId id)const;
+
+	Summary FrameSummary()const;
+	Summary ScopeSummary(ScopeId id)const;
+
+	// counts[i] = frames with binMs*i <= time < binMs*(i+1); the last bin also takes
+	// every longer frame.
+	void Histogram(double binMs, size_t binCount, std::vector<uint32_t>& counts)const;
+
+	// One row per frame held: index, frame time and every scope, in milliseconds.
+	// Scope names in the header are quoted.
+	bool WriteCSV(const char* path, std::string* error = 0)const;
+	// Summaries of the frame and every scope, followed by the frame times.
+	bool WriteJSON(const char* path, std::string* error = 0)const;
+
+	void Clear();
+
+private:
+	size_t Slot(size_t frame)const;
+	Summary Summarize(std::vector<double>& ms)const;
+
+	ClockFn mClock;
+	size_t mCapacity;
+	size_t mCount;
+	size_t mNext;
+	uint64_t mTotalFrames;
+
+	// Ring buffers: mFrameNs[slot] and mScopeNs[slot*MaxScopes + id].
+	std::vector<uint64_t> mFrameNs;
+	std::vector<uint64_t> mScopeNs;
+	std::vector<std::string> mScopeNames;
+
+	// The frame being recorded.
+	bool mInFrame;
+	uint64_t mFrameStart;
+	uint64_t mCurrentScopeNs[MaxScopes];
+	uint64_t mScopeStart[MaxScopes];
+	uint32_t mScopeDepth[MaxScopes];
+};
+
+#endif // FRAMEPROFILER_H
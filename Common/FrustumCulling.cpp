@@ -0,0 +1,249 @@
+#include "FrustumCulling.h"
+#include <cmath>
+
+#if defined(__AVX__)
+#define FRUSTUMCULLING_AVX
+#include <immintrin.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FRUSTUMCULLING_SSE2
+#include <emmintrin.h>
+#endif
+
+// Boxes are padded to this many so the widest loop has no tail.
+static const size_t BoxBatch = 8;
+
+CullBoxes::CullBoxes()
+	: mCount(0)
+{
+}
+
+void CullBoxes::Clear()
+{
+	for(int a = 0; a < 3; ++a)
+	{
+		mCenter[a].clear();
+		mExtent[a].clear();
+	}
+	mCount = 0;
+}
+
+void CullBoxes::Reserve(size_t count)
+{
+	size_t padded = (count + BoxBatch - 1) / BoxBatch * BoxBatch;
+	for(int a = 0; a < 3; ++a)
+	{
+		mCenter[a].reserve(padded);
+		mExtent[a].reserve(padded);
+	}
+}
+
+uint32_t CullBoxes::Add(const AABB& box)
+{
+	if(mCount == Stride())
+	{
+		// Grow by a whole batch of zero-sized boxes at the origin; the padding is
+		// tested along with real boxes but its results are never written out.
+		for(int a = 0; a < 3; ++a)
+		{
+			mCenter[a].resize(mCount + BoxBatch, 0.0f);
+			mExtent[a].resize(mCount + BoxBatch, 0.0f);
+		}
+	}
+
+	Set((uint32_t)mCount, box);
+	return (uint32_t)mCount++;
+}
+
+void CullBoxes::Set(uint32_t index, const AABB& box)
+{
+	Vec3 c = box.Center();
+	Vec3 e = box.Extents();
+	for(int a = 0; a < 3; ++a)
+	{
+		mCenter[a][index] = c[a];
+		mExtent[a][index] = e[a];
+	}
+}
+
+void CullBoxes::RemoveSwap(uint32_t index)
+{
+	--mCount;
+	for(int a = 0; a < 3; ++a)
+	{
+		mCenter[a][index] = mCenter[a][mCount];
+		mExtent[a][index] = mExtent[a][mCount];
+	}
+}
+
+void FrustumCulling::ExtractPlanes(const Mat4& viewProj, Frustum& frustum)
+{
+	// Left, right, bottom, top, near, far: column 3 plus or minus columns 0-2, or
+	// column 2 alone for the near plane of a [0, 1] depth range.
+	static const int column[6] = { 0, 0, 1, 1, 2, 2 };
+	static const float sign[6] = { 1.0f, -1.0f, 1.0f, -1.0f, 0.0f, -1.0f };
+
+	const float (*m)[4] = viewProj.m;
+	for(int i = 0; i < 6; ++i)
+	{
+		float p[4];
+		for(int r = 0; r < 4; ++r)
+			p[r] = i == 4 ? m[r][2] : m[r][3] + sign[i]*m[r][column[i]];
+
+		float len = std::sqrt(p[0]*p[0] + p[1]*p[1] + p[2]*p[2]);
+		float inv = len > 0.0f ? 1.0f / len : 0.0f;
+		frustum.Planes[i] = Vec4(p[0]*inv, p[1]*inv, p[2]*inv, p[3]*inv);
+	}
+}
+
+//
+// A box is outside a plane when its center's signed distance plus its projected
+// radius is negative.  Every path evaluates
+//   d = ((a*cx + b*cy) + c*cz) + w,   r = (|a|*ex + |b|*ey) + |c|*ez,   out = d + r < 0
+// in the same order so they agree bit for bit.
+//
+
+bool FrustumCulling::TestAABB(const Frustum& frustum, const AABB& box)
+{
+	Vec3 c = box.Center();
+	Vec3 e = box.Extents();
+	for(int p = 0; p < 6; ++p)
+	{
+		const Vec4& pl = frustum.Planes[p];
+		float d = ((pl.x*c.x + pl.y*c.y) + pl.z*c.z) + pl.w;
+		float r = (std::fabs(pl.x)*e.x + std::fabs(pl.y)*e.y) + std::fabs(pl.z)*e.z;
+		if(d + r < 0.0f)
+			return false;
+	}
+	return true;
+}
+
+size_t FrustumCulling::CullScalar(const Frustum& frustum, const CullBoxes& boxes, uint8_t* visible)
+{
+	const float* cx = boxes.Center(0);
+	const float* cy = boxes.Center(1);
+	const float* cz = boxes.Center(2);
+	const float* ex = boxes.Extent(0);
+	const float* ey = boxes.Extent(1);
+	const float* ez = boxes.Extent(2);
+
+	size_t count = 0;
+	for(size_t i = 0; i < boxes.Count(); ++i)
+	{
+		uint8_t in = 1;
+		for(int p = 0; p < 6; ++p)
+		{
+			const Vec4& pl = frustum.Planes[p];
+			float d = ((pl.x*cx[i] + pl.y*cy[i]) + pl.z*cz[i]) + pl.w;
+			float r = (std::fabs(pl.x)*ex[i] + std::fabs(pl.y)*ey[i]) + std::fabs(pl.z)*ez[i];
+			if(d + r < 0.0f)
+			{
+				in = 0;
+				break;
+			}
+		}
+		visible[i] = in;
+		count += in;
+	}
+	return count;
+}
+
+size_t FrustumCulling::Cull(const Frustum& frustum, const CullBoxes& boxes, uint8_t* visible)
+{
+#if defined(FRUSTUMCULLING_AVX)
+	const float* cx = boxes.Center(0);
+	const float* cy = boxes.Center(1);
+	const float* cz = boxes.Center(2);
+	const float* ex = boxes.Extent(0);
+	const float* ey = boxes.Extent(1);
+	const float* ez = boxes.Extent(2);
+
+	__m256 a[6], b[6], c[6], w[6], absA[6], absB[6], absC[6];
+	const __m256 signMask = _mm256_set1_ps(-0.0f);
+	for(int p = 0; p < 6; ++p)
+	{
+		a[p] = _mm256_set1_ps(frustum.Planes[p].x);
+		b[p] = _mm256_set1_ps(frustum.Planes[p].y);
+		c[p] = _mm256_set1_ps(frustum.Planes[p].z);
+		w[p] = _mm256_set1_ps(frustum.Planes[p].w);
+		absA[p] = _mm256_andnot_ps(signMask, a[p]);
+		absB[p] = _mm256_andnot_ps(signMask, b[p]);
+		absC[p] = _mm256_andnot_ps(signMask, c[p]);
+	}
+
+	const __m256 zero = _mm256_setzero_ps();
+	size_t count = 0;
+	for(size_t i = 0; i < boxes.Count(); i += 8)
+	{
+		__m256 x = _mm256_loadu_ps(cx + i), y = _mm256_loadu_ps(cy + i), z = _mm256_loadu_ps(cz + i);
+		__m256 hx = _mm256_loadu_ps(ex + i), hy = _mm256_loadu_ps(ey + i), hz = _mm256_loadu_ps(ez + i);
+
+		__m256 outside = zero;
+		for(int p = 0; p < 6; ++p)
+		{
+			__m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a[p], x), _mm256_mul_ps(b[p], y)), _mm256_mul_ps(c[p], z)), w[p]);
+			__m256 r = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(absA[p], hx), _mm256_mul_ps(absB[p], hy)), _mm256_mul_ps(absC[p], hz));
+			outside = _mm256_or_ps(outside, _mm256_cmp_ps(_mm256_add_ps(d, r), zero, _CMP_LT_OQ));
+		}
+
+		int mask = ~_mm256_movemask_ps(outside) & 0xff;
+		size_t n = boxes.Count() - i < 8 ? boxes.Count() - i : 8;
+		for(size_t k = 0; k < n; ++k)
+		{
+			uint8_t in = (uint8_t)((mask >> k) & 1);
+			visible[i + k] = in;
+			count += in;
+		}
+	}
+	return count;
+#elif defined(FRUSTUMCULLING_SSE2)
+	const float* cx = boxes.Center(0);
+	const float* cy = boxes.Center(1);
+	const float* cz = boxes.Center(2);
+	const float* ex = boxes.Extent(0);
+	const float* ey = boxes.Extent(1);
+	const float* ez = boxes.Extent(2);
+
+	__m128 a[6], b[6], c[6], w[6], absA[6], absB[6], absC[6];
+	const __m128 signMask = _mm_set1_ps(-0.0f);
+	for(int p = 0; p < 6; ++p)
+	{
+		a[p] = _mm_set1_ps(frustum.Planes[p].x);
+		b[p] = _mm_set1_ps(frustum.Planes[p].y);
+		c[p] = _mm_set1_ps(frustum.Planes[p].z);
+		w[p] = _mm_set1_ps(frustum.Planes[p].w);
+		absA[p] = _mm_andnot_ps(signMask, a[p]);
+		absB[p] = _mm_andnot_ps(signMask, b[p]);
+		absC[p] = _mm_andnot_ps(signMask, c[p]);
+	}
+
+	const __m128 zero = _mm_setzero_ps();
+	size_t count = 0;
+	for(size_t i = 0; i < boxes.Count(); i += 4)
+	{
+		__m128 x = _mm_loadu_ps(cx + i), y = _mm_loadu_ps(cy + i), z = _mm_loadu_ps(cz + i);
+		__m128 hx = _mm_loadu_ps(ex + i), hy = _mm_loadu_ps(ey + i), hz = _mm_loadu_ps(ez + i);
+
+		__m128 outside = zero;
+		for(int p = 0; p < 6; ++p)
+		{
+			__m128 d = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(a[p], x), _mm_mul_ps(b[p], y)), _mm_mul_ps(c[p], z)), w[p]);
+			__m128 r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(absA[p], hx), _mm_mul_ps(absB[p], hy)), _mm_mul_ps(absC[p], hz));
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(d, r), zero));
+		}
+
+		int mask = ~_mm_movemask_ps(outside) & 0xf;
+		size_t n = boxes.Count() - i < 4 ? boxes.Count() - i : 4;
+		for(size_t k = 0; k < n; ++k)
+		{
+			uint8_t in = (uint8_t)((mask >> k) & 1);
+			visible[i + k] = in;
+			count += in;
+		}
+	}
+	return count;
+#else
+	return CullScalar(frustum, boxes, visible);
+#endif
+}
@@ -0,0 +1,74 @@
+#ifndef FRUSTUMCULLING_H
+#define FRUSTUMCULLING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "VecMath.h"
+
+///<summary>
+/// Six planes (a, b, c, d) with inward-facing normals: a point p is inside when
+/// a*p.x + b*p.y + c*p.z + d >= 0 for every plane.  This is what ExtractFrustumPlanes
+/// in d3dUtil produces, and since Vec4 matches XMFLOAT4 its output can be copied
+/// straight into Planes.
+///</summary>
+struct Frustum
+{
+	Vec4 Planes[6];
+};
+
+///<summary>
+/// Boxes stored as structure-of-arrays centers and extents, padded to a multiple of
+/// eight so the SIMD loops never need a scalar tail.
+///</summary>
+class CullBoxes
+{
+public:
+	CullBoxes();
+
+	void Clear();
+	void Reserve(size_t count);
+
+	// Returns the index of the box, which is also its index in the visibility output.
+	uint32_t Add(const AABB& box);
+	void Set(uint32_t index, const AABB& box);
+
+	// Moves the last box into index, for lists kept in step with a swap-removed array.
+	void RemoveSwap(uint32_t index);
+
+	size_t Count()const { return mCount; }
+
+	// Padded arrays, Stride() floats each.
+	size_t Stride()const { return mCenter[0].size(); }
+	const float* Center(int axis)const { return mCenter[axis].data(); }
+	const float* Extent(int axis)const { return mExtent[axis].data(); }
+
+private:
+	std::vector<float> mCenter[3];
+	std::vector<float> mExtent[3];
+	size_t mCount;
+};
+
+///<summary>
+/// Conservative AABB-versus-frustum tests.  A box is culled only when it lies entirely
+/// behind one plane, so boxes near a frustum corner may be kept.  Cull tests eight
+/// boxes per iteration with AVX, four with SSE2, and falls back to CullScalar when the
+/// compiler targets neither; all paths give identical results.
+///</summary>
+class FrustumCulling
+{
+public:
+	// The planes of a row-major view-projection matrix, normalized, in the same order
+	// and with the same values as ExtractFrustumPlanes.
+	static void ExtractPlanes(const Mat4& viewProj, Frustum& frustum);
+
+	static bool TestAABB(const Frustum& frustum, const AABB& box);
+
+	// visible[i] = 1 if box i may be visible, 0 if it is outside.  Returns the number
+	// of visible boxes.
+	static size_t Cull(const Frustum& frustum, const CullBoxes& boxes, uint8_t* visible);
+	static size_t CullScalar(const Frustum& frustum, const CullBoxes& boxes, uint8_t* visible);
+};
+
+#endif // FRUSTUMCULLING_H
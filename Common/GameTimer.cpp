@@ -1,14 +1,19 @@
 
-#include <windows.h>
 #include "GameTimer.h"
+#include <chrono>
+
+// Counts are nanoseconds of steady_clock, which is the performance counter on Windows.
+static int64_t CurrentCount()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
 
 GameTimer::GameTimer()
 : mSecondsPerCount(0.0), mDeltaTime(-1.0), mBaseTime(0), 
   mPausedTime(0), mPrevTime(0), mCurrTime(0), mStopped(false)
 {
-	__int64 countsPerSec;
-	QueryPerformanceFrequency((LARGE_INTEGER*)&countsPerSec);
-	mSecondsPerCount = 1.0 / (double)countsPerSec;
+	mSecondsPerCount = 1.0e-9;
 }
 
 // Returns the total time elapsed since Reset() was called, NOT counting any
@@ -52,8 +57,7 @@ float GameTimer::DeltaTime()const
 
 void GameTimer::Reset()
 {
-	__int64 currTime;
-	QueryPerformanceCounter((LARGE_INTEGER*)&currTime);
+	int64_t currTime = CurrentCount();
 
 	mBaseTime = currTime;
 	mPrevTime = currTime;
@@ -63,8 +67,7 @@ void GameTimer::Reset()
 
 void GameTimer::Start()
 {
-	__int64 startTime;
-	QueryPerformanceCounter((LARGE_INTEGER*)&startTime);
+	int64_t startTime = CurrentCount();
 
 
 	// Accumulate the time elapsed between stop and start pairs.
@@ -87,8 +90,7 @@ void GameTimer::Stop()
 {
 	if( !mStopped )
 	{
-		__int64 currTime;
-		QueryPerformanceCounter((LARGE_INTEGER*)&currTime);
+		int64_t currTime = CurrentCount();
 
 		mStopTime = currTime;
 		mStopped  = true;
@@ -103,8 +105,7 @@ void GameTimer::Tick()
 		return;
 	}
 
-	__int64 currTime;
-	QueryPerformanceCounter((LARGE_INTEGER*)&currTime);
+	int64_t currTime = CurrentCount();
 	mCurrTime = currTime;
 
 	// Time difference between this frame and the previous.
@@ -1,7 +1,8 @@
 #include "GeometryGenerator.h"
 #include "MathHelper.h"
+#include "ParallelFor.h"
 
-using namespace DirectX;
+#include <cmath>
 
 void GeometryGenerator::CreateBox(float width, float height, float depth, MeshData& meshData)
 {
@@ -57,7 +58,7 @@ void GeometryGenerator::CreateBox(float width, float height, float depth, MeshDa
 	// Create the indices.
 	//
 
-	UINT i[36];
+	uint32_t i[36];
 
 	// Fill in the front face index data
 	i[0] = 0; i[1] = 1; i[2] = 2;
@@ -86,10 +87,15 @@ void GeometryGenerator::CreateBox(float width, float height, float depth, MeshDa
 	meshData.Indices.assign(&i[0], &i[36]);
 }
 
-void GeometryGenerator::CreateSphere(float radius, UINT sliceCount, UINT stackCount, MeshData& meshData)
+void GeometryGenerator::CreateSphere(float radius, uint32_t sliceCount, uint32_t stackCount, MeshData& meshData)
 {
-	meshData.Vertices.clear();
-	meshData.Indices.clear();
+	// Two poles plus (stackCount-1) rings of (sliceCount+1) vertices; a triangle fan
+	// for each pole cap and a quad strip between every pair of adjacent rings.
+	uint32_t ringVertexCount = sliceCount+1;
+	uint32_t vertexCount = (stackCount-1)*ringVertexCount + 2;
+	uint32_t indexCount  = 6*sliceCount*(stackCount-1);
+
+	meshData.Resize(vertexCount, indexCount);
 
 	//
 	// Compute the vertices stating at the top pole and moving down the stacks.
@@ -101,58 +107,55 @@ void GeometryGenerator::CreateSphere(float radius, UINT sliceCount, UINT stackCo
 	Vertex topVertex(0.0f, +radius, 0.0f, 0.0f, +1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f);
 	Vertex bottomVertex(0.0f, -radius, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
 
-	meshData.Vertices.push_back( topVertex );
+	uint32_t v = 0;
+	meshData.Vertices[v++] = topVertex;
 
-	float phiStep   = XM_PI/stackCount;
-	float thetaStep = 2.0f*XM_PI/sliceCount;
+	float phiStep   = MathHelper::Pi/stackCount;
+	float thetaStep = 2.0f*MathHelper::Pi/sliceCount;
 
 	// Compute vertices for each stack ring (do not count the poles as rings).
-	for(UINT i = 1; i <= stackCount-1; ++i)
+	for(uint32_t i = 1; i <= stackCount-1; ++i)
 	{
 		float phi = i*phiStep;
 
 		// Vertices of ring.
-		for(UINT j = 0; j <= sliceCount; ++j)
+		for(uint32_t j = 0; j <= sliceCount; ++j)
 		{
 			float theta = j*thetaStep;
 
-			Vertex v;
+			Vertex& vertex = meshData.Vertices[v++];
 
 			// spherical to cartesian
-			v.Position.x = radius*sinf(phi)*cosf(theta);
-			v.Position.y = radius*cosf(phi);
-			v.Position.z = radius*sinf(phi)*sinf(theta);
+			vertex.Position.x = radius*sinf(phi)*cosf(theta);
+			vertex.Position.y = radius*cosf(phi);
+			vertex.Position.z = radius*sinf(phi)*sinf(theta);
 
 			// Partial derivative of P with respect to theta
-			v.TangentU.x = -radius*sinf(phi)*sinf(theta);
-			v.TangentU.y = 0.0f;
-			v.TangentU.z = +radius*sinf(phi)*cosf(theta);
-
-			XMVECTOR T = XMLoadFloat3(&v.TangentU);
-			XMStoreFloat3(&v.TangentU, XMVector3Normalize(T));
-
-			XMVECTOR p = XMLoadFloat3(&v.Position);
-			XMStoreFloat3(&v.Normal, XMVector3Normalize(p));
+			vertex.TangentU.x = -radius*sinf(phi)*sinf(theta);
+			vertex.TangentU.y = 0.0f;
+			vertex.TangentU.z = +radius*sinf(phi)*cosf(theta);
 
-			v.TexC.x = theta / XM_2PI;
-			v.TexC.y = phi / XM_PI;
+			vertex.TangentU = Normalize(vertex.TangentU);
+			vertex.Normal = Normalize(vertex.Position);
 
-			meshData.Vertices.push_back( v );
+			vertex.TexC.x = theta / (2.0f*MathHelper::Pi);
+			vertex.TexC.y = phi / MathHelper::Pi;
 		}
 	}
 
-	meshData.Vertices.push_back( bottomVertex );
+	meshData.Vertices[v++] = bottomVertex;
 
 	//
 	// Compute indices for top stack.  The top stack was written first to the vertex buffer
 	// and connects the top pole to the first ring.
 	//
 
-	for(UINT i = 1; i <= sliceCount; ++i)
+	uint32_t k = 0;
+	for(uint32_t i = 1; i <= sliceCount; ++i)
 	{
-		meshData.Indices.push_back(0);
-		meshData.Indices.push_back(i+1);
-		meshData.Indices.push_back(i);
+		meshData.Indices[k++] = 0;
+		meshData.Indices[k++] = i+1;
+		meshData.Indices[k++] = i;
 	}
 	
 	//
@@ -161,19 +164,18 @@ void GeometryGenerator::CreateSphere(float radius, UINT sliceCount, UINT stackCo
 
 	// Offset the indices to the index of the first vertex in the first ring.
 	// This is just skipping the top pole vertex.
-	UINT baseIndex = 1;
-	UINT ringVertexCount = sliceCount+1;
-	for(UINT i = 0; i < stackCount-2; ++i)
+	uint32_t baseIndex = 1;
+	for(uint32_t i = 0; i < stackCount-2; ++i)
 	{
-		for(UINT j = 0; j < sliceCount; ++j)
+		for(uint32_t j = 0; j < sliceCount; ++j)
 		{
-			meshData.Indices.push_back(baseIndex + i*ringVertexCount + j);
-			meshData.Indices.push_back(baseIndex + i*ringVertexCount + j+1);
-			meshData.Indices.push_back(baseIndex + (i+1)*ringVertexCount + j);
+			meshData.Indices[k++] = baseIndex + i*ringVertexCount + j;
+			meshData.Indices[k++] = baseIndex + i*ringVertexCount + j+1;
+			meshData.Indices[k++] = baseIndex + (i+1)*ringVertexCount + j;
 
-			meshData.Indices.push_back(baseIndex + (i+1)*ringVertexCount + j);
-			meshData.Indices.push_back(baseIndex + i*ringVertexCount + j+1);
-			meshData.Indices.push_back(baseIndex + (i+1)*ringVertexCount + j+1);
+			meshData.Indices[k++] = baseIndex + (i+1)*ringVertexCount + j;
+			meshData.Indices[k++] = baseIndex + i*ringVertexCount + j+1;
+			meshData.Indices[k++] = baseIndex + (i+1)*ringVertexCount + j+1;
 		}
 	}
 
@@ -183,119 +185,173 @@ void GeometryGenerator::CreateSphere(float radius, UINT sliceCount, UINT stackCo
 	//
 
 	// South pole vertex was added last.
-	UINT southPoleIndex = (UINT)meshData.Vertices.size()-1;
+	uint32_t southPoleIndex = vertexCount-1;
 
 	// Offset the indices to the index of the first vertex in the last ring.
 	baseIndex = southPoleIndex - ringVertexCount;
 	
-	for(UINT i = 0; i < sliceCount; ++i)
+	for(uint32_t i = 0; i < sliceCount; ++i)
 	{
-		meshData.Indices.push_back(southPoleIndex);
-		meshData.Indices.push_back(baseIndex+i);
-		meshData.Indices.push_back(baseIndex+i+1);
+		meshData.Indices[k++] = southPoleIndex;
+		meshData.Indices[k++] = baseIndex+i;
+		meshData.Indices[k++] = baseIndex+i+1;
 	}
 }
  
-void GeometryGenerator::Subdivide(MeshData& meshData)
+namespace
 {
-	// Save a copy of the input geometry.
-	MeshData inputCopy = meshData;
+	const unsigned long long EmptyEdgeKey = ~0ull;
+}
 
+void GeometryGenerator::EdgeMidpointMap::Reset(uint32_t maxEdges)
+{
+	// Keep the load factor at or below one half.
+	uint32_t bits = 1;
+	while((1ull << bits) < 2ull*maxEdges)
+		++bits;
+
+	mShift = 64 - bits;
+	mKeys.assign(size_t(1) << bits, EmptyEdgeKey);
+	mValues.resize(size_t(1) << bits);
+}
 
-	meshData.Vertices.resize(0);
-	meshData.Indices.resize(0);
+uint32_t GeometryGenerator::EdgeMidpointMap::FindOrInsert(uint32_t i0, uint32_t i1, uint32_t newIndex)
+{
+	// Order the endpoints so (a,b) and (b,a) hash to the same slot.
+	unsigned long long key = i0 < i1 ?
+		((unsigned long long)i0 << 32) | i1 :
+		((unsigned long long)i1 << 32) | i0;
 
-	//       v1
-	//       *
-	//      / \
-	//     /   \
-	//  m0*-----*m1
-	//   / \   / \
-	//  /   \ /   \
-	// *-----*-----*
-	// v0    m2     v2
+	// Fibonacci hashing spreads the packed indices over the high bits.
+	size_t mask = mKeys.size() - 1;
+	size_t slot = (size_t)((key * 0x9E3779B97F4A7C15ull) >> mShift);
 
-	UINT numTris = inputCopy.Indices.size()/3;
-	for(UINT i = 0; i < numTris; ++i)
+	while(mKeys[slot] != EmptyEdgeKey)
 	{
-		Vertex v0 = inputCopy.Vertices[ inputCopy.Indices[i*3+0] ];
-		Vertex v1 = inputCopy.Vertices[ inputCopy.Indices[i*3+1] ];
-		Vertex v2 = inputCopy.Vertices[ inputCopy.Indices[i*3+2] ];
+		if(mKeys[slot] == key)
+			return mValues[slot];
 
-		//
-		// Generate the midpoints.
-		//
+		slot = (slot + 1) & mask;
+	}
 
-		Vertex m0, m1, m2;
+	mKeys[slot] = key;
+	mValues[slot] = newIndex;
+	return newIndex;
+}
 
-		// For subdivision, we just care about the position component.  We derive the other
-		// vertex components in CreateGeosphere.
+void GeometryGenerator::Subdivide(MeshData& meshData, std::vector<uint32_t>& inputIndices, EdgeMidpointMap& edgeMidpoints,
+	uint32_t& openEdges)
+{
+	// Move the input indices into the caller's scratch array instead of copying them.
+	// The input vertices stay where they are; new midpoints are appended after them.
+	inputIndices.swap(meshData.Indices);
+
+	/*
+	       v1
+	       *
+	      / \
+	     /   \
+	  m0*-----*m1
+	   / \   / \
+	  /   \ /   \
+	 *-----*-----*
+	 v0    m2     v2
+	*/
+
+	uint32_t numTris = (uint32_t)inputIndices.size()/3;
+
+	// Every edge is used by two triangles except the open ones, so there are
+	// (3*numTris + openEdges)/2 edges, each getting one midpoint.  Splitting an open
+	// edge leaves two open halves; the new inner edges are all shared.
+	uint32_t numEdges = (3*numTris + openEdges)/2;
+	edgeMidpoints.Reset(numEdges);
+	meshData.Vertices.reserve(meshData.Vertices.size() + numEdges);
+	meshData.Indices.resize(numTris*12);
+	openEdges *= 2;
+
+	// Each edge is shared by two triangles, so look its midpoint up before creating
+	// it.  For subdivision, we just care about the position component.  We derive the
+	// other vertex components in CreateGeosphere.
+	auto midpoint = [&](uint32_t i0, uint32_t i1) -> uint32_t
+	{
+		uint32_t newIndex = (uint32_t)meshData.Vertices.size();
+		uint32_t index = edgeMidpoints.FindOrInsert(i0, i1, newIndex);
+
+		if(index == newIndex)
+		{
+			const Vec3& p0 = meshData.Vertices[i0].Position;
+			const Vec3& p1 = meshData.Vertices[i1].Position;
 
-		m0.Position = XMFLOAT3(
-			0.5f*(v0.Position.x + v1.Position.x),
-			0.5f*(v0.Position.y + v1.Position.y),
-			0.5f*(v0.Position.z + v1.Position.z));
+			Vertex m;
+			m.Position = Vec3(
+				0.5f*(p0.x + p1.x),
+				0.5f*(p0.y + p1.y),
+				0.5f*(p0.z + p1.z));
 
-		m1.Position = XMFLOAT3(
-			0.5f*(v1.Position.x + v2.Position.x),
-			0.5f*(v1.Position.y + v2.Position.y),
-			0.5f*(v1.Position.z + v2.Position.z));
+			meshData.Vertices.push_back(m);
+		}
+
+		return index;
+	};
+
+	for(uint32_t i = 0; i < numTris; ++i)
+	{
+		uint32_t v0 = inputIndices[i*3+0];
+		uint32_t v1 = inputIndices[i*3+1];
+		uint32_t v2 = inputIndices[i*3+2];
+
+		//
+		// Generate (or reuse) the midpoints.
+		//
 
-		m2.Position = XMFLOAT3(
-			0.5f*(v0.Position.x + v2.Position.x),
-			0.5f*(v0.Position.y + v2.Position.y),
-			0.5f*(v0.Position.z + v2.Position.z));
+		uint32_t m0 = midpoint(v0, v1);
+		uint32_t m1 = midpoint(v1, v2);
+		uint32_t m2 = midpoint(v0, v2);
 
 		//
 		// Add new geometry.
 		//
 
-		meshData.Vertices.push_back(v0); // 0
-		meshData.Vertices.push_back(v1); // 1
-		meshData.Vertices.push_back(v2); // 2
-		meshData.Vertices.push_back(m0); // 3
-		meshData.Vertices.push_back(m1); // 4
-		meshData.Vertices.push_back(m2); // 5
- 
-		meshData.Indices.push_back(i*6+0);
-		meshData.Indices.push_back(i*6+3);
-		meshData.Indices.push_back(i*6+5);
+		uint32_t* k = &meshData.Indices[i*12];
+		k[0]  = v0;
+		k[1]  = m0;
+		k[2]  = m2;
 
-		meshData.Indices.push_back(i*6+3);
-		meshData.Indices.push_back(i*6+4);
-		meshData.Indices.push_back(i*6+5);
+		k[3]  = m0;
+		k[4]  = m1;
+		k[5]  = m2;
 
-		meshData.Indices.push_back(i*6+5);
-		meshData.Indices.push_back(i*6+4);
-		meshData.Indices.push_back(i*6+2);
+		k[6]  = m2;
+		k[7]  = m1;
+		k[8]  = v2;
 
-		meshData.Indices.push_back(i*6+3);
-		meshData.Indices.push_back(i*6+1);
-		meshData.Indices.push_back(i*6+4);
+		k[9]  = m0;
+		k[10] = v1;
+		k[11] = m1;
 	}
 }
 
-void GeometryGenerator::CreateGeosphere(float radius, UINT numSubdivisions, MeshData& meshData)
+void GeometryGenerator::CreateGeosphere(float radius, uint32_t numSubdivisions, MeshData& meshData)
 {
-	// Put a cap on the number of subdivisions.
-	numSubdivisions = MathHelper::Min(numSubdivisions, 5u);
+	// Put a cap on the number of subdivisions.  Level 8 is already ~1.3M faces.
+	numSubdivisions = MathHelper::Min(numSubdivisions, 8u);
 
 	// Approximate a sphere by tessellating an icosahedron.
 
 	const float X = 0.525731f; 
 	const float Z = 0.850651f;
 
-	XMFLOAT3 pos[12] = 
+	Vec3 pos[12] = 
 	{
-		XMFLOAT3(-X, 0.0f, Z),  XMFLOAT3(X, 0.0f, Z),  
-		XMFLOAT3(-X, 0.0f, -Z), XMFLOAT3(X, 0.0f, -Z),    
-		XMFLOAT3(0.0f, Z, X),   XMFLOAT3(0.0f, Z, -X), 
-		XMFLOAT3(0.0f, -Z, X),  XMFLOAT3(0.0f, -Z, -X),    
-		XMFLOAT3(Z, X, 0.0f),   XMFLOAT3(-Z, X, 0.0f), 
-		XMFLOAT3(Z, -X, 0.0f),  XMFLOAT3(-Z, -X, 0.0f)
+		Vec3(-X, 0.0f, Z),  Vec3(X, 0.0f, Z),  
+		Vec3(-X, 0.0f, -Z), Vec3(X, 0.0f, -Z),    
+		Vec3(0.0f, Z, X),   Vec3(0.0f, Z, -X), 
+		Vec3(0.0f, -Z, X),  Vec3(0.0f, -Z, -X),    
+		Vec3(Z, X, 0.0f),   Vec3(-Z, X, 0.0f), 
+		Vec3(Z, -X, 0.0f),  Vec3(-Z, -X, 0.0f)
 	};
 
-	DWORD k[60] = 
+	uint32_t k[60] = 
 	{
 		1,4,0,  4,9,0,  4,5,9,  8,5,4,  1,8,4,    
 		1,10,8, 10,3,8, 8,3,5,  3,2,5,  3,7,2,    
@@ -303,54 +359,76 @@ void GeometryGenerator::CreateGeosphere(float radius, UINT numSubdivisions, Mesh
 		10,1,6, 11,0,9, 2,11,9, 5,2,9,  11,2,7 
 	};
 
-	meshData.Vertices.resize(12);
-	meshData.Indices.resize(60);
-
-	for(UINT i = 0; i < 12; ++i)
+	// Every level turns each triangle into four and adds one shared vertex per edge,
+	// giving 10*4^n+2 vertices.  Reserve the final sizes once so no level reallocates;
+	// the index arrays are swapped between levels, so both need the final size.
+	uint32_t finalTris = 20;
+	for(uint32_t i = 0; i < numSubdivisions; ++i)
+		finalTris *= 4;
+	uint32_t finalVerts = finalTris/2 + 2;
+
+	// Scratch for Subdivide lives here rather than in the generator, so one
+	// GeometryGenerator can build meshes on several threads at once.
+	std::vector<uint32_t> scratchIndices;
+	EdgeMidpointMap edgeMidpoints;
+	uint32_t openEdges = 0;   // The icosahedron is closed.
+
+	meshData.Reserve(finalVerts, 3*finalTris);
+	scratchIndices.reserve(3*finalTris);
+	meshData.Resize(12, 60);
+
+	for(uint32_t i = 0; i < 12; ++i)
 		meshData.Vertices[i].Position = pos[i];
 
-	for(UINT i = 0; i < 60; ++i)
+	for(uint32_t i = 0; i < 60; ++i)
 		meshData.Indices[i] = k[i];
 
-	for(UINT i = 0; i < numSubdivisions; ++i)
-		Subdivide(meshData);
+	for(uint32_t i = 0; i < numSubdivisions; ++i)
+		Subdivide(meshData, scratchIndices, edgeMidpoints, openEdges);
 
-	// Project vertices onto sphere and scale.
-	for(UINT i = 0; i < meshData.Vertices.size(); ++i)
+	// Project vertices onto sphere and scale.  Vertices are independent, so the
+	// high subdivision levels are split across threads.
+	Vertex* vertices = meshData.Vertices.data();
+	ParallelFor(meshData.Vertices.size(), 16*1024, [=](size_t begin, size_t end)
 	{
-		// Project onto unit sphere.
-		XMVECTOR n = XMVector3Normalize(XMLoadFloat3(&meshData.Vertices[i].Position));
-
-		// Project onto sphere.
-		XMVECTOR p = radius*n;
+		for(size_t i = begin; i < end; ++i)
+		{
+			// Project onto unit sphere.
+			Vec3 n = Normalize(vertices[i].Position);
 
-		XMStoreFloat3(&meshData.Vertices[i].Position, p);
-		XMStoreFloat3(&meshData.Vertices[i].Normal, n);
+			// Project onto sphere.
+			vertices[i].Position = radius*n;
+			vertices[i].Normal = n;
 
-		// Derive texture coordinates from spherical coordinates.
-		float theta = MathHelper::AngleFromXY(
-			meshData.Vertices[i].Position.x, 
-			meshData.Vertices[i].Position.z);
+			// Derive texture coordinates from spherical coordinates.
+			float theta = MathHelper::AngleFromXY(
+				vertices[i].Position.x, 
+				vertices[i].Position.z);
 
-		float phi = acosf(meshData.Vertices[i].Position.y / radius);
+			float phi = acosf(vertices[i].Position.y / radius);
 
-		meshData.Vertices[i].TexC.x = theta/XM_2PI;
-		meshData.Vertices[i].TexC.y = phi/XM_PI;
+			vertices[i].TexC.x = theta/(2.0f*MathHelper::Pi);
+			vertices[i].TexC.y = phi/MathHelper::Pi;
 
-		// Partial derivative of P with respect to theta
-		meshData.Vertices[i].TangentU.x = -radius*sinf(phi)*sinf(theta);
-		meshData.Vertices[i].TangentU.y = 0.0f;
-		meshData.Vertices[i].TangentU.z = +radius*sinf(phi)*cosf(theta);
+			// Partial derivative of P with respect to theta
+			vertices[i].TangentU.x = -radius*sinf(phi)*sinf(theta);
+			vertices[i].TangentU.y = 0.0f;
+			vertices[i].TangentU.z = +radius*sinf(phi)*cosf(theta);
 
-		XMVECTOR T = XMLoadFloat3(&meshData.Vertices[i].TangentU);
-		XMStoreFloat3(&meshData.Vertices[i].TangentU, XMVector3Normalize(T));
-	}
+			vertices[i].TangentU = Normalize(vertices[i].TangentU);
+		}
+	});
 }
 
-void GeometryGenerator::CreateCylinder(float bottomRadius, float topRadius, float height, UINT sliceCount, UINT stackCount, MeshData& meshData)
+void GeometryGenerator::CreateCylinder(float bottomRadius, float topRadius, float height, uint32_t sliceCount, uint32_t stackCount, MeshData& meshData)
 {
-	meshData.Vertices.clear();
-	meshData.Indices.clear();
+	// The side rings and the two caps are appended in turn; reserve the exact
+	// total so the appends never reallocate.  Each cap is one ring plus a center.
+	uint32_t ringVertexCount = sliceCount+1;
+	meshData.Clear();
+	meshData.Reserve(
+		(stackCount+1)*ringVertexCount + 2*(ringVertexCount+1),
+		6*sliceCount*stackCount + 2*3*sliceCount);
 
 	//
 	// Build Stacks.
@@ -361,24 +439,24 @@ void GeometryGenerator::CreateCylinder(float bottomRadius, float topRadius, floa
 	// Amount to increment radius as we move up each stack level from bottom to top.
 	float radiusStep = (topRadius - bottomRadius) / stackCount;
 
-	UINT ringCount = stackCount+1;
+	uint32_t ringCount = stackCount+1;
 
 	// Compute vertices for each stack ring starting at the bottom and moving up.
-	for(UINT i = 0; i < ringCount; ++i)
+	for(uint32_t i = 0; i < ringCount; ++i)
 	{
 		float y = -0.5f*height + i*stackHeight;
 		float r = bottomRadius + i*radiusStep;
 
 		// vertices of ring
-		float dTheta = 2.0f*XM_PI/sliceCount;
-		for(UINT j = 0; j <= sliceCount; ++j)
+		float dTheta = 2.0f*MathHelper::Pi/sliceCount;
+		for(uint32_t j = 0; j <= sliceCount; ++j)
 		{
 			Vertex vertex;
 
 			float c = cosf(j*dTheta);
 			float s = sinf(j*dTheta);
 
-			vertex.Position = XMFLOAT3(r*c, y, r*s);
+			vertex.Position = Vec3(r*c, y, r*s);
 
 			vertex.TexC.x = (float)j/sliceCount;
 			vertex.TexC.y = 1.0f - (float)i/stackCount;
@@ -403,28 +481,24 @@ void GeometryGenerator::CreateCylinder(float bottomRadius, float topRadius, floa
 			//  dz/dv = (r0-r1)*sin(t)
 
 			// This is unit length.
-			vertex.TangentU = XMFLOAT3(-s, 0.0f, c);
+			vertex.TangentU = Vec3(-s, 0.0f, c);
 
 			float dr = bottomRadius-topRadius;
-			XMFLOAT3 bitangent(dr*c, -height, dr*s);
+			Vec3 bitangent(dr*c, -height, dr*s);
 
-			XMVECTOR T = XMLoadFloat3(&vertex.TangentU);
-			XMVECTOR B = XMLoadFloat3(&bitangent);
-			XMVECTOR N = XMVector3Normalize(XMVector3Cross(T, B));
-			XMStoreFloat3(&vertex.Normal, N);
+			vertex.Normal = Normalize(Cross(vertex.TangentU, bitangent));
 
 			meshData.Vertices.push_back(vertex);
 		}
 	}
 
-	// Add one because we duplicate the first and last vertex per ring
-	// since the texture coordinates are different.
-	UINT ringVertexCount = sliceCount+1;
+	// ringVertexCount has one more vertex than sliceCount because we duplicate
+	// the first and last vertex per ring since the texture coordinates are different.
 
 	// Compute indices for each stack.
-	for(UINT i = 0; i < stackCount; ++i)
+	for(uint32_t i = 0; i < stackCount; ++i)
 	{
-		for(UINT j = 0; j < sliceCount; ++j)
+		for(uint32_t j = 0; j < sliceCount; ++j)
 		{
 			meshData.Indices.push_back(i*ringVertexCount + j);
 			meshData.Indices.push_back((i+1)*ringVertexCount + j);
@@ -436,20 +510,19 @@ void GeometryGenerator::CreateCylinder(float bottomRadius, float topRadius, floa
 		}
 	}
 
-	BuildCylinderTopCap(bottomRadius, topRadius, height, sliceCount, stackCount, meshData);
-	BuildCylinderBottomCap(bottomRadius, topRadius, height, sliceCount, stackCount, meshData);
+	BuildCylinderTopCap(topRadius, height, sliceCount, meshData);
+	BuildCylinderBottomCap(bottomRadius, height, sliceCount, meshData);
 }
 
-void GeometryGenerator::BuildCylinderTopCap(float bottomRadius, float topRadius, float height, 
-											UINT sliceCount, UINT stackCount, MeshData& meshData)
+void GeometryGenerator::BuildCylinderTopCap(float topRadius, float height, uint32_t sliceCount, MeshData& meshData)
 {
-	UINT baseIndex = (UINT)meshData.Vertices.size();
+	uint32_t baseIndex = (uint32_t)meshData.Vertices.size();
 
 	float y = 0.5f*height;
-	float dTheta = 2.0f*XM_PI/sliceCount;
+	float dTheta = 2.0f*MathHelper::Pi/sliceCount;
 
 	// Duplicate cap ring vertices because the texture coordinates and normals differ.
-	for(UINT i = 0; i <= sliceCount; ++i)
+	for(uint32_t i = 0; i <= sliceCount; ++i)
 	{
 		float x = topRadius*cosf(i*dTheta);
 		float z = topRadius*sinf(i*dTheta);
@@ -466,9 +539,9 @@ void GeometryGenerator::BuildCylinderTopCap(float bottomRadius, float topRadius,
 	meshData.Vertices.push_back( Vertex(0.0f, y, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.5f, 0.5f) );
 
 	// Index of center vertex.
-	UINT centerIndex = (UINT)meshData.Vertices.size()-1;
+	uint32_t centerIndex = (uint32_t)meshData.Vertices.size()-1;
 
-	for(UINT i = 0; i < sliceCount; ++i)
+	for(uint32_t i = 0; i < sliceCount; ++i)
 	{
 		meshData.Indices.push_back(centerIndex);
 		meshData.Indices.push_back(baseIndex + i+1);
@@ -476,19 +549,18 @@ void GeometryGenerator::BuildCylinderTopCap(float bottomRadius, float topRadius,
 	}
 }
 
-void GeometryGenerator::BuildCylinderBottomCap(float bottomRadius, float topRadius, float height, 
-											   UINT sliceCount, UINT stackCount, MeshData& meshData)
+void GeometryGenerator::BuildCylinderBottomCap(float bottomRadius, float height, uint32_t sliceCount, MeshData& meshData)
 {
 	// 
 	// Build bottom cap.
 	//
 
-	UINT baseIndex = (UINT)meshData.Vertices.size();
+	uint32_t baseIndex = (uint32_t)meshData.Vertices.size();
 	float y = -0.5f*height;
 
 	// vertices of ring
-	float dTheta = 2.0f*XM_PI/sliceCount;
-	for(UINT i = 0; i <= sliceCount; ++i)
+	float dTheta = 2.0f*MathHelper::Pi/sliceCount;
+	for(uint32_t i = 0; i <= sliceCount; ++i)
 	{
 		float x = bottomRadius*cosf(i*dTheta);
 		float z = bottomRadius*sinf(i*dTheta);
@@ -505,9 +577,9 @@ void GeometryGenerator::BuildCylinderBottomCap(float bottomRadius, float topRadi
 	meshData.Vertices.push_back( Vertex(0.0f, y, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.5f, 0.5f) );
 
 	// Cache the index of center vertex.
-	UINT centerIndex = (UINT)meshData.Vertices.size()-1;
+	uint32_t centerIndex = (uint32_t)meshData.Vertices.size()-1;
 
-	for(UINT i = 0; i < sliceCount; ++i)
+	for(uint32_t i = 0; i < sliceCount; ++i)
 	{
 		meshData.Indices.push_back(centerIndex);
 		meshData.Indices.push_back(baseIndex + i);
@@ -515,10 +587,12 @@ void GeometryGenerator::BuildCylinderBottomCap(float bottomRadius, float topRadi
 	}
 }
 
-void GeometryGenerator::CreateGrid(float width, float depth, UINT m, UINT n, MeshData& meshData)
+void GeometryGenerator::CreateGrid(float width, float depth, uint32_t m, uint32_t n, MeshData& meshData)
 {
-	UINT vertexCount = m*n;
-	UINT faceCount   = (m-1)*(n-1)*2;
+	uint32_t vertexCount = m*n;
+	uint32_t faceCount   = (m-1)*(n-1)*2;
+
+	meshData.Resize(vertexCount, faceCount*3); // 3 indices per face
 
 	//
 	// Create the vertices.
@@ -533,53 +607,62 @@ void GeometryGenerator::CreateGrid(float width, float depth, UINT m, UINT n, Mes
 	float du = 1.0f / (n-1);
 	float dv = 1.0f / (m-1);
 
-	meshData.Vertices.resize(vertexCount);
-	for(UINT i = 0; i < m; ++i)
+	// Rows are independent, so split them across threads.  Small grids are not
+	// worth a thread launch and stay on the calling thread.
+	const size_t minVertsPerThread = 64*1024;
+	Vertex* vertices = meshData.Vertices.data();
+	ParallelFor(m, minVertsPerThread/n + 1, [=](size_t rowBegin, size_t rowEnd)
 	{
-		float z = halfDepth - i*dz;
-		for(UINT j = 0; j < n; ++j)
+		for(uint32_t i = (uint32_t)rowBegin; i < (uint32_t)rowEnd; ++i)
 		{
-			float x = -halfWidth + j*dx;
-
-			meshData.Vertices[i*n+j].Position = XMFLOAT3(x, 0.0f, z);
-			meshData.Vertices[i*n+j].Normal   = XMFLOAT3(0.0f, 1.0f, 0.0f);
-			meshData.Vertices[i*n+j].TangentU = XMFLOAT3(1.0f, 0.0f, 0.0f);
-
-			// Stretch texture over grid.
-			meshData.Vertices[i*n+j].TexC.x = j*du;
-			meshData.Vertices[i*n+j].TexC.y = i*dv;
+			float z = halfDepth - i*dz;
+			Vertex* row = vertices + i*n;
+			for(uint32_t j = 0; j < n; ++j)
+			{
+				float x = -halfWidth + j*dx;
+
+				row[j].Position = Vec3(x, 0.0f, z);
+				row[j].Normal   = Vec3(0.0f, 1.0f, 0.0f);
+				row[j].TangentU = Vec3(1.0f, 0.0f, 0.0f);
+
+				// Stretch texture over grid.
+				row[j].TexC.x = j*du;
+				row[j].TexC.y = i*dv;
+			}
 		}
-	}
+	});
  
     //
 	// Create the indices.
 	//
 
-	meshData.Indices.resize(faceCount*3); // 3 indices per face
-
-	// Iterate over each quad and compute indices.
-	UINT k = 0;
-	for(UINT i = 0; i < m-1; ++i)
+	// Iterate over each quad and compute indices.  Each row of quads writes its own
+	// contiguous block of 6*(n-1) indices, so rows can be filled in parallel too.
+	uint32_t* indices = meshData.Indices.data();
+	ParallelFor(m-1, minVertsPerThread/n + 1, [=](size_t rowBegin, size_t rowEnd)
 	{
-		for(UINT j = 0; j < n-1; ++j)
+		for(uint32_t i = (uint32_t)rowBegin; i < (uint32_t)rowEnd; ++i)
 		{
-			meshData.Indices[k]   = i*n+j;
-			meshData.Indices[k+1] = i*n+j+1;
-			meshData.Indices[k+2] = (i+1)*n+j;
-
-			meshData.Indices[k+3] = (i+1)*n+j;
-			meshData.Indices[k+4] = i*n+j+1;
-			meshData.Indices[k+5] = (i+1)*n+j+1;
-
-			k += 6; // next quad
+			uint32_t k = i*(n-1)*6;
+			for(uint32_t j = 0; j < n-1; ++j)
+			{
+				indices[k]   = i*n+j;
+				indices[k+1] = i*n+j+1;
+				indices[k+2] = (i+1)*n+j;
+
+				indices[k+3] = (i+1)*n+j;
+				indices[k+4] = i*n+j+1;
+				indices[k+5] = (i+1)*n+j+1;
+
+				k += 6; // next quad
+			}
 		}
-	}
+	});
 }
 
 void GeometryGenerator::CreateFullscreenQuad(MeshData& meshData)
 {
-	meshData.Vertices.resize(4);
-	meshData.Indices.resize(6);
+	meshData.Resize(4, 6);
 
 	// Position coordinates specified in NDC space.
 	meshData.Vertices[0] = Vertex(
@@ -614,3 +697,24 @@ void GeometryGenerator::CreateFullscreenQuad(MeshData& meshData)
 	meshData.Indices[4] = 2;
 	meshData.Indices[5] = 3;
 }
+
+void GeometryGenerator::OptimizeMesh(MeshData& meshData, MeshOptimizer::Report* report)
+{
+	if(meshData.Indices.empty())
+		return;
+
+	std::vector<uint32_t> remap;
+	MeshOptimizer::Report stats = MeshOptimizer::Optimize(meshData.Indices, meshData.Vertices.size(),
+		&meshData.Vertices[0].Position.x, sizeof(Vertex), remap);
+
+	uint32_t vertexCount = 0;
+	for(size_t i = 0; i < remap.size(); ++i)
+	{
+		if(remap[i] != MeshOptimizer::InvalidIndex)
+			++vertexCount;
+	}
+	MeshOptimizer::RemapVertices(meshData.Vertices, remap.data(), vertexCount);
+
+	if(report)
+		*report = stats;
+}
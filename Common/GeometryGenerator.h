@@ -2,7 +2,11 @@
 #ifndef GEOMETRYGENERATOR_H
 #define GEOMETRYGENERATOR_H
 
-#include "d3dUtil.h"
+#include <cstdint>
+#include <vector>
+
+#include "MeshOptimizer.h"
+#include "VecMath.h"
 
 class GeometryGenerator
 {
@@ -10,7 +14,7 @@ public:
 	struct Vertex
 	{
 		Vertex(){}
-		Vertex(const DirectX::XMFLOAT3& p, const DirectX::XMFLOAT3& n, const DirectX::XMFLOAT3& t, const DirectX::XMFLOAT2& uv)
+		Vertex(const Vec3& p, const Vec3& n, const Vec3& t, const Vec2& uv)
 			: Position(p), Normal(n), TangentU(t), TexC(uv){}
 		Vertex(
 			float px, float py, float pz, 
@@ -20,16 +24,40 @@ public:
 			: Position(px,py,pz), Normal(nx,ny,nz),
 			  TangentU(tx, ty, tz), TexC(u,v){}
 
-		DirectX::XMFLOAT3 Position;
-		DirectX::XMFLOAT3 Normal;
-		DirectX::XMFLOAT3 TangentU;
-		DirectX::XMFLOAT2 TexC;
+		Vec3 Position;
+		Vec3 Normal;
+		Vec3 TangentU;
+		Vec2 TexC;
 	};
 
+	///<summary>
+	/// Vertex and index storage for a generated mesh.  The Create* methods size the
+	/// arrays exactly and overwrite them in place, so a MeshData that is reused across
+	/// calls keeps its capacity and stops allocating once it has held the largest mesh.
+	///</summary>
 	struct MeshData
 	{
 		std::vector<Vertex> Vertices;
-		std::vector<UINT> Indices;
+		std::vector<uint32_t> Indices;
+
+		void Resize(uint32_t vertexCount, uint32_t indexCount)
+		{
+			Vertices.resize(vertexCount);
+			Indices.resize(indexCount);
+		}
+
+		void Reserve(uint32_t vertexCount, uint32_t indexCount)
+		{
+			Vertices.reserve(vertexCount);
+			Indices.reserve(indexCount);
+		}
+
+		// Empties the mesh but keeps the allocated storage for the next call.
+		void Clear()
+		{
+			Vertices.clear();
+			Indices.clear();
+		}
 	};
 
 	///<summary>
@@ -41,26 +69,28 @@ public:
 	/// Creates a sphere centered at the origin with the given radius.  The
 	/// slices and stacks parameters control the degree of tessellation.
 	///</summary>
-	void CreateSphere(float radius, UINT sliceCount, UINT stackCount, MeshData& meshData);
+	void CreateSphere(float radius, uint32_t sliceCount, uint32_t stackCount, MeshData& meshData);
 
 	///<summary>
 	/// Creates a geosphere centered at the origin with the given radius.  The
-	/// depth controls the level of tessellation.
+	/// depth controls the level of tessellation.  Vertices are shared between
+	/// neighbouring triangles, so level n has 10*4^n+2 vertices and 20*4^n faces.
 	///</summary>
-	void CreateGeosphere(float radius, UINT numSubdivisions, MeshData& meshData);
+	void CreateGeosphere(float radius, uint32_t numSubdivisions, MeshData& meshData);
 
 	///<summary>
 	/// Creates a cylinder parallel to the y-axis, and centered about the origin.  
 	/// The bottom and top radius can vary to form various cone shapes rather than true
 	// cylinders.  The slices and stacks parameters control the degree of tessellation.
 	///</summary>
-	void CreateCylinder(float bottomRadius, float topRadius, float height, UINT sliceCount, UINT stackCount, MeshData& meshData);
+	void CreateCylinder(float bottomRadius, float topRadius, float height, uint32_t sliceCount, uint32_t stackCount, MeshData& meshData);
 
 	///<summary>
 	/// Creates an mxn grid in the xz-plane with m rows and n columns, centered
-	/// at the origin with the specified width and depth.
+	/// at the origin with the specified width and depth.  Large grids are filled
+	/// in parallel across the hardware threads.
 	///</summary>
-	void CreateGrid(float width, float depth, UINT m, UINT n, MeshData& meshData);
+	void CreateGrid(float width, float depth, uint32_t m, uint32_t n, MeshData& meshData);
 
 	///<summary>
 	/// Creates a quad covering the screen in NDC coordinates.  This is useful for
@@ -68,10 +98,44 @@ public:
 	///</summary>
 	void CreateFullscreenQuad(MeshData& meshData);
 
+	///<summary>
+	/// Reorders the mesh's triangles for the post-transform vertex cache and for
+	/// overdraw, then reorders its vertices into first-use order.  Unreferenced
+	/// vertices are dropped.  If report is non-null it receives the ACMR/ATVR before
+	/// and after.
+	///</summary>
+	void OptimizeMesh(MeshData& meshData, MeshOptimizer::Report* report = 0);
+
 private:
-	void Subdivide(MeshData& meshData);
-	void BuildCylinderTopCap(float bottomRadius, float topRadius, float height, UINT sliceCount, UINT stackCount, MeshData& meshData);
-	void BuildCylinderBottomCap(float bottomRadius, float topRadius, float height, UINT sliceCount, UINT stackCount, MeshData& meshData);
+	///<summary>
+	/// Open-addressing map from an undirected edge to the index of its midpoint
+	/// vertex.  The table is sized once per subdivision level and never rehashed.
+	///</summary>
+	class EdgeMidpointMap
+	{
+	public:
+		EdgeMidpointMap() : mShift(64) {}
+
+		// Clears the table and sizes it for at most maxEdges distinct edges.
+		void Reset(uint32_t maxEdges);
+
+		// Returns the midpoint already stored for edge (i0, i1); otherwise stores
+		// newIndex for the edge and returns it.
+		uint32_t FindOrInsert(uint32_t i0, uint32_t i1, uint32_t newIndex);
+
+	private:
+		std::vector<unsigned long long> mKeys;
+		std::vector<uint32_t> mValues;
+		uint32_t mShift;
+	};
+
+	// inputIndices receives the previous level's indices, swapped out of meshData so
+	// the input is never copied.  openEdges is the number of edges of the input used by
+	// one triangle only, and comes back as the output's.
+	void Subdivide(MeshData& meshData, std::vector<uint32_t>& inputIndices, EdgeMidpointMap& edgeMidpoints,
+		uint32_t& openEdges);
+	void BuildCylinderTopCap(float topRadius, float height, uint32_t sliceCount, MeshData& meshData);
+	void BuildCylinderBottomCap(float bottomRadius, float height, uint32_t sliceCount, MeshData& meshData);
 };
 
 #endif // GEOMETRYGENERATOR_H
\ No newline at end of file
@@ -0,0 +1,148 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Empty files cannot be mapped; they open successfully with this as their view so
+// IsOpen() still reports true.
+static const uint8_t gEmptyView[1] = { 0 };
+
+MappedFile::MappedFile()
+	:
+#ifdef _WIN32
+	  mMapping(0),
+#endif
+	  mData(0), mSize(0)
+{
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::Open(const char* path)
+{
+	Close();
+
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, 0);
+	return MapHandle(file);
+}
+
+bool MappedFile::Open(const wchar_t* path)
+{
+	Close();
+
+	HANDLE file = CreateFileW(path, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, 0);
+	return MapHandle(file);
+}
+
+bool MappedFile::MapHandle(void* file)
+{
+	if(file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize;
+	if(!GetFileSizeEx(file, &fileSize) || (unsigned long long)fileSize.QuadPart > (size_t)-1)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	if(fileSize.QuadPart == 0)
+	{
+		CloseHandle(file);
+		mData = gEmptyView;
+		mSize = 0;
+		return true;
+	}
+
+	// The mapping object keeps the file open, so the handle can go right away.
+	mMapping = CreateFileMappingW(file, 0, PAGE_READONLY, 0, 0, 0);
+	CloseHandle(file);
+	if(!mMapping)
+		return false;
+
+	mData = static_cast<const uint8_t*>(MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0));
+	if(!mData)
+	{
+		CloseHandle(mMapping);
+		mMapping = 0;
+		return false;
+	}
+
+	mSize = (size_t)fileSize.QuadPart;
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if(mData && mData != gEmptyView)
+		UnmapViewOfFile(mData);
+	if(mMapping)
+		CloseHandle(mMapping);
+
+	mMapping = 0;
+	mData = 0;
+	mSize = 0;
+}
+
+#else
+
+bool MappedFile::Open(const char* path)
+{
+	Close();
+
+	int fd = open(path, O_RDONLY);
+	if(fd < 0)
+		return false;
+
+	struct stat st;
+	if(fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+	{
+		close(fd);
+		return false;
+	}
+
+	if(st.st_size == 0)
+	{
+		close(fd);
+		mData = gEmptyView;
+		mSize = 0;
+		return true;
+	}
+
+	// The mapping keeps its own reference to the file, so the descriptor can go.
+	void* view = mmap(0, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(view == MAP_FAILED)
+		return false;
+
+	mData = static_cast<const uint8_t*>(view);
+	mSize = (size_t)st.st_size;
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if(mData && mData != gEmptyView)
+		munmap(const_cast<uint8_t*>(mData), mSize);
+
+	mData = 0;
+	mSize = 0;
+}
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+#include <cstdint>
+
+///<summary>
+/// Read-only memory mapping of a whole file.  The view stays valid until Close() or
+/// destruction, so parsers can hand out pointers into it instead of copying.  Uses
+/// CreateFileMapping/MapViewOfFile on Windows and mmap elsewhere.
+///</summary>
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	bool Open(const char* path);
+#ifdef _WIN32
+	bool Open(const wchar_t* path);
+#endif
+	void Close();
+
+	bool IsOpen()const { return mData != 0; }
+
+	const uint8_t* Data()const { return mData; }
+	size_t Size()const { return mSize; }
+
+private:
+	MappedFile(const MappedFile& rhs);
+	MappedFile& operator=(const MappedFile& rhs);
+
+#ifdef _WIN32
+	bool MapHandle(void* file);
+
+	void* mMapping;
+#endif
+	const uint8_t* mData;
+	size_t mSize;
+};
+
+#endif // MAPPEDFILE_H
@@ -0,0 +1,27 @@
+#ifndef MARCHINGCUBESTABLES_H
+#define MARCHINGCUBESTABLES_H
+
+///<summary>
+/// Marching cubes lookup tables shared by the CPU mesher.  Corner and edge numbering
+/// follow FX/marchingCubes.fx: corner i sets bit i of the case index when its density
+/// is positive (solid), and offsets are given in world (x, y, z) voxel steps.
+///</summary>
+class MarchingCubesTables
+{
+public:
+	// Voxel-space offset of each cell corner.
+	static const int CornerOffset[8][3];
+
+	// The two corners joined by each cell edge, and the axis (0=x, 1=y, 2=z) the
+	// edge runs along from its first corner.
+	static const int EdgeCorners[12][2];
+	static const int EdgeAxis[12];
+
+	// Number of triangles emitted for each of the 256 corner sign cases.
+	static const int CaseTriangleCount[256];
+
+	// Up to five triangles per case, as edge numbers; unused entries are -1.
+	static const int TriTable[256][5][3];
+};
+
+#endif // MARCHINGCUBESTABLES_H
@@ -2,7 +2,6 @@
 #include "MathHelper.h"
 #include <float.h>
 #include <cmath>
-using namespace DirectX;
 
 const float MathHelper::Infinity = FLT_MAX;
 const float MathHelper::Pi       = 3.1415926535f;
@@ -29,6 +28,9 @@ float MathHelper::AngleFromXY(float x, float y)
 	return theta;
 }
 
+#if defined(_WIN32)
+using namespace DirectX;
+
 XMVECTOR MathHelper::RandUnitVec3()
 {
 	XMVECTOR One  = XMVectorSet(1.0f, 1.0f, 1.0f, 1.0f);
@@ -75,4 +77,5 @@ XMVECTOR MathHelper::RandHemisphereUnitVec3(XMVECTOR n)
 
 		return XMVector3Normalize(v);
 	}
-}
\ No newline at end of file
+}
+#endif
@@ -2,8 +2,14 @@
 #ifndef MATHHELPER_H
 #define MATHHELPER_H
 
+#include <cstdlib>
+
+// The matrix and vector helpers need DirectXMath, which only the Windows build has;
+// the scalar helpers are shared with the portable core.
+#if defined(_WIN32)
 #include <Windows.h>
 #include <DirectXMath.h>
+#endif
 
 class MathHelper
 {
@@ -47,6 +53,7 @@ public:
 	// Returns the polar angle of the point (x,y) in [0, 2*PI).
 	static float AngleFromXY(float x, float y);
 
+#if defined(_WIN32)
 	static DirectX::XMMATRIX InverseTranspose(DirectX::CXMMATRIX M)
 	{
 		// Inverse-transpose is just applied to normals.  So zero out 
@@ -61,6 +68,7 @@ public:
 
 	static DirectX::XMVECTOR RandUnitVec3();
 	static DirectX::XMVECTOR RandHemisphereUnitVec3(DirectX::XMVECTOR n);
+#endif
 
 	static const float Infinity;
 	static const float Pi;
@@ -0,0 +1,310 @@
+#include "MeshFile.h"
+
+#include <cfloat>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// Floating-point std::from_chars is much faster than strtof and ignores the locale,
+// but older standard libraries only ship the integer overloads.
+#if defined(__has_include)
+#if __has_include(<charconv>) && (__cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L))
+#include <charconv>
+#endif
+#endif
+
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+#define MESHFILE_FROM_CHARS 1
+#else
+#define MESHFILE_FROM_CHARS 0
+#endif
+
+static_assert(sizeof(MeshFileHeader) == 64, "MeshFileHeader is part of the file format");
+static_assert(sizeof(MeshFile::Vertex) == 24, "MeshFile::Vertex is part of the file format");
+
+const uint32_t MeshFile::Magic;
+const uint32_t MeshFile::Version;
+const uint32_t MeshFile::BlobAlignment;
+
+namespace
+{
+	bool Fail(std::string* error, const char* message)
+	{
+		if(error)
+			*error = message;
+		return false;
+	}
+
+	//---------------------------------------------------------------------------------------
+	// Cursor over the text model format.
+	//---------------------------------------------------------------------------------------
+
+	class TextCursor
+	{
+	public:
+		TextCursor(const char* text, size_t size) : mPos(text), mEnd(text + size) {}
+
+		void SkipSpace()
+		{
+			while(mPos < mEnd && (*mPos == ' ' || *mPos == '\t' || *mPos == '\r' || *mPos == '\n'))
+				++mPos;
+		}
+
+		// Skips whitespace, then consumes token if the text continues with it.
+		bool Expect(const char* token)
+		{
+			SkipSpace();
+			size_t length = std::strlen(token);
+			if(size_t(mEnd - mPos) < length || std::memcmp(mPos, token, length) != 0)
+				return false;
+			mPos += length;
+			return true;
+		}
+
+		// Skips up to and past the next occurrence of c.
+		bool SkipPast(char c)
+		{
+			const void* found = std::memchr(mPos, c, mEnd - mPos);
+			if(!found)
+				return false;
+			mPos = static_cast<const char*>(found) + 1;
+			return true;
+		}
+
+		bool ParseUInt(uint32_t& value)
+		{
+			SkipSpace();
+			const char* start = mPos;
+			uint64_t v = 0;
+			while(mPos < mEnd && *mPos >= '0' && *mPos <= '9')
+			{
+				v = v*10 + uint64_t(*mPos - '0');
+				if(v > 0xFFFFFFFFull)
+					return false;
+				++mPos;
+			}
+			value = uint32_t(v);
+			return mPos != start;
+		}
+
+		bool ParseFloat(float& value)
+		{
+			SkipSpace();
+#if MESHFILE_FROM_CHARS
+			std::from_chars_result result = std::from_chars(mPos, mEnd, value);
+			if(result.ec != std::errc())
+				return false;
+			mPos = result.ptr;
+			return true;
+#else
+			// strtof needs a terminated string; the mapped text is not.
+			char buffer[64];
+			size_t length = 0;
+			while(mPos + length < mEnd && length + 1 < sizeof(buffer) &&
+				mPos[length] != ' ' && mPos[length] != '\t' && mPos[length] != '\r' && mPos[length] != '\n')
+			{
+				buffer[length] = mPos[length];
+				++length;
+			}
+			buffer[length] = '\0';
+
+			char* end = 0;
+			value = std::strtof(buffer, &end);
+			if(end == buffer)
+				return false;
+			mPos += end - buffer;
+			return true;
+#endif
+		}
+
+	private:
+		const char* mPos;
+		const char* mEnd;
+	};
+
+	size_t AlignUp(size_t value, size_t alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+}
+
+MeshFile::MeshFile()
+	: mVertices(0), mIndices(0)
+{
+	std::memset(&mHeader, 0, sizeof(mHeader));
+}
+
+bool MeshFile::Load(const char* path, std::string* error)
+{
+	mVertices = 0;
+	mIndices = 0;
+	std::memset(&mHeader, 0, sizeof(mHeader));
+
+	if(!mFile.Open(path))
+		return Fail(error, "cannot open file");
+
+	if(!LoadFromMemory(mFile.Data(), mFile.Size(), error))
+	{
+		mFile.Close();
+		return false;
+	}
+	return true;
+}
+
+bool MeshFile::LoadFromMemory(const uint8_t* data, size_t size, std::string* error)
+{
+	mVertices = 0;
+	mIndices = 0;
+	std::memset(&mHeader, 0, sizeof(mHeader));
+
+	if(size < sizeof(MeshFileHeader))
+		return Fail(error, "file too small for header");
+	if(reinterpret_cast<uintptr_t>(data) % 4 != 0)
+		return Fail(error, "mesh image is not 4-byte aligned");
+
+	MeshFileHeader header;
+	std::memcpy(&header, data, sizeof(header));
+
+	if(header.Magic != Magic)
+		return Fail(error, "not a mesh file");
+	if(header.Version != Version)
+		return Fail(error, "unsupported mesh file version");
+	if(header.VertexFormat != FormatPosNormal || header.VertexStride != sizeof(Vertex))
+		return Fail(error, "unsupported vertex format");
+	if(header.IndexCount % 3 != 0)
+		return Fail(error, "index count is not a multiple of 3");
+	if(header.VertexOffset % BlobAlignment != 0 || header.IndexOffset % BlobAlignment != 0)
+		return Fail(error, "misaligned blob offset");
+
+	// Sizes are computed in 64 bits from 32-bit counts, so they cannot overflow.
+	uint64_t vertexBytes = uint64_t(header.VertexCount) * header.VertexStride;
+	uint64_t indexBytes = uint64_t(header.IndexCount) * sizeof(uint32_t);
+	if(header.VertexOffset < sizeof(MeshFileHeader) || header.VertexOffset > size || vertexBytes > size - header.VertexOffset)
+		return Fail(error, "vertex blob out of bounds");
+	if(header.IndexOffset < sizeof(MeshFileHeader) || header.IndexOffset > size || indexBytes > size - header.IndexOffset)
+		return Fail(error, "index blob out of bounds");
+
+	const uint32_t* indices = reinterpret_cast<const uint32_t*>(data + header.IndexOffset);
+	for(uint32_t i = 0; i < header.IndexCount; ++i)
+	{
+		if(indices[i] >= header.VertexCount)
+			return Fail(error, "index out of range");
+	}
+
+	mHeader = header;
+	mVertices = reinterpret_cast<const Vertex*>(data + header.VertexOffset);
+	mIndices = indices;
+	return true;
+}
+
+bool MeshFile::ParseText(const char* text, size_t size, MeshData& mesh, std::string* error)
+{
+	mesh.Vertices.clear();
+	mesh.Indices.clear();
+
+	TextCursor cursor(text, size);
+
+	uint32_t vertexCount = 0;
+	uint32_t triangleCount = 0;
+	if(!cursor.Expect("VertexCount:") || !cursor.ParseUInt(vertexCount))
+		return Fail(error, "expected VertexCount");
+	if(!cursor.Expect("TriangleCount:") || !cursor.ParseUInt(triangleCount))
+		return Fail(error, "expected TriangleCount");
+	if(triangleCount > 0xFFFFFFFFu / 3)
+		return Fail(error, "too many triangles");
+
+	// Each vertex takes at least 12 bytes of text and each triangle 6, which bounds
+	// the allocation below by the input size.
+	if(uint64_t(vertexCount)*12 > size || uint64_t(triangleCount)*6 > size)
+		return Fail(error, "counts exceed file size");
+
+	if(!cursor.Expect("VertexList") || !cursor.SkipPast('{'))
+		return Fail(error, "expected VertexList");
+
+	mesh.Vertices.resize(vertexCount);
+	for(uint32_t i = 0; i < vertexCount; ++i)
+	{
+		Vertex& v = mesh.Vertices[i];
+		if(!cursor.ParseFloat(v.Position[0]) || !cursor.ParseFloat(v.Position[1]) || !cursor.ParseFloat(v.Position[2]) ||
+		   !cursor.ParseFloat(v.Normal[0]) || !cursor.ParseFloat(v.Normal[1]) || !cursor.ParseFloat(v.Normal[2]))
+			return Fail(error, "bad vertex");
+	}
+
+	if(!cursor.Expect("}") || !cursor.Expect("TriangleList") || !cursor.Expect("{"))
+		return Fail(error, "expected TriangleList");
+
+	mesh.Indices.resize(size_t(triangleCount)*3);
+	for(size_t i = 0; i < mesh.Indices.size(); ++i)
+	{
+		if(!cursor.ParseUInt(mesh.Indices[i]))
+			return Fail(error, "bad index");
+		if(mesh.Indices[i] >= vertexCount)
+			return Fail(error, "index out of range");
+	}
+
+	if(!cursor.Expect("}"))
+		return Fail(error, "expected end of TriangleList");
+
+	return true;
+}
+
+bool MeshFile::LoadText(const char* path, MeshData& mesh, std::string* error)
+{
+	MappedFile file;
+	if(!file.Open(path))
+		return Fail(error, "cannot open file");
+
+	return ParseText(reinterpret_cast<const char*>(file.Data()), file.Size(), mesh, error);
+}
+
+bool MeshFile::Write(const char* path, const MeshData& mesh, std::string* error)
+{
+	if(mesh.Indices.size() % 3 != 0)
+		return Fail(error, "index count is not a multiple of 3");
+
+	MeshFileHeader header;
+	std::memset(&header, 0, sizeof(header));
+	header.Magic = Magic;
+	header.Version = Version;
+	header.VertexFormat = FormatPosNormal;
+	header.VertexStride = sizeof(Vertex);
+	header.VertexCount = uint32_t(mesh.Vertices.size());
+	header.IndexCount = uint32_t(mesh.Indices.size());
+
+	size_t vertexBytes = mesh.Vertices.size()*sizeof(Vertex);
+	size_t indexBytes = mesh.Indices.size()*sizeof(uint32_t);
+	header.VertexOffset = AlignUp(sizeof(MeshFileHeader), BlobAlignment);
+	header.IndexOffset = AlignUp(size_t(header.VertexOffset) + vertexBytes, BlobAlignment);
+
+	for(int c = 0; c < 3; ++c)
+	{
+		header.BoundsMin[c] = mesh.Vertices.empty() ? 0.0f : FLT_MAX;
+		header.BoundsMax[c] = mesh.Vertices.empty() ? 0.0f : -FLT_MAX;
+	}
+	for(size_t i = 0; i < mesh.Vertices.size(); ++i)
+	{
+		for(int c = 0; c < 3; ++c)
+		{
+			float p = mesh.Vertices[i].Position[c];
+			header.BoundsMin[c] = p < header.BoundsMin[c] ? p : header.BoundsMin[c];
+			header.BoundsMax[c] = p > header.BoundsMax[c] ? p : header.BoundsMax[c];
+		}
+	}
+
+	FILE* file = std::fopen(path, "wb");
+	if(!file)
+		return Fail(error, "cannot create file");
+
+	static const uint8_t padding[BlobAlignment] = { 0 };
+	size_t vertexPad = size_t(header.VertexOffset) - sizeof(MeshFileHeader);
+	size_t indexPad = size_t(header.IndexOffset) - size_t(header.VertexOffset) - vertexBytes;
+
+	bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1;
+	ok = ok && (vertexPad == 0 || std::fwrite(padding, vertexPad, 1, file) == 1);
+	ok = ok && (vertexBytes == 0 || std::fwrite(mesh.Vertices.data(), vertexBytes, 1, file) == 1);
+	ok = ok && (indexPad == 0 || std::fwrite(padding, indexPad, 1, file) == 1);
+	ok = ok && (indexBytes == 0 || std::fwrite(mesh.Indices.data(), indexBytes, 1, file) == 1);
+	ok = (std::fclose(file) == 0) && ok;
+
+	return ok ? true : Fail(error, "write failed");
+}
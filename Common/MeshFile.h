@@ -0,0 +1,95 @@
+#ifndef MESHFILE_H
+#define MESHFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "MappedFile.h"
+
+//---------------------------------------------------------------------------------------
+// Binary mesh container (.mesh), little endian:
+//
+//   MeshFileHeader   64 bytes at offset 0
+//   vertices         VertexCount * VertexStride bytes at VertexOffset
+//   indices          IndexCount 32-bit indices at IndexOffset
+//
+// Both blobs start on a 16-byte boundary, so a mapped file can be handed straight to
+// a buffer upload without copying or unpacking.
+//---------------------------------------------------------------------------------------
+
+struct MeshFileHeader
+{
+	uint32_t Magic;
+	uint32_t Version;
+	uint32_t VertexFormat;
+	uint32_t VertexStride;
+	uint32_t VertexCount;
+	uint32_t IndexCount;
+	uint64_t VertexOffset;
+	uint64_t IndexOffset;
+	float BoundsMin[3];
+	float BoundsMax[3];
+};
+
+///<summary>
+/// Loads and writes .mesh files, and parses the text models in Models/*.txt
+/// ("VertexCount:", "TriangleCount:", "VertexList (pos, normal)" then "TriangleList").
+/// A loaded MeshFile keeps the file mapped; Vertices() and Indices() point into the
+/// mapping and stay valid until the next Load or destruction.
+///</summary>
+class MeshFile
+{
+public:
+	static const uint32_t Magic = 0x48534D54; // "TMSH"
+	static const uint32_t Version = 1;
+	static const uint32_t BlobAlignment = 16;
+
+	enum VertexFormat
+	{
+		FormatPosNormal = 1,
+	};
+
+	// FormatPosNormal vertex; same layout as the text files' vertex lines.
+	struct Vertex
+	{
+		float Position[3];
+		float Normal[3];
+	};
+
+	struct MeshData
+	{
+		std::vector<Vertex> Vertices;
+		std::vector<uint32_t> Indices;
+	};
+
+	MeshFile();
+
+	// Maps a .mesh file and validates its header, blob bounds and indices.
+	bool Load(const char* path, std::string* error = 0);
+
+	// Validates a .mesh image already in memory.  data must be 4-byte aligned and
+	// outlive the MeshFile.
+	bool LoadFromMemory(const uint8_t* data, size_t size, std::string* error = 0);
+
+	const MeshFileHeader& Header()const { return mHeader; }
+	const Vertex* Vertices()const { return mVertices; }
+	const uint32_t* Indices()const { return mIndices; }
+	uint32_t VertexCount()const { return mHeader.VertexCount; }
+	uint32_t IndexCount()const { return mHeader.IndexCount; }
+
+	// Parses a text model.  text need not be null terminated.
+	static bool ParseText(const char* text, size_t size, MeshData& mesh, std::string* error = 0);
+	static bool LoadText(const char* path, MeshData& mesh, std::string* error = 0);
+
+	static bool Write(const char* path, const MeshData& mesh, std::string* error = 0);
+
+private:
+	MappedFile mFile;
+	MeshFileHeader mHeader;
+	const Vertex* mVertices;
+	const uint32_t* mIndices;
+};
+
+#endif // MESHFILE_H
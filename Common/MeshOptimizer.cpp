@@ -0,0 +1,413 @@
+#include "MeshOptimizer.h"
+#include "VecMath.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+const uint32_t MeshOptimizer::DefaultCacheSize;
+const uint32_t MeshOptimizer::InvalidIndex;
+const float MeshOptimizer::DefaultOverdrawThreshold = 1.05f;
+
+namespace
+{
+	//---------------------------------------------------------------------------------------
+	// Forsyth scoring.  See "Linear-Speed Vertex Cache Optimisation", Tom Forsyth, 2006.
+	//---------------------------------------------------------------------------------------
+
+	const int   ForsythCacheSize      = 32;
+	const float ForsythCacheDecay     = 1.5f;
+	const float ForsythLastTriScore   = 0.75f;
+	const float ForsythValenceScale   = 2.0f;
+	const float ForsythValencePower   = 0.5f;
+	const int   ForsythMaxValence     = 64;
+
+	struct ForsythScoreTables
+	{
+		ForsythScoreTables()
+		{
+			for(int i = 0; i < ForsythCacheSize; ++i)
+			{
+				if(i < 3)
+				{
+					// The last triangle's vertices get a fixed score so the algorithm does
+					// not favour reusing them straight away (they may be in a strip already).
+					Cache[i] = ForsythLastTriScore;
+				}
+				else
+				{
+					float scale = 1.0f / (ForsythCacheSize - 3);
+					Cache[i] = std::pow(1.0f - (i - 3)*scale, ForsythCacheDecay);
+				}
+			}
+
+			Valence[0] = 0.0f;
+			for(int i = 1; i <= ForsythMaxValence; ++i)
+				Valence[i] = ForsythValenceScale * std::pow(float(i), -ForsythValencePower);
+		}
+
+		float Cache[ForsythCacheSize];
+		float Valence[ForsythMaxValence + 1];
+	};
+
+	const ForsythScoreTables& ScoreTables()
+	{
+		static const ForsythScoreTables tables;
+		return tables;
+	}
+
+	float VertexScore(int cachePosition, uint32_t remainingValence)
+	{
+		// Vertices with no triangles left to draw are never worth anything.
+		if(remainingValence == 0)
+			return -1.0f;
+
+		const ForsythScoreTables& tables = ScoreTables();
+		float score = cachePosition >= 0 ? tables.Cache[cachePosition] : 0.0f;
+		score += tables.Valence[std::min<uint32_t>(remainingValence, ForsythMaxValence)];
+		return score;
+	}
+
+	struct Cluster
+	{
+		size_t FirstTriangle;
+		size_t TriangleCount;
+		float SortKey;
+	};
+}
+
+MeshOptimizer::CacheStats MeshOptimizer::AnalyzeVertexCache(const uint32_t* indices, size_t indexCount,
+	size_t vertexCount, uint32_t cacheSize)
+{
+	CacheStats stats;
+
+	size_t triangleCount = indexCount / 3;
+	if(triangleCount == 0 || vertexCount == 0)
+		return stats;
+
+	// timestamps[v] is the transform count when v entered the FIFO; v is still cached
+	// while fewer than cacheSize other vertices have been transformed since.
+	std::vector<uint32_t> timestamps(vertexCount, 0);
+	std::vector<unsigned char> referenced(vertexCount, 0);
+	uint32_t transforms = 0;
+
+	for(size_t i = 0; i < triangleCount*3; ++i)
+	{
+		uint32_t v = indices[i];
+		referenced[v] = 1;
+
+		if(timestamps[v] == 0 || transforms - timestamps[v] + 1 > cacheSize)
+		{
+			++transforms;
+			timestamps[v] = transforms;
+		}
+	}
+
+	size_t uniqueVertices = 0;
+	for(size_t v = 0; v < vertexCount; ++v)
+		uniqueVertices += referenced[v];
+
+	stats.Transforms = transforms;
+	stats.ACMR = float(transforms) / float(triangleCount);
+	stats.ATVR = uniqueVertices ? float(transforms) / float(uniqueVertices) : 0.0f;
+	return stats;
+}
+
+void MeshOptimizer::OptimizeVertexCache(uint32_t* dst, const uint32_t* indices, size_t indexCount, size_t vertexCount)
+{
+	size_t triangleCount = indexCount / 3;
+	if(triangleCount == 0)
+		return;
+
+	// dst may alias indices.
+	std::vector<uint32_t> source(indices, indices + triangleCount*3);
+
+	//
+	// Vertex to triangle adjacency, stored as one flat array with per-vertex offsets.
+	//
+
+	std::vector<uint32_t> valence(vertexCount, 0);
+	for(size_t i = 0; i < triangleCount*3; ++i)
+		++valence[source[i]];
+
+	std::vector<uint32_t> adjacencyOffset(vertexCount + 1, 0);
+	for(size_t v = 0; v < vertexCount; ++v)
+		adjacencyOffset[v + 1] = adjacencyOffset[v] + valence[v];
+
+	std::vector<uint32_t> adjacency(triangleCount*3);
+	std::vector<uint32_t> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+	for(size_t t = 0; t < triangleCount; ++t)
+	{
+		for(int k = 0; k < 3; ++k)
+		{
+			uint32_t v = source[t*3 + k];
+			adjacency[fill[v]++] = uint32_t(t);
+		}
+	}
+
+	// valence is reused as the live count of each vertex's not-yet-emitted triangles;
+	// the first valence[v] entries of its adjacency range are the live ones.
+
+	std::vector<float> vertexScore(vertexCount);
+	for(size_t v = 0; v < vertexCount; ++v)
+		vertexScore[v] = VertexScore(-1, valence[v]);
+
+	std::vector<float> triangleScore(triangleCount);
+	for(size_t t = 0; t < triangleCount; ++t)
+	{
+		triangleScore[t] = vertexScore[source[t*3 + 0]] +
+		                   vertexScore[source[t*3 + 1]] +
+		                   vertexScore[source[t*3 + 2]];
+	}
+
+	std::vector<unsigned char> emitted(triangleCount, 0);
+
+	// LRU cache of vertex indices, most recent first.  Three extra slots hold the
+	// vertices pushed out when a new triangle is added.
+	uint32_t cache[ForsythCacheSize + 3];
+	uint32_t newCache[ForsythCacheSize + 3];
+	int cacheCount = 0;
+
+	size_t outputTriangle = 0;
+	size_t inputCursor = 0;
+
+	int bestTriangle = -1;
+
+	while(outputTriangle < triangleCount)
+	{
+		// With nothing useful in the cache, fall back to the next unemitted triangle in
+		// input order.  The cursor only moves forward, keeping this linear overall.
+		if(bestTriangle < 0)
+		{
+			while(inputCursor < triangleCount && emitted[inputCursor])
+				++inputCursor;
+			bestTriangle = int(inputCursor);
+		}
+
+		const uint32_t* tri = &source[size_t(bestTriangle)*3];
+		dst[outputTriangle*3 + 0] = tri[0];
+		dst[outputTriangle*3 + 1] = tri[1];
+		dst[outputTriangle*3 + 2] = tri[2];
+		++outputTriangle;
+		emitted[bestTriangle] = 1;
+
+		// Drop the triangle from its vertices' live adjacency.
+		for(int k = 0; k < 3; ++k)
+		{
+			uint32_t v = tri[k];
+			uint32_t* list = &adjacency[adjacencyOffset[v]];
+			uint32_t count = valence[v];
+			for(uint32_t i = 0; i < count; ++i)
+			{
+				if(list[i] == uint32_t(bestTriangle))
+				{
+					list[i] = list[count - 1];
+					break;
+				}
+			}
+			--valence[v];
+		}
+
+		// New cache: the triangle's vertices at the front, followed by the previous
+		// contents minus those vertices.
+		int newCount = 0;
+		newCache[newCount++] = tri[0];
+		newCache[newCount++] = tri[1];
+		newCache[newCount++] = tri[2];
+		for(int i = 0; i < cacheCount; ++i)
+		{
+			uint32_t v = cache[i];
+			if(v != tri[0] && v != tri[1] && v != tri[2])
+				newCache[newCount++] = v;
+		}
+
+		// Rescore every vertex that was or is in the cache; evicted ones fall back to
+		// their valence score.
+		for(int i = 0; i < newCount; ++i)
+		{
+			uint32_t v = newCache[i];
+			int position = i < ForsythCacheSize ? i : -1;
+			float score = VertexScore(position, valence[v]);
+			float delta = score - vertexScore[v];
+			vertexScore[v] = score;
+
+			const uint32_t* list = &adjacency[adjacencyOffset[v]];
+			for(uint32_t j = 0; j < valence[v]; ++j)
+				triangleScore[list[j]] += delta;
+		}
+
+		cacheCount = std::min(newCount, ForsythCacheSize);
+		std::memcpy(cache, newCache, cacheCount*sizeof(uint32_t));
+
+		// Next triangle: the best-scoring live triangle touching the cache.
+		bestTriangle = -1;
+		float bestScore = 0.0f;
+		for(int i = 0; i < cacheCount; ++i)
+		{
+			uint32_t v = cache[i];
+			const uint32_t* list = &adjacency[adjacencyOffset[v]];
+			for(uint32_t j = 0; j < valence[v]; ++j)
+			{
+				uint32_t t = list[j];
+				if(triangleScore[t] > bestScore)
+				{
+					bestScore = triangleScore[t];
+					bestTriangle = int(t);
+				}
+			}
+		}
+	}
+}
+
+void MeshOptimizer::OptimizeOverdraw(uint32_t* indices, size_t indexCount,
+	const float* positions, size_t positionStride, size_t vertexCount, float threshold)
+{
+	size_t triangleCount = indexCount / 3;
+	if(triangleCount < 2)
+		return;
+
+	const unsigned char* base = reinterpret_cast<const unsigned char*>(positions);
+	auto position = [base, positionStride](uint32_t v)
+	{
+		const float* p = reinterpret_cast<const float*>(base + v*positionStride);
+		return Vec3(p[0], p[1], p[2]);
+	};
+
+	CacheStats before = AnalyzeVertexCache(indices, indexCount, vertexCount);
+
+	//
+	// Split into clusters at every triangle that misses the cache on all three
+	// vertices; those are the points where the cache order starts over, so moving
+	// whole clusters around costs little extra transform work.
+	//
+
+	std::vector<Cluster> clusters;
+	{
+		std::vector<uint32_t> timestamps(vertexCount, 0);
+		uint32_t transforms = 0;
+
+		for(size_t t = 0; t < triangleCount; ++t)
+		{
+			int misses = 0;
+			for(int k = 0; k < 3; ++k)
+			{
+				uint32_t v = indices[t*3 + k];
+				if(timestamps[v] == 0 || transforms - timestamps[v] + 1 > DefaultCacheSize)
+				{
+					++transforms;
+					timestamps[v] = transforms;
+					++misses;
+				}
+			}
+
+			if(misses == 3 || clusters.empty())
+			{
+				Cluster c = { t, 0, 0.0f };
+				clusters.push_back(c);
+			}
+			++clusters.back().TriangleCount;
+		}
+	}
+
+	if(clusters.size() < 2)
+		return;
+
+	//
+	// Sort key: how far the cluster sits out along its own average normal, measured
+	// from the mesh centroid.  Clusters on the outer hull draw first and occlude the
+	// rest.  Front faces follow this repo's convention, normal = (p1-p0) x (p2-p0).
+	//
+
+	Vec3 meshCentroid;
+	float meshArea = 0.0f;
+	for(size_t t = 0; t < triangleCount; ++t)
+	{
+		Vec3 p0 = position(indices[t*3 + 0]);
+		Vec3 p1 = position(indices[t*3 + 1]);
+		Vec3 p2 = position(indices[t*3 + 2]);
+		float area = Length(Cross(p1 - p0, p2 - p0));
+		meshCentroid += (p0 + p1 + p2) * (area / 3.0f);
+		meshArea += area;
+	}
+	if(meshArea > 0.0f)
+		meshCentroid *= 1.0f / meshArea;
+
+	for(size_t c = 0; c < clusters.size(); ++c)
+	{
+		Cluster& cluster = clusters[c];
+
+		Vec3 centroid;
+		Vec3 normal;
+		float area = 0.0f;
+		for(size_t t = cluster.FirstTriangle; t < cluster.FirstTriangle + cluster.TriangleCount; ++t)
+		{
+			Vec3 p0 = position(indices[t*3 + 0]);
+			Vec3 p1 = position(indices[t*3 + 1]);
+			Vec3 p2 = position(indices[t*3 + 2]);
+			Vec3 n = Cross(p1 - p0, p2 - p0);
+			float a = Length(n);
+			centroid += (p0 + p1 + p2) * (a / 3.0f);
+			normal += n;
+			area += a;
+		}
+		if(area > 0.0f)
+			centroid *= 1.0f / area;
+
+		cluster.SortKey = Dot(centroid - meshCentroid, Normalize(normal));
+	}
+
+	std::stable_sort(clusters.begin(), clusters.end(),
+		[](const Cluster& a, const Cluster& b) { return a.SortKey > b.SortKey; });
+
+	std::vector<uint32_t> sorted;
+	sorted.reserve(triangleCount*3);
+	for(size_t c = 0; c < clusters.size(); ++c)
+	{
+		const uint32_t* first = indices + clusters[c].FirstTriangle*3;
+		sorted.insert(sorted.end(), first, first + clusters[c].TriangleCount*3);
+	}
+
+	CacheStats after = AnalyzeVertexCache(sorted.data(), sorted.size(), vertexCount);
+	if(after.ACMR > before.ACMR * threshold)
+		return;
+
+	std::copy(sorted.begin(), sorted.end(), indices);
+}
+
+size_t MeshOptimizer::OptimizeVertexFetchRemap(uint32_t* remap, const uint32_t* indices, size_t indexCount, size_t vertexCount)
+{
+	std::fill(remap, remap + vertexCount, InvalidIndex);
+
+	uint32_t next = 0;
+	for(size_t i = 0; i < indexCount; ++i)
+	{
+		uint32_t v = indices[i];
+		if(remap[v] == InvalidIndex)
+			remap[v] = next++;
+	}
+
+	return next;
+}
+
+void MeshOptimizer::RemapIndices(uint32_t* indices, size_t indexCount, const uint32_t* remap)
+{
+	for(size_t i = 0; i < indexCount; ++i)
+		indices[i] = remap[indices[i]];
+}
+
+MeshOptimizer::Report MeshOptimizer::Optimize(std::vector<uint32_t>& indices, size_t vertexCount,
+	const float* positions, size_t positionStride, std::vector<uint32_t>& remap)
+{
+	Report report;
+	report.Before = AnalyzeVertexCache(indices.data(), indices.size(), vertexCount);
+
+	OptimizeVertexCache(indices.data(), indices.data(), indices.size(), vertexCount);
+	OptimizeOverdraw(indices.data(), indices.size(), positions, positionStride, vertexCount);
+
+	remap.resize(vertexCount);
+	size_t newVertexCount = OptimizeVertexFetchRemap(remap.data(), indices.data(), indices.size(), vertexCount);
+	RemapIndices(indices.data(), indices.size(), remap.data());
+
+	report.After = AnalyzeVertexCache(indices.data(), indices.size(), newVertexCount);
+	return report;
+}
@@ -0,0 +1,83 @@
+#ifndef MESHOPTIMIZER_H
+#define MESHOPTIMIZER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+///<summary>
+/// Index and vertex reordering for indexed triangle lists:
+///   - vertex cache optimization (Forsyth's linear-speed algorithm, LRU cache model),
+///   - overdraw reordering of cache-coherent triangle clusters (Sander et al.),
+///   - vertex fetch reordering so vertices are stored in first-use order.
+/// Everything runs on the CPU and has no graphics API dependency, so the before/after
+/// metrics can be computed in tools and tests without a device.
+///</summary>
+class MeshOptimizer
+{
+public:
+	// Post-transform cache statistics from a FIFO cache simulation.
+	struct CacheStats
+	{
+		CacheStats() : ACMR(0.0f), ATVR(0.0f), Transforms(0) {}
+
+		float ACMR;          // Average cache miss ratio: transforms per triangle (0.5 ideal, 3 worst).
+		float ATVR;          // Average transform to vertex ratio: transforms per referenced vertex (1 ideal).
+		uint32_t Transforms; // Vertex shader invocations.
+	};
+
+	struct Report
+	{
+		CacheStats Before;
+		CacheStats After;
+	};
+
+	// Size of the FIFO cache used for reporting.  Matches the post-transform cache of
+	// most D3D11-class hardware closely enough for comparing orderings.
+	static const uint32_t DefaultCacheSize = 16;
+
+	// Default overdraw threshold: the overdraw pass may raise ACMR by at most 5%.
+	static const float DefaultOverdrawThreshold;
+
+	static CacheStats AnalyzeVertexCache(const uint32_t* indices, size_t indexCount,
+		size_t vertexCount, uint32_t cacheSize = DefaultCacheSize);
+
+	// Writes a cache-friendly triangle order of indices to dst.  dst may equal indices.
+	static void OptimizeVertexCache(uint32_t* dst, const uint32_t* indices, size_t indexCount, size_t vertexCount);
+
+	// Reorders triangles of a cache-optimized list to draw outward-facing clusters
+	// first, reducing overdraw.  positions is a strided array of float3.  Falls back to
+	// the input order if the result would raise ACMR by more than the threshold.
+	static void OptimizeOverdraw(uint32_t* indices, size_t indexCount,
+		const float* positions, size_t positionStride, size_t vertexCount,
+		float threshold = DefaultOverdrawThreshold);
+
+	// Builds remap[old] = new so vertices are numbered in the order the index list first
+	// uses them.  Unreferenced vertices get InvalidIndex.  Returns the new vertex count.
+	static size_t OptimizeVertexFetchRemap(uint32_t* remap, const uint32_t* indices, size_t indexCount, size_t vertexCount);
+
+	static void RemapIndices(uint32_t* indices, size_t indexCount, const uint32_t* remap);
+
+	// Reorders a vertex attribute array with a remap from OptimizeVertexFetchRemap.
+	template<typename T>
+	static void RemapVertices(std::vector<T>& vertices, const uint32_t* remap, size_t newVertexCount)
+	{
+		std::vector<T> result(newVertexCount);
+		for(size_t i = 0; i < vertices.size(); ++i)
+		{
+			if(remap[i] != InvalidIndex)
+				result[remap[i]] = vertices[i];
+		}
+		vertices.swap(result);
+	}
+
+	// Runs the cache, overdraw and fetch passes on indices and fills remap with the
+	// vertex permutation the caller must apply to every vertex stream (RemapVertices).
+	// Returns the ACMR/ATVR statistics before and after.
+	static Report Optimize(std::vector<uint32_t>& indices, size_t vertexCount,
+		const float* positions, size_t positionStride, std::vector<uint32_t>& remap);
+
+	static const uint32_t InvalidIndex = ~0u;
+};
+
+#endif // MESHOPTIMIZER_H
@@ -0,0 +1,394 @@
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	const uint32_t NoVertex = 0xffffffff;
+}
+
+MeshSimplifier::Settings::Settings()
+	: TargetTriangles(0), MaxError(0.0f)
+{
+}
+
+MeshSimplifier::Report::Report()
+	: TrianglesBefore(0), TrianglesAfter(0), VerticesBefore(0), VerticesAfter(0), LockedVertices(0), Error(0.0f)
+{
+}
+
+MeshSimplifier::Quadric::Quadric()
+{
+	std::fill(m, m + 10, 0.0);
+}
+
+void MeshSimplifier::Quadric::AddPlane(double a, double b, double c, double d)
+{
+	m[0] += a*a; m[1] += a*b; m[2] += a*c; m[3] += a*d;
+	m[4] += b*b; m[5] += b*c; m[6] += b*d;
+	m[7] += c*c; m[8] += c*d;
+	m[9] += d*d;
+}
+
+MeshSimplifier::Quadric& MeshSimplifier::Quadric::operator+=(const Quadric& q)
+{
+	for(int i = 0; i < 10; ++i)
+		m[i] += q.m[i];
+	return *this;
+}
+
+double MeshSimplifier::Quadric::Error(const Vec3& p)const
+{
+	// Sum of squared distances from p to every plane added.
+	double x = p.x, y = p.y, z = p.z;
+	double e = m[0]*x*x + 2.0*m[1]*x*y + 2.0*m[2]*x*z + 2.0*m[3]*x
+	         + m[4]*y*y + 2.0*m[5]*y*z + 2.0*m[6]*y
+	         + m[7]*z*z + 2.0*m[8]*z
+	         + m[9];
+	return (std::max)(e, 0.0);
+}
+
+MeshSimplifier::Report MeshSimplifier::Simplify(const TerrainChunkMesh& source, const uint32_t* indices, size_t indexCount,
+	const Settings& settings, TerrainChunkMesh& out)
+{
+	Report report;
+
+	// Number the vertices the triangles use and drop triangles that are already degenerate.
+	mRemap.assign(source.Positions.size(), NoVertex);
+	mPositions.clear();
+	mNormals.clear();
+	mTriangles.clear();
+	for(size_t i = 0; i + 2 < indexCount; i += 3)
+	{
+		if(indices[i] == indices[i + 1] || indices[i + 1] == indices[i + 2] || indices[i + 2] == indices[i])
+			continue;
+		for(int k = 0; k < 3; ++k)
+		{
+			uint32_t v = indices[i + k];
+			if(mRemap[v] == NoVertex)
+			{
+				mRemap[v] = (uint32_t)mPositions.size();
+				mPositions.push_back(source.Positions[v]);
+				mNormals.push_back(v < source.Normals.size() ? source.Normals[v] : Vec3());
+			}
+			mTriangles.push_back(mRemap[v]);
+		}
+	}
+
+	size_t vertexCount = mPositions.size();
+	size_t triangleCount = mTriangles.size() / 3;
+	report.TrianglesBefore = triangleCount;
+	report.VerticesBefore = vertexCount;
+
+	mQuadrics.assign(vertexCount, Quadric());
+	mVersion.assign(vertexCount, 0);
+	mLocked.assign(vertexCount, 0);
+	mVertexAlive.assign(vertexCount, 1);
+	mTriangleAlive.assign(triangleCount, 1);
+	mVertexTriangles.resize(vertexCount);
+	for(size_t v = 0; v < vertexCount; ++v)
+		mVertexTriangles[v].clear();
+
+	for(size_t t = 0; t < triangleCount; ++t)
+	{
+		const uint32_t* tri = &mTriangles[t*3];
+		for(int k = 0; k < 3; ++k)
+			mVertexTriangles[tri[k]].push_back((uint32_t)t);
+
+		// Unweighted planes, so a quadric's error is a sum of squared distances.
+		Vec3 n = Cross(mPositions[tri[1]] - mPositions[tri[0]], mPositions[tri[2]] - mPositions[tri[0]]);
+		if(LengthSq(n) <= 0.0f)
+			continue;
+		n = Normalize(n);
+		double d = -Dot(n, mPositions[tri[0]]);
+		Quadric plane;
+		plane.AddPlane(n.x, n.y, n.z, d);
+		for(int k = 0; k < 3; ++k)
+			mQuadrics[tri[k]] += plane;
+	}
+
+	LockBorders();
+	for(size_t v = 0; v < vertexCount; ++v)
+		report.LockedVertices += mLocked[v];
+
+	mHeap.clear();
+	for(size_t e = 0; e < mEdges.size(); ++e)
+	{
+		if(e > 0 && mEdges[e] == mEdges[e - 1])
+			continue;
+		PushCollapse((uint32_t)(mEdges[e] >> 32), (uint32_t)mEdges[e]);
+	}
+
+	// Cheapest collapse first until the budget is met or the cheapest is too costly.
+	double maxCost = (double)settings.MaxError*settings.MaxError;
+	double worst = 0.0;
+	while(!mHeap.empty() && (settings.TargetTriangles == 0 || triangleCount > settings.TargetTriangles))
+	{
+		std::pop_heap(mHeap.begin(), mHeap.end());
+		Collapse c = mHeap.back();
+		mHeap.pop_back();
+
+		if(c.Cost > maxCost)
+			break;
+		if(!CanCollapse(c))
+			continue;
+
+		triangleCount -= ApplyCollapse(c);
+		worst = (std::max)(worst, c.Cost);
+	}
+	report.Error = (float)std::sqrt(worst);
+
+	// Write the surviving triangles with their vertices in first-use order.
+	out.Clear();
+	mRemap.assign(vertexCount, NoVertex);
+	for(size_t t = 0; t < mTriangleAlive.size(); ++t)
+	{
+		if(!mTriangleAlive[t])
+			continue;
+		for(int k = 0; k < 3; ++k)
+		{
+			uint32_t v = mTriangles[t*3 + k];
+			if(mRemap[v] == NoVertex)
+			{
+				mRemap[v] = (uint32_t)out.Positions.size();
+				out.Positions.push_back(mPositions[v]);
+				out.Normals.push_back(mNormals[v]);
+				out.Bounds.Extend(mPositions[v]);
+			}
+			out.Indices.push_back(mRemap[v]);
+		}
+	}
+	report.TrianglesAfter = out.Indices.size() / 3;
+	report.VerticesAfter = out.Positions.size();
+	return report;
+}
+
+void MeshSimplifier::LockBorders()
+{
+	// Sorted undirected edges: one used once is open, one used more than twice is not
+	// manifold.  The sorted list also seeds the collapses.
+	mEdges.clear();
+	for(size_t t = 0; t < mTriangleAlive.size(); ++t)
+	{
+		const uint32_t* tri = &mTriangles[t*3];
+		for(int k = 0; k < 3; ++k)
+		{
+			uint32_t a = tri[k], b = tri[(k + 1) % 3];
+			mEdges.push_back((uint64_t)(std::min)(a, b) << 32 | (std::max)(a, b));
+		}
+	}
+	std::sort(mEdges.begin(), mEdges.end());
+
+	for(size_t begin = 0; begin < mEdges.size(); )
+	{
+		size_t end = begin + 1;
+		while(end < mEdges.size() && mEdges[end] == mEdges[begin])
+			++end;
+		if(end - begin != 2)
+		{
+			mLocked[(uint32_t)(mEdges[begin] >> 32)] = 1;
+			mLocked[(uint32_t)mEdges[begin]] = 1;
+		}
+		begin = end;
+	}
+}
+
+void MeshSimplifier::PushCollapse(uint32_t a, uint32_t b)
+{
+	if(mLocked[a] && mLocked[b])
+		return;
+
+	// A locked vertex stays where it is and the other one comes to it.
+	Collapse c;
+	if(mLocked[b])
+		std::swap(a, b);
+	c.Keep = a;
+	c.Remove = b;
+	c.KeepVersion = mVersion[a];
+	c.RemoveVersion = mVersion[b];
+
+	Quadric q = mQuadrics[a];
+	q += mQuadrics[b];
+
+	const Vec3& pa = mPositions[a];
+	const Vec3& pb = mPositions[b];
+	if(mLocked[a])
+	{
+		c.Position = pa;
+		c.Cost = q.Error(pa);
+	}
+	else
+	{
+		// The point of least error solves A p = -b, unless the planes are nearly
+		// parallel (flat or along a crease) and it runs off; then take the best of the
+		// ends and the middle.
+		const double* m = q.m;
+		double xx = m[0], xy = m[1], xz = m[2], yy = m[4], yz = m[5], zz = m[7];
+		double i00 = yy*zz - yz*yz, i01 = xz*yz - xy*zz, i02 = xy*yz - xz*yy;
+		double i11 = xx*zz - xz*xz, i12 = xy*xz - xx*yz, i22 = xx*yy - xy*xy;
+		double det = xx*i00 + xy*i01 + xz*i02;
+		double scale = (xx + yy + zz) / 3.0;
+		bool solved = false;
+		if(std::fabs(det) > 1e-6*scale*scale*scale)
+		{
+			double r0 = -m[3], r1 = -m[6], r2 = -m[8];
+			double x = (i00*r0 + i01*r1 + i02*r2) / det;
+			double y = (i01*r0 + i11*r1 + i12*r2) / det;
+			double z = (i02*r0 + i12*r1 + i22*r2) / det;
+			Vec3 p((float)x, (float)y, (float)z);
+			Vec3 mid = (pa + pb)*0.5f;
+			if(LengthSq(p - mid) <= LengthSq(pb - pa))
+			{
+				c.Position = p;
+				c.Cost = q.Error(p);
+				solved = true;
+			}
+		}
+		if(!solved)
+		{
+			const Vec3 candidates[3] = { pa, pb, (pa + pb)*0.5f };
+			c.Cost = -1.0;
+			for(int i = 0; i < 3; ++i)
+			{
+				double cost = q.Error(candidates[i]);
+				if(c.Cost < 0.0 || cost < c.Cost)
+				{
+					c.Cost = cost;
+					c.Position = candidates[i];
+				}
+			}
+		}
+	}
+
+	mHeap.push_back(c);
+	std::push_heap(mHeap.begin(), mHeap.end());
+}
+
+void MeshSimplifier::Neighbours(uint32_t vertex, std::vector<uint32_t>& out)const
+{
+	out.clear();
+	const std::vector<uint32_t>& triangles = mVertexTriangles[vertex];
+	for(size_t i = 0; i < triangles.size(); ++i)
+	{
+		if(!mTriangleAlive[triangles[i]])
+			continue;
+		const uint32_t* tri = &mTriangles[triangles[i]*3];
+		for(int k = 0; k < 3; ++k)
+		{
+			if(tri[k] != vertex)
+				out.push_back(tri[k]);
+		}
+	}
+	std::sort(out.begin(), out.end());
+	out.erase(std::unique(out.begin(), out.end()), out.end());
+}
+
+bool MeshSimplifier::CanCollapse(const Collapse& c)
+{
+	// Either end changed since the collapse was costed: it was requeued then.
+	if(!mVertexAlive[c.Keep] || !mVertexAlive[c.Remove] ||
+		mVersion[c.Keep] != c.KeepVersion || mVersion[c.Remove] != c.RemoveVersion)
+		return false;
+
+	// Link condition: the ends may only share the neighbours across the triangles on
+	// the edge, or the collapse pinches the surface into a non-manifold fin.
+	Neighbours(c.Keep, mNeighboursA);
+	Neighbours(c.Remove, mNeighboursB);
+	size_t shared = 0, edgeTriangles = 0;
+	for(size_t i = 0, j = 0; i < mNeighboursA.size() && j < mNeighboursB.size(); )
+	{
+		if(mNeighboursA[i] < mNeighboursB[j])
+			++i;
+		else if(mNeighboursB[j] < mNeighboursA[i])
+			++j;
+		else
+		{
+			++shared;
+			++i;
+			++j;
+		}
+	}
+	if(!std::binary_search(mNeighboursA.begin(), mNeighboursA.end(), c.Remove))
+		return false;
+
+	// No remaining triangle may flip or collapse to a line.
+	for(int end = 0; end < 2; ++end)
+	{
+		uint32_t moved = end == 0 ? c.Keep : c.Remove;
+		uint32_t other = end == 0 ? c.Remove : c.Keep;
+		const std::vector<uint32_t>& triangles = mVertexTriangles[moved];
+		for(size_t i = 0; i < triangles.size(); ++i)
+		{
+			if(!mTriangleAlive[triangles[i]])
+				continue;
+			const uint32_t* tri = &mTriangles[triangles[i]*3];
+			if(tri[0] == other || tri[1] == other || tri[2] == other)
+			{
+				if(end == 0)
+					++edgeTriangles;
+				continue;
+			}
+
+			Vec3 p[3] = { mPositions[tri[0]], mPositions[tri[1]], mPositions[tri[2]] };
+			Vec3 before = Cross(p[1] - p[0], p[2] - p[0]);
+			for(int k = 0; k < 3; ++k)
+			{
+				if(tri[k] == moved)
+					p[k] = c.Position;
+			}
+			Vec3 after = Cross(p[1] - p[0], p[2] - p[0]);
+			if(Dot(before, after) <= 0.0f || LengthSq(after) <= 1e-12f*LengthSq(before))
+				return false;
+		}
+	}
+	return shared == edgeTriangles;
+}
+
+size_t MeshSimplifier::ApplyCollapse(const Collapse& c)
+{
+	size_t removed = 0;
+	std::vector<uint32_t>& keepTriangles = mVertexTriangles[c.Keep];
+	const std::vector<uint32_t>& removeTriangles = mVertexTriangles[c.Remove];
+	for(size_t i = 0; i < removeTriangles.size(); ++i)
+	{
+		uint32_t t = removeTriangles[i];
+		if(!mTriangleAlive[t])
+			continue;
+		uint32_t* tri = &mTriangles[t*3];
+		if(tri[0] == c.Keep || tri[1] == c.Keep || tri[2] == c.Keep)
+		{
+			mTriangleAlive[t] = 0;
+			++removed;
+			continue;
+		}
+		for(int k = 0; k < 3; ++k)
+		{
+			if(tri[k] == c.Remove)
+				tri[k] = c.Keep;
+		}
+		keepTriangles.push_back(t);
+	}
+	keepTriangles.erase(std::remove_if(keepTriangles.begin(), keepTriangles.end(), [this](uint32_t t)
+	{
+		return !mTriangleAlive[t];
+	}), keepTriangles.end());
+
+	// Blend the normals by where the new position falls along the edge.
+	Vec3 edge = mPositions[c.Remove] - mPositions[c.Keep];
+	float along = LengthSq(edge) > 0.0f ? Dot(c.Position - mPositions[c.Keep], edge) / LengthSq(edge) : 0.0f;
+	along = (std::min)((std::max)(along, 0.0f), 1.0f);
+	Vec3 normal = mNormals[c.Keep]*(1.0f - along) + mNormals[c.Remove]*along;
+	if(LengthSq(normal) > 1e-12f)
+		mNormals[c.Keep] = Normalize(normal);
+
+	mPositions[c.Keep] = c.Position;
+	mQuadrics[c.Keep] += mQuadrics[c.Remove];
+	mVertexAlive[c.Remove] = 0;
+	++mVersion[c.Keep];
+
+	Neighbours(c.Keep, mNeighboursA);
+	for(size_t i = 0; i < mNeighboursA.size(); ++i)
+		PushCollapse(c.Keep, mNeighboursA[i]);
+	return removed;
+}
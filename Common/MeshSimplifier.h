@@ -0,0 +1,107 @@
+#ifndef MESHSIMPLIFIER_H
+#define MESHSIMPLIFIER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "TerrainMesher.h"
+#include "VecMath.h"
+
+///<summary>
+/// Quadric error metric decimation (Garland and Heckbert) of a chunk's triangles, for
+/// far terrain LODs.  Marching cubes emits triangles for every crossed cell however
+/// flat the surface is; collapsing edges in order of the squared distance they move
+/// the surface from its original planes removes most of them where it is flat and
+/// keeps them where it bends.
+///
+/// Every vertex on an open edge (one used by a single triangle) is locked, as are
+/// non-manifold ones.  A chunk cut out of a larger surface has open edges exactly
+/// where it meets its neighbours, so the border keeps every vertex and still matches
+/// a neighbour at any LOD.  An edge with a locked end collapses onto it; one with two
+/// never does.  A collapse that would flip a triangle or pinch the surface is skipped.
+///
+/// Simplify stops at a triangle budget or at the first collapse that would move the
+/// surface further than an error bound, whichever comes first.  A simplifier keeps its
+/// scratch memory between calls, so reuse one instance per worker thread.
+///</summary>
+class MeshSimplifier
+{
+public:
+	struct Settings
+	{
+		Settings();
+
+		// Stop at this many triangles or fewer; 0 for no budget.
+		size_t TargetTriangles;
+
+		// World units.  No collapse moves the surface further than this from the
+		// original triangles' planes; 0 only merges coplanar triangles.
+		float MaxError;
+	};
+
+	struct Report
+	{
+		Report();
+
+		size_t TrianglesBefore;
+		size_t TrianglesAfter;
+		size_t VerticesBefore;
+		size_t VerticesAfter;
+		size_t LockedVertices;
+		float Error;            // Largest error of any collapse made, in world units.
+	};
+
+	// Simplifies the triangles (three indices each) of source and writes them to out,
+	// with only the vertices they use.  Normals follow the surviving vertices.
+	Report Simplify(const TerrainChunkMesh& source, const uint32_t* indices, size_t indexCount,
+		const Settings& settings, TerrainChunkMesh& out);
+
+private:
+	// Symmetric 4x4 plane quadric: a2 ab ac ad b2 bc bd c2 cd d2.
+	struct Quadric
+	{
+		Quadric();
+
+		void AddPlane(double a, double b, double c, double d);
+		Quadric& operator+=(const Quadric& q);
+		double Error(const Vec3& p)const;
+
+		double m[10];
+	};
+
+	struct Collapse
+	{
+		double Cost;
+		uint32_t Keep;
+		uint32_t Remove;
+		uint32_t KeepVersion;
+		uint32_t RemoveVersion;
+		Vec3 Position;
+
+		bool operator<(const Collapse& rhs)const { return Cost > rhs.Cost; }
+	};
+
+	void LockBorders();
+	void PushCollapse(uint32_t a, uint32_t b);
+	bool CanCollapse(const Collapse& c);
+	size_t ApplyCollapse(const Collapse& c);   // Returns the triangles removed.
+	void Neighbours(uint32_t vertex, std::vector<uint32_t>& out)const;
+
+	std::vector<uint32_t> mRemap;
+	std::vector<Vec3> mPositions;
+	std::vector<Vec3> mNormals;
+	std::vector<Quadric> mQuadrics;
+	std::vector<uint32_t> mVersion;
+	std::vector<uint8_t> mLocked;
+	std::vector<uint8_t> mVertexAlive;
+	std::vector<uint32_t> mTriangles;
+	std::vector<uint8_t> mTriangleAlive;
+	std::vector<std::vector<uint32_t> > mVertexTriangles;
+	std::vector<Collapse> mHeap;
+	std::vector<uint64_t> mEdges;
+	std::vector<uint32_t> mNeighboursA;
+	std::vector<uint32_t> mNeighboursB;
+};
+
+#endif // MESHSIMPLIFIER_H
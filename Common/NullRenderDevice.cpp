@@ -0,0 +1,112 @@
+#include "NullRenderDevice.h"
+
+#include <cassert>
+
+NullDrawBackend::Stats::Stats()
+	: StateChanges(0), ConstantBytes(0), Draws(0), Instances(0), Primitives(0)
+{
+}
+
+void NullDrawBackend::SetPipeline(DrawHandle /*pipeline*/)
+{
+	++mStats.StateChanges;
+}
+
+void NullDrawBackend::SetInputLayout(DrawHandle /*layout*/)
+{
+	++mStats.StateChanges;
+}
+
+void NullDrawBackend::SetTopology(uint32_t /*topology*/)
+{
+	++mStats.StateChanges;
+}
+
+void NullDrawBackend::SetVertexBuffer(DrawHandle /*buffer*/, uint32_t /*stride*/)
+{
+	++mStats.StateChanges;
+}
+
+void NullDrawBackend::SetIndexBuffer(DrawHandle /*buffer*/)
+{
+	++mStats.StateChanges;
+}
+
+void NullDrawBackend::SetInstanceBuffer(DrawHandle /*buffer*/, uint32_t /*stride*/)
+{
+	++mStats.StateChanges;
+}
+
+void NullDrawBackend::SetConstants(uint32_t /*slot*/, uint32_t /*offset*/, const void* /*data*/, uint32_t size)
+{
+	mStats.ConstantBytes += size;
+}
+
+void NullDrawBackend::Draw(const DrawArgs& args, bool /*indexed*/)
+{
+	++mStats.Draws;
+	mStats.Instances += args.InstanceCount;
+	mStats.Primitives += (size_t)args.Count*args.InstanceCount;
+}
+
+NullTextureDevice::NullTextureDevice()
+	: mNext(0), mLive(0)
+{
+}
+
+void* NullTextureDevice::CreateTexture(const DDSCore::TextureDesc& /*desc*/, size_t /*topMip*/,
+	const DDSCore::Subresource* /*subresources*/)
+{
+	++mLive;
+	return reinterpret_cast<void*>(++mNext);
+}
+
+void NullTextureDevice::ReleaseTexture(void* texture)
+{
+	if(texture)
+	{
+		assert(mLive > 0);
+		--mLive;
+	}
+}
+
+NullRenderDevice::Stats::Stats()
+	: Frames(0), VertexBuffers(0), IndexBuffers(0), BufferBytes(0), WrittenBytes(0)
+{
+}
+
+NullRenderDevice::NullRenderDevice(int width, int height)
+	: mWidth(width), mHeight(height)
+{
+}
+
+DrawHandle NullRenderDevice::CreateVertexBuffer(const void* /*data*/, uint32_t bytes, bool dynamic)
+{
+	Buffer buffer = { bytes, dynamic };
+	mVertexBuffers.push_back(buffer);
+	++mStats.VertexBuffers;
+	mStats.BufferBytes += bytes;
+	return (DrawHandle)(mVertexBuffers.size() - 1);
+}
+
+DrawHandle NullRenderDevice::CreateIndexBuffer(const uint32_t* /*indices*/, uint32_t count)
+{
+	mStats.BufferBytes += (size_t)count*sizeof(uint32_t);
+	return (DrawHandle)mStats.IndexBuffers++;
+}
+
+void NullRenderDevice::WriteVertexBuffer(DrawHandle buffer, const void* /*data*/, uint32_t bytes)
+{
+	assert(buffer < mVertexBuffers.size());
+	assert(mVertexBuffers[buffer].Dynamic && bytes <= mVertexBuffers[buffer].Bytes);
+	mStats.WrittenBytes += bytes;
+}
+
+void NullRenderDevice::Clear(const float /*color*/[4])
+{
+}
+
+void NullRenderDevice::Present()
+{
+	++mStats.Frames;
+}
@@ -0,0 +1,114 @@
+#ifndef NULLRENDERDEVICE_H
+#define NULLRENDERDEVICE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "RenderDevice.h"
+
+///<summary>
+/// Draw backend that only counts what it is asked to do.  Unlike RecordingDrawBackend
+/// it keeps no per-call memory, so it can run for as many frames as a soak test needs.
+///</summary>
+class NullDrawBackend : public IDrawBackend
+{
+public:
+	struct Stats
+	{
+		Stats();
+
+		size_t StateChanges;
+		size_t ConstantBytes;
+		size_t Draws;
+		size_t Instances;
+		size_t Primitives;   // Index or vertex count times instance count.
+	};
+
+	void SetPipeline(DrawHandle pipeline);
+	void SetInputLayout(DrawHandle layout);
+	void SetTopology(uint32_t topology);
+	void SetVertexBuffer(DrawHandle buffer, uint32_t stride);
+	void SetIndexBuffer(DrawHandle buffer);
+	void SetInstanceBuffer(DrawHandle buffer, uint32_t stride);
+	void SetConstants(uint32_t slot, uint32_t offset, const void* data, uint32_t size);
+	void Draw(const DrawArgs& args, bool indexed);
+
+	const Stats& GetStats()const { return mStats; }
+	void ResetStats() { mStats = Stats(); }
+
+private:
+	Stats mStats;
+};
+
+///<summary>
+/// Texture device that hands out distinct non-null handles and tracks how many texels
+/// would be resident.
+///</summary>
+class NullTextureDevice : public ITextureDevice
+{
+public:
+	NullTextureDevice();
+
+	void* CreateTexture(const DDSCore::TextureDesc& desc, size_t topMip, const DDSCore::Subresource* subresources);
+	void ReleaseTexture(void* texture);
+
+	size_t LiveTextures()const { return mLive; }
+
+private:
+	uintptr_t mNext;
+	size_t mLive;
+};
+
+///<summary>
+/// IRenderDevice with no GPU behind it.  Buffers are kept as sizes only; writes are
+/// bounds checked and counted, which catches overflowing dynamic buffers headless.
+///</summary>
+class NullRenderDevice : public IRenderDevice
+{
+public:
+	struct Stats
+	{
+		Stats();
+
+		size_t Frames;
+		size_t VertexBuffers;
+		size_t IndexBuffers;
+		size_t BufferBytes;    // Allocated across all buffers.
+		size_t WrittenBytes;   // Through WriteVertexBuffer.
+	};
+
+	NullRenderDevice(int width = 1280, int height = 720);
+
+	int Width()const { return mWidth; }
+	int Height()const { return mHeight; }
+
+	DrawHandle CreateVertexBuffer(const void* data, uint32_t bytes, bool dynamic);
+	DrawHandle CreateIndexBuffer(const uint32_t* indices, uint32_t count);
+	void WriteVertexBuffer(DrawHandle buffer, const void* data, uint32_t bytes);
+
+	IDrawBackend& DrawBackend() { return mDrawBackend; }
+	ITextureDevice& TextureDevice() { return mTextureDevice; }
+
+	void Clear(const float color[4]);
+	void Present();
+
+	const Stats& GetStats()const { return mStats; }
+	const NullDrawBackend::Stats& GetDrawStats()const { return mDrawBackend.GetStats(); }
+
+private:
+	struct Buffer
+	{
+		uint32_t Bytes;
+		bool Dynamic;
+	};
+
+	int mWidth;
+	int mHeight;
+	std::vector<Buffer> mVertexBuffers;
+	NullDrawBackend mDrawBackend;
+	NullTextureDevice mTextureDevice;
+	Stats mStats;
+};
+
+#endif // NULLRENDERDEVICE_H
@@ -0,0 +1,458 @@
+#include "OcclusionBuffer.h"
+#include "ParallelFor.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OCCLUSIONBUFFER_SSE2
+#include <emmintrin.h>
+#endif
+
+// Tiles are rasterized by one thread each; blocks hold the coarse maximum depth.
+static const int TileWidth = 32;
+static const int TileHeight = 16;
+static const int BlockSize = 8;
+
+// Triangles per binning task; fewer are not worth a thread.
+static const size_t MinTrianglesPerTask = 2048;
+
+OcclusionBuffer::Stats::Stats()
+	: Occluders(0), Triangles(0), TrianglesBinned(0), BoxesTested(0), BoxesOccluded(0)
+{
+}
+
+OcclusionBuffer::OcclusionBuffer(int width, int height)
+	: mTrianglesPerBin(0), mBinsDone(0)
+{
+	mTilesX = (std::max(width, 1) + TileWidth - 1) / TileWidth;
+	mTilesY = (std::max(height, 1) + TileHeight - 1) / TileHeight;
+	mWidth = mTilesX*TileWidth;
+	mHeight = mTilesY*TileHeight;
+
+	mDepth.assign(size_t(mWidth)*mHeight, 1.0f);
+	mBlockMax.assign(size_t(mWidth / BlockSize)*(mHeight / BlockSize), 1.0f);
+	std::memset(mViewProj, 0, sizeof(mViewProj));
+}
+
+void OcclusionBuffer::Begin(const float viewProj[16])
+{
+	std::memcpy(mViewProj, viewProj, sizeof(mViewProj));
+	std::fill(mDepth.begin(), mDepth.end(), 1.0f);
+	std::fill(mBlockMax.begin(), mBlockMax.end(), 1.0f);
+	mOccluders.clear();
+	mStats = Stats();
+}
+
+void OcclusionBuffer::AddOccluder(const Vec3* positions, const uint32_t* indices, size_t indexCount)
+{
+	if(indexCount < 3)
+		return;
+
+	Occluder o = { positions, indices, indexCount - indexCount % 3 };
+	mOccluders.push_back(o);
+	++mStats.Occluders;
+	mStats.Triangles += o.IndexCount / 3;
+}
+
+//---------------------------------------------------------------------------------------
+// Setup and binning
+//---------------------------------------------------------------------------------------
+
+void OcclusionBuffer::Render()
+{
+	mTriangleStart.resize(mOccluders.size() + 1);
+	mTriangleStart[0] = 0;
+	for(size_t i = 0; i < mOccluders.size(); ++i)
+		mTriangleStart[i + 1] = mTriangleStart[i] + mOccluders[i].IndexCount / 3;
+	size_t triangleCount = mTriangleStart.back();
+
+	// One bin per task; each task sets up a contiguous run of triangles.
+	ParallelForPool& pool = ParallelForPool::Instance();
+	size_t taskCount = std::max<size_t>(1, std::min(pool.ThreadCount(), triangleCount / MinTrianglesPerTask));
+	mTrianglesPerBin = (triangleCount + taskCount - 1) / taskCount;
+	mBinsDone = 0;
+
+	mBins.resize(taskCount);
+	for(size_t b = 0; b < taskCount; ++b)
+	{
+		mBins[b].Triangles.clear();
+		mBins[b].TileTriangles.resize(size_t(mTilesX)*mTilesY);
+		for(size_t t = 0; t < mBins[b].TileTriangles.size(); ++t)
+			mBins[b].TileTriangles[t].clear();
+	}
+
+	// The bins, then the tiles, in one job.  Ranges are taken in order, so a thread
+	// waiting in a tile range only waits for bins other threads are already filling.
+	pool.Run(taskCount + size_t(mTilesX)*mTilesY, &OcclusionBuffer::RenderRange, this);
+
+	for(size_t b = 0; b < taskCount; ++b)
+		mStats.TrianglesBinned += mBins[b].Triangles.size();
+}
+
+void OcclusionBuffer::RenderRange(void* context, size_t range)
+{
+	OcclusionBuffer& buffer = *static_cast<OcclusionBuffer*>(context);
+	size_t binCount = buffer.mBins.size();
+	if(range < binCount)
+	{
+		size_t triangleCount = buffer.mTriangleStart.back();
+		size_t first = std::min(triangleCount, range*buffer.mTrianglesPerBin);
+		buffer.SetupTriangles(first, std::min(triangleCount, first + buffer.mTrianglesPerBin), buffer.mBins[range]);
+
+		std::lock_guard<std::mutex> lock(buffer.mBinMutex);
+		if(++buffer.mBinsDone == binCount)
+			buffer.mBinsFull.notify_all();
+		return;
+	}
+
+	{
+		std::unique_lock<std::mutex> lock(buffer.mBinMutex);
+		buffer.mBinsFull.wait(lock, [&buffer, binCount]() { return buffer.mBinsDone == binCount; });
+	}
+
+	// Tiles own disjoint pixels, so they rasterize without synchronization.
+	int tile = (int)(range - binCount);
+	buffer.RasterizeTile(tile);
+	buffer.UpdateBlockMax(tile);
+}
+
+void OcclusionBuffer::SetupTriangles(size_t first, size_t last, Bin& bin)const
+{
+	if(first >= last)
+		return;
+
+	const float* m = mViewProj;
+
+	// Find the occluder holding triangle 'first'.
+	size_t o = std::upper_bound(mTriangleStart.begin(), mTriangleStart.end(), first) - mTriangleStart.begin() - 1;
+
+	for(size_t t = first; t < last; ++t)
+	{
+		while(t >= mTriangleStart[o + 1])
+			++o;
+
+		const Occluder& occ = mOccluders[o];
+		const uint32_t* idx = occ.Indices + (t - mTriangleStart[o])*3;
+
+		float clip[3][4];
+		for(int v = 0; v < 3; ++v)
+		{
+			const Vec3& p = occ.Positions[idx[v]];
+			for(int c = 0; c < 4; ++c)
+				clip[v][c] = p.x*m[c] + p.y*m[4 + c] + p.z*m[8 + c] + m[12 + c];
+		}
+
+		// Trivially reject triangles entirely outside one clip plane.
+		bool outside = false;
+		for(int axis = 0; axis < 2 && !outside; ++axis)
+		{
+			outside = (clip[0][axis] > clip[0][3] && clip[1][axis] > clip[1][3] && clip[2][axis] > clip[2][3]) ||
+			          (clip[0][axis] < -clip[0][3] && clip[1][axis] < -clip[1][3] && clip[2][axis] < -clip[2][3]);
+		}
+		if(outside || (clip[0][2] > clip[0][3] && clip[1][2] > clip[1][3] && clip[2][2] > clip[2][3]))
+			continue;
+
+		int behind = (clip[0][2] < 0.0f) + (clip[1][2] < 0.0f) + (clip[2][2] < 0.0f);
+		if(behind == 3)
+			continue;
+		if(behind == 0)
+		{
+			EmitTriangle(clip, bin);
+			continue;
+		}
+
+		// Clip against the near plane (z = 0), which leaves a triangle or a quad.
+		float poly[4][4];
+		int n = 0;
+		for(int v = 0; v < 3; ++v)
+		{
+			const float* a = clip[v];
+			const float* b = clip[(v + 1) % 3];
+			if(a[2] >= 0.0f)
+				std::memcpy(poly[n++], a, sizeof(float)*4);
+			if((a[2] >= 0.0f) != (b[2] >= 0.0f))
+			{
+				float s = a[2] / (a[2] - b[2]);
+				for(int c = 0; c < 4; ++c)
+					poly[n][c] = a[c] + (b[c] - a[c])*s;
+				poly[n][2] = 0.0f;
+				++n;
+			}
+		}
+
+		for(int v = 1; v + 1 < n; ++v)
+		{
+			float tri[3][4];
+			std::memcpy(tri[0], poly[0], sizeof(tri[0]));
+			std::memcpy(tri[1], poly[v], sizeof(tri[1]));
+			std::memcpy(tri[2], poly[v + 1], sizeof(tri[2]));
+			EmitTriangle(tri, bin);
+		}
+	}
+}
+
+void OcclusionBuffer::EmitTriangle(const float clip[3][4], Bin& bin)const
+{
+	ScreenTriangle tri;
+	for(int v = 0; v < 3; ++v)
+	{
+		// Vertices on the near plane can have w = 0 only if the projection has no
+		// near distance; those triangles are dropped.
+		if(clip[v][3] <= 0.0f)
+			return;
+		float invW = 1.0f / clip[v][3];
+		tri.X[v] = (clip[v][0]*invW*0.5f + 0.5f)*mWidth;
+		tri.Y[v] = (0.5f - clip[v][1]*invW*0.5f)*mHeight;
+		tri.Z[v] = clip[v][2]*invW;
+	}
+
+	// Signed area; orientation does not matter for occlusion, so flip to positive.
+	float area = (tri.X[1] - tri.X[0])*(tri.Y[2] - tri.Y[0]) - (tri.Y[1] - tri.Y[0])*(tri.X[2] - tri.X[0]);
+	if(std::fabs(area) < 1e-6f)
+		return;
+	if(area < 0.0f)
+	{
+		std::swap(tri.X[1], tri.X[2]);
+		std::swap(tri.Y[1], tri.Y[2]);
+		std::swap(tri.Z[1], tri.Z[2]);
+	}
+
+	float minX = std::min(tri.X[0], std::min(tri.X[1], tri.X[2]));
+	float maxX = std::max(tri.X[0], std::max(tri.X[1], tri.X[2]));
+	float minY = std::min(tri.Y[0], std::min(tri.Y[1], tri.Y[2]));
+	float maxY = std::max(tri.Y[0], std::max(tri.Y[1], tri.Y[2]));
+	if(maxX < 0.0f || maxY < 0.0f || minX >= (float)mWidth || minY >= (float)mHeight)
+		return;
+
+	// Clamp before converting; vertices just past the near plane project far off screen.
+	tri.MinTileX = (int)std::max(0.0f, minX) / TileWidth;
+	tri.MinTileY = (int)std::max(0.0f, minY) / TileHeight;
+	tri.MaxTileX = (int)std::min((float)mWidth - 1.0f, maxX) / TileWidth;
+	tri.MaxTileY = (int)std::min((float)mHeight - 1.0f, maxY) / TileHeight;
+
+	uint32_t index = (uint32_t)bin.Triangles.size();
+	bin.Triangles.push_back(tri);
+	for(int ty = tri.MinTileY; ty <= tri.MaxTileY; ++ty)
+		for(int tx = tri.MinTileX; tx <= tri.MaxTileX; ++tx)
+			bin.TileTriangles[ty*mTilesX + tx].push_back(index);
+}
+
+//---------------------------------------------------------------------------------------
+// Rasterization
+//---------------------------------------------------------------------------------------
+
+void OcclusionBuffer::RasterizeTile(int tile)
+{
+	int tx = tile % mTilesX;
+	int ty = tile / mTilesX;
+	int x0 = tx*TileWidth, y0 = ty*TileHeight;
+
+	// Bins in task order keep the result independent of thread timing (not that it
+	// matters for a min-depth buffer).
+	for(size_t b = 0; b < mBins.size(); ++b)
+	{
+		const std::vector<uint32_t>& list = mBins[b].TileTriangles[tile];
+		for(size_t i = 0; i < list.size(); ++i)
+			RasterizeTriangle(mBins[b].Triangles[list[i]], x0, y0, x0 + TileWidth, y0 + TileHeight);
+	}
+}
+
+void OcclusionBuffer::RasterizeTriangle(const ScreenTriangle& tri, int x0, int y0, int x1, int y1)
+{
+	// Pixel bounds of the triangle inside the tile.
+	float minX = std::min(tri.X[0], std::min(tri.X[1], tri.X[2]));
+	float maxX = std::max(tri.X[0], std::max(tri.X[1], tri.X[2]));
+	float minY = std::min(tri.Y[0], std::min(tri.Y[1], tri.Y[2]));
+	float maxY = std::max(tri.Y[0], std::max(tri.Y[1], tri.Y[2]));
+	int px0 = (int)std::floor(std::max((float)x0, minX));
+	int px1 = (int)std::ceil(std::min((float)x1, maxX));
+	int py0 = (int)std::floor(std::max((float)y0, minY));
+	int py1 = (int)std::ceil(std::min((float)y1, maxY));
+	if(px0 >= px1 || py0 >= py1)
+		return;
+
+	// Edge i runs from vertex i to i+1; E(x, y) = A*x + B*y + C is >= 0 inside.
+	float A[3], B[3], C[3];
+	for(int e = 0; e < 3; ++e)
+	{
+		int n = (e + 1) % 3;
+		A[e] = tri.Y[e] - tri.Y[n];
+		B[e] = tri.X[n] - tri.X[e];
+		C[e] = tri.X[e]*tri.Y[n] - tri.Y[e]*tri.X[n];
+	}
+
+	// Depth plane z = zx*x + zy*y + z0.
+	float area = (tri.X[1] - tri.X[0])*(tri.Y[2] - tri.Y[0]) - (tri.Y[1] - tri.Y[0])*(tri.X[2] - tri.X[0]);
+	float invArea = 1.0f / area;
+	float zx = ((tri.Z[1] - tri.Z[0])*(tri.Y[2] - tri.Y[0]) - (tri.Z[2] - tri.Z[0])*(tri.Y[1] - tri.Y[0]))*invArea;
+	float zy = ((tri.Z[2] - tri.Z[0])*(tri.X[1] - tri.X[0]) - (tri.Z[1] - tri.Z[0])*(tri.X[2] - tri.X[0]))*invArea;
+	float z0 = tri.Z[0] - zx*tri.X[0] - zy*tri.Y[0];
+
+	// Rows are a multiple of four pixels wide within a tile, so SSE can start at any
+	// multiple of four.
+	px0 &= ~3;
+
+	for(int y = py0; y < py1; ++y)
+	{
+		float cy = y + 0.5f;
+		float* row = &mDepth[size_t(y)*mWidth];
+
+#if defined(OCCLUSIONBUFFER_SSE2)
+		__m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+		__m128 e0Step = _mm_set1_ps(A[0]*4.0f), e1Step = _mm_set1_ps(A[1]*4.0f), e2Step = _mm_set1_ps(A[2]*4.0f);
+		__m128 zStep = _mm_set1_ps(zx*4.0f);
+		__m128 xs = _mm_add_ps(_mm_set1_ps((float)px0), offsets);
+		__m128 e0 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(A[0]), xs), _mm_set1_ps(B[0]*cy + C[0]));
+		__m128 e1 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(A[1]), xs), _mm_set1_ps(B[1]*cy + C[1]));
+		__m128 e2 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(A[2]), xs), _mm_set1_ps(B[2]*cy + C[2]));
+		__m128 z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(zx), xs), _mm_set1_ps(zy*cy + z0));
+		const __m128 zero = _mm_setzero_ps();
+
+		for(int x = px0; x < px1; x += 4)
+		{
+			__m128 inside = _mm_cmpge_ps(_mm_min_ps(_mm_min_ps(e0, e1), e2), zero);
+			if(_mm_movemask_ps(inside))
+			{
+				__m128 old = _mm_loadu_ps(row + x);
+				__m128 nearer = _mm_min_ps(old, _mm_max_ps(z, zero));
+				_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, old)));
+			}
+			e0 = _mm_add_ps(e0, e0Step);
+			e1 = _mm_add_ps(e1, e1Step);
+			e2 = _mm_add_ps(e2, e2Step);
+			z = _mm_add_ps(z, zStep);
+		}
+#else
+		for(int x = px0; x < px1; ++x)
+		{
+			float cx = x + 0.5f;
+			if(A[0]*cx + B[0]*cy + C[0] >= 0.0f && A[1]*cx + B[1]*cy + C[1] >= 0.0f &&
+			   A[2]*cx + B[2]*cy + C[2] >= 0.0f)
+			{
+				float z = std::max(0.0f, zx*cx + zy*cy + z0);
+				row[x] = std::min(row[x], z);
+			}
+		}
+#endif
+	}
+}
+
+void OcclusionBuffer::UpdateBlockMax(int tile)
+{
+	int tx = tile % mTilesX;
+	int ty = tile / mTilesX;
+	int blocksX = mWidth / BlockSize;
+
+	for(int by = ty*TileHeight / BlockSize; by < (ty + 1)*TileHeight / BlockSize; ++by)
+	{
+		for(int bx = tx*TileWidth / BlockSize; bx < (tx + 1)*TileWidth / BlockSize; ++bx)
+		{
+			float farthest = 0.0f;
+			for(int y = by*BlockSize; y < (by + 1)*BlockSize; ++y)
+			{
+				const float* row = &mDepth[size_t(y)*mWidth + bx*BlockSize];
+				for(int x = 0; x < BlockSize; ++x)
+					farthest = std::max(farthest, row[x]);
+			}
+			mBlockMax[size_t(by)*blocksX + bx] = farthest;
+		}
+	}
+}
+
+//---------------------------------------------------------------------------------------
+// Queries
+//---------------------------------------------------------------------------------------
+
+bool OcclusionBuffer::TestAABB(const AABB& box)const
+{
+	const float* m = mViewProj;
+
+	float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX, minZ = FLT_MAX;
+	for(int corner = 0; corner < 8; ++corner)
+	{
+		float p[3] = { (corner & 1) ? box.Max.x : box.Min.x,
+		               (corner & 2) ? box.Max.y : box.Min.y,
+		               (corner & 4) ? box.Max.z : box.Min.z };
+		float clip[4];
+		for(int c = 0; c < 4; ++c)
+			clip[c] = p[0]*m[c] + p[1]*m[4 + c] + p[2]*m[8 + c] + m[12 + c];
+
+		// A corner in front of the near plane means the box reaches the camera.
+		if(clip[2] < 0.0f || clip[3] <= 0.0f)
+			return true;
+
+		float invW = 1.0f / clip[3];
+		float sx = (clip[0]*invW*0.5f + 0.5f)*mWidth;
+		float sy = (0.5f - clip[1]*invW*0.5f)*mHeight;
+		minX = std::min(minX, sx);
+		maxX = std::max(maxX, sx);
+		minY = std::min(minY, sy);
+		maxY = std::max(maxY, sy);
+		minZ = std::min(minZ, clip[2]*invW);
+	}
+
+	// Every pixel the projected box touches, plus a one pixel border: a neighbour's
+	// center may be what an occluder covered instead of these pixels.
+	if(maxX < 0.0f || maxY < 0.0f || minX >= (float)mWidth || minY >= (float)mHeight)
+		return true;   // Off screen; frustum culling decides those.
+	int x0 = (int)std::floor(std::max(0.0f, minX - 1.0f));
+	int y0 = (int)std::floor(std::max(0.0f, minY - 1.0f));
+	int x1 = (int)std::ceil(std::min((float)mWidth, maxX + 2.0f));
+	int y1 = (int)std::ceil(std::min((float)mHeight, maxY + 2.0f));
+
+	return TestRect(x0, y0, x1, y1, minZ);
+}
+
+bool OcclusionBuffer::TestRect(int x0, int y0, int x1, int y1, float minZ)const
+{
+	int blocksX = mWidth / BlockSize;
+
+	for(int by = y0 / BlockSize; by <= (y1 - 1) / BlockSize; ++by)
+	{
+		for(int bx = x0 / BlockSize; bx <= (x1 - 1) / BlockSize; ++bx)
+		{
+			// Everything in the block is nearer than the box: nothing to read.
+			if(mBlockMax[size_t(by)*blocksX + bx] < minZ)
+				continue;
+
+			int ya = std::max(y0, by*BlockSize), yb = std::min(y1, (by + 1)*BlockSize);
+			int xa = std::max(x0, bx*BlockSize), xb = std::min(x1, (bx + 1)*BlockSize);
+			for(int y = ya; y < yb; ++y)
+			{
+				const float* row = &mDepth[size_t(y)*mWidth];
+				for(int x = xa; x < xb; ++x)
+				{
+					if(row[x] >= minZ)
+						return true;
+				}
+			}
+		}
+	}
+	return false;
+}
+
+size_t OcclusionBuffer::Cull(const CullBoxes& boxes, uint8_t* visible)
+{
+	size_t count = 0;
+	size_t tested = 0;
+	for(size_t i = 0; i < boxes.Count(); ++i)
+	{
+		if(!visible[i])
+			continue;
+
+		Vec3 c(boxes.Center(0)[i], boxes.Center(1)[i], boxes.Center(2)[i]);
+		Vec3 e(boxes.Extent(0)[i], boxes.Extent(1)[i], boxes.Extent(2)[i]);
+		++tested;
+		if(TestAABB(AABB(c - e, c + e)))
+			++count;
+		else
+			visible[i] = 0;
+	}
+
+	mStats.BoxesTested += tested;
+	mStats.BoxesOccluded += tested - count;
+	return count;
+}
@@ -0,0 +1,126 @@
+#ifndef OCCLUSIONBUFFER_H
+#define OCCLUSIONBUFFER_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "FrustumCulling.h"
+#include "VecMath.h"
+
+///<summary>
+/// Low resolution CPU depth buffer for occlusion culling.  Each frame:
+///
+///   Begin(viewProj)        clears the buffer for a camera,
+///   AddOccluder(...)       queues triangle meshes that hide what is behind them,
+///   Render()               rasterizes the occluders,
+///   TestAABB / Cull        ask whether boxes may still be visible.
+///
+/// viewProj is row-major for row vectors (the XMFLOAT4X4 layout) and depth is D3D's
+/// z/w in [0, 1].  Render is one ParallelForPool job: its first ranges transform and
+/// bin triangles into screen tiles, the rest rasterize one tile each, four pixels at a
+/// time with SSE2 where available, once every bin is full.  A per-block maximum depth
+/// lets most box tests finish without reading pixels.
+///
+/// Occluders are sampled at pixel centers, so at this resolution their silhouettes can
+/// cover up to half a pixel more than they do on screen, and a pixel holds the depth
+/// at its center rather than the farthest over its area.  Box tests therefore read one
+/// pixel beyond the box's footprint, which is testing against the buffer eroded by a
+/// pixel; occluders can be the real surface, back faces and open edges included.
+///</summary>
+class OcclusionBuffer
+{
+public:
+	struct Stats
+	{
+		Stats();
+
+		size_t Occluders;
+		size_t Triangles;         // Submitted.
+		size_t TrianglesBinned;   // After clipping and removing off-screen triangles.
+		size_t BoxesTested;
+		size_t BoxesOccluded;
+	};
+
+	// The size is rounded up to whole tiles.
+	OcclusionBuffer(int width = 256, int height = 128);
+
+	int Width()const { return mWidth; }
+	int Height()const { return mHeight; }
+
+	void Begin(const float viewProj[16]);
+
+	// Queues triangles (three indices each) over positions.  The arrays are read by
+	// Render and must stay alive until then.
+	void AddOccluder(const Vec3* positions, const uint32_t* indices, size_t indexCount);
+
+	void Render();
+
+	// True if some part of the box may be in front of the occluders.
+	bool TestAABB(const AABB& box)const;
+
+	// Clears visible[i] for each box that is occluded; boxes already marked invisible
+	// are skipped.  Returns the number still visible.
+	size_t Cull(const CullBoxes& boxes, uint8_t* visible);
+
+	const float* Depth()const { return mDepth.data(); }
+	const Stats& GetStats()const { return mStats; }
+
+private:
+	struct Occluder
+	{
+		const Vec3* Positions;
+		const uint32_t* Indices;
+		size_t IndexCount;
+	};
+
+	// A triangle after projection, in pixels, with its depth plane.
+	struct ScreenTriangle
+	{
+		float X[3];
+		float Y[3];
+		float Z[3];
+		int MinTileX, MinTileY, MaxTileX, MaxTileY;
+	};
+
+	// Triangles binned by one worker: the triangles and, per tile, indices into them.
+	struct Bin
+	{
+		std::vector<ScreenTriangle> Triangles;
+		std::vector<std::vector<uint32_t> > TileTriangles;
+	};
+
+	OcclusionBuffer(const OcclusionBuffer& rhs);
+	OcclusionBuffer& operator=(const OcclusionBuffer& rhs);
+
+	static void RenderRange(void* context, size_t range);
+	void SetupTriangles(size_t first, size_t last, Bin& bin)const;
+	void EmitTriangle(const float clip[3][4], Bin& bin)const;
+	void RasterizeTile(int tile);
+	void RasterizeTriangle(const ScreenTriangle& tri, int x0, int y0, int x1, int y1);
+	void UpdateBlockMax(int tile);
+	bool TestRect(int x0, int y0, int x1, int y1, float minZ)const;
+
+	int mWidth;
+	int mHeight;
+	int mTilesX;
+	int mTilesY;
+	float mViewProj[16];
+
+	std::vector<float> mDepth;
+	std::vector<float> mBlockMax;   // Farthest depth of each BlockSize^2 block.
+	std::vector<Occluder> mOccluders;
+	std::vector<size_t> mTriangleStart;   // Prefix sum of triangle counts over mOccluders.
+	std::vector<Bin> mBins;
+	Stats mStats;
+
+	// Render's job: binning ranges count mBinsDone up; tile ranges wait for all of them.
+	size_t mTrianglesPerBin;
+	size_t mBinsDone;
+	std::mutex mBinMutex;
+	std::condition_variable mBinsFull;
+};
+
+#endif // OCCLUSIONBUFFER_H
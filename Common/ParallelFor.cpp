@@ -0,0 +1,109 @@
+#include "ParallelFor.h"
+
+ParallelForPool& ParallelForPool::Instance()
+{
+	static ParallelForPool pool;
+	return pool;
+}
+
+ParallelForPool::ParallelForPool()
+	: mStop(false)
+{
+	size_t hwThreads = std::max<size_t>(1, std::thread::hardware_concurrency());
+	for(size_t i = 1; i < hwThreads; ++i)
+		mWorkers.emplace_back([this]() { WorkerMain(); });
+}
+
+ParallelForPool::~ParallelForPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mStop = true;
+	}
+	mWake.notify_all();
+	for(size_t i = 0; i < mWorkers.size(); ++i)
+		mWorkers[i].join();
+}
+
+void ParallelForPool::Run(size_t rangeCount, RangeFunction function, void* context)
+{
+	if(rangeCount == 0)
+		return;
+
+	Job job;
+	job.Function = function;
+	job.Context = context;
+	job.Ranges = rangeCount;
+	job.Next = 0;
+	job.Done = 0;
+
+	if(!mWorkers.empty() && rangeCount > 1)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mJobs.push_back(&job);
+		}
+		mWake.notify_all();
+	}
+
+	size_t range = job.Next++;
+	while(range < rangeCount)
+		Work(job, range), range = job.Next++;
+
+	// Every range is taken; wait for the workers still running theirs.
+	std::unique_lock<std::mutex> lock(mMutex);
+	mJobs.erase(std::remove(mJobs.begin(), mJobs.end(), &job), mJobs.end());
+	mFinished.wait(lock, [&job]() { return job.Done.load() == job.Ranges; });
+}
+
+void ParallelForPool::Work(Job& job, size_t range)
+{
+	size_t ranges = job.Ranges;
+	job.Function(job.Context, range);
+
+	// The job may be gone as soon as the last range is counted, so only the pool is
+	// touched after that.
+	if(job.Done.fetch_add(1) + 1 == ranges)
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mFinished.notify_all();
+	}
+}
+
+void ParallelForPool::WorkerMain()
+{
+	for(;;)
+	{
+		Job* job = 0;
+		size_t range = 0, ranges = 0;
+		{
+			// Take the first range under the lock: a job in the list has not finished,
+			// and one with a range taken cannot finish before that range is done.
+			std::unique_lock<std::mutex> lock(mMutex);
+			for(;;)
+			{
+				if(mStop)
+					return;
+				for(size_t i = 0; i < mJobs.size() && !job; ++i)
+				{
+					range = mJobs[i]->Next++;
+					if(range < mJobs[i]->Ranges)
+						job = mJobs[i], ranges = job->Ranges;
+				}
+				if(job)
+					break;
+				mWake.wait(lock);
+			}
+		}
+
+		// Take the next range before counting this one done, so the job stays alive.
+		for(;;)
+		{
+			size_t next = job->Next++;
+			Work(*job, range);
+			if(next >= ranges)
+				break;
+			range = next;
+		}
+	}
+}
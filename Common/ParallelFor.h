@@ -0,0 +1,102 @@
+#ifndef PARALLELFOR_H
+#define PARALLELFOR_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+///<summary>
+/// The worker threads behind ParallelFor: one per hardware thread but the caller's,
+/// started on first use and kept for the life of the process, so per-frame callers
+/// pay a wake-up rather than a thread launch.
+///
+/// Run splits a job into numbered ranges that the caller and any idle worker take in
+/// turn; the caller works on its own job until every range is taken and then waits for
+/// the rest.  Since the caller can always finish its job alone, a range may itself
+/// call Run, and several threads may run jobs at once.
+///</summary>
+class ParallelForPool
+{
+public:
+	typedef void (*RangeFunction)(void* context, size_t range);
+
+	static ParallelForPool& Instance();
+
+	// Threads a job can use, the caller's included.
+	size_t ThreadCount()const { return mWorkers.size() + 1; }
+
+	// Calls function(context, r) for every r in [0, rangeCount) and returns when all
+	// have returned.
+	void Run(size_t rangeCount, RangeFunction function, void* context);
+
+private:
+	struct Job
+	{
+		RangeFunction Function;
+		void* Context;
+		size_t Ranges;
+		std::atomic<size_t> Next;
+		std::atomic<size_t> Done;
+	};
+
+	ParallelForPool();
+	~ParallelForPool();
+	ParallelForPool(const ParallelForPool& rhs);
+	ParallelForPool& operator=(const ParallelForPool& rhs);
+
+	void WorkerMain();
+	void Work(Job& job, size_t range);
+
+	std::mutex mMutex;
+	std::condition_variable mWake;
+	std::condition_variable mFinished;
+	std::vector<Job*> mJobs;
+	std::vector<std::thread> mWorkers;
+	bool mStop;
+};
+
+//---------------------------------------------------------------------------------------
+// Splits [0, count) into contiguous ranges and calls body(begin, end) for each range,
+// one range per hardware thread, on ParallelForPool.  The calling thread runs ranges
+// itself and returns once every range is done.  Work smaller than minPerThread
+// elements per thread is not worth waking a worker, so it stays on the calling thread.
+//---------------------------------------------------------------------------------------
+
+template<typename Fn>
+void ParallelFor(size_t count, size_t minPerThread, Fn body)
+{
+	if(count == 0)
+		return;
+
+	ParallelForPool& pool = ParallelForPool::Instance();
+	size_t threadCount = std::min(pool.ThreadCount(), std::max<size_t>(1, count / std::max<size_t>(1, minPerThread)));
+
+	if(threadCount <= 1)
+	{
+		body(size_t(0), count);
+		return;
+	}
+
+	struct Context
+	{
+		Fn* Body;
+		size_t Count;
+		size_t RangeSize;
+	};
+	Context context = { &body, count, (count + threadCount - 1) / threadCount };
+
+	pool.Run(threadCount, [](void* p, size_t range)
+	{
+		const Context& c = *static_cast<const Context*>(p);
+		size_t begin = range*c.RangeSize;
+		size_t end = std::min(c.Count, begin + c.RangeSize);
+		if(begin < end)
+			(*c.Body)(begin, end);
+	}, &context);
+}
+
+#endif // PARALLELFOR_H
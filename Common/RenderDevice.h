@@ -0,0 +1,42 @@
+#ifndef RENDERDEVICE_H
+#define RENDERDEVICE_H
+
+#include <cstdint>
+
+#include "DrawCommandList.h"
+#include "TextureStreamer.h"
+
+///<summary>
+/// The graphics device as the platform-neutral code sees it: buffers named by
+/// DrawHandle, a draw backend to submit DrawQueues to, a texture device for the
+/// TextureStreamer, and presentation.  Pipelines and input layouts are shader
+/// specific and are registered with the concrete backend.
+///
+/// D3D11RenderDevice drives a real device.  NullRenderDevice accepts everything and
+/// draws nothing, so the scene update, culling and draw recording can run headless.
+///</summary>
+class IRenderDevice
+{
+public:
+	virtual ~IRenderDevice() {}
+
+	virtual int Width()const = 0;
+	virtual int Height()const = 0;
+
+	// Buffers live as long as the device.  Immutable buffers take their contents at
+	// creation; dynamic ones start empty and are filled with WriteVertexBuffer.
+	virtual DrawHandle CreateVertexBuffer(const void* data, uint32_t bytes, bool dynamic) = 0;
+	virtual DrawHandle CreateIndexBuffer(const uint32_t* indices, uint32_t count) = 0;
+
+	// Replaces the contents of a dynamic vertex buffer; bytes must fit in it.
+	virtual void WriteVertexBuffer(DrawHandle buffer, const void* data, uint32_t bytes) = 0;
+
+	virtual IDrawBackend& DrawBackend() = 0;
+	virtual ITextureDevice& TextureDevice() = 0;
+
+	// Clears the back buffer to color and the depth buffer to 1.
+	virtual void Clear(const float color[4]) = 0;
+	virtual void Present() = 0;
+};
+
+#endif // RENDERDEVICE_H
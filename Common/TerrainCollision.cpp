@@ -0,0 +1,931 @@
+#include "TerrainCollision.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <unordered_map>
+
+const uint32_t CollisionBVH::MaxLeafTriangles;
+const uint32_t CollisionBVH::MaxSAHDepth;
+const uint32_t CollisionBVH::MaxDepth;
+const float CollisionBVH::SweepTolerance = 1e-3f;
+const float CollisionBVH::RebuildRatio = 1.5f;
+
+namespace
+{
+	const uint32_t NoIndex = 0xffffffff;
+	const int SweepIterations = 64;
+	const int SAHBins = 12;
+	// A walk holds at most one entry per level below the root plus the root's.
+	const int StackSize = 64;
+	static_assert(CollisionBVH::MaxDepth + 1 <= StackSize, "a query stack must hold the deepest tree");
+
+	// Real-Time Collision Detection 5.1.5.
+	Vec3 ClosestPointTriangle(const Vec3& p, const Vec3& a, const Vec3& b, const Vec3& c)
+	{
+		Vec3 ab = b - a, ac = c - a, ap = p - a;
+		float d1 = Dot(ab, ap), d2 = Dot(ac, ap);
+		if(d1 <= 0.0f && d2 <= 0.0f)
+			return a;
+
+		Vec3 bp = p - b;
+		float d3 = Dot(ab, bp), d4 = Dot(ac, bp);
+		if(d3 >= 0.0f && d4 <= d3)
+			return b;
+
+		float vc = d1*d4 - d3*d2;
+		if(vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+			return a + ab*(d1 / (d1 - d3));
+
+		Vec3 cp = p - c;
+		float d5 = Dot(ab, cp), d6 = Dot(ac, cp);
+		if(d6 >= 0.0f && d5 <= d6)
+			return c;
+
+		float vb = d5*d2 - d1*d6;
+		if(vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+			return a + ac*(d2 / (d2 - d6));
+
+		float va = d3*d6 - d5*d4;
+		if(va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+			return b + (c - b)*((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+
+		float denom = 1.0f / (va + vb + vc);
+		return a + ab*(vb*denom) + ac*(vc*denom);
+	}
+
+	// Real-Time Collision Detection 5.1.9.  Returns the squared distance.
+	float ClosestSegmentSegment(const Vec3& p1, const Vec3& q1, const Vec3& p2, const Vec3& q2, Vec3& c1, Vec3& c2)
+	{
+		const float epsilon = 1e-12f;
+		Vec3 d1 = q1 - p1, d2 = q2 - p2, r = p1 - p2;
+		float a = Dot(d1, d1), e = Dot(d2, d2), f = Dot(d2, r);
+		float s, t;
+		if(a <= epsilon && e <= epsilon)
+		{
+			c1 = p1;
+			c2 = p2;
+			return Dot(c1 - c2, c1 - c2);
+		}
+		if(a <= epsilon)
+		{
+			s = 0.0f;
+			t = (std::min)((std::max)(f / e, 0.0f), 1.0f);
+		}
+		else
+		{
+			float c = Dot(d1, r);
+			if(e <= epsilon)
+			{
+				t = 0.0f;
+				s = (std::min)((std::max)(-c / a, 0.0f), 1.0f);
+			}
+			else
+			{
+				float b = Dot(d1, d2);
+				float denom = a*e - b*b;
+				s = denom != 0.0f ? (std::min)((std::max)((b*f - c*e) / denom, 0.0f), 1.0f) : 0.0f;
+				t = (b*s + f) / e;
+				if(t < 0.0f)
+				{
+					t = 0.0f;
+					s = (std::min)((std::max)(-c / a, 0.0f), 1.0f);
+				}
+				else if(t > 1.0f)
+				{
+					t = 1.0f;
+					s = (std::min)((std::max)((b - c) / a, 0.0f), 1.0f);
+				}
+			}
+		}
+		c1 = p1 + d1*s;
+		c2 = p2 + d2*t;
+		return Dot(c1 - c2, c1 - c2);
+	}
+
+	bool SegmentIntersectsTriangle(const Vec3& p, const Vec3& q, const Vec3& a, const Vec3& b, const Vec3& c, Vec3& point)
+	{
+		Vec3 dir = q - p, e1 = b - a, e2 = c - a;
+		Vec3 pv = Cross(dir, e2);
+		float det = Dot(e1, pv);
+		if(std::fabs(det) < 1e-12f)
+			return false;
+		float inv = 1.0f / det;
+		Vec3 tv = p - a;
+		float u = Dot(tv, pv)*inv;
+		if(u < 0.0f || u > 1.0f)
+			return false;
+		Vec3 qv = Cross(tv, e1);
+		float v = Dot(dir, qv)*inv;
+		if(v < 0.0f || u + v > 1.0f)
+			return false;
+		float t = Dot(e2, qv)*inv;
+		if(t < 0.0f || t > 1.0f)
+			return false;
+		point = p + dir*t;
+		return true;
+	}
+
+	// Closest points between segment pq and triangle abc.  Returns the squared distance.
+	float ClosestSegmentTriangle(const Vec3& p, const Vec3& q, const Vec3& a, const Vec3& b, const Vec3& c,
+		Vec3& onSegment, Vec3& onTriangle)
+	{
+		Vec3 crossing;
+		if(SegmentIntersectsTriangle(p, q, a, b, c, crossing))
+		{
+			onSegment = onTriangle = crossing;
+			return 0.0f;
+		}
+
+		// Otherwise the closest pair has an end of the segment or an edge of the triangle.
+		onSegment = p;
+		onTriangle = ClosestPointTriangle(p, a, b, c);
+		float best = LengthSq(onSegment - onTriangle);
+
+		Vec3 onTri = ClosestPointTriangle(q, a, b, c);
+		float d = LengthSq(q - onTri);
+		if(d < best)
+		{
+			best = d;
+			onSegment = q;
+			onTriangle = onTri;
+		}
+
+		const Vec3* corners[4] = { &a, &b, &c, &a };
+		for(int e = 0; e < 3; ++e)
+		{
+			Vec3 s, t;
+			d = ClosestSegmentSegment(p, q, *corners[e], *corners[e + 1], s, t);
+			if(d < best)
+			{
+				best = d;
+				onSegment = s;
+				onTriangle = t;
+			}
+		}
+		return best;
+	}
+
+	// Slab test of the ray origin + direction*t against box; [tEnter, tExit] is clipped
+	// to [0, tMax].
+	bool RayBox(const Vec3& origin, const Vec3& direction, const Vec3& mn, const Vec3& mx, float tMax, float& tEnter)
+	{
+		float t0 = 0.0f, t1 = tMax;
+		for(int axis = 0; axis < 3; ++axis)
+		{
+			if(std::fabs(direction[axis]) < 1e-20f)
+			{
+				if(origin[axis] < mn[axis] || origin[axis] > mx[axis])
+					return false;
+				continue;
+			}
+			float inv = 1.0f / direction[axis];
+			float ta = (mn[axis] - origin[axis])*inv;
+			float tb = (mx[axis] - origin[axis])*inv;
+			t0 = (std::max)(t0, (std::min)(ta, tb));
+			t1 = (std::min)(t1, (std::max)(ta, tb));
+			if(t0 > t1)
+				return false;
+		}
+		tEnter = t0;
+		return true;
+	}
+
+	AABB CapsuleBounds(const Vec3& a, const Vec3& b, float radius)
+	{
+		Vec3 r(radius, radius, radius);
+		return AABB(Min(a, b) - r, Max(a, b) + r);
+	}
+
+	// Advances capsule ab along direction towards one triangle.  The gap between two
+	// convex shapes is convex along a straight path, so it lies above its tangent: a
+	// Newton step, the gap over its rate of closing, does not pass the first contact,
+	// and once the gap stops shrinking there is no contact ahead.  Where the shape heads
+	// straight at the triangle the first step lands on the contact; a graze at a
+	// shallow angle converges quadratically where a step of the gap alone would crawl.
+	//
+	// Near an edge the closest points round enough to skew the rate, and a step can
+	// land just inside the triangle.  From then on the contact is bracketed between the
+	// last clear position and that one, and steps that would leave the bracket halve it
+	// instead.  The returned distance is always a clear position.
+	bool SweepTriangle(const Vec3& a, const Vec3& b, float radius, const Vec3& direction, float maxDistance,
+		const Vec3& v0, const Vec3& v1, const Vec3& v2, float& distance, Vec3& onSegment, Vec3& onTriangle)
+	{
+		float t = 0.0f, clear = 0.0f, blocked = maxDistance;
+		bool overlapAhead = false;
+		for(int iteration = 0; iteration < SweepIterations; ++iteration)
+		{
+			Vec3 offset = direction*t;
+			float separation = std::sqrt(ClosestSegmentTriangle(a + offset, b + offset, v0, v1, v2, onSegment, onTriangle));
+			float gap = separation - radius;
+			if(gap < 0.0f && t > 0.0f)
+			{
+				blocked = t;
+				overlapAhead = true;
+				t = 0.5f*(clear + blocked);
+				continue;
+			}
+			if(gap <= CollisionBVH::SweepTolerance)
+			{
+				distance = t;
+				return true;
+			}
+
+			clear = t;
+			float closing = Dot(onTriangle - onSegment, direction) / separation;
+			float next = closing > 0.0f ? t + gap / closing : FLT_MAX;
+			if(next >= blocked)
+			{
+				if(!overlapAhead)
+					return false;
+				next = 0.5f*(clear + blocked);
+			}
+			t = next;
+		}
+
+		// Out of steps.  A graze that has not touched yet has no contact to report; one
+		// bracketed by an overlap stops at its last clear position.
+		if(!overlapAhead)
+			return false;
+		ClosestSegmentTriangle(a + direction*clear, b + direction*clear, v0, v1, v2, onSegment, onTriangle);
+		distance = clear;
+		return true;
+	}
+
+	// Median split of the chunks on the longest axis of their centers; leaves hold one.
+	struct ChunkBox
+	{
+		AABB Bounds;
+		Vec3 Centroid;
+		uint32_t Chunk;
+	};
+
+	uint32_t BuildChunkNode(std::vector<CollisionBVH::Node>& nodes, std::vector<ChunkBox>& boxes, uint32_t begin, uint32_t end)
+	{
+		uint32_t index = (uint32_t)nodes.size();
+		nodes.push_back(CollisionBVH::Node());
+
+		AABB bounds, centroids;
+		for(uint32_t i = begin; i < end; ++i)
+		{
+			bounds.Extend(boxes[i].Bounds);
+			centroids.Extend(boxes[i].Centroid);
+		}
+		nodes[index].Min = bounds.Min;
+		nodes[index].Max = bounds.Max;
+
+		if(end - begin == 1)
+		{
+			nodes[index].LeftOrFirst = boxes[begin].Chunk;
+			nodes[index].Count = 1;
+			return index;
+		}
+
+		Vec3 extent = centroids.Max - centroids.Min;
+		int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+		uint32_t mid = begin + (end - begin) / 2;
+		std::nth_element(boxes.begin() + begin, boxes.begin() + mid, boxes.begin() + end,
+			[axis](const ChunkBox& l, const ChunkBox& r) { return l.Centroid[axis] < r.Centroid[axis]; });
+
+		BuildChunkNode(nodes, boxes, begin, mid);
+		uint32_t right = BuildChunkNode(nodes, boxes, mid, end);
+		nodes[index].LeftOrFirst = right;
+		nodes[index].Count = 0;
+		return index;
+	}
+}
+
+void CollisionMesh::FromChunk(const TerrainChunkMesh& chunk, const uint32_t* indices, size_t indexCount,
+	float weldDistance, CollisionMesh& out)
+{
+	out.Clear();
+
+	std::vector<uint32_t> remap(chunk.Positions.size(), NoIndex);
+	std::vector<uint32_t> clusterCount;
+	std::unordered_map<uint64_t, uint32_t> clusters;
+	float invWeld = weldDistance > 0.0f ? 1.0f / weldDistance : 0.0f;
+
+	for(size_t i = 0; i + 2 < indexCount; i += 3)
+	{
+		uint32_t tri[3];
+		for(int k = 0; k < 3; ++k)
+		{
+			uint32_t source = indices[i + k];
+			if(remap[source] == NoIndex)
+			{
+				const Vec3& p = chunk.Positions[source];
+				if(weldDistance > 0.0f)
+				{
+					// 21 bits per axis is plenty for a chunk.
+					uint64_t key = 0;
+					for(int axis = 0; axis < 3; ++axis)
+						key = (key << 21) | (uint64_t)((int64_t)std::floor(p[axis]*invWeld) & 0x1fffff);
+
+					std::unordered_map<uint64_t, uint32_t>::iterator it = clusters.find(key);
+					if(it == clusters.end())
+					{
+						it = clusters.insert(std::make_pair(key, (uint32_t)out.Positions.size())).first;
+						out.Positions.push_back(Vec3());
+						clusterCount.push_back(0);
+					}
+					remap[source] = it->second;
+					out.Positions[it->second] += p;
+					++clusterCount[it->second];
+				}
+				else
+				{
+					remap[source] = (uint32_t)out.Positions.size();
+					out.Positions.push_back(p);
+				}
+			}
+			tri[k] = remap[source];
+		}
+
+		if(tri[0] != tri[1] && tri[1] != tri[2] && tri[2] != tri[0])
+			out.Indices.insert(out.Indices.end(), tri, tri + 3);
+	}
+
+	// Each cluster sits at the mean of its vertices.
+	for(size_t v = 0; v < clusterCount.size(); ++v)
+		out.Positions[v] *= 1.0f / clusterCount[v];
+}
+
+CollisionBVH::CollisionBVH()
+	: mBuiltCost(0.0f), mDepth(0)
+{
+}
+
+AABB CollisionBVH::TriangleBounds(uint32_t triangle)const
+{
+	AABB box;
+	for(int k = 0; k < 3; ++k)
+		box.Extend(mMesh.Positions[mMesh.Indices[triangle*3 + k]]);
+	return box;
+}
+
+AABB CollisionBVH::Bounds()const
+{
+	if(mNodes.empty())
+		return AABB();
+	return AABB(mNodes[0].Min, mNodes[0].Max);
+}
+
+void CollisionBVH::Build(const CollisionMesh& mesh)
+{
+	mNodes.clear();
+	mSource.clear();
+	mMesh.Clear();
+	mBuiltCost = 0.0f;
+	mDepth = 0;
+
+	size_t count = mesh.TriangleCount();
+	if(count == 0)
+		return;
+
+	std::vector<BuildTriangle> triangles(count);
+	for(size_t t = 0; t < count; ++t)
+	{
+		BuildTriangle& tri = triangles[t];
+		for(int k = 0; k < 3; ++k)
+			tri.Bounds.Extend(mesh.Positions[mesh.Indices[t*3 + k]]);
+		tri.Centroid = tri.Bounds.Center();
+		tri.Source = (uint32_t)t;
+	}
+
+	mNodes.reserve(2*count);
+	BuildNode(triangles, 0, (uint32_t)count, 0);
+
+	mSource.resize(count);
+	for(size_t t = 0; t < count; ++t)
+		mSource[t] = triangles[t].Source;
+	ReorderMesh(mesh);
+	mBuiltCost = SAHCost();
+}
+
+uint32_t CollisionBVH::BuildNode(std::vector<BuildTriangle>& triangles, uint32_t begin, uint32_t end, uint32_t depth)
+{
+	mDepth = (std::max)(mDepth, depth);
+	uint32_t index = (uint32_t)mNodes.size();
+	mNodes.push_back(Node());
+
+	AABB bounds, centroids;
+	for(uint32_t t = begin; t < end; ++t)
+	{
+		bounds.Extend(triangles[t].Bounds);
+		centroids.Extend(triangles[t].Centroid);
+	}
+	mNodes[index].Min = bounds.Min;
+	mNodes[index].Max = bounds.Max;
+
+	uint32_t count = end - begin;
+
+	// Binned SAH: the cost of a split is the triangles on each side times the area of
+	// their bounds.  Leaving a node whole costs its triangles times its own area.
+	int bestAxis = -1;
+	int bestSplit = 0;
+	float bestCost = FLT_MAX;
+	if(count > 1 && depth < MaxSAHDepth)
+	{
+		for(int axis = 0; axis < 3; ++axis)
+		{
+			float lo = centroids.Min[axis], extent = centroids.Max[axis] - lo;
+			if(extent <= 0.0f)
+				continue;
+
+			AABB binBounds[SAHBins];
+			uint32_t binCount[SAHBins] = {};
+			float scale = SAHBins / extent;
+			for(uint32_t t = begin; t < end; ++t)
+			{
+				int bin = (std::min)((int)((triangles[t].Centroid[axis] - lo)*scale), SAHBins - 1);
+				++binCount[bin];
+				binBounds[bin].Extend(triangles[t].Bounds);
+			}
+
+			float rightArea[SAHBins];
+			uint32_t rightCount[SAHBins];
+			AABB right;
+			uint32_t n = 0;
+			for(int bin = SAHBins - 1; bin > 0; --bin)
+			{
+				right.Extend(binBounds[bin]);
+				n += binCount[bin];
+				rightArea[bin] = right.SurfaceArea();
+				rightCount[bin] = n;
+			}
+
+			AABB left;
+			n = 0;
+			for(int split = 1; split < SAHBins; ++split)
+			{
+				left.Extend(binBounds[split - 1]);
+				n += binCount[split - 1];
+				if(n == 0 || rightCount[split] == 0)
+					continue;
+				float cost = n*left.SurfaceArea() + rightCount[split]*rightArea[split];
+				if(cost < bestCost)
+				{
+					bestCost = cost;
+					bestAxis = axis;
+					bestSplit = split;
+				}
+			}
+		}
+	}
+
+	float area = bounds.SurfaceArea();
+	bool splitPays = bestAxis >= 0 && area + bestCost < count*area;
+	if(count <= 1 || (count <= MaxLeafTriangles && !splitPays))
+	{
+		mNodes[index].LeftOrFirst = begin;
+		mNodes[index].Count = count;
+		return index;
+	}
+
+	uint32_t mid;
+	if(bestAxis >= 0)
+	{
+		float lo = centroids.Min[bestAxis];
+		float scale = SAHBins / (centroids.Max[bestAxis] - lo);
+		BuildTriangle* split = std::partition(&triangles[begin], &triangles[begin] + count, [&](const BuildTriangle& tri)
+		{
+			return (std::min)((int)((tri.Centroid[bestAxis] - lo)*scale), SAHBins - 1) < bestSplit;
+		});
+		mid = (uint32_t)(split - &triangles[0]);
+	}
+	else
+		mid = begin;
+
+	// Every centroid in one place, or too deep to weigh splits: halve the list at its
+	// median so the depth stays logarithmic.
+	if(mid == begin || mid == end)
+	{
+		mid = begin + count / 2;
+		if(bestAxis < 0)
+		{
+			Vec3 extent = centroids.Max - centroids.Min;
+			int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+			std::nth_element(triangles.begin() + begin, triangles.begin() + mid, triangles.begin() + end,
+				[axis](const BuildTriangle& l, const BuildTriangle& r) { return l.Centroid[axis] < r.Centroid[axis]; });
+		}
+	}
+
+	BuildNode(triangles, begin, mid, depth + 1);
+	uint32_t right = BuildNode(triangles, mid, end, depth + 1);
+	mNodes[index].LeftOrFirst = right;
+	mNodes[index].Count = 0;
+	return index;
+}
+
+void CollisionBVH::ReorderMesh(const CollisionMesh& mesh)
+{
+	mMesh.Positions = mesh.Positions;
+	mMesh.Indices.resize(mSource.size()*3);
+	for(size_t slot = 0; slot < mSource.size(); ++slot)
+	{
+		for(int k = 0; k < 3; ++k)
+			mMesh.Indices[slot*3 + k] = mesh.Indices[mSource[slot]*3 + k];
+	}
+}
+
+void CollisionBVH::Refit(const CollisionMesh& mesh)
+{
+	assert(mesh.TriangleCount() == mSource.size());
+	ReorderMesh(mesh);
+	RefitNodes();
+}
+
+void CollisionBVH::RefitNodes()
+{
+	// Children always follow their parent, so walking backwards visits them first.
+	for(size_t i = mNodes.size(); i-- > 0; )
+	{
+		Node& node = mNodes[i];
+		AABB box;
+		if(node.Count > 0)
+		{
+			for(uint32_t t = 0; t < node.Count; ++t)
+				box.Extend(TriangleBounds(node.LeftOrFirst + t));
+		}
+		else
+		{
+			const Node& left = mNodes[i + 1];
+			const Node& right = mNodes[node.LeftOrFirst];
+			box.Extend(AABB(left.Min, left.Max));
+			box.Extend(AABB(right.Min, right.Max));
+		}
+		node.Min = box.Min;
+		node.Max = box.Max;
+	}
+}
+
+bool CollisionBVH::Update(const CollisionMesh& mesh)
+{
+	if(mNodes.empty() || mesh.TriangleCount() != mSource.size())
+	{
+		Build(mesh);
+		return false;
+	}
+
+	Refit(mesh);
+	if(SAHCost() > RebuildRatio*mBuiltCost)
+	{
+		Build(mesh);
+		return false;
+	}
+	return true;
+}
+
+float CollisionBVH::SAHCost()const
+{
+	if(mNodes.empty())
+		return 0.0f;
+
+	float rootArea = Bounds().SurfaceArea();
+	if(rootArea <= 0.0f)
+		return 0.0f;
+
+	float cost = 0.0f;
+	for(size_t i = 0; i < mNodes.size(); ++i)
+	{
+		float area = AABB(mNodes[i].Min, mNodes[i].Max).SurfaceArea();
+		cost += mNodes[i].Count > 0 ? area*mNodes[i].Count : area;
+	}
+	return cost / rootArea;
+}
+
+bool CollisionBVH::OverlapSphere(const Vec3& center, float radius, std::vector<uint32_t>* triangles)const
+{
+	return OverlapCapsule(center, center, radius, triangles);
+}
+
+bool CollisionBVH::OverlapCapsule(const Vec3& a, const Vec3& b, float radius, std::vector<uint32_t>* triangles)const
+{
+	if(mNodes.empty())
+		return false;
+
+	AABB query = CapsuleBounds(a, b, radius);
+	float radiusSq = radius*radius;
+	bool found = false;
+
+	uint32_t stack[StackSize];
+	int top = 0;
+	stack[top++] = 0;
+	while(top > 0)
+	{
+		uint32_t index = stack[--top];
+		const Node& node = mNodes[index];
+		if(!query.Overlaps(AABB(node.Min, node.Max)))
+			continue;
+
+		if(node.Count == 0)
+		{
+			stack[top++] = node.LeftOrFirst;
+			stack[top++] = index + 1;
+			continue;
+		}
+
+		for(uint32_t t = node.LeftOrFirst; t < node.LeftOrFirst + node.Count; ++t)
+		{
+			const uint32_t* tri = &mMesh.Indices[t*3];
+			Vec3 onSegment, onTriangle;
+			if(ClosestSegmentTriangle(a, b, mMesh.Positions[tri[0]], mMesh.Positions[tri[1]], mMesh.Positions[tri[2]],
+				onSegment, onTriangle) <= radiusSq)
+			{
+				if(!triangles)
+					return true;
+				triangles->push_back(t);
+				found = true;
+			}
+		}
+	}
+	return found;
+}
+
+bool CollisionBVH::SweepSphere(const Vec3& center, float radius, const Vec3& direction, float maxDistance,
+	CollisionHit& hit)const
+{
+	return SweepCapsule(center, center, radius, direction, maxDistance, hit);
+}
+
+bool CollisionBVH::SweepCapsule(const Vec3& a, const Vec3& b, float radius, const Vec3& direction, float maxDistance,
+	CollisionHit& hit)const
+{
+	hit = CollisionHit();
+	if(mNodes.empty())
+		return false;
+
+	// Sweep the capsule's box: the center moves along the ray, node boxes grow by the
+	// box's half size.
+	Vec3 center = (a + b)*0.5f;
+	AABB shape = CapsuleBounds(a, b, radius);
+	Vec3 half = shape.Extents();
+
+	float best = maxDistance;
+	struct Entry
+	{
+		uint32_t Node;
+		float Enter;
+	};
+	Entry stack[StackSize];
+	int top = 0;
+
+	float enter;
+	if(!RayBox(center, direction, mNodes[0].Min - half, mNodes[0].Max + half, best, enter))
+		return false;
+	stack[top].Node = 0;
+	stack[top++].Enter = enter;
+
+	while(top > 0)
+	{
+		Entry entry = stack[--top];
+		if(entry.Enter > best)
+			continue;
+
+		const Node& node = mNodes[entry.Node];
+		if(node.Count == 0)
+		{
+			// Push the farther child first so the nearer is walked first.
+			uint32_t children[2] = { entry.Node + 1, node.LeftOrFirst };
+			float enters[2];
+			bool hits[2];
+			for(int c = 0; c < 2; ++c)
+			{
+				const Node& child = mNodes[children[c]];
+				hits[c] = RayBox(center, direction, child.Min - half, child.Max + half, best, enters[c]);
+			}
+			int nearFirst = hits[0] && hits[1] && enters[1] < enters[0] ? 1 : 0;
+			for(int k = 1; k >= 0; --k)
+			{
+				int c = k == 0 ? nearFirst : 1 - nearFirst;
+				if(hits[c])
+				{
+					stack[top].Node = children[c];
+					stack[top++].Enter = enters[c];
+				}
+			}
+			continue;
+		}
+
+		for(uint32_t t = node.LeftOrFirst; t < node.LeftOrFirst + node.Count; ++t)
+		{
+			const uint32_t* tri = &mMesh.Indices[t*3];
+			const Vec3& v0 = mMesh.Positions[tri[0]];
+			const Vec3& v1 = mMesh.Positions[tri[1]];
+			const Vec3& v2 = mMesh.Positions[tri[2]];
+
+			float distance;
+			Vec3 onSegment, onTriangle;
+			if(!SweepTriangle(a, b, radius, direction, best, v0, v1, v2, distance, onSegment, onTriangle))
+				continue;
+			if(hit.Hit && distance >= hit.Distance)
+				continue;
+
+			Vec3 normal = onSegment - onTriangle;
+			if(LengthSq(normal) > 1e-12f)
+				normal = Normalize(normal);
+			else
+			{
+				// Touching or crossing: use the face, turned against the motion.
+				normal = Normalize(Cross(v1 - v0, v2 - v0));
+				if(Dot(normal, direction) > 0.0f)
+					normal = -normal;
+			}
+
+			hit.Hit = true;
+			hit.Distance = distance;
+			hit.Position = onTriangle;
+			hit.Normal = normal;
+			hit.Triangle = t;
+			best = distance;
+		}
+	}
+	return hit.Hit;
+}
+
+TerrainCollision::TerrainCollision(size_t chunkCount)
+{
+	Resize(chunkCount);
+}
+
+std::shared_ptr<const TerrainCollision::State> TerrainCollision::Load()const
+{
+	return std::atomic_load(&mState);
+}
+
+void TerrainCollision::Publish(const std::shared_ptr<State>& state)
+{
+	std::vector<ChunkBox> boxes;
+	for(size_t c = 0; c < state->Chunks.size(); ++c)
+	{
+		const Collider& collider = state->Chunks[c];
+		if(!collider || collider->Nodes().empty())
+			continue;
+		ChunkBox box;
+		box.Bounds = collider->Bounds();
+		box.Centroid = box.Bounds.Center();
+		box.Chunk = (uint32_t)c;
+		boxes.push_back(box);
+	}
+
+	state->Nodes.clear();
+	if(!boxes.empty())
+	{
+		state->Nodes.reserve(2*boxes.size());
+		BuildChunkNode(state->Nodes, boxes, 0, (uint32_t)boxes.size());
+	}
+	std::atomic_store(&mState, std::shared_ptr<const State>(state));
+}
+
+void TerrainCollision::Resize(size_t chunkCount)
+{
+	std::lock_guard<std::mutex> lock(mWriteMutex);
+	std::shared_ptr<State> state = std::make_shared<State>();
+	state->Chunks.resize(chunkCount);
+	Publish(state);
+}
+
+size_t TerrainCollision::ChunkCount()const
+{
+	return Load()->Chunks.size();
+}
+
+void TerrainCollision::SetChunk(size_t chunk, const Collider& collider)
+{
+	std::lock_guard<std::mutex> lock(mWriteMutex);
+	std::shared_ptr<State> state = std::make_shared<State>();
+	state->Chunks = Load()->Chunks;
+	state->Chunks[chunk] = collider;
+	Publish(state);
+}
+
+TerrainCollision::Collider TerrainCollision::Chunk(size_t chunk)const
+{
+	return Load()->Chunks[chunk];
+}
+
+bool TerrainCollision::UpdateChunk(size_t chunk, const CollisionMesh& mesh)
+{
+	// Readers may hold the current collider, so refit a copy.
+	Collider current = Chunk(chunk);
+	std::shared_ptr<CollisionBVH> next;
+	bool refitted = false;
+	if(current && current->Mesh().TriangleCount() == mesh.TriangleCount())
+	{
+		next = std::make_shared<CollisionBVH>(*current);
+		refitted = next->Update(mesh);
+	}
+	else
+	{
+		next = std::make_shared<CollisionBVH>();
+		next->Build(mesh);
+	}
+	SetChunk(chunk, next);
+	return refitted;
+}
+
+bool TerrainCollision::OverlapCapsule(const Vec3& a, const Vec3& b, float radius)const
+{
+	std::shared_ptr<const State> state = Load();
+	if(state->Nodes.empty())
+		return false;
+
+	AABB query = CapsuleBounds(a, b, radius);
+	uint32_t stack[StackSize];
+	int top = 0;
+	stack[top++] = 0;
+	while(top > 0)
+	{
+		uint32_t index = stack[--top];
+		const CollisionBVH::Node& node = state->Nodes[index];
+		if(!query.Overlaps(AABB(node.Min, node.Max)))
+			continue;
+
+		if(node.Count == 0)
+		{
+			stack[top++] = node.LeftOrFirst;
+			stack[top++] = index + 1;
+		}
+		else if(state->Chunks[node.LeftOrFirst]->OverlapCapsule(a, b, radius))
+			return true;
+	}
+	return false;
+}
+
+bool TerrainCollision::SweepCapsule(const Vec3& a, const Vec3& b, float radius, const Vec3& direction,
+	float maxDistance, CollisionHit& hit, size_t* hitChunk)const
+{
+	hit = CollisionHit();
+
+	std::shared_ptr<const State> state = Load();
+	if(state->Nodes.empty())
+		return false;
+
+	// The same walk as CollisionBVH::SweepCapsule, over chunk bounds.
+	Vec3 center = (a + b)*0.5f;
+	Vec3 half = CapsuleBounds(a, b, radius).Extents();
+
+	float best = maxDistance;
+	size_t bestChunk = 0;
+	struct Entry
+	{
+		uint32_t Node;
+		float Enter;
+	};
+	Entry stack[StackSize];
+	int top = 0;
+
+	float enter;
+	if(!RayBox(center, direction, state->Nodes[0].Min - half, state->Nodes[0].Max + half, best, enter))
+		return false;
+	stack[top].Node = 0;
+	stack[top++].Enter = enter;
+
+	while(top > 0)
+	{
+		Entry entry = stack[--top];
+		if(entry.Enter > best)
+			continue;
+
+		const CollisionBVH::Node& node = state->Nodes[entry.Node];
+		if(node.Count == 0)
+		{
+			uint32_t children[2] = { entry.Node + 1, node.LeftOrFirst };
+			float enters[2];
+			bool hits[2];
+			for(int c = 0; c < 2; ++c)
+			{
+				const CollisionBVH::Node& child = state->Nodes[children[c]];
+				hits[c] = RayBox(center, direction, child.Min - half, child.Max + half, best, enters[c]);
+			}
+			int nearFirst = hits[0] && hits[1] && enters[1] < enters[0] ? 1 : 0;
+			for(int k = 1; k >= 0; --k)
+			{
+				int c = k == 0 ? nearFirst : 1 - nearFirst;
+				if(hits[c])
+				{
+					stack[top].Node = children[c];
+					stack[top++].Enter = enters[c];
+				}
+			}
+			continue;
+		}
+
+		// Equal distances go to the lower chunk, whatever order the walk found them in.
+		size_t chunk = node.LeftOrFirst;
+		CollisionHit chunkHit;
+		if(state->Chunks[chunk]->SweepCapsule(a, b, radius, direction, best, chunkHit) &&
+			(!hit.Hit || chunkHit.Distance < hit.Distance || (chunkHit.Distance == hit.Distance && chunk < bestChunk)))
+		{
+			hit = chunkHit;
+			best = chunkHit.Distance;
+			bestChunk = chunk;
+		}
+	}
+
+	if(hit.Hit && hitChunk)
+		*hitChunk = bestChunk;
+	return hit.Hit;
+}
@@ -0,0 +1,196 @@
+#ifndef TERRAINCOLLISION_H
+#define TERRAINCOLLISION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "TerrainMesher.h"
+#include "VecMath.h"
+
+///<summary>
+/// Triangles for collision only: positions and three indices per triangle.
+///</summary>
+struct CollisionMesh
+{
+	std::vector<Vec3> Positions;
+	std::vector<uint32_t> Indices;
+
+	size_t TriangleCount()const { return Indices.size() / 3; }
+
+	void Clear()
+	{
+		Positions.clear();
+		Indices.clear();
+	}
+
+	// Copies triangles (three indices each) of a chunk mesh, keeping only the vertices
+	// they use.  With weldDistance > 0 vertices are clustered on a grid of that spacing
+	// and triangles that collapse are dropped, which coarsens the mesh by up to
+	// weldDistance; 0 keeps it exact.
+	static void FromChunk(const TerrainChunkMesh& chunk, const uint32_t* indices, size_t indexCount,
+		float weldDistance, CollisionMesh& out);
+};
+
+struct CollisionHit
+{
+	CollisionHit() : Hit(false), Distance(0.0f), Triangle(0) {}
+
+	bool Hit;
+	float Distance;     // How far the shape moved before touching; 0 if it started in contact.
+	Vec3 Position;      // Contact point on the triangle.
+	Vec3 Normal;        // Unit length, from the triangle towards the shape.
+	uint32_t Triangle;  // In the collider's mesh.
+};
+
+///<summary>
+/// Bounding volume hierarchy over a CollisionMesh, for sphere and capsule queries.
+///
+/// Build splits by the surface area heuristic over binned centroids and stores the
+/// nodes depth first in 32 bytes each, a left child right after its parent, so a walk
+/// mostly moves forward through memory; the mesh's triangles are reordered to match the
+/// leaves.  Refit recomputes the bounds bottom up for moved vertices or a new mesh with
+/// the same triangle count, without touching the tree's shape.  Refitting to very
+/// different triangles loosens the tree, so Update rebuilds once the refitted SAH cost
+/// passes RebuildRatio times the cost at the last build.
+///
+/// From MaxSAHDepth levels down Build stops weighing splits and halves each node at its
+/// median, so no tree is deeper than MaxDepth however the triangles lie, and the fixed
+/// stacks the queries walk it with cannot overflow.
+///
+/// A sphere is a capsule whose segment has no length.  Sweeps advance the shape towards
+/// each triangle by Newton steps on their gap, which is convex along the path, so a
+/// step does not pass the first contact; one that rounding carries into the triangle
+/// is caught and the contact bisected instead.  A sweep reports the contact once the
+/// gap is within SweepTolerance, and never a distance where the shape overlaps.  One
+/// that grazes a triangle without closing to that in 64 steps reports no contact with
+/// it, since the shape is still clear where it gave up.
+///
+/// Queries are const and keep their state on the stack; any number of threads may
+/// query one collider at once, but not while it is refitted or rebuilt.
+/// TerrainCollision swaps whole colliders instead.
+///</summary>
+class CollisionBVH
+{
+public:
+	static const uint32_t MaxLeafTriangles = 4;
+	static const uint32_t MaxSAHDepth = 32;
+	// MaxSAHDepth plus the median splits that bring 2^32 triangles down to leaves.
+	static const uint32_t MaxDepth = 62;
+	static const float SweepTolerance;
+	static const float RebuildRatio;
+
+	struct Node
+	{
+		Vec3 Min;
+		uint32_t LeftOrFirst;   // First triangle of a leaf, or the right child.
+		Vec3 Max;
+		uint32_t Count;         // Triangles in a leaf, 0 for an interior node.
+	};
+
+	CollisionBVH();
+
+	void Build(const CollisionMesh& mesh);
+
+	// The mesh must have as many triangles as the one the tree was built over.  Its
+	// triangles are taken in their order in mesh and reordered to the leaves.
+	void Refit(const CollisionMesh& mesh);
+
+	// Refits if the triangle count matches and the tree stays tight, else rebuilds.
+	// Returns true if it refitted.
+	bool Update(const CollisionMesh& mesh);
+
+	bool OverlapSphere(const Vec3& center, float radius, std::vector<uint32_t>* triangles = 0)const;
+	bool OverlapCapsule(const Vec3& a, const Vec3& b, float radius, std::vector<uint32_t>* triangles = 0)const;
+
+	// direction is unit length.  Reports the first contact within maxDistance.
+	bool SweepSphere(const Vec3& center, float radius, const Vec3& direction, float maxDistance, CollisionHit& hit)const;
+	bool SweepCapsule(const Vec3& a, const Vec3& b, float radius, const Vec3& direction, float maxDistance,
+		CollisionHit& hit)const;
+
+	const CollisionMesh& Mesh()const { return mMesh; }
+	const std::vector<Node>& Nodes()const { return mNodes; }
+	AABB Bounds()const;
+
+	// Levels below the root of the deepest leaf.
+	uint32_t Depth()const { return mDepth; }
+
+	// Expected cost of a query, in node-box areas; lower is better.
+	float SAHCost()const;
+
+private:
+	struct BuildTriangle
+	{
+		AABB Bounds;
+		Vec3 Centroid;
+		uint32_t Source;
+	};
+
+	uint32_t BuildNode(std::vector<BuildTriangle>& triangles, uint32_t begin, uint32_t end, uint32_t depth);
+	void ReorderMesh(const CollisionMesh& mesh);
+	void RefitNodes();
+	AABB TriangleBounds(uint32_t triangle)const;
+
+	CollisionMesh mMesh;            // Triangles in leaf order.
+	std::vector<Node> mNodes;
+	std::vector<uint32_t> mSource;  // Triangle index in the built mesh for each leaf slot.
+	float mBuiltCost;
+	uint32_t mDepth;
+};
+
+///<summary>
+/// Collision over every terrain chunk.  Each chunk's collider is an immutable
+/// CollisionBVH behind a shared_ptr, and the colliders are published together with a
+/// tree over their bounds as one immutable state.  A query takes its own reference to
+/// the state, walks the tree to the colliders its shape reaches and keeps the nearest
+/// contact, so it costs the log of the chunk count rather than a pass over every chunk.
+/// A chunk can be remeshed and a new state published while other threads are still
+/// querying the old one, which is freed when the last of them finishes.  Publishing
+/// copies the chunk list and rebuilds the tree, which is cheap next to building one
+/// collider; writers take a lock, so chunks may be updated from several threads.
+///</summary>
+class TerrainCollision
+{
+public:
+	typedef std::shared_ptr<const CollisionBVH> Collider;
+
+	explicit TerrainCollision(size_t chunkCount = 0);
+
+	// Sets the chunk count and removes every chunk's collider.  Safe while queries run.
+	void Resize(size_t chunkCount);
+	size_t ChunkCount()const;
+
+	// Safe while queries run.  A null collider removes the chunk.
+	void SetChunk(size_t chunk, const Collider& collider);
+	Collider Chunk(size_t chunk)const;
+
+	// Builds a collider for a new mesh, or refits a copy of the chunk's current one
+	// when CollisionBVH::Update allows it, and publishes it.  Returns true if it refitted.
+	bool UpdateChunk(size_t chunk, const CollisionMesh& mesh);
+
+	bool OverlapCapsule(const Vec3& a, const Vec3& b, float radius)const;
+	bool SweepCapsule(const Vec3& a, const Vec3& b, float radius, const Vec3& direction, float maxDistance,
+		CollisionHit& hit, size_t* hitChunk = 0)const;
+
+private:
+	TerrainCollision(const TerrainCollision& rhs);
+	TerrainCollision& operator=(const TerrainCollision& rhs);
+
+	// Leaves of the tree hold one chunk each, its index in LeftOrFirst.  Chunks with
+	// no collider or no triangles are left out.
+	struct State
+	{
+		std::vector<Collider> Chunks;
+		std::vector<CollisionBVH::Node> Nodes;
+	};
+
+	std::shared_ptr<const State> Load()const;
+	void Publish(const std::shared_ptr<State>& state);
+
+	std::shared_ptr<const State> mState;
+	std::mutex mWriteMutex;
+};
+
+#endif // TERRAINCOLLISION_H
@@ -0,0 +1,46 @@
+#include "TerrainEffectConstants.h"
+
+// HLSL packing: nothing straddles a 16-byte register, structs and matrices start one.
+static_assert(offsetof(TerrainEffectConstants::StaticConstants, CornerHeight) == 64, "cbStatic layout");
+static_assert(offsetof(TerrainEffectConstants::StaticConstants, VoxelSize) == 68, "cbStatic layout");
+static_assert(offsetof(TerrainEffectConstants::StaticConstants, Material) == 80, "cbStatic layout");
+static_assert(sizeof(TerrainEffectConstants::StaticConstants) == 144, "cbStatic layout");
+static_assert(offsetof(TerrainEffectConstants::PerFrameConstants, EyePosW) == 192, "cbPerFrame layout");
+static_assert(offsetof(TerrainEffectConstants::PerFrameConstants, ViewProj) == 208, "cbPerFrame layout");
+static_assert(sizeof(TerrainEffectConstants::PerFrameConstants) == 272, "cbPerFrame layout");
+static_assert(offsetof(TerrainEffectConstants::PerObjectConstants, Chunk) == 128, "cbPerObject layout");
+static_assert(offsetof(TerrainEffectConstants::ChunkConstants, Extent) == 16, "cbPerObject layout");
+static_assert(sizeof(TerrainEffectConstants::PerObjectConstants) == 160, "cbPerObject layout");
+
+const size_t TerrainEffectConstants::LightSize;
+const size_t TerrainEffectConstants::LightCount;
+const size_t TerrainEffectConstants::MaterialSize;
+
+const char* TerrainEffectConstants::CBufferName(Slot slot)
+{
+	static const char* names[SlotCount] = { "cbStatic", "cbPerFrame", "cbPerObject" };
+	return names[slot];
+}
+
+TerrainEffectConstants::TerrainEffectConstants()
+{
+	mStatic = mCache.AddBlock(sizeof(StaticConstants), ConstantBufferCache::Static, StaticSlot);
+	mPerFrame = mCache.AddBlock(sizeof(PerFrameConstants), ConstantBufferCache::PerFrame, PerFrameSlot);
+	mPerObject = mCache.AddBlock(offsetof(PerObjectConstants, Chunk), ConstantBufferCache::PerObject, PerObjectSlot);
+}
+
+void TerrainEffectConstants::InvalidateAll()
+{
+	mCache.Invalidate(mStatic);
+	mCache.Invalidate(mPerFrame);
+	mCache.Invalidate(mPerObject);
+}
+
+void TerrainEffectConstants::SetMatrix(ConstantBufferCache::BlockId block, size_t offset, const Mat4& m)
+{
+	Mat4 transposed;
+	for(int r = 0; r < 4; ++r)
+		for(int c = 0; c < 4; ++c)
+			transposed.m[r][c] = m.m[c][r];
+	mCache.Set(block, offset, transposed);
+}
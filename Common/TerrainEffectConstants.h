@@ -0,0 +1,108 @@
+#ifndef TERRAINEFFECTCONSTANTS_H
+#define TERRAINEFFECTCONSTANTS_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "ConstantBufferCache.h"
+#include "VecMath.h"
+
+///<summary>
+/// The terrain effect's constants (marchingCubes.fx), split into cbuffers by how often
+/// they change: cbStatic holds what is fixed once the world is built (texture
+/// transform, grid size, material), cbPerFrame the camera and lights, and cbPerObject
+/// the terrain's own transforms and the box of the chunk being drawn.  Effects11 uploads a whole cbuffer once any
+/// byte of it changes, so a moving camera no longer drags the static fields along.
+///
+/// Every setter goes through a ConstantBufferCache, so values re-set each frame only
+/// reach the backend when they differ.  The chunk box is not cached: it changes with
+/// every terrain draw, which carries it as DrawConstants.  The structs mirror the compiled layout, with
+/// matrices transposed for the shader's default column_major packing; lights and the
+/// material are LightHelper.h's DirectionalLight and Material, passed as bytes so this
+/// class builds without DirectXMath.
+///</summary>
+class TerrainEffectConstants
+{
+public:
+	// Backend slots, one per cbuffer.
+	enum Slot
+	{
+		StaticSlot,
+		PerFrameSlot,
+		PerObjectSlot,
+		SlotCount
+	};
+
+	static const size_t LightSize = 64;     // DirectionalLight
+	static const size_t LightCount = 3;
+	static const size_t MaterialSize = 64;  // Material
+
+	struct StaticConstants
+	{
+		Mat4 TexTransform;
+		uint32_t CornerHeight;
+		Vec3 VoxelSize;
+		uint8_t Material[MaterialSize];
+	};
+
+	struct PerFrameConstants
+	{
+		uint8_t DirLights[LightCount*LightSize];
+		Vec3 EyePosW;
+		float Pad;
+		Mat4 ViewProj;
+	};
+
+	// The box a chunk's TerrainCompact grid positions are quantized over.
+	struct ChunkConstants
+	{
+		Vec3 Origin;
+		float Pad0;
+		Vec3 Extent;
+		float Pad1;
+	};
+
+	struct PerObjectConstants
+	{
+		Mat4 World;
+		Mat4 WorldViewProj;
+		ChunkConstants Chunk;
+	};
+
+	static const char* CBufferName(Slot slot);
+
+	TerrainEffectConstants();
+
+	// cbStatic
+	void SetTexTransform(const Mat4& m) { SetMatrix(mStatic, offsetof(StaticConstants, TexTransform), m); }
+	void SetCornerHeight(uint32_t n) { mCache.Set(mStatic, offsetof(StaticConstants, CornerHeight), n); }
+	void SetVoxelSize(const Vec3& v) { mCache.Set(mStatic, offsetof(StaticConstants, VoxelSize), v); }
+	void SetMaterial(const void* material) { mCache.Set(mStatic, offsetof(StaticConstants, Material), material, MaterialSize); }
+
+	// cbPerFrame
+	void SetDirLights(const void* lights) { mCache.Set(mPerFrame, offsetof(PerFrameConstants, DirLights), lights, LightCount*LightSize); }
+	void SetEyePosW(const Vec3& v) { mCache.Set(mPerFrame, offsetof(PerFrameConstants, EyePosW), v); }
+	void SetViewProj(const Mat4& m) { SetMatrix(mPerFrame, offsetof(PerFrameConstants, ViewProj), m); }
+
+	// cbPerObject
+	void SetWorld(const Mat4& m) { SetMatrix(mPerObject, offsetof(PerObjectConstants, World), m); }
+	void SetWorldViewProj(const Mat4& m) { SetMatrix(mPerObject, offsetof(PerObjectConstants, WorldViewProj), m); }
+
+	// Hands every changed range to backend, by slot.
+	void Flush(IConstantBufferBackend& backend) { mCache.Flush(backend); }
+
+	// After the device lost its buffers.
+	void InvalidateAll();
+
+	const ConstantBufferCache& Cache()const { return mCache; }
+
+private:
+	void SetMatrix(ConstantBufferCache::BlockId block, size_t offset, const Mat4& m);
+
+	ConstantBufferCache mCache;
+	ConstantBufferCache::BlockId mStatic;
+	ConstantBufferCache::BlockId mPerFrame;
+	ConstantBufferCache::BlockId mPerObject;
+};
+
+#endif // TERRAINEFFECTCONSTANTS_H
@@ -0,0 +1,241 @@
+#include "TerrainMesher.h"
+#include "FastNoise.h"
+#include "MarchingCubesTables.h"
+#include "ParallelFor.h"
+#include "VertexCompression.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+//---------------------------------------------------------------------------------------
+// DensityField
+//---------------------------------------------------------------------------------------
+
+DensityField::DensityField()
+	: mSizeX(0), mSizeY(0), mSizeZ(0)
+{
+}
+
+void DensityField::Resize(int sizeX, int sizeY, int sizeZ)
+{
+	mSizeX = sizeX;
+	mSizeY = sizeY;
+	mSizeZ = sizeZ;
+	mSamples.assign(size_t(sizeX)*sizeY*sizeZ, 0.0f);
+}
+
+void DensityField::Generate(FastNoise& noise, int originX, int originY, int originZ, float scale)
+{
+	for(int y = 0; y < mSizeY; ++y)
+	{
+		for(int z = 0; z < mSizeZ; ++z)
+		{
+			float* row = &mSamples[Index(0, y, z)];
+			for(int x = 0; x < mSizeX; ++x)
+			{
+				row[x] = noise.GetNoise(FN_DECIMAL((originX + x)*scale),
+				                        FN_DECIMAL((originZ + z)*scale),
+				                        FN_DECIMAL((originY + y)*scale));
+			}
+		}
+	}
+}
+
+Vec3 DensityField::Gradient(int x, int y, int z)const
+{
+	int x0 = std::max(x - 1, 0), x1 = std::min(x + 1, mSizeX - 1);
+	int y0 = std::max(y - 1, 0), y1 = std::min(y + 1, mSizeY - 1);
+	int z0 = std::max(z - 1, 0), z1 = std::min(z + 1, mSizeZ - 1);
+
+	return Vec3(
+		(At(x1, y, z) - At(x0, y, z)) / float(std::max(x1 - x0, 1)),
+		(At(x, y1, z) - At(x, y0, z)) / float(std::max(y1 - y0, 1)),
+		(At(x, y, z1) - At(x, y, z0)) / float(std::max(z1 - z0, 1)));
+}
+
+//---------------------------------------------------------------------------------------
+// TerrainMesher
+//---------------------------------------------------------------------------------------
+
+void TerrainMesher::Extract(const DensityField& field, const Vec3& origin, const Vec3& voxelSize, TerrainChunkMesh& mesh)
+{
+	mesh.Clear();
+
+	int sx = field.SizeX();
+	int sy = field.SizeY();
+	int sz = field.SizeZ();
+	if(sx < 2 || sy < 2 || sz < 2)
+		return;
+
+	mEdgeVertex.assign(size_t(sx)*sy*sz*3, MeshOptimizer::InvalidIndex);
+
+	Vec3 invVoxelSize(1.0f / voxelSize.x, 1.0f / voxelSize.y, 1.0f / voxelSize.z);
+
+	// Welds the vertex on the edge leaving corner (x,y,z) along axis.
+	auto edgeVertex = [&](int x, int y, int z, int axis) -> uint32_t
+	{
+		uint32_t& slot = mEdgeVertex[field.Index(x, y, z)*3 + axis];
+		if(slot != MeshOptimizer::InvalidIndex)
+			return slot;
+
+		int x1 = x + (axis == 0);
+		int y1 = y + (axis == 1);
+		int z1 = z + (axis == 2);
+
+		float d0 = field.At(x, y, z);
+		float d1 = field.At(x1, y1, z1);
+
+		// Same interpolation as the geometry shader, including its snapping of
+		// near-zero densities to the corner.
+		float t;
+		if(std::fabs(d0) < 1e-4f)
+			t = 0.0f;
+		else if(std::fabs(d1) < 1e-4f)
+			t = 1.0f;
+		else
+			t = std::min(std::max(-d0 / (d1 - d0), 0.0f), 1.0f);
+
+		Vec3 corner((float)x, (float)y, (float)z);
+		corner[axis] += t;
+
+		Vec3 gradient = Lerp(field.Gradient(x, y, z), field.Gradient(x1, y1, z1), t) * invVoxelSize;
+
+		Vec3 p = origin + corner*voxelSize;
+		slot = uint32_t(mesh.Positions.size());
+		mesh.Positions.push_back(p);
+		mesh.Normals.push_back(Normalize(-gradient));
+		mesh.Bounds.Extend(p);
+		return slot;
+	};
+
+	for(int y = 0; y < sy - 1; ++y)
+	{
+		for(int z = 0; z < sz - 1; ++z)
+		{
+			for(int x = 0; x < sx - 1; ++x)
+			{
+				int caseIndex = 0;
+				for(int c = 0; c < 8; ++c)
+				{
+					const int* o = MarchingCubesTables::CornerOffset[c];
+					if(field.At(x + o[0], y + o[1], z + o[2]) > 0.0f)
+						caseIndex |= 1 << c;
+				}
+
+				int triangleCount = MarchingCubesTables::CaseTriangleCount[caseIndex];
+				for(int t = 0; t < triangleCount; ++t)
+				{
+					uint32_t v[3];
+					for(int k = 0; k < 3; ++k)
+					{
+						int edge = MarchingCubesTables::TriTable[caseIndex][t][k];
+						const int* o = MarchingCubesTables::CornerOffset[MarchingCubesTables::EdgeCorners[edge][0]];
+						v[k] = edgeVertex(x + o[0], y + o[1], z + o[2], MarchingCubesTables::EdgeAxis[edge]);
+					}
+
+					// Corner snapping can collapse a triangle; drop it rather than emit
+					// a zero-area face.
+					const Vec3& p0 = mesh.Positions[v[0]];
+					Vec3 faceNormal = Cross(mesh.Positions[v[1]] - p0, mesh.Positions[v[2]] - p0);
+					if(LengthSq(faceNormal) == 0.0f)
+						continue;
+
+					// Wind the triangle so its face normal agrees with the gradient normals,
+					// keeping front faces outward regardless of the table's winding.
+					Vec3 vertexNormal = mesh.Normals[v[0]] + mesh.Normals[v[1]] + mesh.Normals[v[2]];
+					if(Dot(faceNormal, vertexNormal) < 0.0f)
+						std::swap(v[1], v[2]);
+
+					mesh.Indices.push_back(v[0]);
+					mesh.Indices.push_back(v[1]);
+					mesh.Indices.push_back(v[2]);
+				}
+			}
+		}
+	}
+}
+
+MeshOptimizer::Report TerrainMesher::Optimize(TerrainChunkMesh& mesh)
+{
+	if(mesh.Indices.empty())
+		return MeshOptimizer::Report();
+
+	MeshOptimizer::Report report = MeshOptimizer::Optimize(mesh.Indices, mesh.Positions.size(),
+		&mesh.Positions[0].x, sizeof(Vec3), mRemap);
+
+	size_t vertexCount = 0;
+	for(size_t i = 0; i < mRemap.size(); ++i)
+	{
+		if(mRemap[i] != MeshOptimizer::InvalidIndex)
+			++vertexCount;
+	}
+
+	MeshOptimizer::RemapVertices(mesh.Positions, mRemap.data(), vertexCount);
+	MeshOptimizer::RemapVertices(mesh.Normals, mRemap.data(), vertexCount);
+	return report;
+}
+
+MeshOptimizer::Report TerrainMesher::Optimize(TerrainChunkMesh& mesh, std::vector<std::vector<uint32_t> >& chunks)
+{
+	MeshOptimizer::Report report;
+	const size_t vertexCount = mesh.Positions.size();
+	if(vertexCount == 0)
+		return report;
+
+	mesh.Indices.clear();
+	for(size_t c = 0; c < chunks.size(); ++c)
+		mesh.Indices.insert(mesh.Indices.end(), chunks[c].begin(), chunks[c].end());
+	report.Before = MeshOptimizer::AnalyzeVertexCache(mesh.Indices.data(), mesh.Indices.size(), vertexCount);
+
+	// Chunks are drawn one at a time, so each is ordered for the cache on its own.
+	const float* positions = &mesh.Positions[0].x;
+	ParallelFor(chunks.size(), 1, [&chunks, positions, vertexCount](size_t begin, size_t end)
+	{
+		for(size_t c = begin; c < end; ++c)
+		{
+			std::vector<uint32_t>& indices = chunks[c];
+			MeshOptimizer::OptimizeVertexCache(indices.data(), indices.data(), indices.size(), vertexCount);
+			MeshOptimizer::OptimizeOverdraw(indices.data(), indices.size(), positions, sizeof(Vec3), vertexCount);
+		}
+	});
+
+	// Vertices on a chunk border keep one copy, placed where the first chunk using it
+	// needs it.
+	mesh.Indices.clear();
+	for(size_t c = 0; c < chunks.size(); ++c)
+		mesh.Indices.insert(mesh.Indices.end(), chunks[c].begin(), chunks[c].end());
+
+	mRemap.resize(vertexCount);
+	size_t newVertexCount = MeshOptimizer::OptimizeVertexFetchRemap(mRemap.data(), mesh.Indices.data(),
+		mesh.Indices.size(), vertexCount);
+	MeshOptimizer::RemapIndices(mesh.Indices.data(), mesh.Indices.size(), mRemap.data());
+	for(size_t c = 0; c < chunks.size(); ++c)
+		MeshOptimizer::RemapIndices(chunks[c].data(), chunks[c].size(), mRemap.data());
+	MeshOptimizer::RemapVertices(mesh.Positions, mRemap.data(), newVertexCount);
+	MeshOptimizer::RemapVertices(mesh.Normals, mRemap.data(), newVertexCount);
+
+	report.After = MeshOptimizer::AnalyzeVertexCache(mesh.Indices.data(), mesh.Indices.size(), newVertexCount);
+	return report;
+}
+
+void TerrainMesher::PackCompact(const TerrainChunkMesh& mesh, void* dst, size_t dstStride)
+{
+	if(mesh.Positions.empty())
+		return;
+
+	Vec3 extent = mesh.Bounds.Size();
+	unsigned char* out = static_cast<unsigned char*>(dst);
+
+	// Vertex::TerrainCompact: UNORM16x4 position at offset 0, SNORM16x2 normal at 8.
+	VertexCompression::QuantizePositions(&mesh.Positions[0].x, sizeof(Vec3), mesh.Positions.size(),
+		&mesh.Bounds.Min.x, &extent.x, out, dstStride);
+	VertexCompression::EncodeOctNormals(&mesh.Normals[0].x, sizeof(Vec3), mesh.Normals.size(),
+		out + 8, dstStride);
+
+	for(size_t i = 0; i < mesh.Positions.size(); ++i)
+	{
+		uint16_t one = 0xFFFF;
+		std::memcpy(out + i*dstStride + 6, &one, sizeof(one));
+	}
+}
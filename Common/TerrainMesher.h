@@ -0,0 +1,105 @@
+#ifndef TERRAINMESHER_H
+#define TERRAINMESHER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "MeshOptimizer.h"
+#include "VecMath.h"
+
+class FastNoise;
+
+///<summary>
+/// Density samples on the corners of a block of voxels.  Samples are stored x fastest,
+/// then z, then y, the same layout TerrainApp uploads to its R32_FLOAT Texture3D
+/// (width = x, height = z, depth = y).  Positive density is solid.
+///</summary>
+class DensityField
+{
+public:
+	DensityField();
+
+	void Resize(int sizeX, int sizeY, int sizeZ);
+
+	// Fills every corner with noise.GetNoise(x, z, y) * scale, where (x, y, z) is the
+	// corner's integer coordinate offset by origin.  TerrainWorld::Build generates the
+	// field TerrainApp uploads this way, at origin (0,0,0).
+	void Generate(FastNoise& noise, int originX, int originY, int originZ, float scale = 1.0f);
+
+	int SizeX()const { return mSizeX; }
+	int SizeY()const { return mSizeY; }
+	int SizeZ()const { return mSizeZ; }
+
+	size_t Index(int x, int y, int z)const { return (size_t(y)*mSizeZ + z)*mSizeX + x; }
+
+	float  At(int x, int y, int z)const { return mSamples[Index(x, y, z)]; }
+	float& At(int x, int y, int z)      { return mSamples[Index(x, y, z)]; }
+
+	const float* Data()const { return mSamples.data(); }
+	float* Data()            { return mSamples.data(); }
+
+	// Central-difference gradient at a corner (one-sided on the border), in density
+	// units per voxel.
+	Vec3 Gradient(int x, int y, int z)const;
+
+private:
+	int mSizeX;
+	int mSizeY;
+	int mSizeZ;
+	std::vector<float> mSamples;
+};
+
+///<summary>
+/// Output of TerrainMesher::Extract: an indexed triangle list with one vertex per
+/// crossed voxel edge, so neighbouring cells share their vertices.
+///</summary>
+struct TerrainChunkMesh
+{
+	std::vector<Vec3> Positions;
+	std::vector<Vec3> Normals;
+	std::vector<uint32_t> Indices;
+	AABB Bounds;
+
+	void Clear()
+	{
+		Positions.clear();
+		Normals.clear();
+		Indices.clear();
+		Bounds = AABB();
+	}
+};
+
+///<summary>
+/// CPU marching cubes over a DensityField, producing the same surface as
+/// FX/marchingCubes.fx: identical tables, edge interpolation and gradient normals.
+/// A TerrainMesher keeps its scratch memory between calls, so reuse one instance per
+/// worker thread when extracting many chunks.
+///</summary>
+class TerrainMesher
+{
+public:
+	// Extracts the zero isosurface of field.  origin is the world position of corner
+	// (0,0,0) and voxelSize the world size of one cell.  Mesh contents are replaced.
+	void Extract(const DensityField& field, const Vec3& origin, const Vec3& voxelSize, TerrainChunkMesh& mesh);
+
+	// Reorders the chunk for the post-transform cache, overdraw and vertex fetch.
+	MeshOptimizer::Report Optimize(TerrainChunkMesh& mesh);
+
+	// The same for a mesh whose triangles are split into chunks that index its shared
+	// vertices: each chunk's triangles are reordered on their own, then the vertices
+	// are numbered in the order the chunks, in turn, first use them, and mesh.Indices
+	// becomes the chunks' indices concatenated.  The report covers that concatenation.
+	MeshOptimizer::Report Optimize(TerrainChunkMesh& mesh, std::vector<std::vector<uint32_t> >& chunks);
+
+	// Writes the chunk as Vertex::TerrainCompact (12 bytes: UNORM16x4 position over
+	// mesh.Bounds, octahedral SNORM16x2 normal) into dst with the given stride.
+	static void PackCompact(const TerrainChunkMesh& mesh, void* dst, size_t dstStride);
+
+private:
+	// Vertex index for each (corner, axis) edge of the field, or InvalidIndex.
+	std::vector<uint32_t> mEdgeVertex;
+	std::vector<uint32_t> mRemap;
+};
+
+#endif // TERRAINMESHER_H
@@ -0,0 +1,417 @@
+#include "TerrainRaycast.h"
+#include "ParallelFor.h"
+
+#include <cfloat>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TERRAINRAYCAST_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	// Corner i of a cell is at (i & 1, (i >> 1) & 1, (i >> 2) & 1).
+	inline float Trilinear(const float c[8], float x, float y, float z)
+	{
+		float c00 = c[0] + (c[1] - c[0])*x;
+		float c10 = c[2] + (c[3] - c[2])*x;
+		float c01 = c[4] + (c[5] - c[4])*x;
+		float c11 = c[6] + (c[7] - c[6])*x;
+		float c0 = c00 + (c10 - c00)*y;
+		float c1 = c01 + (c11 - c01)*y;
+		return c0 + (c1 - c0)*z;
+	}
+
+	// The interpolant at four points of a cell at once, in the same operation order as
+	// Trilinear.
+	inline void TrilinearFour(const float c[8], const float x[4], const float y[4], const float z[4], float out[4])
+	{
+#if defined(TERRAINRAYCAST_SSE2)
+		__m128 X = _mm_loadu_ps(x);
+		__m128 Y = _mm_loadu_ps(y);
+		__m128 Z = _mm_loadu_ps(z);
+		__m128 c0 = _mm_set1_ps(c[0]), c1 = _mm_set1_ps(c[1]), c2 = _mm_set1_ps(c[2]), c3 = _mm_set1_ps(c[3]);
+		__m128 c4 = _mm_set1_ps(c[4]), c5 = _mm_set1_ps(c[5]), c6 = _mm_set1_ps(c[6]), c7 = _mm_set1_ps(c[7]);
+		__m128 c00 = _mm_add_ps(c0, _mm_mul_ps(_mm_sub_ps(c1, c0), X));
+		__m128 c10 = _mm_add_ps(c2, _mm_mul_ps(_mm_sub_ps(c3, c2), X));
+		__m128 c01 = _mm_add_ps(c4, _mm_mul_ps(_mm_sub_ps(c5, c4), X));
+		__m128 c11 = _mm_add_ps(c6, _mm_mul_ps(_mm_sub_ps(c7, c6), X));
+		__m128 y0 = _mm_add_ps(c00, _mm_mul_ps(_mm_sub_ps(c10, c00), Y));
+		__m128 y1 = _mm_add_ps(c01, _mm_mul_ps(_mm_sub_ps(c11, c01), Y));
+		_mm_storeu_ps(out, _mm_add_ps(y0, _mm_mul_ps(_mm_sub_ps(y1, y0), Z)));
+#else
+		for(int i = 0; i < 4; ++i)
+			out[i] = Trilinear(c, x[i], y[i], z[i]);
+#endif
+	}
+
+	inline Vec3 TrilinearGradient(const float c[8], float x, float y, float z)
+	{
+		float dx = ((c[1] - c[0])*(1.0f - y) + (c[3] - c[2])*y)*(1.0f - z) + ((c[5] - c[4])*(1.0f - y) + (c[7] - c[6])*y)*z;
+		float dy = ((c[2] - c[0])*(1.0f - x) + (c[3] - c[1])*x)*(1.0f - z) + ((c[6] - c[4])*(1.0f - x) + (c[7] - c[5])*x)*z;
+		float dz = ((c[4] - c[0])*(1.0f - x) + (c[5] - c[1])*x)*(1.0f - y) + ((c[6] - c[2])*(1.0f - x) + (c[7] - c[3])*x)*y;
+		return Vec3(dx, dy, dz);
+	}
+
+	inline float Clamp01(float v) { return (std::min)((std::max)(v, 0.0f), 1.0f); }
+
+	// The cell a ray at p is in along one axis.  On a cell boundary a ray heading in
+	// the negative direction is in the lower cell.
+	inline int CellCoord(float p, float d, int cells)
+	{
+		float f = std::floor(p);
+		int c = (int)f;
+		if(d < 0.0f && p == f)
+			--c;
+		return (std::min)((std::max)(c, 0), cells - 1);
+	}
+
+	// True if the node cannot contain the surface: all air or all solid.
+	inline bool NodeUniform(float mn, float mx)
+	{
+		return mx <= 0.0f || mn > 0.0f;
+	}
+}
+
+TerrainRaycaster::TerrainRaycaster()
+	: mField(0)
+{
+}
+
+void TerrainRaycaster::Build(const DensityField& field, const Vec3& origin, const Vec3& voxelSize)
+{
+	mField = &field;
+	mOrigin = origin;
+	mVoxelSize = voxelSize;
+	mInvVoxelSize = Vec3(1.0f / voxelSize.x, 1.0f / voxelSize.y, 1.0f / voxelSize.z);
+	mLevels.clear();
+
+	int sx = field.SizeX() - 1;
+	int sy = field.SizeY() - 1;
+	int sz = field.SizeZ() - 1;
+	if(sx < 1 || sy < 1 || sz < 1)
+		return;
+
+	// Halve until one node covers the whole field.
+	for(;;)
+	{
+		Level level;
+		level.SizeX = sx;
+		level.SizeY = sy;
+		level.SizeZ = sz;
+		level.Min.resize(size_t(sx)*sy*sz);
+		level.Max.resize(size_t(sx)*sy*sz);
+		mLevels.push_back(level);
+		if(sx == 1 && sy == 1 && sz == 1)
+			break;
+		sx = (sx + 1) / 2;
+		sy = (sy + 1) / 2;
+		sz = (sz + 1) / 2;
+	}
+
+	for(size_t l = 0; l < mLevels.size(); ++l)
+		BuildLevel(l, 0, 0, 0, mLevels[l].SizeX - 1, mLevels[l].SizeY - 1, mLevels[l].SizeZ - 1);
+}
+
+void TerrainRaycaster::Update(int x0, int y0, int z0, int x1, int y1, int z1)
+{
+	if(mLevels.empty())
+		return;
+
+	// A corner belongs to the cells on both sides of it.
+	const Level& cells = mLevels[0];
+	x0 = (std::max)(x0 - 1, 0); x1 = (std::min)(x1, cells.SizeX - 1);
+	y0 = (std::max)(y0 - 1, 0); y1 = (std::min)(y1, cells.SizeY - 1);
+	z0 = (std::max)(z0 - 1, 0); z1 = (std::min)(z1, cells.SizeZ - 1);
+	if(x0 > x1 || y0 > y1 || z0 > z1)
+		return;
+
+	for(size_t l = 0; l < mLevels.size(); ++l)
+		BuildLevel(l, x0 >> l, y0 >> l, z0 >> l, x1 >> l, y1 >> l, z1 >> l);
+}
+
+void TerrainRaycaster::BuildLevel(size_t l, int x0, int y0, int z0, int x1, int y1, int z1)
+{
+	Level& level = mLevels[l];
+	for(int y = y0; y <= y1; ++y)
+	{
+		for(int z = z0; z <= z1; ++z)
+		{
+			for(int x = x0; x <= x1; ++x)
+			{
+				float mn = FLT_MAX, mx = -FLT_MAX;
+				if(l == 0)
+				{
+					float corners[8];
+					LoadCorners(x, y, z, corners);
+					for(int c = 0; c < 8; ++c)
+					{
+						mn = (std::min)(mn, corners[c]);
+						mx = (std::max)(mx, corners[c]);
+					}
+				}
+				else
+				{
+					const Level& child = mLevels[l - 1];
+					int cx1 = (std::min)(2*x + 1, child.SizeX - 1);
+					int cy1 = (std::min)(2*y + 1, child.SizeY - 1);
+					int cz1 = (std::min)(2*z + 1, child.SizeZ - 1);
+					for(int cy = 2*y; cy <= cy1; ++cy)
+					{
+						for(int cz = 2*z; cz <= cz1; ++cz)
+						{
+							for(int cx = 2*x; cx <= cx1; ++cx)
+							{
+								size_t i = child.Index(cx, cy, cz);
+								mn = (std::min)(mn, child.Min[i]);
+								mx = (std::max)(mx, child.Max[i]);
+							}
+						}
+					}
+				}
+				size_t i = level.Index(x, y, z);
+				level.Min[i] = mn;
+				level.Max[i] = mx;
+			}
+		}
+	}
+}
+
+void TerrainRaycaster::LoadCorners(int x, int y, int z, float corners[8])const
+{
+	for(int c = 0; c < 8; ++c)
+		corners[c] = mField->At(x + (c & 1), y + ((c >> 1) & 1), z + ((c >> 2) & 1));
+}
+
+float TerrainRaycaster::CellDensity(const float corners[8], const Vec3& local)const
+{
+	return Trilinear(corners, Clamp01(local.x), Clamp01(local.y), Clamp01(local.z));
+}
+
+AABB TerrainRaycaster::Bounds()const
+{
+	if(mLevels.empty())
+		return AABB();
+	const Level& cells = mLevels[0];
+	return AABB(mOrigin, mOrigin + Vec3((float)cells.SizeX, (float)cells.SizeY, (float)cells.SizeZ)*mVoxelSize);
+}
+
+float TerrainRaycaster::Density(const Vec3& p)const
+{
+	if(mLevels.empty())
+		return 0.0f;
+
+	const Level& cells = mLevels[0];
+	Vec3 q = (p - mOrigin)*mInvVoxelSize;
+	int x = (std::min)((std::max)((int)std::floor(q.x), 0), cells.SizeX - 1);
+	int y = (std::min)((std::max)((int)std::floor(q.y), 0), cells.SizeY - 1);
+	int z = (std::min)((std::max)((int)std::floor(q.z), 0), cells.SizeZ - 1);
+
+	float corners[8];
+	LoadCorners(x, y, z, corners);
+	return CellDensity(corners, q - Vec3((float)x, (float)y, (float)z));
+}
+
+float TerrainRaycaster::CellExit(const CellRay& ray, float t, int x, int y, int z, int size)const
+{
+	const int lo[3] = { x, y, z };
+	float exit = FLT_MAX;
+	for(int a = 0; a < 3; ++a)
+	{
+		if(ray.Direction[a] > 0.0f)
+			exit = (std::min)(exit, (lo[a] + size - ray.Origin[a])*ray.InvDirection[a]);
+		else if(ray.Direction[a] < 0.0f)
+			exit = (std::min)(exit, (lo[a] - ray.Origin[a])*ray.InvDirection[a]);
+	}
+
+	// Rounding can put the exit at or behind t; always make progress.
+	float minStep = 1e-6f*(1.0f + std::fabs(t));
+	return (std::max)(exit, t + minStep);
+}
+
+bool TerrainRaycaster::TestCell(const CellRay& ray, int x, int y, int z, float t0, float t1, float& tHit)const
+{
+	float corners[8];
+	LoadCorners(x, y, z, corners);
+
+	Vec3 cell((float)x, (float)y, (float)z);
+	float ts[4], lx[4], ly[4], lz[4], f[4];
+	for(int i = 0; i < 4; ++i)
+	{
+		ts[i] = t0 + (t1 - t0)*(i / 3.0f);
+		Vec3 local = ray.Origin + ray.Direction*ts[i] - cell;
+		lx[i] = Clamp01(local.x);
+		ly[i] = Clamp01(local.y);
+		lz[i] = Clamp01(local.z);
+	}
+	TrilinearFour(corners, lx, ly, lz, f);
+
+	if(f[0] > 0.0f)
+	{
+		tHit = t0;
+		return true;
+	}
+
+	for(int i = 1; i < 4; ++i)
+	{
+		if(f[i] <= 0.0f)
+			continue;
+
+		// Illinois regula falsi on [a, b] with f(a) <= 0 < f(b).
+		float a = ts[i - 1], fa = f[i - 1];
+		float b = ts[i], fb = f[i];
+		int side = 0;
+		for(int iteration = 0; iteration < 12; ++iteration)
+		{
+			float t = (fb - fa) != 0.0f ? b - fb*(b - a) / (fb - fa) : 0.5f*(a + b);
+			float ft = CellDensity(corners, ray.Origin + ray.Direction*t - cell);
+			if(std::fabs(ft) < 1e-6f)
+			{
+				a = b = t;
+				break;
+			}
+			if(ft > 0.0f)
+			{
+				b = t;
+				fb = ft;
+				if(side == 1)
+					fa *= 0.5f;
+				side = 1;
+			}
+			else
+			{
+				a = t;
+				fa = ft;
+				if(side == -1)
+					fb *= 0.5f;
+				side = -1;
+			}
+		}
+
+		// The solid end of the bracket, so a hit point never reads as air.
+		tHit = b;
+		return true;
+	}
+	return false;
+}
+
+bool TerrainRaycaster::Raycast(const TerrainRay& ray, TerrainRayHit& hit)const
+{
+	hit = TerrainRayHit();
+	if(mLevels.empty())
+		return false;
+
+	const Level& cells = mLevels[0];
+	const int cellCount[3] = { cells.SizeX, cells.SizeY, cells.SizeZ };
+
+	CellRay r;
+	r.Origin = (ray.Origin - mOrigin)*mInvVoxelSize;
+	r.Direction = ray.Direction*mInvVoxelSize;
+
+	// Clip to the field.
+	float tEnter = 0.0f, tExit = ray.MaxDistance;
+	for(int a = 0; a < 3; ++a)
+	{
+		if(r.Direction[a] == 0.0f)
+		{
+			r.InvDirection[a] = 0.0f;
+			if(r.Origin[a] < 0.0f || r.Origin[a] > (float)cellCount[a])
+				return false;
+			continue;
+		}
+		r.InvDirection[a] = 1.0f / r.Direction[a];
+		float ta = (0.0f - r.Origin[a])*r.InvDirection[a];
+		float tb = ((float)cellCount[a] - r.Origin[a])*r.InvDirection[a];
+		tEnter = (std::max)(tEnter, (std::min)(ta, tb));
+		tExit = (std::min)(tExit, (std::max)(ta, tb));
+	}
+	if(tEnter > tExit)
+		return false;
+
+	float tHit = 0.0f;
+	int hitCell[3] = { 0, 0, 0 };
+	bool found = false;
+
+	float t = tEnter;
+	while(t <= tExit && !found)
+	{
+		Vec3 p = r.Origin + r.Direction*t;
+		int c[3];
+		for(int a = 0; a < 3; ++a)
+			c[a] = CellCoord(p[a], r.Direction[a], cellCount[a]);
+
+		// Jump over the largest node around the ray that holds no surface.
+		bool skipped = false;
+		for(size_t l = mLevels.size() - 1; l >= 1; --l)
+		{
+			const Level& level = mLevels[l];
+			size_t i = level.Index(c[0] >> l, c[1] >> l, c[2] >> l);
+			if(NodeUniform(level.Min[i], level.Max[i]) && !(t == tEnter && level.Min[i] > 0.0f))
+			{
+				int size = 1 << l;
+				t = CellExit(r, t, (c[0] >> l) << l, (c[1] >> l) << l, (c[2] >> l) << l, size);
+				skipped = true;
+				break;
+			}
+		}
+		if(skipped)
+			continue;
+
+		float exit = CellExit(r, t, c[0], c[1], c[2], 1);
+		size_t i = cells.Index(c[0], c[1], c[2]);
+		bool solidStart = t == tEnter && cells.Min[i] > 0.0f;
+		if(!NodeUniform(cells.Min[i], cells.Max[i]) || solidStart)
+		{
+			if(TestCell(r, c[0], c[1], c[2], t, (std::min)(exit, tExit), tHit))
+			{
+				found = true;
+				hitCell[0] = c[0];
+				hitCell[1] = c[1];
+				hitCell[2] = c[2];
+			}
+		}
+		t = exit;
+	}
+	if(!found)
+		return false;
+
+	float corners[8];
+	LoadCorners(hitCell[0], hitCell[1], hitCell[2], corners);
+	Vec3 local = r.Origin + r.Direction*tHit - Vec3((float)hitCell[0], (float)hitCell[1], (float)hitCell[2]);
+	Vec3 gradient = TrilinearGradient(corners, Clamp01(local.x), Clamp01(local.y), Clamp01(local.z))*mInvVoxelSize;
+
+	hit.Hit = true;
+	hit.Distance = tHit;
+	hit.Position = ray.Origin + ray.Direction*tHit;
+	hit.Normal = LengthSq(gradient) > 0.0f ? Normalize(-gradient) : -ray.Direction;
+	hit.CellX = hitCell[0];
+	hit.CellY = hitCell[1];
+	hit.CellZ = hitCell[2];
+	return true;
+}
+
+bool TerrainRaycaster::LineOfSight(const Vec3& a, const Vec3& b)const
+{
+	Vec3 d = b - a;
+	float length = Length(d);
+	if(length <= 0.0f)
+		return Density(a) <= 0.0f;
+
+	TerrainRayHit hit;
+	return !Raycast(TerrainRay(a, d*(1.0f / length), length), hit);
+}
+
+size_t TerrainRaycaster::RaycastBatch(const TerrainRay* rays, TerrainRayHit* hits, size_t count)const
+{
+	ParallelFor(count, 256, [this, rays, hits](size_t begin, size_t end)
+	{
+		for(size_t i = begin; i < end; ++i)
+			Raycast(rays[i], hits[i]);
+	});
+
+	size_t hitCount = 0;
+	for(size_t i = 0; i < count; ++i)
+		hitCount += hits[i].Hit ? 1 : 0;
+	return hitCount;
+}
@@ -0,0 +1,114 @@
+#ifndef TERRAINRAYCAST_H
+#define TERRAINRAYCAST_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "TerrainMesher.h"
+#include "VecMath.h"
+
+struct TerrainRay
+{
+	TerrainRay() : MaxDistance(0.0f) {}
+	TerrainRay(const Vec3& origin, const Vec3& direction, float maxDistance)
+		: Origin(origin), Direction(direction), MaxDistance(maxDistance) {}
+
+	Vec3 Origin;
+	Vec3 Direction;     // Unit length.
+	float MaxDistance;
+};
+
+struct TerrainRayHit
+{
+	TerrainRayHit() : Hit(false), Distance(0.0f), CellX(0), CellY(0), CellZ(0) {}
+
+	bool Hit;
+	float Distance;     // Along the ray, in world units.
+	Vec3 Position;
+	Vec3 Normal;        // Unit length, pointing out of the terrain.
+	int CellX;
+	int CellY;
+	int CellZ;
+};
+
+///<summary>
+/// Ray queries against a DensityField on the CPU, for picking, line of sight and
+/// projectiles without the GPU's triangles.  The surface is the zero crossing of the
+/// trilinear interpolation of the field (positive is solid), which passes through the
+/// same edge points as TerrainMesher's triangles and differs from them by a fraction
+/// of a voxel inside cells.
+///
+/// Build keeps a min/max hierarchy over the cells: level 0 holds each cell's corner
+/// range, each level above merges 2x2x2 nodes.  A node whose range does not straddle
+/// zero is all air or all solid, so the ray jumps to where it leaves the node.  Cells
+/// that straddle zero are walked in DDA order; the interpolant is sampled at four
+/// points along the ray's span through the cell at once (SSE2 where available) and
+/// the first sign change is refined with regula falsi.  A crossing that enters and
+/// leaves the solid between two samples, narrower than a third of a cell, is missed.
+///
+/// A ray that starts inside the solid hits at distance 0.  Queries are const and keep
+/// no state, so any number of threads can cast at once; RaycastBatch spreads a batch
+/// over threads itself.  The field must outlive the raycaster, and after editing it
+/// call Update over the edited corners before the next query.
+///</summary>
+class TerrainRaycaster
+{
+public:
+	TerrainRaycaster();
+
+	// origin is the world position of corner (0,0,0) and voxelSize the world size of
+	// one cell, as for TerrainMesher::Extract.
+	void Build(const DensityField& field, const Vec3& origin, const Vec3& voxelSize);
+
+	// Recomputes the hierarchy over the cells touching corners [x0,x1] x [y0,y1] x [z0,z1].
+	void Update(int x0, int y0, int z0, int x1, int y1, int z1);
+
+	bool Raycast(const TerrainRay& ray, TerrainRayHit& hit)const;
+
+	// True if nothing solid lies between a and b.
+	bool LineOfSight(const Vec3& a, const Vec3& b)const;
+
+	// Casts count rays across threads.  Returns the number that hit.
+	size_t RaycastBatch(const TerrainRay* rays, TerrainRayHit* hits, size_t count)const;
+
+	// Trilinear density at a world position, clamped to the field.
+	float Density(const Vec3& p)const;
+
+	size_t LevelCount()const { return mLevels.size(); }
+	AABB Bounds()const;
+
+private:
+	struct Level
+	{
+		int SizeX;
+		int SizeY;
+		int SizeZ;
+		std::vector<float> Min;
+		std::vector<float> Max;
+
+		size_t Index(int x, int y, int z)const { return (size_t(y)*SizeZ + z)*SizeX + x; }
+	};
+
+	// The ray in cell units: position = Origin + Direction*t, t in world units.
+	struct CellRay
+	{
+		Vec3 Origin;
+		Vec3 Direction;
+		Vec3 InvDirection;
+	};
+
+	void BuildLevel(size_t level, int x0, int y0, int z0, int x1, int y1, int z1);
+	float CellExit(const CellRay& ray, float t, int x, int y, int z, int size)const;
+	bool TestCell(const CellRay& ray, int x, int y, int z, float t0, float t1, float& tHit)const;
+	float CellDensity(const float corners[8], const Vec3& local)const;
+	void LoadCorners(int x, int y, int z, float corners[8])const;
+
+	const DensityField* mField;
+	Vec3 mOrigin;
+	Vec3 mVoxelSize;
+	Vec3 mInvVoxelSize;
+	std::vector<Level> mLevels;
+};
+
+#endif // TERRAINRAYCAST_H
@@ -0,0 +1,471 @@
+#include "TerrainWorld.h"
+#include "FastNoise.h"
+#include "ParallelFor.h"
+#include "TerrainEffectConstants.h"
+#include "VertexCompression.h"
+
+#include <algorithm>
+#include <cmath>
+
+OrbitCamera::OrbitCamera()
+	: Theta(1.3f*3.1415926535f), Phi(0.4f*3.1415926535f), Radius(80.0f), TargetX(0.0f), TargetY(0.0f),
+	FovY(0.25f*3.1415926535f), Aspect(800.0f / 600.0f), NearZ(1.0f), FarZ(1000.0f)
+{
+}
+
+Vec3 OrbitCamera::Eye()const
+{
+	// Convert spherical to Cartesian coordinates.
+	return Vec3(Radius*std::sin(Phi)*std::cos(Theta), Radius*std::cos(Phi), Radius*std::sin(Phi)*std::sin(Theta));
+}
+
+Mat4 OrbitCamera::View()const
+{
+	// Panning slides the eye and the target sideways and up together.
+	Vec3 pan(TargetX*std::sin(Theta), TargetY, -TargetX*std::cos(Theta));
+	return MatrixLookAtLH(Eye() + pan, pan, Vec3(0.0f, 1.0f, 0.0f));
+}
+
+Mat4 OrbitCamera::Proj()const
+{
+	return MatrixPerspectiveFovLH(FovY, Aspect, NearZ, FarZ);
+}
+
+TerrainWorld::Settings::Settings()
+	: Corners(33), Extent(160.0f), ChunkQuads(8), Seed(24), NoiseFrequency(0.03f), OccluderRange(80.0f),
+	CollisionWeld(1.0f), FarLodKeep(0.25f), FarLodError(2.0f),
+	TreeSlices(4), WaveRows(160), WaveColumns(160), WaveSpacing(1.0f), WaveTimeStep(0.03f), WaveSpeed(5.0f),
+	WaveDamping(0.3f), WaveDisturbInterval(0.1f)
+{
+	// Trees on gentle slopes, thinning out towards the top of the volume.
+	Trees.Density = 0.02f;
+	Trees.Spacing = 6.0f;
+	Trees.MinUpDot = 0.75f;
+	Trees.FullUpDot = 0.9f;
+	Trees.MinHeight = 5.0f;
+	Trees.MaxHeight = 110.0f;
+	Trees.HeightFade = 30.0f;
+	Trees.MinSize = 8.0f;
+	Trees.MaxSize = 12.0f;
+}
+
+TerrainWorld::TerrainWorld(const Settings& settings)
+	: mSettings(settings), mTime(0.0f), mNextDisturb(0.0f), mRandom(settings.Seed), mProfiler(0),
+	mWavesScope(0), mCullScope(0), mTreeLod(settings.TreeLod)
+{
+}
+
+void TerrainWorld::SetProfiler(FrameProfiler* profiler)
+{
+	mProfiler = profiler;
+	if(mProfiler)
+	{
+		mWavesScope = mProfiler->AddScope("Waves::Update");
+		mCullScope = mProfiler->AddScope("Terrain culling");
+	}
+}
+
+Vec3 TerrainWorld::VoxelSize()const
+{
+	float voxel = mSettings.Extent / (mSettings.Corners - 1);
+	return Vec3(voxel, voxel, voxel);
+}
+
+AABB TerrainWorld::GridBounds()const
+{
+	const float half = 0.5f*mSettings.Extent;
+	return AABB(Vec3(-half, 0.0f, -half), Vec3(half, mSettings.Extent, half));
+}
+
+void TerrainWorld::PackGridVertices(std::vector<TerrainGridCompactVertex>& out)const
+{
+	// The shader derives everything else from the position, so the normal is just up.
+	out.resize(mGridVertices.size());
+	if(out.empty())
+		return;
+
+	for(size_t c = 0; c < mChunks.size(); ++c)
+	{
+		const Chunk& chunk = mChunks[c];
+		VertexCompression::QuantizePositions(&mGridVertices[chunk.BaseVertex].Position.x, sizeof(TerrainGridVertex),
+			chunk.VertexCount, &chunk.Origin.x, &chunk.Extent.x, out[chunk.BaseVertex].Position, sizeof(TerrainGridCompactVertex));
+	}
+
+	int16_t up[2];
+	const float n[3] = { 0.0f, 1.0f, 0.0f };
+	VertexCompression::OctEncode(n, up);
+	for(size_t i = 0; i < out.size(); ++i)
+	{
+		out[i].Position[3] = 0;
+		out[i].Normal[0] = up[0];
+		out[i].Normal[1] = up[1];
+	}
+}
+
+void TerrainWorld::PackSlabInstances(std::vector<uint32_t>& out)const
+{
+	out.resize(VoxelLayers());
+	for(size_t i = 0; i < out.size(); ++i)
+		out[i] = (uint32_t)i;
+}
+
+void TerrainWorld::PackWaveVertices(WaveCompactVertex* out)const
+{
+	const size_t count = mWaves.VertexCount();
+	if(count == 0)
+		return;
+
+	VertexCompression::EncodeOctNormals(&mWaves.Normal(0).x, sizeof(Vec3), count, out[0].Normal, sizeof(WaveCompactVertex));
+
+	// Texture coordinates in [0,1] derived from the position.
+	const float invWidth = 1.0f / mWaves.Width();
+	const float invDepth = 1.0f / mWaves.Depth();
+	for(size_t i = 0; i < count; ++i)
+	{
+		const Vec3& p = mWaves[(int)i];
+		out[i].Position = p;
+		out[i].TexC[0] = VertexCompression::FloatToHalf(0.5f + p.x*invWidth);
+		out[i].TexC[1] = VertexCompression::FloatToHalf(0.5f - p.z*invDepth);
+	}
+}
+
+void TerrainWorld::Build()
+{
+	FastNoise noise;
+	noise.SetSeed(mSettings.Seed);
+	noise.SetFrequency(mSettings.NoiseFrequency);
+	noise.SetNoiseType(FastNoise::SimplexFractal);
+
+	mDensity.Resize(mSettings.Corners, mSettings.Corners, mSettings.Corners);
+	mDensity.Generate(noise, 0, 0, 0);
+
+	// Corner (0,0,0) sits at the (-Extent/2, 0, -Extent/2) corner of the grid.
+	float half = 0.5f*mSettings.Extent;
+	mRaycaster.Build(mDensity, Vec3(-half, 0.0f, -half), VoxelSize());
+
+	BuildGrid();
+	BuildSurface();
+	BuildCollision();
+	BuildFarLods();
+	BuildTrees();
+
+	mWaves.Init(mSettings.WaveRows, mSettings.WaveColumns, mSettings.WaveSpacing, mSettings.WaveTimeStep,
+		mSettings.WaveSpeed, mSettings.WaveDamping);
+	mTime = 0.0f;
+	mNextDisturb = mSettings.WaveDisturbInterval;
+}
+
+void TerrainWorld::BuildGrid()
+{
+	// The same vertices GeometryGenerator::CreateGrid makes: rows from +z to -z, x
+	// increasing along a row, texture stretched over the grid.  Each chunk gets its own
+	// copy of its vertices, so a chunk's positions quantize over its box rather than
+	// the whole field: ChunkQuads voxels instead of Corners - 1 per 65535 steps.
+	const uint32_t quads = (uint32_t)mSettings.Corners - 1;
+	const float half = 0.5f*mSettings.Extent;
+	const Vec3 voxel = VoxelSize();
+
+	// Quads grouped into square chunks so each chunk is one index range that can be
+	// culled and drawn on its own.
+	mGridVertices.clear();
+	mGridIndices.clear();
+	mGridIndices.reserve(quads*quads*6);
+	mChunks.clear();
+	mSlabBoxes.Clear();
+	for(uint32_t z0 = 0; z0 < quads; z0 += mSettings.ChunkQuads)
+	{
+		for(uint32_t x0 = 0; x0 < quads; x0 += mSettings.ChunkQuads)
+		{
+			uint32_t z1 = (std::min)(z0 + mSettings.ChunkQuads, quads);
+			uint32_t x1 = (std::min)(x0 + mSettings.ChunkQuads, quads);
+			uint32_t rowVerts = x1 - x0 + 1;
+
+			Chunk chunk;
+			chunk.BaseVertex = (uint32_t)mGridVertices.size();
+			for(uint32_t i = z0; i <= z1; ++i)
+			{
+				for(uint32_t j = x0; j <= x1; ++j)
+				{
+					TerrainGridVertex v;
+					v.Position = Vec3(-half + j*voxel.x, 0.0f, half - i*voxel.z);
+					v.U = (float)j / quads;
+					v.V = (float)i / quads;
+					mGridVertices.push_back(v);
+				}
+			}
+			chunk.VertexCount = (uint32_t)mGridVertices.size() - chunk.BaseVertex;
+
+			chunk.StartIndex = (uint32_t)mGridIndices.size();
+			for(uint32_t i = 0; i < z1 - z0; ++i)
+			{
+				for(uint32_t j = 0; j < x1 - x0; ++j)
+				{
+					uint32_t v = chunk.BaseVertex + i*rowVerts + j;
+					uint32_t quad[6] = { v, v + 1, v + rowVerts, v + rowVerts, v + 1, v + rowVerts + 1 };
+					mGridIndices.insert(mGridIndices.end(), quad, quad + 6);
+				}
+			}
+			chunk.IndexCount = (uint32_t)mGridIndices.size() - chunk.StartIndex;
+
+			// The shader takes y from the instance, so the grid positions are world
+			// positions at y = 0; the box still spans the field's height.
+			const Vec3& a = mGridVertices[chunk.BaseVertex].Position;
+			const Vec3& b = mGridVertices[chunk.BaseVertex + chunk.VertexCount - 1].Position;
+			Vec3 lo((std::min)(a.x, b.x), 0.0f, (std::min)(a.z, b.z));
+			Vec3 hi((std::max)(a.x, b.x), mSettings.Extent, (std::max)(a.z, b.z));
+			chunk.Origin = lo;
+			chunk.Extent = hi - lo;
+			mChunks.push_back(chunk);
+
+			// Cells reach one voxel past their corner vertex, so pad by a voxel.
+			for(int slab = 0; slab < VoxelLayers(); ++slab)
+			{
+				mSlabBoxes.Add(AABB(Vec3(lo.x - voxel.x, slab*voxel.y, lo.z - voxel.z),
+					Vec3(hi.x + voxel.x, (slab + 1)*voxel.y, hi.z + voxel.z)));
+			}
+		}
+	}
+	mSlabVisible.assign(mSlabBoxes.Count(), 1);
+}
+
+void TerrainWorld::BuildSurface()
+{
+	// Corner (0,0,0) sits at the (-Extent/2, 0, -Extent/2) corner of the grid.
+	float half = 0.5f*mSettings.Extent;
+	TerrainMesher mesher;
+	mesher.Extract(mDensity, Vec3(-half, 0.0f, -half), VoxelSize(), mSurface);
+
+	// Give each triangle to the chunk whose columns hold its centroid, found from the
+	// centroid's grid cell: BuildGrid lays chunks out row by row from +z, x increasing.
+	const Vec3 voxel = VoxelSize();
+	const int quads = mSettings.Corners - 1;
+	const int chunksX = (quads + (int)mSettings.ChunkQuads - 1) / (int)mSettings.ChunkQuads;
+	mChunkSurfaceIndices.assign(mChunks.size(), std::vector<uint32_t>());
+	const std::vector<Vec3>& positions = mSurface.Positions;
+	const std::vector<uint32_t>& indices = mSurface.Indices;
+	for(size_t t = 0; t + 2 < indices.size(); t += 3)
+	{
+		Vec3 centroid = (positions[indices[t]] + positions[indices[t + 1]] + positions[indices[t + 2]]) * (1.0f / 3.0f);
+
+		int column = (std::min)((std::max)((int)std::floor((centroid.x + half) / voxel.x), 0), quads - 1);
+		int row = (std::min)((std::max)((int)std::floor((half - centroid.z) / voxel.z), 0), quads - 1);
+		size_t chunk = size_t(row / (int)mSettings.ChunkQuads)*chunksX + column / (int)mSettings.ChunkQuads;
+		mChunkSurfaceIndices[chunk].insert(mChunkSurfaceIndices[chunk].end(), &indices[t], &indices[t] + 3);
+	}
+
+	mSurfaceReport = mesher.Optimize(mSurface, mChunkSurfaceIndices);
+}
+
+void TerrainWorld::BuildCollision()
+{
+	mCollision.Resize(mChunks.size());
+	ParallelFor(mChunks.size(), 1, [this](size_t begin, size_t end)
+	{
+		CollisionMesh mesh;
+		for(size_t c = begin; c < end; ++c)
+		{
+			const std::vector<uint32_t>& indices = mChunkSurfaceIndices[c];
+			CollisionMesh::FromChunk(mSurface, indices.data(), indices.size(), mSettings.CollisionWeld, mesh);
+			mCollision.UpdateChunk(c, mesh);
+		}
+	});
+}
+
+void TerrainWorld::BuildFarLods()
+{
+	mFarLods.resize(mChunks.size());
+	mFarLodReports.resize(mChunks.size());
+	ParallelFor(mChunks.size(), 1, [this](size_t begin, size_t end)
+	{
+		MeshSimplifier simplifier;
+		for(size_t c = begin; c < end; ++c)
+		{
+			const std::vector<uint32_t>& indices = mChunkSurfaceIndices[c];
+			MeshSimplifier::Settings settings;
+			settings.TargetTriangles = (size_t)(mSettings.FarLodKeep*(indices.size() / 3));
+			settings.MaxError = mSettings.FarLodError;
+			mFarLodReports[c] = simplifier.Simplify(mSurface, indices.data(), indices.size(), settings, mFarLods[c]);
+		}
+	});
+}
+
+void TerrainWorld::BuildTrees()
+{
+	const uint32_t quads = (uint32_t)mSettings.Corners - 1;
+	const uint32_t chunksX = (quads + mSettings.ChunkQuads - 1) / mSettings.ChunkQuads;
+
+	std::vector<ScatterSurface> surfaces(mChunks.size());
+	std::vector<uint32_t> seeds(mChunks.size());
+	for(size_t c = 0; c < mChunks.size(); ++c)
+	{
+		surfaces[c].Positions = mSurface.Positions.data();
+		surfaces[c].Normals = mSurface.Normals.data();
+		surfaces[c].Indices = mChunkSurfaceIndices[c].data();
+		surfaces[c].IndexCount = mChunkSurfaceIndices[c].size();
+		seeds[c] = VegetationScatter::ChunkSeed(mSettings.Seed, (int)(c % chunksX), 0, (int)(c / chunksX));
+	}
+
+	mTrees.assign(mChunks.size(), std::vector<VegetationInstance>());
+	VegetationScatter::ScatterChunks(surfaces.data(), seeds.data(), surfaces.size(), mSettings.Trees, mTrees.data());
+
+	// Chunks without trees never emit anything, so their center does not matter.
+	mTreeCenters.assign(mChunks.size(), Vec3());
+	for(size_t c = 0; c < mChunks.size(); ++c)
+	{
+		AABB bounds;
+		for(size_t i = 0; i < mTrees[c].size(); ++i)
+			bounds.Extend(mTrees[c][i].Position);
+		if(!bounds.IsEmpty())
+			mTreeCenters[c] = bounds.Center();
+	}
+	mTreeLod.Reset(mChunks.size());
+}
+
+size_t TerrainWorld::TreeCount()const
+{
+	size_t count = 0;
+	for(size_t c = 0; c < mTrees.size(); ++c)
+		count += mTrees[c].size();
+	return count;
+}
+
+void TerrainWorld::DisturbWaves()
+{
+	// Random interior point, away from the fixed border.
+	uint32_t i = 5 + (uint32_t)(mRandom() % (mWaves.RowCount() - 10));
+	uint32_t j = 5 + (uint32_t)(mRandom() % (mWaves.ColumnCount() - 10));
+	float magnitude = 0.5f + 0.5f*(float)(mRandom() % 4096) / 4096.0f;
+	mWaves.Disturb(i, j, magnitude);
+}
+
+void TerrainWorld::Update(float dt)
+{
+	mTime += dt;
+	while(mSettings.WaveDisturbInterval > 0.0f && mTime >= mNextDisturb)
+	{
+		DisturbWaves();
+		mNextDisturb += mSettings.WaveDisturbInterval;
+	}
+
+	if(mProfiler)
+		mProfiler->BeginScope(mWavesScope);
+	mWaves.Update(dt);
+	if(mProfiler)
+		mProfiler->EndScope(mWavesScope);
+
+	mTreeLod.Update(mTreeCenters.data(), mTreeCenters.size(), mCamera.Eye(), dt);
+}
+
+bool TerrainWorld::ChunkVisible(size_t chunk)const
+{
+	const uint8_t* visible = &mSlabVisible[chunk*VoxelLayers()];
+	return std::find(visible, visible + VoxelLayers(), 1) != visible + VoxelLayers();
+}
+
+void TerrainWorld::Cull()
+{
+	if(mProfiler)
+		mProfiler->BeginScope(mCullScope);
+
+	Mat4 viewProj = ViewProj();
+	Frustum frustum;
+	FrustumCulling::ExtractPlanes(viewProj, frustum);
+	FrustumCulling::Cull(frustum, mSlabBoxes, mSlabVisible.data());
+
+	// Any chunk with a slab in view may hide the chunks behind it.
+	Vec3 eye = mCamera.Eye();
+	float rangeSq = mSettings.OccluderRange*mSettings.OccluderRange;
+	mOcclusion.Begin(viewProj.Data());
+	for(size_t c = 0; c < mChunks.size(); ++c)
+	{
+		const std::vector<uint32_t>& indices = mChunkSurfaceIndices[c];
+		if(indices.empty())
+			continue;
+
+		size_t box = c*VoxelLayers();
+		float dx = mSlabBoxes.Center(0)[box] - eye.x;
+		float dz = mSlabBoxes.Center(2)[box] - eye.z;
+		if(dx*dx + dz*dz > rangeSq || !ChunkVisible(c))
+			continue;
+
+		mOcclusion.AddOccluder(mSurface.Positions.data(), indices.data(), indices.size());
+	}
+	mOcclusion.Render();
+	mOcclusion.Cull(mSlabBoxes, mSlabVisible.data());
+
+	if(mProfiler)
+		mProfiler->EndScope(mCullScope);
+}
+
+size_t TerrainWorld::RecordTerrain(DrawCommandList& list, const DrawState& state, size_t chunkBegin, size_t chunkEnd)const
+{
+	// The shader takes each slab's layer from the instance stream, which honours the
+	// start instance (SV_InstanceID would not), so hidden slabs at both ends are dropped.
+	size_t draws = 0;
+	for(size_t c = chunkBegin; c < chunkEnd; ++c)
+	{
+		const uint8_t* visible = &mSlabVisible[c*VoxelLayers()];
+		int top = VoxelLayers() - 1;
+		while(top >= 0 && !visible[top])
+			--top;
+		if(top < 0)
+			continue;
+		int bottom = 0;
+		while(!visible[bottom])
+			++bottom;
+
+		DrawArgs args;
+		args.Count = mChunks[c].IndexCount;
+		args.StartIndex = mChunks[c].StartIndex;
+		args.StartInstance = bottom;
+		args.InstanceCount = top - bottom + 1;
+		TerrainEffectConstants::ChunkConstants box = { mChunks[c].Origin, 0.0f, mChunks[c].Extent, 0.0f };
+		list.Draw(state, args, DrawConstants(TerrainEffectConstants::PerObjectSlot,
+			offsetof(TerrainEffectConstants::PerObjectConstants, Chunk), &box, sizeof(box)));
+		++draws;
+	}
+	return draws;
+}
+
+size_t TerrainWorld::RecordTerrain(DrawCommandList* lists, size_t listCount, const DrawState& state)const
+{
+	// Ranges split by list, not by thread, so the lists do not depend on the pool size.
+	std::vector<size_t> draws(listCount, 0);
+	size_t perList = (mChunks.size() + listCount - 1) / (std::max)(listCount, size_t(1));
+	ParallelFor(listCount, 1, [this, lists, &draws, &state, perList](size_t begin, size_t end)
+	{
+		for(size_t l = begin; l < end; ++l)
+		{
+			size_t chunkBegin = (std::min)(l*perList, mChunks.size());
+			size_t chunkEnd = (std::min)(chunkBegin + perList, mChunks.size());
+			draws[l] = RecordTerrain(lists[l], state, chunkBegin, chunkEnd);
+		}
+	});
+
+	size_t total = 0;
+	for(size_t l = 0; l < listCount; ++l)
+		total += draws[l];
+	return total;
+}
+
+size_t TerrainWorld::RecordTrees(DrawCommandList& list, const DrawState& state)
+{
+	mTreeBatches.Clear();
+	for(size_t c = 0; c < mChunks.size(); ++c)
+	{
+		if(ChunkVisible(c))
+			mTreeLod.Emit(c, mTrees[c].data(), mTrees[c].size(), mSettings.TreeSlices, mTreeBatches);
+	}
+	mTreeBatches.Build(mCamera.Eye());
+
+	const std::vector<BillboardBatch>& batches = mTreeBatches.Batches();
+	for(size_t b = 0; b < batches.size(); ++b)
+	{
+		DrawArgs args;
+		args.Count = 4;
+		args.InstanceCount = batches[b].InstanceCount;
+		args.StartInstance = batches[b].StartInstance;
+		list.Draw(state, args);
+	}
+	return batches.size();
+}
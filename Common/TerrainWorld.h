@@ -0,0 +1,274 @@
+#ifndef TERRAINWORLD_H
+#define TERRAINWORLD_H
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "BillboardBatch.h"
+#include "DrawCommandList.h"
+#include "FrameProfiler.h"
+#include "FrustumCulling.h"
+#include "MeshSimplifier.h"
+#include "OcclusionBuffer.h"
+#include "TerrainCollision.h"
+#include "TerrainMesher.h"
+#include "TerrainRaycast.h"
+#include "VecMath.h"
+#include "VegetationLod.h"
+#include "VegetationScatter.h"
+#include "Waves.h"
+
+///<summary>
+/// Camera orbiting a target point, as the demo's mouse controls drive it.  Eye() is
+/// the orbit position before panning, which is what lighting and LOD use.
+///</summary>
+struct OrbitCamera
+{
+	OrbitCamera();
+
+	Vec3 Eye()const;
+	Mat4 View()const;
+	Mat4 Proj()const;
+
+	float Theta;
+	float Phi;
+	float Radius;
+	float TargetX;
+	float TargetY;
+
+	float FovY;
+	float Aspect;
+	float NearZ;
+	float FarZ;
+};
+
+///<summary>
+/// Terrain grid vertex as the world builds it.
+///</summary>
+struct TerrainGridVertex
+{
+	Vec3 Position;
+	float U;
+	float V;
+};
+
+///<summary>
+/// Terrain grid vertex as uploaded, laid out like Vertex::TerrainCompact: the position
+/// as UNORM16 over its chunk's box (w spare) and an octahedral SNORM16 normal.
+///</summary>
+struct TerrainGridCompactVertex
+{
+	uint16_t Position[4];
+	int16_t Normal[2];
+};
+
+///<summary>
+/// Wave vertex as streamed each frame, laid out like Vertex::BasicCompact: float
+/// position, octahedral SNORM16 normal and half texture coordinates.
+///</summary>
+struct WaveCompactVertex
+{
+	Vec3 Position;
+	int16_t Normal[2];
+	uint16_t TexC[2];
+};
+
+///<summary>
+/// Everything the terrain demo simulates, without a device: the density field, the
+/// chunked grid the marching cubes shader expands, the CPU surface used as occluders
+/// and for scattering trees, tree LOD, the wave simulation and the camera.  Build once,
+/// then each frame Update, Cull and record draws.  TerrainApp uploads the grid and the
+/// density to the GPU; headless runners submit the same draws to a NullRenderDevice.
+///
+/// The field has Corners samples per axis over a cube of side Extent whose bottom face
+/// is centered on the origin.  The grid has one quad per voxel column, grouped into
+/// square chunks of ChunkQuads quads, each one contiguous index range over vertices of
+/// its own (borders are duplicated), so its positions quantize over its box alone and
+/// every terrain draw passes that box in cbPerObject.  Every chunk has one cull box
+/// per voxel layer (slab), chunk-major.  Slabs are instances: each reads its layer
+/// from the SlabInstances stream, so a draw can start at any slab.
+///</summary>
+class TerrainWorld
+{
+public:
+	struct Settings
+	{
+		Settings();
+
+		int Corners;
+		float Extent;
+		uint32_t ChunkQuads;
+		uint32_t Seed;
+		float NoiseFrequency;
+
+		// Chunks within this distance of the eye occlude the ones behind them.
+		float OccluderRange;
+
+		// Collision meshes weld the surface's vertices on a grid this fine; 0 keeps
+		// every triangle.
+		float CollisionWeld;
+
+		// Far LOD meshes keep at most this fraction of each chunk's triangles (0 for no
+		// budget) and stay within FarLodError world units of the full surface.
+		float FarLodKeep;
+		float FarLodError;
+
+		ScatterSettings Trees;
+		VegetationLodSettings TreeLod;
+		uint32_t TreeSlices;
+
+		uint32_t WaveRows;
+		uint32_t WaveColumns;
+		float WaveSpacing;
+		float WaveTimeStep;
+		float WaveSpeed;
+		float WaveDamping;
+		float WaveDisturbInterval;
+	};
+
+	struct Chunk
+	{
+		uint32_t StartIndex;
+		uint32_t IndexCount;
+		uint32_t BaseVertex;
+		uint32_t VertexCount;
+		// The box the chunk's compact grid positions are quantized over.
+		Vec3 Origin;
+		Vec3 Extent;
+	};
+
+	explicit TerrainWorld(const Settings& settings = Settings());
+
+	// Registers "Waves::Update" and "Terrain culling" scopes.  Optional; the profiler
+	// must outlive the world.
+	void SetProfiler(FrameProfiler* profiler);
+
+	void Build();
+
+	// Disturbs and steps the waves and moves chunks between tree LOD bands.
+	void Update(float dt);
+
+	// Frustum culls every slab, then occlusion culls them against the nearby chunks.
+	void Cull();
+
+	// Appends one draw per chunk in [chunkBegin, chunkEnd) with a visible slab, over the
+	// instances from its lowest visible slab to its highest, with the chunk's box as
+	// TerrainEffectConstants::ChunkConstants.  state.InstanceBuffer must hold
+	// PackSlabInstances.  Returns the number of draws.
+	size_t RecordTerrain(DrawCommandList& list, const DrawState& state, size_t chunkBegin, size_t chunkEnd)const;
+	size_t RecordTerrain(DrawCommandList& list, const DrawState& state)const { return RecordTerrain(list, state, 0, mChunks.size()); }
+
+	// Records the chunks on the ParallelFor workers, list l getting the l-th of listCount
+	// contiguous chunk ranges.  Every terrain draw has the same key, so gathering the
+	// lists in order submits the draws in the same order as recording into one list.
+	size_t RecordTerrain(DrawCommandList* lists, size_t listCount, const DrawState& state)const;
+
+	// Builds this frame's tree instances from the chunks with a visible slab and appends
+	// one draw per texture slice.  The instances, TreeBatches().Instances(), must be in
+	// state.InstanceBuffer before the draws are submitted.
+	size_t RecordTrees(DrawCommandList& list, const DrawState& state);
+
+	const Settings& GetSettings()const { return mSettings; }
+
+	OrbitCamera& Camera() { return mCamera; }
+	const OrbitCamera& Camera()const { return mCamera; }
+	Mat4 ViewProj()const { return mCamera.View()*mCamera.Proj(); }
+
+	float TotalTime()const { return mTime; }
+
+	const DensityField& Density()const { return mDensity; }
+	// Ray queries against the density field, in world space.
+	const TerrainRaycaster& Raycaster()const { return mRaycaster; }
+	// Sphere and capsule queries against each chunk's collision mesh.
+	const TerrainCollision& Collision()const { return mCollision; }
+	Vec3 VoxelSize()const;
+	int VoxelLayers()const { return mSettings.Corners - 1; }
+
+	const std::vector<TerrainGridVertex>& GridVertices()const { return mGridVertices; }
+	// The field's cube.
+	AABB GridBounds()const;
+	void PackGridVertices(std::vector<TerrainGridCompactVertex>& out)const;
+	// The terrain's per-instance stream: one uint32_t layer per slab, 0 to VoxelLayers() - 1.
+	void PackSlabInstances(std::vector<uint32_t>& out)const;
+	const std::vector<uint32_t>& GridIndices()const { return mGridIndices; }
+	const std::vector<Chunk>& Chunks()const { return mChunks; }
+
+	const CullBoxes& SlabBoxes()const { return mSlabBoxes; }
+	const std::vector<uint8_t>& SlabVisible()const { return mSlabVisible; }
+	bool ChunkVisible(size_t chunk)const;
+
+	const TerrainChunkMesh& SurfaceMesh()const { return mSurface; }
+	const std::vector<uint32_t>& ChunkSurfaceIndices(size_t chunk)const { return mChunkSurfaceIndices[chunk]; }
+	// ACMR/ATVR of the surface before and after each chunk was ordered for the cache.
+	const MeshOptimizer::Report& SurfaceReport()const { return mSurfaceReport; }
+
+	// Each chunk's surface decimated for distant LODs, its own vertices; the border
+	// matches the full surface, so any mix of LODs joins without cracks.
+	const TerrainChunkMesh& FarLodMesh(size_t chunk)const { return mFarLods[chunk]; }
+	const MeshSimplifier::Report& FarLodReport(size_t chunk)const { return mFarLodReports[chunk]; }
+
+	const std::vector<VegetationInstance>& ChunkTrees(size_t chunk)const { return mTrees[chunk]; }
+	size_t TreeCount()const;
+
+	// Instances RecordTrees can produce in one frame: every tree twice while fading.
+	size_t MaxTreeInstances()const { return 2*TreeCount(); }
+
+	const BillboardBatchBuilder& TreeBatches()const { return mTreeBatches; }
+	const VegetationLod& TreeLod()const { return mTreeLod; }
+	const OcclusionBuffer& Occlusion()const { return mOcclusion; }
+
+	const Waves& GetWaves()const { return mWaves; }
+	// Writes the current wave solution to out[0, GetWaves().VertexCount()).
+	void PackWaveVertices(WaveCompactVertex* out)const;
+
+private:
+	TerrainWorld(const TerrainWorld& rhs);
+	TerrainWorld& operator=(const TerrainWorld& rhs);
+
+	void BuildGrid();
+	void BuildSurface();
+	void BuildCollision();
+	void BuildFarLods();
+	void BuildTrees();
+	void DisturbWaves();
+
+	Settings mSettings;
+	OrbitCamera mCamera;
+	float mTime;
+	float mNextDisturb;
+	std::minstd_rand mRandom;
+
+	FrameProfiler* mProfiler;
+	FrameProfiler::ScopeId mWavesScope;
+	FrameProfiler::ScopeId mCullScope;
+
+	DensityField mDensity;
+	TerrainRaycaster mRaycaster;
+
+	std::vector<TerrainGridVertex> mGridVertices;
+	std::vector<uint32_t> mGridIndices;
+	std::vector<Chunk> mChunks;
+	CullBoxes mSlabBoxes;
+	std::vector<uint8_t> mSlabVisible;
+
+	// The surface extracted on the CPU, its triangles split by chunk.
+	TerrainChunkMesh mSurface;
+	std::vector<std::vector<uint32_t> > mChunkSurfaceIndices;
+	MeshOptimizer::Report mSurfaceReport;
+	OcclusionBuffer mOcclusion;
+	TerrainCollision mCollision;
+	std::vector<TerrainChunkMesh> mFarLods;
+	std::vector<MeshSimplifier::Report> mFarLodReports;
+
+	// Trees scattered over each chunk, LOD picked from the center of each chunk's trees.
+	std::vector<std::vector<VegetationInstance> > mTrees;
+	std::vector<Vec3> mTreeCenters;
+	VegetationLod mTreeLod;
+	BillboardBatchBuilder mTreeBatches;
+
+	Waves mWaves;
+};
+
+#endif // TERRAINWORLD_H
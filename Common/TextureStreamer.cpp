@@ -0,0 +1,480 @@
+#include "TextureStreamer.h"
+
+#include <algorithm>
+
+const TextureStreamer::TextureId TextureStreamer::InvalidTexture;
+
+namespace
+{
+	// Prefetch granularity.  Touching one byte per page faults the whole page in.
+	const size_t PageSize = 4096;
+
+	const size_t NoMip = ~size_t(0);
+
+	bool IsBlockCompressed(DXGI_FORMAT format)
+	{
+		size_t numBytes, rowBytes, numRows;
+		DDSCore::GetSurfaceInfo(4, 4, format, &numBytes, &rowBytes, &numRows);
+		return numRows == 1;
+	}
+}
+
+TextureStreamer::Texture::Texture()
+	: MemoryData(0), MemorySize(0), Desc(), TailMip(0), Failed(false),
+	  Ready(false), Priority(0.0f), Handle(0), ResidentMip(0), PrefetchedMip(0),
+	  FinestMip(0), TargetMip(0), IoPending(false)
+{
+}
+
+TextureStreamer::TextureStreamer(ITextureDevice& device, const Config& config)
+	: mDevice(device), mConfig(config),
+	  mResidentBytes(0), mUploads(0), mEvictions(0), mUploadedBytes(0),
+	  mRunningJobs(0), mQuit(false)
+{
+	mWorker = std::thread(&TextureStreamer::IoThread, this);
+}
+
+TextureStreamer::~TextureStreamer()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mQuit = true;
+	}
+	mWake.notify_all();
+	mWorker.join();
+
+	for(size_t i = 0; i < mTextures.size(); ++i)
+	{
+		if(mTextures[i]->Handle)
+			mDevice.ReleaseTexture(mTextures[i]->Handle);
+	}
+}
+
+TextureStreamer::TextureId TextureStreamer::Load(const char* path, float priority)
+{
+	Texture* texture = new Texture();
+	texture->Path = path ? path : "";
+	texture->Priority = priority;
+	return Add(texture);
+}
+
+TextureStreamer::TextureId TextureStreamer::LoadFromMemory(const uint8_t* data, size_t size, float priority)
+{
+	Texture* texture = new Texture();
+	texture->MemoryData = data;
+	texture->MemorySize = size;
+	texture->Priority = priority;
+	return Add(texture);
+}
+
+TextureStreamer::TextureId TextureStreamer::Add(Texture* texture)
+{
+	TextureId id = (TextureId)mTextures.size();
+	mTextures.push_back(std::unique_ptr<Texture>(texture));
+
+	texture->IoPending = true;
+
+	IoJob job;
+	job.Target = texture;
+	job.Parse = true;
+	job.Mip = 0;
+	job.EndMip = 0;
+	QueueIO(job);
+
+	return id;
+}
+
+void TextureStreamer::SetPriority(TextureId id, float priority)
+{
+	if(id < mTextures.size())
+		mTextures[id]->Priority = priority;
+}
+
+void* TextureStreamer::GetTexture(TextureId id)const
+{
+	return id < mTextures.size() ? mTextures[id]->Handle : 0;
+}
+
+size_t TextureStreamer::ResidentMip(TextureId id)const
+{
+	return id < mTextures.size() ? mTextures[id]->ResidentMip : 0;
+}
+
+bool TextureStreamer::Failed(TextureId id)const
+{
+	return id >= mTextures.size() || (mTextures[id]->Ready && mTextures[id]->Failed);
+}
+
+TextureStreamer::Stats TextureStreamer::GetStats()const
+{
+	Stats stats;
+	stats.ResidentBytes = mResidentBytes;
+	stats.Uploads = mUploads;
+	stats.Evictions = mEvictions;
+	stats.UploadedBytes = mUploadedBytes;
+
+	stats.PendingLoads = 0;
+	for(size_t i = 0; i < mTextures.size(); ++i)
+	{
+		const Texture& texture = *mTextures[i];
+		if(!texture.Handle && !(texture.Ready && texture.Failed))
+			++stats.PendingLoads;
+	}
+
+	std::lock_guard<std::mutex> lock(mMutex);
+	stats.PendingIO = mJobs.size() + mRunningJobs + mCompleted.size();
+	return stats;
+}
+
+//---------------------------------------------------------------------------------------
+// Main thread.
+//---------------------------------------------------------------------------------------
+
+void TextureStreamer::Update()
+{
+	std::vector<IoJob> completed;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		completed.swap(mCompleted);
+	}
+
+	for(size_t i = 0; i < completed.size(); ++i)
+	{
+		Texture& texture = *completed[i].Target;
+		texture.IoPending = false;
+
+		if(completed[i].Parse)
+		{
+			texture.Ready = true;
+			texture.ResidentMip = texture.Desc.mipCount;
+			texture.PrefetchedMip = texture.Failed ? texture.Desc.mipCount : texture.TailMip;
+		}
+		else
+		{
+			texture.PrefetchedMip = std::min(texture.PrefetchedMip, completed[i].Mip);
+		}
+	}
+
+	// Tails first.  They are small, do not count against the per-frame upload limit
+	// and make the texture drawable.
+	for(size_t i = 0; i < mTextures.size(); ++i)
+	{
+		Texture& texture = *mTextures[i];
+		if(texture.Ready && !texture.Failed && !texture.Handle)
+		{
+			if(!MakeResident(texture, texture.TailMip))
+				texture.Failed = true;
+		}
+	}
+
+	// Share the budget out in priority order.  Tails are always resident; what is left
+	// goes to the most important textures first, so every texture has a target mip
+	// that fits and lower-priority textures never win memory back from higher ones.
+	std::vector<Texture*> order;
+	order.reserve(mTextures.size());
+
+	size_t available = mConfig.MemoryBudget;
+	for(size_t i = 0; i < mTextures.size(); ++i)
+	{
+		Texture* texture = mTextures[i].get();
+		if(!texture->Handle)
+			continue;
+
+		order.push_back(texture);
+		size_t tailBytes = BytesFrom(*texture, texture->TailMip);
+		available -= std::min(available, tailBytes);
+	}
+
+	std::stable_sort(order.begin(), order.end(),
+		[](const Texture* a, const Texture* b) { return a->Priority > b->Priority; });
+
+	for(size_t i = 0; i < order.size(); ++i)
+	{
+		Texture& texture = *order[i];
+		size_t tailBytes = BytesFrom(texture, texture.TailMip);
+
+		// Invisible textures keep what they have while it fits but do not grow.
+		size_t finest = texture.Priority > 0.0f ? texture.FinestMip : std::max(texture.FinestMip, texture.ResidentMip);
+
+		texture.TargetMip = texture.TailMip;
+		for(size_t mip = texture.TailMip; mip > finest; --mip)
+		{
+			if(!texture.TopMipValid[mip - 1])
+				continue;
+			if(BytesFrom(texture, mip - 1) - tailBytes > available)
+				break;
+			texture.TargetMip = mip - 1;
+		}
+		available -= BytesFrom(texture, texture.TargetMip) - tailBytes;
+	}
+
+	// Refine towards the targets by one mip per texture, most important first.
+	size_t uploaded = 0;
+	for(size_t i = 0; i < order.size(); ++i)
+	{
+		Texture& texture = *order[i];
+		if(texture.ResidentMip <= texture.TargetMip)
+			continue;
+
+		size_t next = FinerMip(texture);
+
+		// Never upload from pages that are not in memory yet; ask the I/O thread to
+		// fault them in and try again on a later frame.
+		if(texture.PrefetchedMip > next)
+		{
+			if(!texture.IoPending)
+			{
+				texture.IoPending = true;
+
+				IoJob job;
+				job.Target = &texture;
+				job.Parse = false;
+				job.Mip = next;
+				job.EndMip = texture.ResidentMip;
+				QueueIO(job);
+			}
+			continue;
+		}
+
+		// At least one refinement per frame, so a texture larger than the limit
+		// still streams in.
+		if(uploaded > 0 && uploaded >= mConfig.UploadBytesPerFrame)
+			continue;
+
+		size_t extra = BytesFrom(texture, next) - BytesFrom(texture, texture.ResidentMip);
+		if(!EvictFor(extra))
+			continue;
+
+		if(MakeResident(texture, next))
+			uploaded += BytesFrom(texture, next);
+		else
+			texture.FinestMip = texture.ResidentMip;
+	}
+}
+
+void TextureStreamer::WaitForIO()
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	mIdle.wait(lock, [this]() { return mJobs.empty() && mRunningJobs == 0; });
+}
+
+size_t TextureStreamer::BytesFrom(const Texture& texture, size_t topMip)
+{
+	size_t bytes = 0;
+	for(size_t mip = topMip; mip < texture.MipBytes.size(); ++mip)
+		bytes += texture.MipBytes[mip];
+	return bytes;
+}
+
+size_t TextureStreamer::FinerMip(const Texture& texture)
+{
+	for(size_t mip = texture.ResidentMip; mip > texture.FinestMip; --mip)
+	{
+		if(texture.TopMipValid[mip - 1])
+			return mip - 1;
+	}
+	return NoMip;
+}
+
+size_t TextureStreamer::CoarserMip(const Texture& texture)
+{
+	for(size_t mip = texture.ResidentMip + 1; mip <= texture.TailMip; ++mip)
+	{
+		if(texture.TopMipValid[mip])
+			return mip;
+	}
+	return NoMip;
+}
+
+bool TextureStreamer::MakeResident(Texture& texture, size_t topMip)
+{
+	const DDSCore::TextureDesc& desc = texture.Desc;
+	size_t levels = desc.mipCount - topMip;
+
+	std::vector<DDSCore::Subresource> subresources(levels * desc.arraySize);
+	for(size_t slice = 0; slice < desc.arraySize; ++slice)
+	{
+		for(size_t level = 0; level < levels; ++level)
+			subresources[slice*levels + level] = texture.Layout[slice*desc.mipCount + topMip + level];
+	}
+
+	void* handle = mDevice.CreateTexture(desc, topMip, subresources.data());
+	if(!handle)
+		return false;
+
+	if(texture.Handle)
+	{
+		mDevice.ReleaseTexture(texture.Handle);
+		mResidentBytes -= BytesFrom(texture, texture.ResidentMip);
+	}
+
+	size_t bytes = BytesFrom(texture, topMip);
+	texture.Handle = handle;
+	texture.ResidentMip = topMip;
+	mResidentBytes += bytes;
+	mUploadedBytes += bytes;
+	++mUploads;
+	return true;
+}
+
+bool TextureStreamer::EvictFor(size_t bytes)
+{
+	while(mResidentBytes + bytes > mConfig.MemoryBudget)
+	{
+		// Lowest priority texture holding more than its target.
+		Texture* victim = 0;
+		for(size_t i = 0; i < mTextures.size(); ++i)
+		{
+			Texture* texture = mTextures[i].get();
+			if(!texture->Handle || texture->ResidentMip >= texture->TargetMip)
+				continue;
+			if(!victim || texture->Priority < victim->Priority)
+				victim = texture;
+		}
+
+		if(!victim || !MakeResident(*victim, CoarserMip(*victim)))
+			return false;
+
+		// Pages of the dropped mip may be reclaimed by the OS; fetch them again first.
+		victim->PrefetchedMip = victim->ResidentMip;
+		++mEvictions;
+	}
+	return true;
+}
+
+//---------------------------------------------------------------------------------------
+// I/O thread.
+//---------------------------------------------------------------------------------------
+
+void TextureStreamer::QueueIO(const IoJob& job)
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mJobs.push_back(job);
+	}
+	mWake.notify_one();
+}
+
+void TextureStreamer::IoThread()
+{
+	for(;;)
+	{
+		IoJob job;
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mWake.wait(lock, [this]() { return mQuit || !mJobs.empty(); });
+			if(mQuit)
+				return;
+
+			job = mJobs.front();
+			mJobs.pop_front();
+			++mRunningJobs;
+		}
+
+		Texture& texture = *job.Target;
+		if(job.Parse)
+		{
+			ParseTexture(texture, mConfig.TailBytes);
+			if(!texture.Failed)
+				Prefetch(texture, texture.TailMip, texture.Desc.mipCount);
+		}
+		else
+		{
+			Prefetch(texture, job.Mip, job.EndMip);
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mCompleted.push_back(job);
+			--mRunningJobs;
+			if(mJobs.empty() && mRunningJobs == 0)
+				mIdle.notify_all();
+		}
+	}
+}
+
+void TextureStreamer::ParseTexture(Texture& texture, size_t tailBytes)
+{
+	const uint8_t* data = texture.MemoryData;
+	size_t size = texture.MemorySize;
+	if(!data)
+	{
+		if(!texture.File.Open(texture.Path.c_str()))
+		{
+			texture.Failed = true;
+			return;
+		}
+		data = texture.File.Data();
+		size = texture.File.Size();
+	}
+
+	DDSCore::TextureDesc& desc = texture.Desc;
+	if(DDSCore::ParseDDS(data, size, desc) != DDSCore::DDS_OK)
+	{
+		texture.Failed = true;
+		return;
+	}
+
+	texture.Layout.resize(desc.mipCount * desc.arraySize);
+
+	size_t twidth, theight, tdepth, skipMip = 0;
+	if(DDSCore::FillInitData(desc.width, desc.height, desc.depth, desc.mipCount, desc.arraySize,
+		desc.format, 0, desc.bitSize, desc.bitData, twidth, theight, tdepth, skipMip,
+		texture.Layout.data()) != DDSCore::DDS_OK)
+	{
+		texture.Failed = true;
+		return;
+	}
+
+	bool blockCompressed = IsBlockCompressed(desc.format);
+
+	texture.MipBytes.assign(desc.mipCount, 0);
+	texture.TopMipValid.assign(desc.mipCount, 0);
+	for(size_t mip = 0; mip < desc.mipCount; ++mip)
+	{
+		size_t depth = std::max<size_t>(1, desc.depth >> mip);
+		for(size_t slice = 0; slice < desc.arraySize; ++slice)
+			texture.MipBytes[mip] += texture.Layout[slice*desc.mipCount + mip].SysMemSlicePitch * depth;
+
+		// D3D requires the top level of a block-compressed texture to be whole blocks.
+		size_t width = std::max<size_t>(1, desc.width >> mip);
+		size_t height = std::max<size_t>(1, desc.height >> mip);
+		texture.TopMipValid[mip] = mip == 0 || !blockCompressed || (width % 4 == 0 && height % 4 == 0);
+	}
+
+	// The tail is the longest run of small mips that fits in tailBytes, and always
+	// includes at least the smallest usable top level.
+	size_t tail = desc.mipCount - 1;
+	while(!texture.TopMipValid[tail])
+		--tail;
+	for(size_t mip = tail; mip > 0; --mip)
+	{
+		if(BytesFrom(texture, mip - 1) > tailBytes)
+			break;
+		if(texture.TopMipValid[mip - 1])
+			tail = mip - 1;
+	}
+	texture.TailMip = tail;
+}
+
+void TextureStreamer::Prefetch(const Texture& texture, size_t firstMip, size_t endMip)
+{
+	const DDSCore::TextureDesc& desc = texture.Desc;
+
+	volatile uint8_t sink = 0;
+	for(size_t slice = 0; slice < desc.arraySize; ++slice)
+	{
+		for(size_t mip = firstMip; mip < endMip && mip < desc.mipCount; ++mip)
+		{
+			const DDSCore::Subresource& sub = texture.Layout[slice*desc.mipCount + mip];
+			const uint8_t* bytes = static_cast<const uint8_t*>(sub.pSysMem);
+			size_t size = sub.SysMemSlicePitch * std::max<size_t>(1, desc.depth >> mip);
+
+			for(size_t offset = 0; offset < size; offset += PageSize)
+				sink = sink + bytes[offset];
+			if(size > 0)
+				sink = sink + bytes[size - 1];
+		}
+	}
+	(void)sink;
+}
@@ -0,0 +1,173 @@
+#ifndef TEXTURESTREAMER_H
+#define TEXTURESTREAMER_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "DDSCore.h"
+#include "MappedFile.h"
+
+///<summary>
+/// Creates and releases GPU textures for the streamer.  D3D11TextureDevice is the real
+/// implementation; tests and tools can supply a fake that only records calls.
+///</summary>
+class ITextureDevice
+{
+public:
+	virtual ~ITextureDevice() {}
+
+	// Creates a texture holding mips [topMip, desc.mipCount) of every array slice.
+	// subresources has (desc.mipCount - topMip) entries per slice, slice-major, and
+	// points into the mapped file.  Returns 0 on failure.
+	virtual void* CreateTexture(const DDSCore::TextureDesc& desc, size_t topMip,
+		const DDSCore::Subresource* subresources) = 0;
+
+	virtual void ReleaseTexture(void* texture) = 0;
+};
+
+///<summary>
+/// Asynchronous DDS streaming with mip-tail-first residency.
+///
+/// Load() returns immediately.  An I/O thread maps and parses the file, and the next
+/// Update() creates the texture from its mip tail, the smallest mips that fit in
+/// Config::TailBytes, so something is drawable almost at once.  After that, each
+/// Update() refines textures one mip at a time in priority order.  The I/O thread
+/// pages the next mip in before the main thread uploads it, so uploads never block on
+/// the disk.  Config::MemoryBudget is handed out in priority order each frame; when a
+/// refinement needs memory, textures holding more than their share drop their finest
+/// mip, least important first.  Textures never drop below their tail.
+///
+/// All methods except the constructor's worker run on the calling (render) thread.
+///</summary>
+class TextureStreamer
+{
+public:
+	typedef uint32_t TextureId;
+	static const TextureId InvalidTexture = ~0u;
+
+	struct Config
+	{
+		Config() : MemoryBudget(64u << 20), UploadBytesPerFrame(8u << 20), TailBytes(64u << 10) {}
+
+		size_t MemoryBudget;        // Resident texel bytes across all textures.
+		size_t UploadBytesPerFrame; // Texel bytes created per Update(); tails are exempt.
+		size_t TailBytes;           // Largest mip tail created on first residency.
+	};
+
+	struct Stats
+	{
+		size_t ResidentBytes;
+		size_t PendingLoads;   // Textures not yet resident.
+		size_t PendingIO;      // Queued or running I/O jobs.
+		size_t Uploads;        // Textures created since construction.
+		size_t Evictions;      // Mips dropped for the budget since construction.
+		size_t UploadedBytes;  // Texel bytes handed to the device since construction.
+	};
+
+	TextureStreamer(ITextureDevice& device, const Config& config = Config());
+	~TextureStreamer();
+
+	// Queues a DDS file.  priority orders refinement and eviction; pass the texture's
+	// on-screen importance (for example its projected area), 0 for not visible.
+	TextureId Load(const char* path, float priority = 1.0f);
+
+	// As Load, for an image already in memory.  data must outlive the streamer.
+	TextureId LoadFromMemory(const uint8_t* data, size_t size, float priority = 1.0f);
+
+	void SetPriority(TextureId id, float priority);
+
+	// Finishes completed I/O, creates tails, refines and evicts.  Call once per frame.
+	void Update();
+
+	// Blocks until every queued I/O job has finished.  Does not upload; call Update()
+	// afterwards.  Meant for loading screens and tools.
+	void WaitForIO();
+
+	// The device texture for id, or 0 while it is not resident yet.
+	void* GetTexture(TextureId id)const;
+
+	// Finest resident mip of id, 0 being full resolution.  Only meaningful while
+	// GetTexture(id) is non-null.
+	size_t ResidentMip(TextureId id)const;
+	bool Failed(TextureId id)const;
+
+	Stats GetStats()const;
+
+private:
+	TextureStreamer(const TextureStreamer& rhs);
+	TextureStreamer& operator=(const TextureStreamer& rhs);
+
+	struct Texture
+	{
+		Texture();
+
+		// Written by the I/O thread while parsing; read-only once the parse job completes.
+		std::string Path;
+		const uint8_t* MemoryData;
+		size_t MemorySize;
+		MappedFile File;
+		DDSCore::TextureDesc Desc;
+		std::vector<DDSCore::Subresource> Layout; // Slice-major, full mip chain.
+		std::vector<size_t> MipBytes;            // Bytes of each mip across all slices.
+		std::vector<uint8_t> TopMipValid;        // Mip can start a texture (BC block alignment).
+		size_t TailMip;
+		bool Failed;
+
+		// Main thread only.
+		bool Ready;            // Parse job completed.
+		float Priority;
+		void* Handle;
+		size_t ResidentMip;    // Desc.mipCount when not resident.
+		size_t PrefetchedMip;  // Finest mip whose pages the I/O thread has touched.
+		size_t FinestMip;      // Raised if the device refuses a larger texture.
+		size_t TargetMip;      // Where the budget allows this texture to go this frame.
+		bool IoPending;
+	};
+
+	struct IoJob
+	{
+		Texture* Target;
+		bool Parse;    // Map and parse the file, then page in the tail.
+		size_t Mip;    // Page in mips [Mip, EndMip).
+		size_t EndMip;
+	};
+
+	TextureId Add(Texture* texture);
+	void QueueIO(const IoJob& job);
+	void IoThread();
+	static void ParseTexture(Texture& texture, size_t tailBytes);
+	static void Prefetch(const Texture& texture, size_t firstMip, size_t endMip);
+
+	static size_t BytesFrom(const Texture& texture, size_t topMip);
+	static size_t FinerMip(const Texture& texture);
+	static size_t CoarserMip(const Texture& texture);
+	bool MakeResident(Texture& texture, size_t topMip);
+	bool EvictFor(size_t bytes);
+
+	ITextureDevice& mDevice;
+	Config mConfig;
+	std::vector<std::unique_ptr<Texture> > mTextures;
+
+	size_t mResidentBytes;
+	size_t mUploads;
+	size_t mEvictions;
+	size_t mUploadedBytes;
+
+	mutable std::mutex mMutex;
+	std::condition_variable mWake;
+	std::condition_variable mIdle;
+	std::deque<IoJob> mJobs;
+	std::vector<IoJob> mCompleted;
+	size_t mRunningJobs;
+	bool mQuit;
+	std::thread mWorker;
+};
+
+#endif // TEXTURESTREAMER_H
@@ -0,0 +1,59 @@
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+
+#include <atomic>
+#include <cstdint>
+
+///<summary>
+/// Hands slots 0-2 between one writer thread and one reader thread without locks.  The
+/// writer fills WriteSlot() and publishes it; the reader acquires the most recently
+/// published slot and reads it for as long as it likes.  Nothing here blocks: the
+/// third slot is always free for the writer, and publishing twice before the reader
+/// acquires replaces the older slot.  A writer that must not drop a slot checks
+/// Pending first; how either side waits is up to the caller.
+///
+/// The slots are indices so the data can live wherever suits the caller.
+///</summary>
+class TripleBufferIndex
+{
+public:
+	TripleBufferIndex() : mWrite(0), mShared(1), mRead(2) {}
+
+	// Writer side.
+	uint32_t WriteSlot()const { return mWrite; }
+	void Publish()
+	{
+		// Releases the writes to the slot; acquires the slot the reader left.
+		uint32_t previous = mShared.exchange(mWrite | Fresh, std::memory_order_acq_rel);
+		mWrite = previous & SlotMask;
+	}
+
+	// True while the last published slot has not been acquired.  The writer can wait
+	// on this to keep every frame instead of only the latest.
+	bool Pending()const { return (mShared.load(std::memory_order_acquire) & Fresh) != 0; }
+
+	// Reader side.  Returns false, keeping ReadSlot(), if nothing was published since
+	// the last Acquire.
+	bool Acquire()
+	{
+		if(!Pending())
+			return false;
+		uint32_t previous = mShared.exchange(mRead, std::memory_order_acq_rel);
+		mRead = previous & SlotMask;
+		return true;
+	}
+	uint32_t ReadSlot()const { return mRead; }
+
+private:
+	TripleBufferIndex(const TripleBufferIndex& rhs);
+	TripleBufferIndex& operator=(const TripleBufferIndex& rhs);
+
+	static const uint32_t SlotMask = 3;
+	static const uint32_t Fresh = 4;
+
+	uint32_t mWrite;                  // Owned by the writer.
+	std::atomic<uint32_t> mShared;    // Slot in flight, plus Fresh once published.
+	uint32_t mRead;                   // Owned by the reader.
+};
+
+#endif // TRIPLEBUFFER_H
@@ -0,0 +1,180 @@
+#ifndef VECMATH_H
+#define VECMATH_H
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+//---------------------------------------------------------------------------------------
+// Small platform-neutral vector types for the CPU-side terrain code, which has to build
+// without Windows or DirectXMath.  Vec2, Vec3 and Vec4 are layout-compatible with
+// DirectX::XMFLOAT2, XMFLOAT3 and XMFLOAT4, so arrays can be handed across by pointer.
+//---------------------------------------------------------------------------------------
+
+struct Vec2
+{
+	Vec2() : x(0.0f), y(0.0f) {}
+	Vec2(float x, float y) : x(x), y(y) {}
+
+	float x, y;
+};
+
+struct Vec3
+{
+	Vec3() : x(0.0f), y(0.0f), z(0.0f) {}
+	Vec3(float x, float y, float z) : x(x), y(y), z(z) {}
+
+	float  operator[](int i)const { return (&x)[i]; }
+	float& operator[](int i)      { return (&x)[i]; }
+
+	Vec3 operator+(const Vec3& v)const { return Vec3(x + v.x, y + v.y, z + v.z); }
+	Vec3 operator-(const Vec3& v)const { return Vec3(x - v.x, y - v.y, z - v.z); }
+	Vec3 operator*(const Vec3& v)const { return Vec3(x * v.x, y * v.y, z * v.z); }
+	Vec3 operator*(float s)const       { return Vec3(x * s, y * s, z * s); }
+	Vec3 operator-()const              { return Vec3(-x, -y, -z); }
+
+	Vec3& operator+=(const Vec3& v) { x += v.x; y += v.y; z += v.z; return *this; }
+	Vec3& operator-=(const Vec3& v) { x -= v.x; y -= v.y; z -= v.z; return *this; }
+	Vec3& operator*=(float s)       { x *= s; y *= s; z *= s; return *this; }
+
+	float x, y, z;
+};
+
+struct Vec4
+{
+	Vec4() : x(0.0f), y(0.0f), z(0.0f), w(0.0f) {}
+	Vec4(float x, float y, float z, float w) : x(x), y(y), z(z), w(w) {}
+
+	float x, y, z, w;
+};
+
+inline Vec3 operator*(float s, const Vec3& v) { return v * s; }
+
+inline float Dot(const Vec3& a, const Vec3& b) { return a.x*b.x + a.y*b.y + a.z*b.z; }
+
+inline Vec3 Cross(const Vec3& a, const Vec3& b)
+{
+	return Vec3(a.y*b.z - a.z*b.y, a.z*b.x - a.x*b.z, a.x*b.y - a.y*b.x);
+}
+
+inline float LengthSq(const Vec3& v) { return Dot(v, v); }
+inline float Length(const Vec3& v)   { return std::sqrt(Dot(v, v)); }
+
+// Returns v scaled to unit length, or the zero vector if v has no length.
+inline Vec3 Normalize(const Vec3& v)
+{
+	float len = Length(v);
+	return len > 0.0f ? v * (1.0f / len) : Vec3();
+}
+
+// (std::min) and (std::max) keep windows.h's min/max macros from expanding when this
+// header is included after it.
+inline Vec3 Min(const Vec3& a, const Vec3& b) { return Vec3((std::min)(a.x, b.x), (std::min)(a.y, b.y), (std::min)(a.z, b.z)); }
+inline Vec3 Max(const Vec3& a, const Vec3& b) { return Vec3((std::max)(a.x, b.x), (std::max)(a.y, b.y), (std::max)(a.z, b.z)); }
+
+inline Vec3 Lerp(const Vec3& a, const Vec3& b, float t) { return a + (b - a)*t; }
+
+//---------------------------------------------------------------------------------------
+// Axis-aligned bounding box.  A default-constructed box is empty (Min > Max) so it can
+// be grown with Extend without a special first case.
+//---------------------------------------------------------------------------------------
+
+struct AABB
+{
+	AABB() : Min(FLT_MAX, FLT_MAX, FLT_MAX), Max(-FLT_MAX, -FLT_MAX, -FLT_MAX) {}
+	AABB(const Vec3& mn, const Vec3& mx) : Min(mn), Max(mx) {}
+
+	bool IsEmpty()const { return Min.x > Max.x || Min.y > Max.y || Min.z > Max.z; }
+
+	Vec3 Center()const  { return (Min + Max) * 0.5f; }
+	Vec3 Extents()const { return (Max - Min) * 0.5f; }
+	Vec3 Size()const    { return Max - Min; }
+
+	void Extend(const Vec3& p)  { Min = ::Min(Min, p); Max = ::Max(Max, p); }
+	void Extend(const AABB& b)  { Min = ::Min(Min, b.Min); Max = ::Max(Max, b.Max); }
+
+	bool Contains(const Vec3& p)const
+	{
+		return p.x >= Min.x && p.x <= Max.x && p.y >= Min.y && p.y <= Max.y && p.z >= Min.z && p.z <= Max.z;
+	}
+
+	bool Overlaps(const AABB& b)const
+	{
+		return Min.x <= b.Max.x && Max.x >= b.Min.x &&
+		       Min.y <= b.Max.y && Max.y >= b.Min.y &&
+		       Min.z <= b.Max.z && Max.z >= b.Min.z;
+	}
+
+	float SurfaceArea()const
+	{
+		if(IsEmpty())
+			return 0.0f;
+		Vec3 d = Size();
+		return 2.0f*(d.x*d.y + d.y*d.z + d.z*d.x);
+	}
+
+	Vec3 Min;
+	Vec3 Max;
+};
+
+//---------------------------------------------------------------------------------------
+// Row-major 4x4 matrix transforming row vectors (p' = p*M), the DirectXMath convention,
+// so Mat4 is layout-compatible with DirectX::XMFLOAT4X4.  Only what the CPU-side camera
+// and culling need.
+//---------------------------------------------------------------------------------------
+
+struct Mat4
+{
+	Mat4()
+	{
+		for(int r = 0; r < 4; ++r)
+			for(int c = 0; c < 4; ++c)
+				m[r][c] = r == c ? 1.0f : 0.0f;
+	}
+
+	const float* Data()const { return &m[0][0]; }
+
+	float m[4][4];
+};
+
+inline Mat4 operator*(const Mat4& a, const Mat4& b)
+{
+	Mat4 r;
+	for(int i = 0; i < 4; ++i)
+		for(int j = 0; j < 4; ++j)
+			r.m[i][j] = a.m[i][0]*b.m[0][j] + a.m[i][1]*b.m[1][j] + a.m[i][2]*b.m[2][j] + a.m[i][3]*b.m[3][j];
+	return r;
+}
+
+// Same results as XMMatrixLookAtLH.
+inline Mat4 MatrixLookAtLH(const Vec3& eye, const Vec3& target, const Vec3& up)
+{
+	Vec3 z = Normalize(target - eye);
+	Vec3 x = Normalize(Cross(up, z));
+	Vec3 y = Cross(z, x);
+
+	Mat4 r;
+	r.m[0][0] = x.x; r.m[0][1] = y.x; r.m[0][2] = z.x;
+	r.m[1][0] = x.y; r.m[1][1] = y.y; r.m[1][2] = z.y;
+	r.m[2][0] = x.z; r.m[2][1] = y.z; r.m[2][2] = z.z;
+	r.m[3][0] = -Dot(x, eye); r.m[3][1] = -Dot(y, eye); r.m[3][2] = -Dot(z, eye);
+	return r;
+}
+
+// Same results as XMMatrixPerspectiveFovLH: depth maps [nearZ, farZ] to [0, 1].
+inline Mat4 MatrixPerspectiveFovLH(float fovY, float aspect, float nearZ, float farZ)
+{
+	float h = 1.0f / std::tan(0.5f*fovY);
+	float range = farZ / (farZ - nearZ);
+
+	Mat4 r;
+	r.m[0][0] = h / aspect;
+	r.m[1][1] = h;
+	r.m[2][2] = range;
+	r.m[2][3] = 1.0f;
+	r.m[3][2] = -range*nearZ;
+	r.m[3][3] = 0.0f;
+	return r;
+}
+
+#endif // VECMATH_H
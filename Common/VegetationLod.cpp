@@ -0,0 +1,130 @@
+#include "VegetationLod.h"
+
+#include <algorithm>
+#include <cmath>
+
+VegetationLodSettings::VegetationLodSettings()
+	: MidDistance(60.0f), FarDistance(110.0f), CullDistance(200.0f), Hysteresis(5.0f), FadeTime(0.5f),
+	FarKeepEvery(3)
+{
+}
+
+VegetationLod::Stats::Stats()
+	: Transitions(0)
+{
+	for(int b = 0; b < VegetationBandCount; ++b)
+	{
+		Chunks[b] = 0;
+		Instances[b] = 0;
+	}
+}
+
+VegetationLod::VegetationLod(const VegetationLodSettings& settings)
+	: mSettings(settings)
+{
+}
+
+void VegetationLod::Reset(size_t chunkCount)
+{
+	Chunk chunk = { VegetationNear, VegetationNear, 1.0f, false };
+	mChunks.assign(chunkCount, chunk);
+	mStats = Stats();
+}
+
+uint8_t VegetationLod::SelectBand(float d, uint8_t current)const
+{
+	const float boundaries[VegetationBandCount - 1] = { mSettings.MidDistance, mSettings.FarDistance, mSettings.CullDistance };
+
+	// A boundary the chunk is already past moves towards the eye, one it has not
+	// crossed yet moves away.
+	uint8_t band = VegetationNear;
+	for(uint8_t i = 0; i < VegetationBandCount - 1; ++i)
+	{
+		float edge = boundaries[i] + (current > i ? -mSettings.Hysteresis : mSettings.Hysteresis);
+		if(d > edge)
+			band = i + 1;
+	}
+	return band;
+}
+
+void VegetationLod::Update(const Vec3* chunkCenters, size_t chunkCount, const Vec3& eye, float dt)
+{
+	if(mChunks.size() != chunkCount)
+		Reset(chunkCount);
+
+	mStats = Stats();
+	float step = mSettings.FadeTime > 0.0f ? dt / mSettings.FadeTime : 1.0f;
+
+	for(size_t c = 0; c < chunkCount; ++c)
+	{
+		Chunk& chunk = mChunks[c];
+		float d = Length(chunkCenters[c] - eye);
+
+		if(!chunk.Valid)
+		{
+			chunk.Band = chunk.FromBand = SelectBand(d, VegetationNear);
+			chunk.Progress = 1.0f;
+			chunk.Valid = true;
+		}
+		else
+		{
+			chunk.Progress = (std::min)(chunk.Progress + step, 1.0f);
+
+			uint8_t band = SelectBand(d, chunk.Band);
+			if(band != chunk.Band)
+			{
+				// Turning back mid-transition fades the way it came instead of popping.
+				if(chunk.Progress < 1.0f && band == chunk.FromBand)
+					chunk.Progress = 1.0f - chunk.Progress;
+				else
+					chunk.Progress = mSettings.FadeTime > 0.0f ? 0.0f : 1.0f;
+				chunk.FromBand = chunk.Band;
+				chunk.Band = band;
+			}
+		}
+
+		++mStats.Chunks[chunk.Band];
+		if(chunk.Progress < 1.0f)
+			++mStats.Transitions;
+	}
+}
+
+BillboardLod VegetationLod::BandLod(uint8_t band)const
+{
+	BillboardLod lod;
+	lod.Band = band;
+	if(band == VegetationFar)
+	{
+		// Keep the covered area: KeepEvery times fewer quads, each sqrt(KeepEvery) larger.
+		lod.KeepEvery = (std::max)(mSettings.FarKeepEvery, 1u);
+		lod.SizeScale = std::sqrt((float)lod.KeepEvery);
+	}
+	return lod;
+}
+
+size_t VegetationLod::Emit(size_t chunk, const VegetationInstance* instances, size_t count, uint32_t sliceCount,
+	BillboardBatchBuilder& builder)
+{
+	const Chunk& c = mChunks[chunk];
+	size_t added = 0;
+
+	if(c.Progress < 1.0f && c.FromBand != VegetationCulled)
+	{
+		BillboardLod lod = BandLod(c.FromBand);
+		lod.Fade = c.Progress;
+		lod.FadeOut = true;
+		size_t kept = builder.Add(instances, count, sliceCount, lod);
+		mStats.Instances[c.FromBand] += kept;
+		added += kept;
+	}
+
+	if(c.Band != VegetationCulled)
+	{
+		BillboardLod lod = BandLod(c.Band);
+		lod.Fade = c.Progress;
+		size_t kept = builder.Add(instances, count, sliceCount, lod);
+		mStats.Instances[c.Band] += kept;
+		added += kept;
+	}
+	return added;
+}
@@ -0,0 +1,101 @@
+#ifndef VEGETATIONLOD_H
+#define VEGETATIONLOD_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "VecMath.h"
+#include "BillboardBatch.h"
+
+///<summary>
+/// Distance bands for vegetation, finest first.  Near trees are full-resolution
+/// billboards, Mid ones sample a coarser mip as impostors, Far chunks keep one tree in
+/// FarKeepEvery, scaled up to cover roughly the same area, and Culled chunks draw
+/// nothing.
+///</summary>
+enum VegetationBand
+{
+	VegetationNear = 0,
+	VegetationMid = 1,
+	VegetationFar = 2,
+	VegetationCulled = 3,
+	VegetationBandCount = 4
+};
+
+///<summary>
+/// Band boundaries are distances from the eye to a chunk's center.  A chunk only
+/// moves to a coarser band once it is Hysteresis past the boundary, and back to a
+/// finer one once it is Hysteresis inside it, so a camera resting on a boundary does
+/// not flip it every frame.  Band changes cross-fade with a screen-space dither over
+/// FadeTime seconds.
+///</summary>
+struct VegetationLodSettings
+{
+	VegetationLodSettings();
+
+	float MidDistance;
+	float FarDistance;
+	float CullDistance;
+	float Hysteresis;
+	float FadeTime;
+	uint32_t FarKeepEvery;
+};
+
+///<summary>
+/// Picks a band per chunk on the CPU and turns it into BillboardLod runs.  Update once
+/// a frame, then Emit the instances of each chunk to draw.  While a chunk changes band
+/// it is emitted twice, the incoming band fading in and the outgoing one fading out in
+/// the complementary dither pattern, so no pixel is drawn by both.
+///</summary>
+class VegetationLod
+{
+public:
+	struct Stats
+	{
+		Stats();
+
+		size_t Chunks[VegetationBandCount];
+		size_t Instances[VegetationBandCount];   // Emitted this frame, after thinning.
+		size_t Transitions;                      // Chunks currently cross-fading.
+	};
+
+	explicit VegetationLod(const VegetationLodSettings& settings = VegetationLodSettings());
+
+	const VegetationLodSettings& Settings()const { return mSettings; }
+
+	// Forgets every chunk's band; the next Update snaps them without fading.
+	void Reset(size_t chunkCount);
+
+	void Update(const Vec3* chunkCenters, size_t chunkCount, const Vec3& eye, float dt);
+
+	VegetationBand Band(size_t chunk)const { return (VegetationBand)mChunks[chunk].Band; }
+	bool Fading(size_t chunk)const { return mChunks[chunk].Progress < 1.0f; }
+
+	// Adds the chunk's instances to the builder as drawn this frame and returns how
+	// many were added.
+	size_t Emit(size_t chunk, const VegetationInstance* instances, size_t count, uint32_t sliceCount,
+		BillboardBatchBuilder& builder);
+
+	const Stats& GetStats()const { return mStats; }
+
+private:
+	// The band a chunk at distance d settles in, given the band it is in now.
+	uint8_t SelectBand(float d, uint8_t current)const;
+
+	BillboardLod BandLod(uint8_t band)const;
+
+	struct Chunk
+	{
+		uint8_t Band;
+		uint8_t FromBand;
+		float Progress;   // 0 when a transition starts, 1 once FromBand is gone.
+		bool Valid;
+	};
+
+	VegetationLodSettings mSettings;
+	std::vector<Chunk> mChunks;
+	Stats mStats;
+};
+
+#endif // VEGETATIONLOD_H
@@ -0,0 +1,205 @@
+#include "VegetationScatter.h"
+#include "ParallelFor.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+// Grids with more cells than this are coarsened; a cell then holds several instances
+// and the spacing test just walks more of them.
+static const size_t MaxGridCells = 1 << 22;
+
+// Small PCG32 generator.  Deterministic across compilers, unlike std:: distributions.
+class ScatterRandom
+{
+public:
+	explicit ScatterRandom(uint32_t seed) : mState(0)
+	{
+		Next();
+		mState += seed;
+		Next();
+	}
+
+	uint32_t Next()
+	{
+		uint64_t old = mState;
+		mState = old*6364136223846793005ULL + 1442695040888963407ULL;
+		uint32_t xorShifted = (uint32_t)(((old >> 18) ^ old) >> 27);
+		uint32_t rot = (uint32_t)(old >> 59);
+		return (xorShifted >> rot) | (xorShifted << ((32 - rot) & 31));
+	}
+
+	// Uniform in [0, 1).
+	float NextFloat() { return (Next() >> 8) * (1.0f / 16777216.0f); }
+
+private:
+	uint64_t mState;
+};
+
+static float Saturate(float v)
+{
+	return (std::min)((std::max)(v, 0.0f), 1.0f);
+}
+
+static float TriangleWeight(const ScatterSettings& s, const Vec3& normal, float height)
+{
+	float slope = s.FullUpDot > s.MinUpDot ? Saturate((normal.y - s.MinUpDot) / (s.FullUpDot - s.MinUpDot))
+	                                       : (normal.y >= s.FullUpDot ? 1.0f : 0.0f);
+	if(slope <= 0.0f)
+		return 0.0f;
+
+	float outside = (std::max)(s.MinHeight - height, height - s.MaxHeight);
+	float band = outside <= 0.0f ? 1.0f : (s.HeightFade > 0.0f ? Saturate(1.0f - outside / s.HeightFade) : 0.0f);
+	return slope*band;
+}
+
+ScatterSettings::ScatterSettings()
+	: Density(0.05f), Spacing(4.0f), MinUpDot(0.7f), FullUpDot(0.9f), MinHeight(-FLT_MAX), MaxHeight(FLT_MAX),
+	HeightFade(0.0f), MinSize(6.0f), MaxSize(10.0f), Aspect(1.0f), VariantCount(4)
+{
+}
+
+uint32_t VegetationScatter::ChunkSeed(uint32_t worldSeed, int x, int y, int z)
+{
+	// Hash the coordinates so neighbouring chunks get unrelated sequences.
+	uint32_t h = worldSeed ^ 0x9e3779b9u;
+	const uint32_t c[3] = { (uint32_t)x, (uint32_t)y, (uint32_t)z };
+	for(int i = 0; i < 3; ++i)
+	{
+		h ^= c[i] + 0x7f4a7c15u + (h << 6) + (h >> 2);
+		h *= 0x85ebca6bu;
+		h ^= h >> 13;
+	}
+	return h;
+}
+
+bool VegetationScatter::IsFarEnough(const Vec3& p, float spacingSq, const std::vector<VegetationInstance>& placed)const
+{
+	int cell[3];
+	for(int a = 0; a < 3; ++a)
+		cell[a] = (std::min)((int)((p[a] - mGridOrigin[a]) / mCellSize), mGridSize[a] - 1);
+
+	for(int z = (std::max)(cell[2] - 1, 0); z <= (std::min)(cell[2] + 1, mGridSize[2] - 1); ++z)
+	{
+		for(int y = (std::max)(cell[1] - 1, 0); y <= (std::min)(cell[1] + 1, mGridSize[1] - 1); ++y)
+		{
+			for(int x = (std::max)(cell[0] - 1, 0); x <= (std::min)(cell[0] + 1, mGridSize[0] - 1); ++x)
+			{
+				size_t c = ((size_t)z*mGridSize[1] + y)*mGridSize[0] + x;
+				for(int32_t i = mGrid[c]; i >= 0; i = mNext[i])
+				{
+					if(LengthSq(placed[i].Position - p) < spacingSq)
+						return false;
+				}
+			}
+		}
+	}
+	return true;
+}
+
+void VegetationScatter::Scatter(const ScatterSurface& surface, const ScatterSettings& settings, uint32_t seed,
+	std::vector<VegetationInstance>& out)
+{
+	out.clear();
+	mTriangles.clear();
+	mCumulativeArea.clear();
+
+	// Weighted area of every triangle that can carry vegetation.
+	AABB bounds;
+	double total = 0.0;
+	for(size_t t = 0; t + 2 < surface.IndexCount; t += 3)
+	{
+		const uint32_t* idx = surface.Indices + t;
+		const Vec3& p0 = surface.Positions[idx[0]];
+		const Vec3& p1 = surface.Positions[idx[1]];
+		const Vec3& p2 = surface.Positions[idx[2]];
+
+		Vec3 normal = Normalize(surface.Normals[idx[0]] + surface.Normals[idx[1]] + surface.Normals[idx[2]]);
+		float weight = TriangleWeight(settings, normal, (p0.y + p1.y + p2.y) * (1.0f / 3.0f));
+		if(weight <= 0.0f)
+			continue;
+
+		float area = 0.5f*Length(Cross(p1 - p0, p2 - p0));
+		if(area <= 0.0f)
+			continue;
+
+		total += area*weight;
+		mTriangles.push_back((uint32_t)t);
+		mCumulativeArea.push_back((float)total);
+		bounds.Extend(p0);
+		bounds.Extend(p1);
+		bounds.Extend(p2);
+	}
+	if(mTriangles.empty() || settings.Density <= 0.0f)
+		return;
+
+	ScatterRandom random(seed);
+
+	// Round the expected candidate count randomly so fractional densities average out.
+	double expected = total*settings.Density;
+	size_t candidates = (size_t)expected + (random.NextFloat() < (float)(expected - std::floor(expected)) ? 1 : 0);
+
+	// Spacing grid over the chunk.
+	mCellSize = (std::max)(settings.Spacing, 1e-3f);
+	Vec3 extent = bounds.Max - bounds.Min;
+	for(;;)
+	{
+		for(int a = 0; a < 3; ++a)
+			mGridSize[a] = (int)(extent[a] / mCellSize) + 1;
+		if((size_t)mGridSize[0]*mGridSize[1]*mGridSize[2] <= MaxGridCells)
+			break;
+		mCellSize *= 2.0f;
+	}
+	mGridOrigin = bounds.Min;
+	mGrid.assign((size_t)mGridSize[0]*mGridSize[1]*mGridSize[2], -1);
+	mNext.clear();
+
+	// Cells are at least Spacing wide, so neighbours closer than that are always in the
+	// surrounding 3x3x3 cells.
+	float spacing = (std::max)(settings.Spacing, 0.0f);
+
+	for(size_t i = 0; i < candidates; ++i)
+	{
+		// Pick a triangle by weighted area, then a uniform point in it.
+		float r = random.NextFloat() * mCumulativeArea.back();
+		size_t k = std::upper_bound(mCumulativeArea.begin(), mCumulativeArea.end(), r) - mCumulativeArea.begin();
+		k = (std::min)(k, mTriangles.size() - 1);
+
+		const uint32_t* idx = surface.Indices + mTriangles[k];
+		float s = std::sqrt(random.NextFloat());
+		float u = random.NextFloat();
+		Vec3 p = surface.Positions[idx[0]]*(1.0f - s) + surface.Positions[idx[1]]*(s*(1.0f - u)) +
+			surface.Positions[idx[2]]*(s*u);
+
+		float size = settings.MinSize + (settings.MaxSize - settings.MinSize)*random.NextFloat();
+		uint32_t variant = settings.VariantCount > 1 ? random.Next() % settings.VariantCount : 0;
+
+		if(!IsFarEnough(p, spacing*spacing, out))
+			continue;
+
+		VegetationInstance instance;
+		instance.Position = p;
+		instance.Height = size;
+		instance.Width = size*settings.Aspect;
+		instance.Variant = variant;
+
+		int cell[3];
+		for(int a = 0; a < 3; ++a)
+			cell[a] = (std::min)((int)((p[a] - mGridOrigin[a]) / mCellSize), mGridSize[a] - 1);
+		size_t c = ((size_t)cell[2]*mGridSize[1] + cell[1])*mGridSize[0] + cell[0];
+		mNext.push_back(mGrid[c]);
+		mGrid[c] = (int32_t)out.size();
+		out.push_back(instance);
+	}
+}
+
+void VegetationScatter::ScatterChunks(const ScatterSurface* surfaces, const uint32_t* seeds, size_t count,
+	const ScatterSettings& settings, std::vector<VegetationInstance>* out)
+{
+	ParallelFor(count, 1, [&](size_t begin, size_t end)
+	{
+		VegetationScatter scatter;
+		for(size_t i = begin; i < end; ++i)
+			scatter.Scatter(surfaces[i], settings, seeds[i], out[i]);
+	});
+}
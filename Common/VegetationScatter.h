@@ -0,0 +1,102 @@
+#ifndef VEGETATIONSCATTER_H
+#define VEGETATIONSCATTER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "VecMath.h"
+
+///<summary>
+/// One scattered plant: the point on the surface it stands on, its size and which
+/// texture variant it uses.
+///</summary>
+struct VegetationInstance
+{
+	Vec3 Position;
+	float Width;
+	float Height;
+	uint32_t Variant;
+};
+
+///<summary>
+/// Where vegetation may grow and how densely.  Each triangle is weighted by
+///   slope:  0 when its normal's y is at or below MinUpDot, 1 at or above FullUpDot,
+///   height: 1 inside [MinHeight, MaxHeight], fading to 0 over HeightFade outside,
+/// and candidates are placed at Density per unit of weighted area.  Candidates closer
+/// than Spacing to an instance already placed are dropped, so the result is a
+/// Poisson-disk set no denser than the spacing allows.
+///</summary>
+struct ScatterSettings
+{
+	ScatterSettings();
+
+	float Density;
+	float Spacing;
+	float MinUpDot;
+	float FullUpDot;
+	float MinHeight;
+	float MaxHeight;
+	float HeightFade;
+	float MinSize;        // Instance height range; width is height * Aspect.
+	float MaxSize;
+	float Aspect;
+	uint32_t VariantCount;
+};
+
+///<summary>
+/// A chunk's triangles: Indices (three per triangle) over Positions and Normals, which
+/// may be shared with other chunks.  Normals point out of the solid, as TerrainMesher
+/// writes them.
+///</summary>
+struct ScatterSurface
+{
+	ScatterSurface() : Positions(0), Normals(0), Indices(0), IndexCount(0) {}
+
+	const Vec3* Positions;
+	const Vec3* Normals;
+	const uint32_t* Indices;
+	size_t IndexCount;
+};
+
+///<summary>
+/// Places vegetation on extracted terrain one chunk at a time.  A chunk's instances
+/// depend only on its own triangles, the settings and its seed, so chunks can be
+/// scattered in any order, on any thread, when they are extracted and thrown away
+/// with them; nothing looks at the whole world.  Spacing is enforced within a chunk
+/// only: two instances on either side of a chunk border can be closer than Spacing.
+///
+/// A VegetationScatter keeps its scratch memory between calls, so reuse one instance
+/// per worker thread.
+///</summary>
+class VegetationScatter
+{
+public:
+	// Seed for the chunk at integer chunk coordinates (x, y, z).
+	static uint32_t ChunkSeed(uint32_t worldSeed, int x, int y, int z);
+
+	// Replaces out with the instances for one chunk.
+	void Scatter(const ScatterSurface& surface, const ScatterSettings& settings, uint32_t seed,
+		std::vector<VegetationInstance>& out);
+
+	// Scatters surfaces[i] with seeds[i] into out[i] across threads.  The result is the
+	// same as calling Scatter on each chunk in turn.
+	static void ScatterChunks(const ScatterSurface* surfaces, const uint32_t* seeds, size_t count,
+		const ScatterSettings& settings, std::vector<VegetationInstance>* out);
+
+private:
+	bool IsFarEnough(const Vec3& p, float spacingSq, const std::vector<VegetationInstance>& placed)const;
+
+	std::vector<uint32_t> mTriangles;   // First index of each triangle with weight > 0.
+	std::vector<float> mCumulativeArea; // Running weighted area, parallel to mTriangles.
+
+	// Uniform grid over the chunk with Spacing-sized cells: the first instance in each
+	// cell, or -1, and the next instance in the same cell.
+	std::vector<int32_t> mGrid;
+	std::vector<int32_t> mNext;
+	Vec3 mGridOrigin;
+	float mCellSize;
+	int mGridSize[3];
+};
+
+#endif // VEGETATIONSCATTER_H
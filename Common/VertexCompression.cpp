@@ -0,0 +1,432 @@
+#include "VertexCompression.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VERTEXCOMPRESSION_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(__F16C__) || (defined(_MSC_VER) && defined(__AVX2__))
+#define VERTEXCOMPRESSION_F16C
+#include <immintrin.h>
+#endif
+
+namespace
+{
+	template<typename T>
+	const T* ElementAt(const void* base, size_t stride, size_t i)
+	{
+		return reinterpret_cast<const T*>(static_cast<const char*>(base) + i*stride);
+	}
+
+	template<typename T>
+	T* ElementAt(void* base, size_t stride, size_t i)
+	{
+		return reinterpret_cast<T*>(static_cast<char*>(base) + i*stride);
+	}
+
+	// Round to nearest, ties to even; matches _mm_cvtps_epi32 under the default MXCSR.
+	inline int RoundToInt(float x)
+	{
+		return (int)std::lrintf(x);
+	}
+
+	inline float SignNotZero(float x)
+	{
+		return x >= 0.0f ? 1.0f : -1.0f;
+	}
+
+#ifdef VERTEXCOMPRESSION_SSE2
+	// Loads component c of four consecutive strided float vectors into one register.
+	inline __m128 GatherLane(const void* src, size_t stride, size_t i, int c)
+	{
+		return _mm_set_ps(
+			ElementAt<float>(src, stride, i+3)[c],
+			ElementAt<float>(src, stride, i+2)[c],
+			ElementAt<float>(src, stride, i+1)[c],
+			ElementAt<float>(src, stride, i+0)[c]);
+	}
+
+	inline __m128 Abs(__m128 v)
+	{
+		return _mm_andnot_ps(_mm_set1_ps(-0.0f), v);
+	}
+
+	// SignNotZero for four lanes: +1 where v >= 0, -1 elsewhere.
+	inline __m128 SignNotZero(__m128 v)
+	{
+		__m128 nonNegative = _mm_cmpge_ps(v, _mm_setzero_ps());
+		return _mm_or_ps(_mm_and_ps(nonNegative, _mm_set1_ps(1.0f)), _mm_andnot_ps(nonNegative, _mm_set1_ps(-1.0f)));
+	}
+
+	inline __m128 Select(__m128 mask, __m128 a, __m128 b)
+	{
+		return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+	}
+#endif
+}
+
+//---------------------------------------------------------------------------------------
+// Half precision.
+//---------------------------------------------------------------------------------------
+
+uint16_t VertexCompression::FloatToHalf(float f)
+{
+	uint32_t x;
+	std::memcpy(&x, &f, sizeof(x));
+
+	uint32_t sign = (x >> 16) & 0x8000;
+	uint32_t absx = x & 0x7FFFFFFF;
+
+	// Inf stays inf; any NaN becomes a quiet NaN.
+	if(absx >= 0x7F800000)
+		return (uint16_t)(sign | 0x7C00 | (absx > 0x7F800000 ? 0x0200 : 0));
+
+	// 65520 and above round to infinity.
+	if(absx >= 0x477FF000)
+		return (uint16_t)(sign | 0x7C00);
+
+	// Below the smallest normal half: scale into the denormal range and let the FPU
+	// round.  The result may round up to 0x0400, which is the smallest normal.
+	if(absx < 0x38800000)
+	{
+		float a;
+		std::memcpy(&a, &absx, sizeof(a));
+		return (uint16_t)(sign | (uint32_t)RoundToInt(a * 16777216.0f));
+	}
+
+	// Rebias the exponent from 127 to 15 and round the dropped 13 mantissa bits
+	// to nearest even.
+	uint32_t mantOdd = (absx >> 13) & 1;
+	absx += 0xC8000FFF + mantOdd;
+	return (uint16_t)(sign | (absx >> 13));
+}
+
+float VertexCompression::HalfToFloat(uint16_t h)
+{
+	uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+	uint32_t exponent = (h >> 10) & 0x1F;
+	uint32_t mantissa = h & 0x3FF;
+
+	uint32_t bits;
+	if(exponent == 0)
+	{
+		// Zero or denormal: mantissa * 2^-24.
+		float f = (float)mantissa * (1.0f / 16777216.0f);
+		std::memcpy(&bits, &f, sizeof(bits));
+		bits |= sign;
+	}
+	else if(exponent == 31)
+	{
+		bits = sign | 0x7F800000 | (mantissa << 13);
+	}
+	else
+	{
+		bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+	}
+
+	float f;
+	std::memcpy(&f, &bits, sizeof(f));
+	return f;
+}
+
+void VertexCompression::EncodeHalf2(const void* src, size_t srcStride, size_t count, void* dst, size_t dstStride)
+{
+	size_t i = 0;
+
+#ifdef VERTEXCOMPRESSION_F16C
+	// Two elements (four floats) per conversion.
+	for(; i + 2 <= count; i += 2)
+	{
+		const float* a = ElementAt<float>(src, srcStride, i);
+		const float* b = ElementAt<float>(src, srcStride, i+1);
+
+		__m128i h = _mm_cvtps_ph(_mm_set_ps(b[1], b[0], a[1], a[0]), _MM_FROUND_TO_NEAREST_INT);
+
+		uint32_t lo = (uint32_t)_mm_cvtsi128_si32(h);
+		uint32_t hi = (uint32_t)_mm_cvtsi128_si32(_mm_srli_si128(h, 4));
+		std::memcpy(ElementAt<uint16_t>(dst, dstStride, i), &lo, sizeof(lo));
+		std::memcpy(ElementAt<uint16_t>(dst, dstStride, i+1), &hi, sizeof(hi));
+	}
+#endif
+
+	for(; i < count; ++i)
+	{
+		const float* s = ElementAt<float>(src, srcStride, i);
+		uint16_t* d = ElementAt<uint16_t>(dst, dstStride, i);
+		d[0] = FloatToHalf(s[0]);
+		d[1] = FloatToHalf(s[1]);
+	}
+}
+
+void VertexCompression::DecodeHalf2(const void* src, size_t srcStride, size_t count, void* dst, size_t dstStride)
+{
+	size_t i = 0;
+
+#ifdef VERTEXCOMPRESSION_F16C
+	for(; i + 2 <= count; i += 2)
+	{
+		uint32_t lo, hi;
+		std::memcpy(&lo, ElementAt<uint16_t>(src, srcStride, i), sizeof(lo));
+		std::memcpy(&hi, ElementAt<uint16_t>(src, srcStride, i+1), sizeof(hi));
+
+		float f[4];
+		_mm_storeu_ps(f, _mm_cvtph_ps(_mm_set_epi32(0, 0, (int)hi, (int)lo)));
+
+		float* a = ElementAt<float>(dst, dstStride, i);
+		float* b = ElementAt<float>(dst, dstStride, i+1);
+		a[0] = f[0]; a[1] = f[1];
+		b[0] = f[2]; b[1] = f[3];
+	}
+#endif
+
+	for(; i < count; ++i)
+	{
+		const uint16_t* s = ElementAt<uint16_t>(src, srcStride, i);
+		float* d = ElementAt<float>(dst, dstStride, i);
+		d[0] = HalfToFloat(s[0]);
+		d[1] = HalfToFloat(s[1]);
+	}
+}
+
+//---------------------------------------------------------------------------------------
+// Octahedral normals.
+//
+// The unit sphere is projected onto the octahedron |x|+|y|+|z| = 1, and the lower
+// half (z < 0) is folded out over the diagonals so the whole surface maps onto
+// the [-1,1]^2 square.
+//---------------------------------------------------------------------------------------
+
+void VertexCompression::OctEncode(const float n[3], int16_t out[2])
+{
+	float l1 = std::fabs(n[0]) + std::fabs(n[1]) + std::fabs(n[2]);
+	float invL1 = l1 > 0.0f ? 1.0f / l1 : 0.0f;
+
+	float x = n[0] * invL1;
+	float y = n[1] * invL1;
+
+	if(n[2] < 0.0f)
+	{
+		float fx = (1.0f - std::fabs(y)) * SignNotZero(x);
+		float fy = (1.0f - std::fabs(x)) * SignNotZero(y);
+		x = fx;
+		y = fy;
+	}
+
+	out[0] = (int16_t)RoundToInt(std::min(1.0f, std::max(-1.0f, x)) * 32767.0f);
+	out[1] = (int16_t)RoundToInt(std::min(1.0f, std::max(-1.0f, y)) * 32767.0f);
+}
+
+void VertexCompression::OctDecode(const int16_t in[2], float n[3])
+{
+	float x = std::max(-1.0f, in[0] * (1.0f / 32767.0f));
+	float y = std::max(-1.0f, in[1] * (1.0f / 32767.0f));
+	float z = 1.0f - std::fabs(x) - std::fabs(y);
+
+	// Unfold the lower hemisphere.
+	float t = std::max(-z, 0.0f);
+	x += x >= 0.0f ? -t : t;
+	y += y >= 0.0f ? -t : t;
+
+	float invLen = 1.0f / std::sqrt(x*x + y*y + z*z);
+	n[0] = x * invLen;
+	n[1] = y * invLen;
+	n[2] = z * invLen;
+}
+
+void VertexCompression::EncodeOctNormals(const void* src, size_t srcStride, size_t count, void* dst, size_t dstStride)
+{
+	size_t i = 0;
+
+#ifdef VERTEXCOMPRESSION_SSE2
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 snormScale = _mm_set1_ps(32767.0f);
+
+	for(; i + 4 <= count; i += 4)
+	{
+		__m128 nx = GatherLane(src, srcStride, i, 0);
+		__m128 ny = GatherLane(src, srcStride, i, 1);
+		__m128 nz = GatherLane(src, srcStride, i, 2);
+
+		__m128 l1 = _mm_add_ps(_mm_add_ps(Abs(nx), Abs(ny)), Abs(nz));
+		__m128 invL1 = _mm_and_ps(_mm_cmpgt_ps(l1, zero), _mm_div_ps(one, l1));
+
+		__m128 x = _mm_mul_ps(nx, invL1);
+		__m128 y = _mm_mul_ps(ny, invL1);
+
+		__m128 lower = _mm_cmplt_ps(nz, zero);
+		__m128 fx = _mm_mul_ps(_mm_sub_ps(one, Abs(y)), SignNotZero(x));
+		__m128 fy = _mm_mul_ps(_mm_sub_ps(one, Abs(x)), SignNotZero(y));
+		x = Select(lower, fx, x);
+		y = Select(lower, fy, y);
+
+		x = _mm_min_ps(one, _mm_max_ps(_mm_set1_ps(-1.0f), x));
+		y = _mm_min_ps(one, _mm_max_ps(_mm_set1_ps(-1.0f), y));
+
+		int32_t qx[4], qy[4];
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(qx), _mm_cvtps_epi32(_mm_mul_ps(x, snormScale)));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(qy), _mm_cvtps_epi32(_mm_mul_ps(y, snormScale)));
+
+		for(int k = 0; k < 4; ++k)
+		{
+			int16_t* d = ElementAt<int16_t>(dst, dstStride, i+k);
+			d[0] = (int16_t)qx[k];
+			d[1] = (int16_t)qy[k];
+		}
+	}
+#endif
+
+	for(; i < count; ++i)
+		OctEncode(ElementAt<float>(src, srcStride, i), ElementAt<int16_t>(dst, dstStride, i));
+}
+
+void VertexCompression::DecodeOctNormals(const void* src, size_t srcStride, size_t count, void* dst, size_t dstStride)
+{
+	size_t i = 0;
+
+#ifdef VERTEXCOMPRESSION_SSE2
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 minusOne = _mm_set1_ps(-1.0f);
+	const __m128 invSnorm = _mm_set1_ps(1.0f / 32767.0f);
+
+	for(; i + 4 <= count; i += 4)
+	{
+		const int16_t* s0 = ElementAt<int16_t>(src, srcStride, i+0);
+		const int16_t* s1 = ElementAt<int16_t>(src, srcStride, i+1);
+		const int16_t* s2 = ElementAt<int16_t>(src, srcStride, i+2);
+		const int16_t* s3 = ElementAt<int16_t>(src, srcStride, i+3);
+
+		__m128 x = _mm_max_ps(minusOne, _mm_mul_ps(_mm_cvtepi32_ps(_mm_set_epi32(s3[0], s2[0], s1[0], s0[0])), invSnorm));
+		__m128 y = _mm_max_ps(minusOne, _mm_mul_ps(_mm_cvtepi32_ps(_mm_set_epi32(s3[1], s2[1], s1[1], s0[1])), invSnorm));
+		__m128 z = _mm_sub_ps(_mm_sub_ps(one, Abs(x)), Abs(y));
+
+		__m128 t = _mm_max_ps(_mm_sub_ps(zero, z), zero);
+		x = _mm_add_ps(x, Select(_mm_cmpge_ps(x, zero), _mm_sub_ps(zero, t), t));
+		y = _mm_add_ps(y, Select(_mm_cmpge_ps(y, zero), _mm_sub_ps(zero, t), t));
+
+		__m128 lenSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z));
+		__m128 invLen = _mm_div_ps(one, _mm_sqrt_ps(lenSq));
+
+		float ox[4], oy[4], oz[4];
+		_mm_storeu_ps(ox, _mm_mul_ps(x, invLen));
+		_mm_storeu_ps(oy, _mm_mul_ps(y, invLen));
+		_mm_storeu_ps(oz, _mm_mul_ps(z, invLen));
+
+		for(int k = 0; k < 4; ++k)
+		{
+			float* d = ElementAt<float>(dst, dstStride, i+k);
+			d[0] = ox[k];
+			d[1] = oy[k];
+			d[2] = oz[k];
+		}
+	}
+#endif
+
+	for(; i < count; ++i)
+		OctDecode(ElementAt<int16_t>(src, srcStride, i), ElementAt<float>(dst, dstStride, i));
+}
+
+//---------------------------------------------------------------------------------------
+// Chunk-relative positions.
+//---------------------------------------------------------------------------------------
+
+void VertexCompression::QuantizePosition(const float p[3], const float origin[3], const float extent[3], uint16_t out[3])
+{
+	for(int c = 0; c < 3; ++c)
+	{
+		float scale = extent[c] > 0.0f ? 65535.0f / extent[c] : 0.0f;
+		float t = (p[c] - origin[c]) * scale;
+		out[c] = (uint16_t)RoundToInt(std::min(65535.0f, std::max(0.0f, t)));
+	}
+}
+
+void VertexCompression::DequantizePosition(const uint16_t in[3], const float origin[3], const float extent[3], float p[3])
+{
+	for(int c = 0; c < 3; ++c)
+		p[c] = origin[c] + (float)in[c] * (extent[c] / 65535.0f);
+}
+
+void VertexCompression::QuantizePositions(const void* src, size_t srcStride, size_t count,
+	const float origin[3], const float extent[3], void* dst, size_t dstStride)
+{
+	size_t i = 0;
+
+#ifdef VERTEXCOMPRESSION_SSE2
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 maxValue = _mm_set1_ps(65535.0f);
+
+	__m128 o[3], scale[3];
+	for(int c = 0; c < 3; ++c)
+	{
+		o[c] = _mm_set1_ps(origin[c]);
+		scale[c] = _mm_set1_ps(extent[c] > 0.0f ? 65535.0f / extent[c] : 0.0f);
+	}
+
+	for(; i + 4 <= count; i += 4)
+	{
+		int32_t q[3][4];
+		for(int c = 0; c < 3; ++c)
+		{
+			__m128 t = _mm_mul_ps(_mm_sub_ps(GatherLane(src, srcStride, i, c), o[c]), scale[c]);
+			t = _mm_min_ps(maxValue, _mm_max_ps(zero, t));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(q[c]), _mm_cvtps_epi32(t));
+		}
+
+		for(int k = 0; k < 4; ++k)
+		{
+			uint16_t* d = ElementAt<uint16_t>(dst, dstStride, i+k);
+			d[0] = (uint16_t)q[0][k];
+			d[1] = (uint16_t)q[1][k];
+			d[2] = (uint16_t)q[2][k];
+		}
+	}
+#endif
+
+	for(; i < count; ++i)
+		QuantizePosition(ElementAt<float>(src, srcStride, i), origin, extent, ElementAt<uint16_t>(dst, dstStride, i));
+}
+
+void VertexCompression::DequantizePositions(const void* src, size_t srcStride, size_t count,
+	const float origin[3], const float extent[3], void* dst, size_t dstStride)
+{
+	size_t i = 0;
+
+#ifdef VERTEXCOMPRESSION_SSE2
+	__m128 o[3], step[3];
+	for(int c = 0; c < 3; ++c)
+	{
+		o[c] = _mm_set1_ps(origin[c]);
+		step[c] = _mm_set1_ps(extent[c] / 65535.0f);
+	}
+
+	for(; i + 4 <= count; i += 4)
+	{
+		const uint16_t* s0 = ElementAt<uint16_t>(src, srcStride, i+0);
+		const uint16_t* s1 = ElementAt<uint16_t>(src, srcStride, i+1);
+		const uint16_t* s2 = ElementAt<uint16_t>(src, srcStride, i+2);
+		const uint16_t* s3 = ElementAt<uint16_t>(src, srcStride, i+3);
+
+		float p[3][4];
+		for(int c = 0; c < 3; ++c)
+		{
+			__m128 q = _mm_cvtepi32_ps(_mm_set_epi32(s3[c], s2[c], s1[c], s0[c]));
+			_mm_storeu_ps(p[c], _mm_add_ps(o[c], _mm_mul_ps(q, step[c])));
+		}
+
+		for(int k = 0; k < 4; ++k)
+		{
+			float* d = ElementAt<float>(dst, dstStride, i+k);
+			d[0] = p[0][k];
+			d[1] = p[1][k];
+			d[2] = p[2][k];
+		}
+	}
+#endif
+
+	for(; i < count; ++i)
+		DequantizePosition(ElementAt<uint16_t>(src, srcStride, i), origin, extent, ElementAt<float>(dst, dstStride, i));
+}
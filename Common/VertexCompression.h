@@ -0,0 +1,61 @@
+#ifndef VERTEXCOMPRESSION_H
+#define VERTEXCOMPRESSION_H
+
+#include <cstddef>
+#include <cstdint>
+
+///<summary>
+/// Quantization helpers for compact vertex formats:
+///   - positions as 16-bit UNORM relative to a chunk origin and extent,
+///   - unit normals as octahedral 2x16-bit SNORM,
+///   - texture coordinates as IEEE half floats.
+/// The batch functions read and write strided arrays so they can work directly on
+/// interleaved vertex structs (GeometryGenerator::Vertex, Vertex::Basic32, ...).
+/// They use SSE2 (and F16C for halves) when the compiler targets it and fall back
+/// to the scalar routines otherwise; both paths produce identical bits.
+///</summary>
+class VertexCompression
+{
+public:
+	//
+	// Half precision.
+	//
+
+	static uint16_t FloatToHalf(float f);
+	static float HalfToFloat(uint16_t h);
+
+	// dst[i*dstStride] = half(src[i*srcStride]) for a pair of floats per element.
+	static void EncodeHalf2(const void* src, size_t srcStride, size_t count, void* dst, size_t dstStride);
+	static void DecodeHalf2(const void* src, size_t srcStride, size_t count, void* dst, size_t dstStride);
+
+	//
+	// Octahedral normals.
+	//
+
+	// Maps a unit vector onto the octahedron and stores it as two SNORM16 values.
+	static void OctEncode(const float n[3], int16_t out[2]);
+	static void OctDecode(const int16_t in[2], float n[3]);
+
+	static void EncodeOctNormals(const void* src, size_t srcStride, size_t count, void* dst, size_t dstStride);
+	static void DecodeOctNormals(const void* src, size_t srcStride, size_t count, void* dst, size_t dstStride);
+
+	//
+	// Chunk-relative positions.
+	//
+
+	// Quantizes p into [0, 65535]^3 over the box [origin, origin + extent].  Values
+	// outside the box are clamped.
+	static void QuantizePosition(const float p[3], const float origin[3], const float extent[3], uint16_t out[3]);
+	static void DequantizePosition(const uint16_t in[3], const float origin[3], const float extent[3], float p[3]);
+
+	static void QuantizePositions(const void* src, size_t srcStride, size_t count,
+		const float origin[3], const float extent[3], void* dst, size_t dstStride);
+	static void DequantizePositions(const void* src, size_t srcStride, size_t count,
+		const float origin[3], const float extent[3], void* dst, size_t dstStride);
+
+	// Half a quantization step: the worst-case rounding error of a quantized
+	// position along one axis, before float rounding of the decoded value.
+	static float PositionError(float extent) { return 0.5f * extent / 65535.0f; }
+};
+
+#endif // VERTEXCOMPRESSION_H
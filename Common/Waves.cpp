@@ -3,11 +3,10 @@
 #include <algorithm>
 #include <vector>
 #include <cassert>
-using namespace DirectX;
 
 Waves::Waves()
 : mNumRows(0), mNumCols(0), mVertexCount(0), mTriangleCount(0), 
-  mK1(0.0f), mK2(0.0f), mK3(0.0f), mTimeStep(0.0f), mSpatialStep(0.0f),
+  mK1(0.0f), mK2(0.0f), mK3(0.0f), mTimeStep(0.0f), mSpatialStep(0.0f), mTime(0.0f),
   mPrevSolution(0), mCurrSolution(0), mNormals(0), mTangentX(0)
 {
 }
@@ -20,22 +19,22 @@ Waves::~Waves()
 	delete[] mTangentX;
 }
 
-UINT Waves::RowCount()const
+uint32_t Waves::RowCount()const
 {
 	return mNumRows;
 }
 
-UINT Waves::ColumnCount()const
+uint32_t Waves::ColumnCount()const
 {
 	return mNumCols;
 }
 
-UINT Waves::VertexCount()const
+uint32_t Waves::VertexCount()const
 {
 	return mVertexCount;
 }
 
-UINT Waves::TriangleCount()const
+uint32_t Waves::TriangleCount()const
 {
 	return mTriangleCount;
 }
@@ -50,7 +49,7 @@ float Waves::Depth()const
 	return mNumRows*mSpatialStep;
 }
 
-void Waves::Init(UINT m, UINT n, float dx, float dt, float speed, float damping)
+void Waves::Init(uint32_t m, uint32_t n, float dx, float dt, float speed, float damping)
 {
 	mNumRows  = m;
 	mNumCols  = n;
@@ -60,6 +59,7 @@ void Waves::Init(UINT m, UINT n, float dx, float dt, float speed, float damping)
 
 	mTimeStep    = dt;
 	mSpatialStep = dx;
+	mTime        = 0.0f;
 
 	float d = damping*dt+2.0f;
 	float e = (speed*speed)*(dt*dt)/(dx*dx);
@@ -73,44 +73,42 @@ void Waves::Init(UINT m, UINT n, float dx, float dt, float speed, float damping)
 	delete[] mNormals;
 	delete[] mTangentX;
 
-	mPrevSolution = new XMFLOAT3[m*n];
-	mCurrSolution = new XMFLOAT3[m*n];
-	mNormals      = new XMFLOAT3[m*n];
-	mTangentX     = new XMFLOAT3[m*n];
+	mPrevSolution = new Vec3[m*n];
+	mCurrSolution = new Vec3[m*n];
+	mNormals      = new Vec3[m*n];
+	mTangentX     = new Vec3[m*n];
 
 	// Generate grid vertices in system memory.
 
 	float halfWidth = (n-1)*dx*0.5f;
 	float halfDepth = (m-1)*dx*0.5f;
-	for(UINT i = 0; i < m; ++i)
+	for(uint32_t i = 0; i < m; ++i)
 	{
 		float z = halfDepth - i*dx;
-		for(UINT j = 0; j < n; ++j)
+		for(uint32_t j = 0; j < n; ++j)
 		{
 			float x = -halfWidth + j*dx;
 
-			mPrevSolution[i*n+j] = XMFLOAT3(x, 0.0f, z);
-			mCurrSolution[i*n+j] = XMFLOAT3(x, 0.0f, z);
-			mNormals[i*n+j]      = XMFLOAT3(0.0f, 1.0f, 0.0f);
-			mTangentX[i*n+j]     = XMFLOAT3(1.0f, 0.0f, 0.0f);
+			mPrevSolution[i*n+j] = Vec3(x, 0.0f, z);
+			mCurrSolution[i*n+j] = Vec3(x, 0.0f, z);
+			mNormals[i*n+j]      = Vec3(0.0f, 1.0f, 0.0f);
+			mTangentX[i*n+j]     = Vec3(1.0f, 0.0f, 0.0f);
 		}
 	}
 }
 
 void Waves::Update(float dt)
 {
-	static float t = 0;
-
 	// Accumulate time.
-	t += dt;
+	mTime += dt;
 
 	// Only update the simulation at the specified time step.
-	if( t >= mTimeStep )
+	if( mTime >= mTimeStep )
 	{
 		// Only update interior points; we use zero boundary conditions.
-		for(UINT i = 1; i < mNumRows-1; ++i)
+		for(uint32_t i = 1; i < mNumRows-1; ++i)
 		{
-			for(UINT j = 1; j < mNumCols-1; ++j)
+			for(uint32_t j = 1; j < mNumCols-1; ++j)
 			{
 				// After this update we will be discarding the old previous
 				// buffer, so overwrite that buffer with the new update.
@@ -136,14 +134,14 @@ void Waves::Update(float dt)
 		// current solution becomes the new previous solution.
 		std::swap(mPrevSolution, mCurrSolution);
 
-		t = 0.0f; // reset time
+		mTime = 0.0f; // reset time
 
 		//
 		// Compute normals using finite difference scheme.
 		//
-		for(UINT i = 1; i < mNumRows-1; ++i)
+		for(uint32_t i = 1; i < mNumRows-1; ++i)
 		{
-			for(UINT j = 1; j < mNumCols-1; ++j)
+			for(uint32_t j = 1; j < mNumCols-1; ++j)
 			{
 				float l = mCurrSolution[i*mNumCols+j-1].y;
 				float r = mCurrSolution[i*mNumCols+j+1].y;
@@ -153,18 +151,14 @@ void Waves::Update(float dt)
 				mNormals[i*mNumCols+j].y = 2.0f*mSpatialStep;
 				mNormals[i*mNumCols+j].z = b-t;
 
-				XMVECTOR n = XMVector3Normalize(XMLoadFloat3(&mNormals[i*mNumCols+j]));
-				XMStoreFloat3(&mNormals[i*mNumCols+j], n);
-
-				mTangentX[i*mNumCols+j] = XMFLOAT3(2.0f*mSpatialStep, r-l, 0.0f);
-				XMVECTOR T = XMVector3Normalize(XMLoadFloat3(&mTangentX[i*mNumCols+j]));
-				XMStoreFloat3(&mTangentX[i*mNumCols+j], T);
+				mNormals[i*mNumCols+j] = Normalize(mNormals[i*mNumCols+j]);
+				mTangentX[i*mNumCols+j] = Normalize(Vec3(2.0f*mSpatialStep, r-l, 0.0f));
 			}
 		}
 	}
 }
 
-void Waves::Disturb(UINT i, UINT j, float magnitude)
+void Waves::Disturb(uint32_t i, uint32_t j, float magnitude)
 {
 	// Don't disturb boundaries.
 	assert(i > 1 && i < mNumRows-2);
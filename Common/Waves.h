@@ -2,8 +2,9 @@
 #ifndef WAVES_H
 #define WAVES_H
 
-#include <Windows.h>
-#include <DirectXMath.h>
+#include <cstdint>
+
+#include "VecMath.h"
 
 class Waves
 {
@@ -11,32 +12,32 @@ public:
 	Waves();
 	~Waves();
 
-	UINT RowCount()const;
-	UINT ColumnCount()const;
-	UINT VertexCount()const;
-	UINT TriangleCount()const;
+	uint32_t RowCount()const;
+	uint32_t ColumnCount()const;
+	uint32_t VertexCount()const;
+	uint32_t TriangleCount()const;
 	float Width()const;
 	float Depth()const;
 
 	// Returns the solution at the ith grid point.
-	const DirectX::XMFLOAT3& operator[](int i)const { return mCurrSolution[i]; }
+	const Vec3& operator[](int i)const { return mCurrSolution[i]; }
 
 	// Returns the solution normal at the ith grid point.
-	const DirectX::XMFLOAT3& Normal(int i)const { return mNormals[i]; }
+	const Vec3& Normal(int i)const { return mNormals[i]; }
 
 	// Returns the unit tangent vector at the ith grid point in the local x-axis direction.
-	const DirectX::XMFLOAT3& TangentX(int i)const { return mTangentX[i]; }
+	const Vec3& TangentX(int i)const { return mTangentX[i]; }
 
-	void Init(UINT m, UINT n, float dx, float dt, float speed, float damping);
+	void Init(uint32_t m, uint32_t n, float dx, float dt, float speed, float damping);
 	void Update(float dt);
-	void Disturb(UINT i, UINT j, float magnitude);
+	void Disturb(uint32_t i, uint32_t j, float magnitude);
 
 private:
-	UINT mNumRows;
-	UINT mNumCols;
+	uint32_t mNumRows;
+	uint32_t mNumCols;
 
-	UINT mVertexCount;
-	UINT mTriangleCount;
+	uint32_t mVertexCount;
+	uint32_t mTriangleCount;
 
 	// Simulation constants we can precompute.
 	float mK1;
@@ -46,10 +47,13 @@ private:
 	float mTimeStep;
 	float mSpatialStep;
 
-	DirectX::XMFLOAT3* mPrevSolution;
-	DirectX::XMFLOAT3* mCurrSolution;
-	DirectX::XMFLOAT3* mNormals;
-	DirectX::XMFLOAT3* mTangentX;
+	// Time accumulated since the last simulation step.
+	float mTime;
+
+	Vec3* mPrevSolution;
+	Vec3* mCurrSolution;
+	Vec3* mNormals;
+	Vec3* mTangentX;
 };
 
 #endif // WAVES_H
\ No newline at end of file
@@ -38,7 +38,8 @@ D3DApp::D3DApp(HINSTANCE hInstance)
 	mSwapChain(0),
 	mDepthStencilBuffer(0),
 	mRenderTargetView(0),
-	mDepthStencilView(0)
+	mDepthStencilView(0),
+	mFrameLoop(mProfiler)
 {
 	ZeroMemory(&mScreenViewport, sizeof(D3D11_VIEWPORT));
 
@@ -51,6 +52,7 @@ D3DApp::D3DApp(HINSTANCE hInstance)
 D3DApp::~D3DApp()
 {
 	ImGui_ImplDX11_Shutdown();
+	mRenderDevice.reset();
 	ReleaseCOM(mRenderTargetView);
 	ReleaseCOM(mDepthStencilView);
 	ReleaseCOM(mSwapChain);
@@ -101,8 +103,7 @@ int D3DApp::Run()
 			if( !mAppPaused )
 			{
 				CalculateFrameStats();
-				UpdateScene(mTimer.DeltaTime());	
-				DrawScene();
+				mFrameLoop.Frame(*this, mTimer.DeltaTime());
 			}
 			else
 			{
@@ -185,6 +186,7 @@ void D3DApp::OnResize()
 	// Bind the render target view and depth/stencil view to the pipeline.
 
 	md3dImmediateContext->OMSetRenderTargets(1, &mRenderTargetView, mDepthStencilView);
+	mRenderDevice->SetTargets(mRenderTargetView, mDepthStencilView, mClientWidth, mClientHeight);
 	
 
 	// Set the viewport transform.
@@ -460,6 +462,8 @@ bool D3DApp::InitDirect3D()
 	ReleaseCOM(dxgiAdapter);
 	ReleaseCOM(dxgiFactory);
 
+	mRenderDevice.reset(new D3D11RenderDevice(md3dDevice, md3dImmediateContext, mSwapChain));
+
 	// The remaining steps that need to be carried out for d3d creation
 	// also need to be executed every time the window is resized.  So
 	// just call the OnResize method here to avoid code duplication.
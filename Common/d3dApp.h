@@ -4,6 +4,10 @@
 
 #include "d3dUtil.h"
 #include "GameTimer.h"
+#include "FrameProfiler.h"
+#include "FrameLoop.h"
+#include "D3D11RenderDevice.h"
+#include <memory>
 #include <string>
 #include "imgui/imgui.h"
 #include "imgui/imgui_impl_dx11.h"
@@ -11,7 +15,7 @@
 extern LRESULT ImGui_ImplDX11_WndProcHandler(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam);
 
 
-class D3DApp
+class D3DApp : public IFrameClient
 {
 public:
 	D3DApp(HINSTANCE hInstance);
@@ -56,6 +60,11 @@ protected:
 
 	GameTimer mTimer;
 
+	// Every unpaused frame is run by mFrameLoop and recorded, with UpdateScene and
+	// DrawScene as scopes.  Derived classes add their own scopes with mProfiler.AddScope.
+	FrameProfiler mProfiler;
+	FrameLoop mFrameLoop;
+
 	ID3D11Device* md3dDevice;
 	ID3D11DeviceContext* md3dImmediateContext;
 	IDXGISwapChain* mSwapChain;
@@ -64,6 +73,10 @@ protected:
 	ID3D11DepthStencilView* mDepthStencilView;
 	D3D11_VIEWPORT mScreenViewport;
 
+	// The device as the platform-neutral code sees it, created with the swap chain and
+	// pointed at the current views on every resize.
+	std::unique_ptr<D3D11RenderDevice> mRenderDevice;
+
 	// Derived class should set these in derived constructor to customize starting values.
 	std::wstring mMainWndCaption;
 	D3D_DRIVER_TYPE md3dDriverType;
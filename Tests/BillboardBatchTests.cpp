@@ -0,0 +1,146 @@
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <random>
+#include <vector>
+
+#include "BillboardBatch.h"
+#include "Test.h"
+#include "VertexCompression.h"
+
+TEST_CASE(BillboardBatch_InstanceMatchesInputLayout)
+{
+	// InputLayoutDesc::TreeBillboard, slot 1: POSITION R32G32B32_FLOAT at 0, SIZE
+	// R16G16_FLOAT at 12, SLICE R16_UINT at 16, LOD R8_UINT at 18, FADE R8_UNORM at 19.
+	CHECK_EQUAL(sizeof(BillboardInstance), size_t(20));
+	CHECK_EQUAL(offsetof(BillboardInstance, Position), size_t(0));
+	CHECK_EQUAL(sizeof(BillboardInstance::Position), size_t(12));
+	CHECK_EQUAL(offsetof(BillboardInstance, Size), size_t(12));
+	CHECK_EQUAL(sizeof(BillboardInstance::Size), size_t(4));
+	CHECK_EQUAL(offsetof(BillboardInstance, Slice), size_t(16));
+	CHECK_EQUAL(sizeof(BillboardInstance::Slice), size_t(2));
+	CHECK_EQUAL(offsetof(BillboardInstance, Lod), size_t(18));
+	CHECK_EQUAL(sizeof(BillboardInstance::Lod), size_t(1));
+	CHECK_EQUAL(offsetof(BillboardInstance, Fade), size_t(19));
+	CHECK_EQUAL(sizeof(BillboardInstance::Fade), size_t(1));
+}
+
+TEST_CASE(BillboardBatch_SortsBySliceThenFrontToBack)
+{
+	std::minstd_rand rng(5);
+	std::uniform_real_distribution<float> coord(-100.0f, 100.0f), size(1.0f, 12.0f);
+	std::vector<VegetationInstance> trees(500);
+	for(size_t i = 0; i < trees.size(); ++i)
+	{
+		trees[i].Position = Vec3(coord(rng), 0.25f*coord(rng), coord(rng));
+		trees[i].Height = size(rng);
+		trees[i].Width = 0.5f*trees[i].Height;
+		trees[i].Variant = (uint32_t)(rng() % 11);
+	}
+
+	// Two chunks' worth, the second fading in.
+	const uint32_t sliceCount = 4;
+	BillboardLod fading;
+	fading.Band = 2;
+	fading.Fade = 0.5f;
+	BillboardBatchBuilder builder;
+	builder.Clear();
+	CHECK_EQUAL(builder.Add(trees.data(), 300, sliceCount), size_t(300));
+	CHECK_EQUAL(builder.Add(trees.data() + 300, 200, sliceCount, fading), size_t(200));
+	const Vec3 eye(10.0f, 40.0f, -20.0f);
+	builder.Build(eye);
+
+	const std::vector<BillboardInstance>& instances = builder.Instances();
+	const std::vector<BillboardBatch>& batches = builder.Batches();
+	CHECK_EQUAL(instances.size(), trees.size());
+	CHECK_EQUAL(batches.size(), size_t(sliceCount));
+
+	// One batch per slice, in slice order, covering the instances end to end; nearest
+	// first within each.
+	uint32_t next = 0;
+	bool batched = true, sorted = true;
+	for(size_t b = 0; b < batches.size(); ++b)
+	{
+		batched = batched && batches[b].StartInstance == next && batches[b].InstanceCount > 0 &&
+			(b == 0 || batches[b].Slice > batches[b - 1].Slice);
+		for(uint32_t i = batches[b].StartInstance; i < batches[b].StartInstance + batches[b].InstanceCount; ++i)
+		{
+			batched = batched && instances[i].Slice == batches[b].Slice;
+			if(i > batches[b].StartInstance)
+				sorted = sorted && LengthSq(instances[i - 1].Position - eye) <= LengthSq(instances[i].Position - eye);
+		}
+		next += batches[b].InstanceCount;
+	}
+	CHECK(batched);
+	CHECK(sorted);
+	CHECK_EQUAL(size_t(next), instances.size());
+
+	// Every tree comes back once, its size within half precision and its slice its
+	// variant modulo the slice count.  Positions are exact, so they find the source.
+	std::vector<int> seen(trees.size(), 0);
+	bool packed = true;
+	for(size_t i = 0; i < instances.size(); ++i)
+	{
+		size_t t = 0;
+		while(t < trees.size() && (trees[t].Position.x != instances[i].Position.x ||
+			trees[t].Position.y != instances[i].Position.y || trees[t].Position.z != instances[i].Position.z))
+			++t;
+		if(t == trees.size())
+		{
+			packed = false;
+			continue;
+		}
+		++seen[t];
+		const BillboardInstance& b = instances[i];
+		packed = packed && b.Slice == trees[t].Variant % sliceCount &&
+			std::fabs(VertexCompression::HalfToFloat(b.Size[0]) - trees[t].Width) <= trees[t].Width / 1024.0f &&
+			std::fabs(VertexCompression::HalfToFloat(b.Size[1]) - trees[t].Height) <= trees[t].Height / 1024.0f;
+		if(t < 300)
+			packed = packed && b.Lod == 0 && b.Fade == 255;
+		else
+			packed = packed && b.Lod == 2 && b.Fade == 128;
+	}
+	CHECK(packed);
+	CHECK(std::count(seen.begin(), seen.end(), 1) == (std::ptrdiff_t)trees.size());
+
+	// Build consumes what was added.
+	builder.Build(eye);
+	CHECK(builder.Instances().empty());
+	CHECK(builder.Batches().empty());
+}
+
+TEST_CASE(BillboardBatch_KeepsOneInNAndScales)
+{
+	std::vector<VegetationInstance> trees(10);
+	for(size_t i = 0; i < trees.size(); ++i)
+	{
+		trees[i].Position = Vec3(float(i), 0.0f, 0.0f);
+		trees[i].Width = 2.0f;
+		trees[i].Height = 4.0f;
+		trees[i].Variant = (uint32_t)i;
+	}
+
+	// Trees 0, 3, 6 and 9, twice the size, as the outgoing band.
+	BillboardLod lod;
+	lod.Band = 1;
+	lod.FadeOut = true;
+	lod.Fade = 0.0f;
+	lod.KeepEvery = 3;
+	lod.SizeScale = 2.0f;
+	BillboardBatchBuilder builder;
+	CHECK_EQUAL(builder.Add(trees.data(), trees.size(), 1, lod), size_t(4));
+	builder.Build(Vec3(-1.0f, 0.0f, 0.0f));
+
+	const std::vector<BillboardInstance>& instances = builder.Instances();
+	CHECK_EQUAL(instances.size(), size_t(4));
+	CHECK_EQUAL(builder.Batches().size(), size_t(1));
+	for(size_t i = 0; i < instances.size(); ++i)
+	{
+		CHECK_EQUAL(instances[i].Position.x, float(3*i));
+		CHECK_EQUAL(instances[i].Slice, uint16_t(0));
+		CHECK_EQUAL(instances[i].Lod, uint8_t(1 | BillboardFadeOut));
+		CHECK_EQUAL(instances[i].Fade, uint8_t(0));
+		CHECK_EQUAL(VertexCompression::HalfToFloat(instances[i].Size[0]), 4.0f);
+		CHECK_EQUAL(VertexCompression::HalfToFloat(instances[i].Size[1]), 8.0f);
+	}
+}
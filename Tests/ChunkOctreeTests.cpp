@@ -0,0 +1,217 @@
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "ChunkOctree.h"
+#include "FrustumCulling.h"
+#include "Test.h"
+
+namespace
+{
+	// The items the tree should hold, by user data; Id is InvalidItem once removed.
+	struct Live
+	{
+		ChunkOctree::ItemId Id;
+		AABB Bounds;
+	};
+
+	AABB RandomBox(std::minstd_rand& rng, float range, float maxSize)
+	{
+		std::uniform_real_distribution<float> center(-range, range), size(0.5f, maxSize);
+		Vec3 c(center(rng), 0.25f*center(rng), center(rng));
+		Vec3 h(0.5f*size(rng), 0.5f*size(rng), 0.5f*size(rng));
+		return AABB(c - h, c + h);
+	}
+
+	std::vector<Frustum> MakeFrusta(std::minstd_rand& rng)
+	{
+		std::uniform_real_distribution<float> coord(-150.0f, 150.0f);
+		Mat4 proj = MatrixPerspectiveFovLH(0.3f*3.1415926f, 16.0f / 9.0f, 1.0f, 400.0f);
+		std::vector<Frustum> frusta(24);
+		for(size_t f = 0; f < frusta.size(); ++f)
+		{
+			// Eyes in and around the world, one looking straight down, one from far out.
+			Vec3 eye(coord(rng), 0.3f*coord(rng), coord(rng));
+			Vec3 target(coord(rng), 0.0f, coord(rng));
+			Vec3 up(0.0f, 1.0f, 0.0f);
+			if(f == 0)
+				eye = Vec3(0.0f, 200.0f, 0.0f), target = Vec3(0.0f, 0.0f, 0.0f), up = Vec3(0.0f, 0.0f, 1.0f);
+			else if(f == 1)
+				eye = Vec3(500.0f, 50.0f, 0.0f), target = Vec3(0.0f, 0.0f, 0.0f);
+			FrustumCulling::ExtractPlanes(MatrixLookAtLH(eye, target, up)*proj, frusta[f]);
+		}
+		return frusta;
+	}
+
+	// Frusta for which the tree's visible set differs from a flat sweep over the live
+	// items, or which report an item twice.
+	size_t Mismatches(const ChunkOctree& octree, const std::vector<Live>& live, const std::vector<Frustum>& frusta)
+	{
+		CullBoxes boxes;
+		std::vector<uint32_t> userData;
+		for(size_t i = 0; i < live.size(); ++i)
+		{
+			if(live[i].Id != ChunkOctree::InvalidItem)
+			{
+				boxes.Add(live[i].Bounds);
+				userData.push_back((uint32_t)i);
+			}
+		}
+
+		size_t mismatches = 0;
+		std::vector<uint8_t> visible(boxes.Stride());
+		for(size_t f = 0; f < frusta.size(); ++f)
+		{
+			FrustumCulling::Cull(frusta[f], boxes, visible.data());
+			std::vector<uint32_t> expected;
+			for(size_t i = 0; i < userData.size(); ++i)
+			{
+				if(visible[i])
+					expected.push_back(userData[i]);
+			}
+
+			std::vector<uint32_t> culled;
+			octree.Cull(frusta[f], Vec3(0.0f, 0.0f, 0.0f), culled);
+			std::sort(culled.begin(), culled.end());
+			mismatches += culled != expected;
+		}
+		return mismatches;
+	}
+
+	size_t LiveCount(const std::vector<Live>& live)
+	{
+		size_t count = 0;
+		for(size_t i = 0; i < live.size(); ++i)
+			count += live[i].Id != ChunkOctree::InvalidItem;
+		return count;
+	}
+}
+
+TEST_CASE(ChunkOctree_CullMatchesFlatSweepThroughEdits)
+{
+	std::minstd_rand rng(17);
+	const std::vector<Frustum> frusta = MakeFrusta(rng);
+	ChunkOctree octree(Vec3(0.0f, 0.0f, 0.0f), 128.0f, 5);
+
+	// Chunks of every size inside the root, and some the root cannot hold: centers
+	// outside its cell, or larger than it.
+	std::vector<Live> live;
+	for(int i = 0; i < 600; ++i)
+	{
+		Live item = { ChunkOctree::InvalidItem, RandomBox(rng, 120.0f, 24.0f) };
+		live.push_back(item);
+	}
+	for(int i = 0; i < 20; ++i)
+	{
+		Live item = { ChunkOctree::InvalidItem, RandomBox(rng, 300.0f, 40.0f) };
+		live.push_back(item);
+	}
+	Live huge = { ChunkOctree::InvalidItem, AABB(Vec3(-200.0f, -10.0f, -200.0f), Vec3(200.0f, 10.0f, 200.0f)) };
+	live.push_back(huge);
+	for(size_t i = 0; i < live.size(); ++i)
+		live[i].Id = octree.Insert(live[i].Bounds, (uint32_t)i);
+
+	CHECK_EQUAL(octree.ItemCount(), live.size());
+	CHECK(octree.NodeCount() > 1);
+	CHECK_EQUAL(Mismatches(octree, live, frusta), size_t(0));
+	std::vector<uint32_t> seen;
+	octree.Cull(frusta[0], Vec3(0.0f, 0.0f, 0.0f), seen);
+	CHECK(!seen.empty() && seen.size() < live.size());
+
+	// Remove a third, overflow items included.
+	for(size_t i = 0; i < live.size(); i += 3)
+	{
+		octree.Remove(live[i].Id);
+		live[i].Id = ChunkOctree::InvalidItem;
+	}
+	CHECK_EQUAL(octree.ItemCount(), LiveCount(live));
+	CHECK_EQUAL(Mismatches(octree, live, frusta), size_t(0));
+
+	// Reinsert half of those; the freed ids are reused.
+	for(size_t i = 0; i < live.size(); i += 6)
+	{
+		live[i].Bounds = RandomBox(rng, 250.0f, 30.0f);
+		live[i].Id = octree.Insert(live[i].Bounds, (uint32_t)i);
+	}
+	CHECK_EQUAL(octree.ItemCount(), LiveCount(live));
+	CHECK_EQUAL(Mismatches(octree, live, frusta), size_t(0));
+
+	// Move the rest: small nudges that stay in their cell, jumps across the world, and
+	// moves into and out of the overflow list.
+	std::uniform_real_distribution<float> nudge(-0.5f, 0.5f);
+	for(size_t i = 0; i < live.size(); ++i)
+	{
+		if(live[i].Id == ChunkOctree::InvalidItem)
+			continue;
+		AABB bounds;
+		switch(i % 4)
+		{
+		case 0:
+			bounds = AABB(live[i].Bounds.Min + Vec3(nudge(rng), 0.0f, nudge(rng)), live[i].Bounds.Max + Vec3(nudge(rng), 0.0f, nudge(rng)));
+			break;
+		case 1:
+			bounds = RandomBox(rng, 120.0f, 24.0f);
+			break;
+		case 2:
+			bounds = RandomBox(rng, 400.0f, 16.0f);
+			break;
+		default:
+			bounds = RandomBox(rng, 60.0f, 4.0f);
+			break;
+		}
+		octree.Update(live[i].Id, bounds);
+		live[i].Bounds = bounds;
+		CHECK_EQUAL(octree.UserData(live[i].Id), uint32_t(i));
+	}
+	CHECK_EQUAL(octree.ItemCount(), LiveCount(live));
+	CHECK_EQUAL(Mismatches(octree, live, frusta), size_t(0));
+
+	// Emptied, the tree is back to its root and culls nothing.
+	for(size_t i = 0; i < live.size(); ++i)
+	{
+		if(live[i].Id != ChunkOctree::InvalidItem)
+			octree.Remove(live[i].Id);
+		live[i].Id = ChunkOctree::InvalidItem;
+	}
+	CHECK_EQUAL(octree.ItemCount(), size_t(0));
+	CHECK_EQUAL(octree.NodeCount(), size_t(1));
+	std::vector<uint32_t> culled;
+	octree.Cull(frusta[0], Vec3(0.0f, 0.0f, 0.0f), culled);
+	CHECK(culled.empty());
+
+	// And fills again from there.
+	ChunkOctree::ItemId id = octree.Insert(AABB(Vec3(1.0f, 1.0f, 1.0f), Vec3(2.0f, 2.0f, 2.0f)), 7);
+	CHECK_EQUAL(octree.ItemCount(), size_t(1));
+	CHECK_EQUAL(octree.UserData(id), uint32_t(7));
+}
+
+TEST_CASE(ChunkOctree_CullStatsAcceptInsideNodes)
+{
+	// A grid of 8-unit chunks seen from above: most of the view holds whole nodes, whose
+	// items are taken without a test.
+	ChunkOctree octree(Vec3(0.0f, 0.0f, 0.0f), 128.0f, 4);
+	std::vector<Live> live;
+	for(int z = -16; z < 16; ++z)
+	{
+		for(int x = -16; x < 16; ++x)
+		{
+			Live item = { ChunkOctree::InvalidItem, AABB(Vec3(8.0f*x, -4.0f, 8.0f*z), Vec3(8.0f*(x + 1), 4.0f, 8.0f*(z + 1))) };
+			item.Id = octree.Insert(item.Bounds, (uint32_t)live.size());
+			live.push_back(item);
+		}
+	}
+
+	Frustum frustum;
+	Mat4 proj = MatrixPerspectiveFovLH(0.25f*3.1415926f, 1.0f, 1.0f, 1000.0f);
+	FrustumCulling::ExtractPlanes(MatrixLookAtLH(Vec3(0.0f, 150.0f, 0.0f), Vec3(0.0f, 0.0f, 0.0f),
+		Vec3(0.0f, 0.0f, 1.0f))*proj, frustum);
+	std::vector<uint32_t> culled;
+	ChunkOctree::CullStats stats;
+	octree.Cull(frustum, Vec3(0.0f, 150.0f, 0.0f), culled, &stats);
+
+	CHECK(stats.ItemsAccepted > 0);
+	CHECK(stats.NodesCulled > 0);
+	CHECK(stats.ItemsTested < live.size());
+	CHECK(culled.size() < live.size());
+	CHECK_EQUAL(Mismatches(octree, live, std::vector<Frustum>(1, frustum)), size_t(0));
+}
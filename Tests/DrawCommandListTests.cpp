@@ -0,0 +1,193 @@
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "DrawCommandList.h"
+#include "Test.h"
+#include "TerrainEffectConstants.h"
+#include "TerrainWorld.h"
+
+namespace
+{
+	bool SameCalls(const RecordingDrawBackend& a, const RecordingDrawBackend& b)
+	{
+		if(a.Calls.size() != b.Calls.size() || a.Constants != b.Constants)
+			return false;
+		for(size_t i = 0; i < a.Calls.size(); ++i)
+		{
+			const RecordingDrawBackend::Call& x = a.Calls[i];
+			const RecordingDrawBackend::Call& y = b.Calls[i];
+			if(x.Type != y.Type || x.A != y.A || x.B != y.B || x.C != y.C || x.D != y.D || x.Indexed != y.Indexed)
+				return false;
+		}
+		return true;
+	}
+
+	void Submit(const DrawCommandList* const* lists, size_t listCount, RecordingDrawBackend& backend)
+	{
+		DrawQueue queue;
+		queue.Gather(lists, listCount);
+		backend.Clear();
+		queue.Submit(backend);
+	}
+
+	// Draw i of a frame: a few pipelines and buffers, so that keys tie often, and
+	// constants on every third draw.
+	void RecordDraw(DrawCommandList& list, uint32_t i)
+	{
+		DrawState state;
+		state.Pipeline = i % 3;
+		state.VertexBuffer = 10 + i % 2;
+		state.VertexStride = 16;
+		state.IndexBuffer = i % 5 == 0 ? NoDrawHandle : 20;
+
+		DrawArgs args;
+		args.Count = 3*(i + 1);
+		args.StartIndex = i;
+		args.StartInstance = i / 4;
+
+		if(i % 3 == 0)
+		{
+			float constants[4] = { float(i), 1.0f, 2.0f, 3.0f };
+			list.Draw(state, args, DrawConstants(1, 16*(i % 2), constants, sizeof(constants)));
+		}
+		else
+		{
+			list.Draw(state, args);
+		}
+	}
+}
+
+TEST_CASE(DrawCommandList_MergedRangesMatchSerial)
+{
+	const uint32_t drawCount = 101;
+
+	DrawCommandList serial;
+	for(uint32_t i = 0; i < drawCount; ++i)
+		RecordDraw(serial, i);
+	const DrawCommandList* serialLists[] = { &serial };
+	RecordingDrawBackend expected;
+	Submit(serialLists, 1, expected);
+	CHECK(!expected.Calls.empty());
+
+	// Contiguous ranges in list order, however many lists and whatever order they were
+	// filled in.
+	const size_t listCounts[] = { 2, 3, 8, 200 };
+	for(size_t n = 0; n < sizeof(listCounts) / sizeof(listCounts[0]); ++n)
+	{
+		std::vector<DrawCommandList> lists(listCounts[n]);
+		size_t perList = (drawCount + lists.size() - 1) / lists.size();
+		for(size_t l = lists.size(); l-- > 0; )
+		{
+			for(size_t i = l*perList; i < (l + 1)*perList && i < drawCount; ++i)
+				RecordDraw(lists[l], uint32_t(i));
+		}
+
+		std::vector<const DrawCommandList*> pointers;
+		for(size_t l = 0; l < lists.size(); ++l)
+			pointers.push_back(&lists[l]);
+		RecordingDrawBackend merged;
+		Submit(pointers.data(), pointers.size(), merged);
+		CHECK(SameCalls(merged, expected));
+	}
+}
+
+TEST_CASE(DrawCommandList_ParallelTerrainMatchesSerial)
+{
+	TerrainWorld::Settings settings;
+	settings.Corners = 17;
+	TerrainWorld world(settings);
+	world.Build();
+	world.Cull();
+
+	DrawState state;
+	state.Pipeline = 1;
+	state.VertexBuffer = 2;
+	state.VertexStride = 16;
+	state.IndexBuffer = 3;
+
+	DrawCommandList serial;
+	size_t serialDraws = world.RecordTerrain(serial, state);
+	CHECK(serialDraws > 1);
+	CHECK_EQUAL(serial.Count(), serialDraws);
+	const DrawCommandList* serialLists[] = { &serial };
+	RecordingDrawBackend expected;
+	Submit(serialLists, 1, expected);
+
+	// Fewer, as many and more lists than chunks.
+	const size_t chunks = world.Chunks().size();
+	const size_t listCounts[] = { 1, 3, chunks, chunks + 5 };
+	for(size_t n = 0; n < sizeof(listCounts) / sizeof(listCounts[0]); ++n)
+	{
+		std::vector<DrawCommandList> lists(listCounts[n]);
+		CHECK_EQUAL(world.RecordTerrain(lists.data(), lists.size(), state), serialDraws);
+
+		std::vector<const DrawCommandList*> pointers;
+		for(size_t l = 0; l < lists.size(); ++l)
+			pointers.push_back(&lists[l]);
+		RecordingDrawBackend merged;
+		Submit(pointers.data(), pointers.size(), merged);
+		CHECK(SameCalls(merged, expected));
+	}
+}
+
+TEST_CASE(DrawCommandList_TerrainDrawsSpanVisibleSlabs)
+{
+	TerrainWorld::Settings settings;
+	settings.Corners = 33;
+	settings.ChunkQuads = 4;
+	TerrainWorld world(settings);
+	world.Build();
+
+	std::vector<uint32_t> slabs;
+	world.PackSlabInstances(slabs);
+	CHECK_EQUAL(slabs.size(), size_t(world.VoxelLayers()));
+
+	// A camera looking steeply down, so many chunks lose slabs at the bottom as well as
+	// the top.
+	world.Camera().Phi = 0.1f*3.1415926535f;
+	world.Camera().Radius = 90.0f;
+	world.Cull();
+
+	DrawCommandList list;
+	world.RecordTerrain(list, DrawState());
+
+	// Each draw's instances read slabs[StartInstance...], which must run from the
+	// chunk's lowest visible slab to its highest, and each carries the box its chunk's
+	// positions are quantized over.
+	typedef TerrainEffectConstants TC;
+	const size_t layers = world.VoxelLayers();
+	const std::vector<uint8_t>& visible = world.SlabVisible();
+	size_t draw = 0, skippedBelow = 0;
+	bool spans = true, boxes = true;
+	for(size_t c = 0; c < world.Chunks().size(); ++c)
+	{
+		size_t first = layers, last = 0;
+		for(size_t s = 0; s < layers; ++s)
+		{
+			if(visible[c*layers + s])
+				first = (std::min)(first, s), last = s;
+		}
+		if(first == layers)
+			continue;
+
+		const DrawCommand& command = list.Command(draw++);
+		const DrawArgs& args = command.Args;
+		const TerrainWorld::Chunk& chunk = world.Chunks()[c];
+		spans = spans && args.StartIndex == chunk.StartIndex &&
+			slabs[args.StartInstance] == first && slabs[args.StartInstance + args.InstanceCount - 1] == last;
+		skippedBelow += first > 0;
+
+		TC::ChunkConstants box;
+		std::memset(&box, 0, sizeof(box));
+		if(command.ConstantSize == sizeof(box))
+			std::memcpy(&box, list.ConstantData(command), sizeof(box));
+		boxes = boxes && command.ConstantSlot == TC::PerObjectSlot &&
+			command.ConstantOffset == offsetof(TC::PerObjectConstants, Chunk) && command.ConstantSize == sizeof(box) &&
+			std::memcmp(&box.Origin, &chunk.Origin, sizeof(Vec3)) == 0 && std::memcmp(&box.Extent, &chunk.Extent, sizeof(Vec3)) == 0;
+	}
+	CHECK(spans);
+	CHECK(boxes);
+	CHECK_EQUAL(draw, list.Count());
+	CHECK(skippedBelow > 0);
+}
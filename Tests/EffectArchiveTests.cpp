@@ -0,0 +1,163 @@
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "EffectArchive.h"
+#include "Test.h"
+
+// Three blobs of odd sizes, so each one after the first needs padding to align.
+static std::vector<EffectArchive::Input> MakeInputs()
+{
+	const char* names[] = { "FX\\Basic.fxo", "FX/TreeSprite.fxo", "FX/buildDensity.fxo" };
+	const size_t sizes[] = { 37, 1, 250 };
+
+	std::vector<EffectArchive::Input> inputs(3);
+	for(size_t i = 0; i < inputs.size(); ++i)
+	{
+		inputs[i].Name = names[i];
+		inputs[i].Data.resize(sizes[i]);
+		for(size_t b = 0; b < sizes[i]; ++b)
+			inputs[i].Data[b] = uint8_t(i*31 + b*7);
+	}
+	return inputs;
+}
+
+static bool SameBytes(const EffectArchive::Blob& blob, const std::vector<uint8_t>& data)
+{
+	return blob.Size == data.size() && std::memcmp(blob.Data, data.data(), data.size()) == 0;
+}
+
+TEST_CASE(EffectArchive_BuildAndLoadRoundTrip)
+{
+	std::vector<EffectArchive::Input> inputs = MakeInputs();
+	std::vector<uint8_t> image;
+	std::string error;
+	CHECK(EffectArchive::Build(inputs, image, &error));
+	CHECK_EQUAL(image.size() % EffectArchive::BlobAlignment, size_t(0));
+
+	EffectArchive archive;
+	CHECK(archive.LoadFromMemory(image.data(), image.size(), &error));
+	CHECK_EQUAL(archive.Count(), inputs.size());
+
+	CHECK_EQUAL(archive.Name(0), std::string("fx/basic.fxo"));
+	CHECK_EQUAL(archive.Name(1), std::string("fx/treesprite.fxo"));
+	CHECK_EQUAL(archive.Name(2), std::string("fx/builddensity.fxo"));
+	for(size_t i = 0; i < archive.Count(); ++i)
+	{
+		EffectArchive::Blob blob = archive.Get(i);
+		CHECK(SameBytes(blob, inputs[i].Data));
+		CHECK_EQUAL(size_t(blob.Data - image.data()) % EffectArchive::BlobAlignment, size_t(0));
+	}
+}
+
+TEST_CASE(EffectArchive_FindNormalizesNames)
+{
+	std::vector<EffectArchive::Input> inputs = MakeInputs();
+	std::vector<uint8_t> image;
+	CHECK(EffectArchive::Build(inputs, image));
+
+	EffectArchive archive;
+	CHECK(archive.LoadFromMemory(image.data(), image.size()));
+
+	// The names Effects::InitAll passes, which differ from the files in case.
+	EffectArchive::Blob blob;
+	CHECK(archive.Find("FX/Basic.fxo", blob) && SameBytes(blob, inputs[0].Data));
+	CHECK(archive.Find("fx\\TREESPRITE.FXO", blob) && SameBytes(blob, inputs[1].Data));
+	CHECK(archive.Find("FX/BuildDensity.fxo", blob) && SameBytes(blob, inputs[2].Data));
+	CHECK(!archive.Find("FX/TreeBillboard.fxo", blob));
+	CHECK(!archive.Find("FX/Basic.fx", blob));
+
+	CHECK_EQUAL(EffectArchive::NormalizeName("A\\B/C.Fxo"), std::string("a/b/c.fxo"));
+}
+
+TEST_CASE(EffectArchive_HashIsFnv1a)
+{
+	// Published 64-bit FNV-1a values.
+	CHECK_EQUAL(EffectArchive::Hash(0, 0), 14695981039346656037ull);
+	CHECK_EQUAL(EffectArchive::Hash(reinterpret_cast<const uint8_t*>("a"), 1), 0xaf63dc4c8601ec8cull);
+	CHECK_EQUAL(EffectArchive::Hash(reinterpret_cast<const uint8_t*>("foobar"), 6), 0x85944171f73967e8ull);
+}
+
+TEST_CASE(EffectArchive_BuildRejectsBadNames)
+{
+	std::vector<EffectArchive::Input> inputs = MakeInputs();
+	std::vector<uint8_t> image;
+	std::string error;
+
+	// Differs from the first only in case and separator.
+	inputs[2].Name = "fx/BASIC.fxo";
+	CHECK(!EffectArchive::Build(inputs, image, &error));
+	CHECK(error.find("duplicate") != std::string::npos);
+
+	inputs[2].Name = "";
+	error.clear();
+	CHECK(!EffectArchive::Build(inputs, image, &error));
+	CHECK(error.find("empty") != std::string::npos);
+}
+
+TEST_CASE(EffectArchive_LoadRejectsDamagedImages)
+{
+	std::vector<EffectArchive::Input> inputs = MakeInputs();
+	std::vector<uint8_t> image;
+	CHECK(EffectArchive::Build(inputs, image));
+
+	EffectArchive archive;
+	std::string error;
+
+	// A flipped bit in the last blob fails its hash.
+	std::vector<uint8_t> damaged = image;
+	damaged[damaged.size() - EffectArchive::BlobAlignment] ^= 0x10;
+	CHECK(!archive.LoadFromMemory(damaged.data(), damaged.size(), &error));
+	CHECK(error.find("hash mismatch") != std::string::npos);
+	CHECK_EQUAL(archive.Count(), size_t(0));
+
+	damaged = image;
+	damaged[0] ^= 0xff;
+	CHECK(!archive.LoadFromMemory(damaged.data(), damaged.size(), &error));
+
+	damaged = image;
+	damaged[4] = 2;
+	CHECK(!archive.LoadFromMemory(damaged.data(), damaged.size(), &error));
+
+	// Every truncation fails somewhere, from the header through the last blob.
+	bool anyAccepted = false;
+	for(size_t size = 0; size < image.size() - EffectArchive::BlobAlignment; ++size)
+		anyAccepted = anyAccepted || archive.LoadFromMemory(image.data(), size);
+	CHECK(!anyAccepted);
+
+	// An entry count past the end of the file.
+	damaged = image;
+	uint32_t entries = 0x10000000;
+	std::memcpy(&damaged[8], &entries, sizeof(entries));
+	CHECK(!archive.LoadFromMemory(damaged.data(), damaged.size(), &error));
+
+	CHECK(archive.LoadFromMemory(image.data(), image.size()));
+}
+
+TEST_CASE(EffectArchive_WriteAndOpen)
+{
+	std::vector<EffectArchive::Input> inputs = MakeInputs();
+	std::string path = (std::filesystem::temp_directory_path() / "EffectArchiveTests.fxa").string();
+
+	std::string error;
+	CHECK(EffectArchive::Write(path.c_str(), inputs, &error));
+
+	{
+		EffectArchive archive;
+		CHECK(archive.Open(path.c_str(), &error));
+		CHECK_EQUAL(archive.Count(), inputs.size());
+
+		EffectArchive::Blob blob;
+		CHECK(archive.Find("FX/buildDensity.fxo", blob) && SameBytes(blob, inputs[2].Data));
+
+		archive.Close();
+		CHECK_EQUAL(archive.Count(), size_t(0));
+		CHECK(!archive.Find("FX/buildDensity.fxo", blob));
+	}
+	std::remove(path.c_str());
+
+	EffectArchive missing;
+	CHECK(!missing.Open(path.c_str(), &error));
+}
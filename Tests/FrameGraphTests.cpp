@@ -0,0 +1,144 @@
+#include <string>
+#include <vector>
+
+#include "FrameGraph.h"
+#include "Test.h"
+
+namespace
+{
+	FrameGraph::TextureDesc Desc(uint32_t width, uint32_t format)
+	{
+		FrameGraph::TextureDesc desc;
+		desc.Width = width;
+		desc.Height = width;
+		desc.Format = format;
+		desc.BytesPerTexel = 4;
+		return desc;
+	}
+
+	// A pass that records its id in order when it runs.
+	FrameGraph::PassId AddPass(FrameGraph& graph, const char* name, std::vector<FrameGraph::PassId>& ran)
+	{
+		FrameGraph::PassId id = (FrameGraph::PassId)graph.PassCount();
+		return graph.AddPass(name, [&ran, id]() { ran.push_back(id); });
+	}
+}
+
+TEST_CASE(FrameGraph_CullsDeadPassesAndAliasesTransients)
+{
+	typedef FrameGraph::PassId PassId;
+	typedef FrameGraph::ResourceId ResourceId;
+
+	FrameGraph graph;
+	std::vector<PassId> ran;
+	const FrameGraph::TextureDesc shadowDesc = Desc(1024, 1);
+	const FrameGraph::TextureDesc colorDesc = Desc(256, 2);
+
+	ResourceId backBuffer = graph.Import("Back buffer", true);
+	ResourceId density = graph.Import("Density volume");
+	ResourceId shadow = graph.CreateTransient("Shadow map", shadowDesc);
+	ResourceId debug = graph.CreateTransient("Debug", colorDesc);
+	ResourceId hdr = graph.CreateTransient("HDR", colorDesc);
+	ResourceId lit = graph.CreateTransient("Lit", colorDesc);
+	ResourceId bloom = graph.CreateTransient("Bloom", colorDesc);
+	ResourceId unused = graph.CreateTransient("Unused", colorDesc);
+
+	// Nothing reads the debug view, nor the end of the two-pass chain after bloom, and
+	// the overlay is switched off: those four passes go.
+	PassId shadowPass = AddPass(graph, "Shadow", ran);
+	graph.Write(shadowPass, shadow);
+	PassId debugPass = AddPass(graph, "Debug", ran);
+	graph.Write(debugPass, debug);
+	PassId scenePass = AddPass(graph, "Scene", ran);
+	graph.Read(scenePass, density);
+	graph.Write(scenePass, hdr);
+	PassId lightPass = AddPass(graph, "Lighting", ran);
+	graph.Read(lightPass, shadow);
+	graph.Read(lightPass, hdr);
+	graph.Write(lightPass, lit);
+	PassId bloomPass = AddPass(graph, "Bloom", ran);
+	graph.Read(bloomPass, lit);
+	graph.Write(bloomPass, bloom);
+	PassId chainPass = AddPass(graph, "Chain", ran);
+	graph.Read(chainPass, bloom);
+	graph.Write(chainPass, debug);
+	PassId chainEndPass = AddPass(graph, "Chain end", ran);
+	graph.Read(chainEndPass, debug);
+	graph.Write(chainEndPass, unused);
+	PassId tonemapPass = AddPass(graph, "Tonemap", ran);
+	graph.Read(tonemapPass, bloom);
+	graph.Write(tonemapPass, backBuffer);
+	PassId overlayPass = AddPass(graph, "Overlay", ran);
+	graph.Write(overlayPass, backBuffer);
+	graph.SetEnabled(overlayPass, false);
+
+	std::string error;
+	CHECK(graph.Compile(&error));
+	CHECK(error.empty());
+
+	// The schedule: the live passes, in the order they were added.
+	CHECK(graph.Execute(&error));
+	const PassId schedule[] = { shadowPass, scenePass, lightPass, bloomPass, tonemapPass };
+	CHECK(ran == std::vector<PassId>(schedule, schedule + 5));
+	CHECK(!graph.PassLive(debugPass) && !graph.PassLive(chainPass) && !graph.PassLive(chainEndPass));
+	CHECK(!graph.PassLive(overlayPass));
+
+	// Lifetimes run from the first live pass to use a transient to the last.
+	CHECK_EQUAL(graph.FirstUse(shadow), shadowPass);
+	CHECK_EQUAL(graph.LastUse(shadow), lightPass);
+	CHECK_EQUAL(graph.FirstUse(hdr), scenePass);
+	CHECK_EQUAL(graph.LastUse(hdr), lightPass);
+	CHECK_EQUAL(graph.FirstUse(lit), lightPass);
+	CHECK_EQUAL(graph.LastUse(lit), bloomPass);
+	CHECK_EQUAL(graph.FirstUse(bloom), bloomPass);
+	CHECK_EQUAL(graph.LastUse(bloom), tonemapPass);
+
+	// HDR and lit meet in the lighting pass, so they need two textures; bloom starts
+	// after HDR's last read and takes its texture.  The shadow map has its own format,
+	// and transients only culled passes use get nothing.
+	CHECK(graph.Physical(hdr) != graph.Physical(lit));
+	CHECK_EQUAL(graph.Physical(bloom), graph.Physical(hdr));
+	CHECK(graph.Physical(shadow) != graph.Physical(hdr) && graph.Physical(shadow) != graph.Physical(lit));
+	CHECK_EQUAL(graph.Physical(debug), FrameGraph::NoPhysical);
+	CHECK_EQUAL(graph.Physical(unused), FrameGraph::NoPhysical);
+	CHECK_EQUAL(graph.PhysicalCount(), size_t(3));
+	CHECK(graph.PhysicalDesc(graph.Physical(shadow)) == shadowDesc);
+	CHECK(graph.PhysicalDesc(graph.Physical(lit)) == colorDesc);
+
+	const FrameGraph::Stats& stats = graph.GetStats();
+	CHECK_EQUAL(stats.LivePasses, size_t(5));
+	CHECK_EQUAL(stats.CulledPasses, size_t(4));
+	CHECK_EQUAL(stats.Transients, size_t(4));
+	CHECK_EQUAL(stats.PhysicalTextures, size_t(3));
+	CHECK_EQUAL(stats.TransientBytes, shadowDesc.Bytes() + 3*colorDesc.Bytes());
+	CHECK_EQUAL(stats.PhysicalBytes, shadowDesc.Bytes() + 2*colorDesc.Bytes());
+
+	// Turning the overlay on keeps it, after the tonemap that shares its output, and
+	// changes no texture.
+	graph.SetEnabled(overlayPass, true);
+	ran.clear();
+	CHECK(graph.Execute(&error));
+	CHECK_EQUAL(ran.size(), size_t(6));
+	CHECK_EQUAL(ran.back(), overlayPass);
+	CHECK_EQUAL(graph.PhysicalCount(), size_t(3));
+}
+
+TEST_CASE(FrameGraph_ReadBeforeWriteFails)
+{
+	FrameGraph graph;
+	std::vector<FrameGraph::PassId> ran;
+	FrameGraph::ResourceId backBuffer = graph.Import("Back buffer", true);
+	FrameGraph::ResourceId temp = graph.CreateTransient("Temp", Desc(64, 1));
+
+	FrameGraph::PassId reader = AddPass(graph, "Reader", ran);
+	graph.Read(reader, temp);
+	graph.Write(reader, backBuffer);
+	FrameGraph::PassId writer = AddPass(graph, "Writer", ran);
+	graph.Write(writer, temp);
+	graph.Write(writer, backBuffer);
+
+	std::string error;
+	CHECK(!graph.Execute(&error));
+	CHECK(ran.empty());
+	CHECK(error.find("\"Reader\"") != std::string::npos);
+}
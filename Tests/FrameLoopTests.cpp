@@ -0,0 +1,126 @@
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "FrameLoop.h"
+#include "Test.h"
+
+namespace
+{
+	// Numbers its frames from 1 into the snapshot slots and records what Render sees.
+	// A slot used by both threads at once counts as a clash.
+	class CountingClient : public IPipelinedFrameClient
+	{
+	public:
+		CountingClient() : mNext(1), mClashes(0)
+		{
+			for(int i = 0; i < 3; ++i)
+			{
+				mSnapshots[i] = 0;
+				mUsers[i] = 0;
+			}
+		}
+
+		void Simulate(float /*dt*/, uint32_t slot)
+		{
+			Enter(slot);
+			mSnapshots[slot] = mNext++;
+			// Long enough for the renderer to catch up and wait.
+			std::this_thread::sleep_for(std::chrono::microseconds(50));
+			Leave(slot);
+		}
+
+		void Render(uint32_t slot)
+		{
+			Enter(slot);
+			Rendered.push_back(mSnapshots[slot]);
+			Leave(slot);
+		}
+
+		size_t Clashes()const { return mClashes.load(); }
+
+		std::vector<uint32_t> Rendered;
+
+	private:
+		void Enter(uint32_t slot)
+		{
+			if(mUsers[slot].fetch_add(1) != 0)
+				++mClashes;
+		}
+		void Leave(uint32_t slot) { mUsers[slot].fetch_sub(1); }
+
+		uint32_t mNext;
+		uint32_t mSnapshots[3];
+		std::atomic<int> mUsers[3];
+		std::atomic<size_t> mClashes;
+	};
+
+	bool InOrder(const std::vector<uint32_t>& rendered, size_t count)
+	{
+		if(rendered.size() != count)
+			return false;
+		for(size_t i = 0; i < count; ++i)
+		{
+			if(rendered[i] != i + 1)
+				return false;
+		}
+		return true;
+	}
+}
+
+TEST_CASE(PipelinedFrameLoop_RendersEveryFrameInOrder)
+{
+	FrameProfiler renderProfiler, simProfiler;
+	PipelinedFrameLoop loop(renderProfiler, simProfiler);
+
+	CountingClient client;
+	loop.Run(client, 500, 1.0f / 60.0f);
+	CHECK(InOrder(client.Rendered, 500));
+	CHECK_EQUAL(loop.SimulatedFrames(), uint64_t(500));
+	CHECK_EQUAL(loop.RenderedFrames(), uint64_t(500));
+	CHECK_EQUAL(client.Clashes(), size_t(0));
+	CHECK(!loop.Running());
+	CHECK_EQUAL(renderProfiler.TotalFrames(), uint64_t(500));
+	CHECK_EQUAL(simProfiler.TotalFrames(), uint64_t(500));
+
+	// A second run on the same loop starts from nothing.
+	CountingClient again;
+	loop.Run(again, 100, 1.0f / 60.0f);
+	CHECK(InOrder(again.Rendered, 100));
+	CHECK_EQUAL(loop.RenderedFrames(), uint64_t(100));
+	CHECK_EQUAL(again.Clashes(), size_t(0));
+}
+
+TEST_CASE(PipelinedFrameLoop_StopWhileWaiting)
+{
+	FrameProfiler renderProfiler, simProfiler;
+	PipelinedFrameLoop loop(renderProfiler, simProfiler);
+
+	// Nothing renders, so the simulation fills its slots and sleeps waiting for the
+	// renderer; Stop must still get it out.
+	CountingClient client;
+	loop.Start(client, 0, 1.0f / 60.0f);
+	while(loop.SimulatedFrames() < 1)
+		std::this_thread::yield();
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	CHECK_EQUAL(loop.SimulatedFrames(), uint64_t(1));
+	loop.Stop();
+	CHECK(!loop.Running());
+
+	// What is left drains, then RenderFrame reports the end.
+	size_t frames = 0;
+	while(loop.RenderFrame())
+		++frames;
+	CHECK(frames <= 1);
+
+	// And the loop starts again after a Stop.
+	CountingClient again;
+	loop.Start(again, 50, 1.0f / 60.0f);
+	while(loop.RenderFrame())
+	{
+	}
+	loop.Stop();
+	CHECK(InOrder(again.Rendered, 50));
+	CHECK_EQUAL(again.Clashes(), size_t(0));
+}
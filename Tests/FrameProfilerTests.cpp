@@ -0,0 +1,120 @@
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "FrameProfiler.h"
+#include "Test.h"
+
+namespace
+{
+	// A clock that only moves when told to, in nanoseconds.
+	uint64_t gFakeNs = 0;
+
+	uint64_t FakeClock()
+	{
+		return gFakeNs;
+	}
+
+	void AdvanceMs(double ms)
+	{
+		gFakeNs += (uint64_t)(ms*1.0e6 + 0.5);
+	}
+
+	// Frame i (from 1) takes i ms, of which 0.5 ms is in the scope: two runs of 0.25 ms,
+	// the first with the same scope nested inside it.
+	void RecordFrames(FrameProfiler& profiler, FrameProfiler::ScopeId scope, size_t first, size_t last)
+	{
+		for(size_t i = first; i <= last; ++i)
+		{
+			profiler.BeginFrame();
+			{
+				FrameProfiler::Scope outer(profiler, scope);
+				AdvanceMs(0.125);
+				{
+					FrameProfiler::Scope inner(profiler, scope);
+					AdvanceMs(0.125);
+				}
+			}
+			{
+				FrameProfiler::Scope again(profiler, scope);
+				AdvanceMs(0.25);
+			}
+			AdvanceMs(i - 0.5);
+			profiler.EndFrame();
+		}
+	}
+}
+
+TEST_CASE(FrameProfiler_PercentilesAndHistogramWithFakeClock)
+{
+	FrameProfiler profiler(100, FakeClock);
+	FrameProfiler::ScopeId scope = profiler.AddScope("Terrain extraction");
+	CHECK_EQUAL(profiler.AddScope("Terrain extraction"), scope);
+
+	// Frames of 1 to 100 ms.  Nearest rank: p50 is the 50th smallest, and so on.
+	RecordFrames(profiler, scope, 1, 100);
+	FrameProfiler::Summary frame = profiler.FrameSummary();
+	CHECK_EQUAL(frame.Frames, size_t(100));
+	CHECK_NEAR(frame.Mean, 50.5, 1e-9);
+	CHECK_NEAR(frame.P50, 50.0, 1e-9);
+	CHECK_NEAR(frame.P95, 95.0, 1e-9);
+	CHECK_NEAR(frame.P99, 99.0, 1e-9);
+	CHECK_NEAR(frame.Max, 100.0, 1e-9);
+
+	// A cancelled frame leaves no trace.
+	profiler.BeginFrame();
+	AdvanceMs(1000.0);
+	profiler.CancelFrame();
+	profiler.EndFrame();
+	CHECK_EQUAL(profiler.TotalFrames(), uint64_t(100));
+
+	// Twenty more wrap the ring, which then holds frames 21 to 120, oldest first.
+	RecordFrames(profiler, scope, 101, 120);
+	CHECK_EQUAL(profiler.FrameCount(), size_t(100));
+	CHECK_EQUAL(profiler.TotalFrames(), uint64_t(120));
+	CHECK_NEAR(profiler.FrameMs(0), 21.0, 1e-9);
+	CHECK_NEAR(profiler.FrameMs(99), 120.0, 1e-9);
+	frame = profiler.FrameSummary();
+	CHECK_NEAR(frame.Mean, 70.5, 1e-9);
+	CHECK_NEAR(frame.P50, 70.0, 1e-9);
+	CHECK_NEAR(frame.P95, 115.0, 1e-9);
+	CHECK_NEAR(frame.P99, 119.0, 1e-9);
+	CHECK_NEAR(frame.Max, 120.0, 1e-9);
+
+	// Runs of a scope add up, nested ones count once.
+	FrameProfiler::Summary extraction = profiler.ScopeSummary(scope);
+	CHECK_NEAR(extraction.P50, 0.5, 1e-9);
+	CHECK_NEAR(extraction.Max, 0.5, 1e-9);
+
+	// 10 ms bins: 21-29 in bin 2, 30-39 in bin 3, and everything from 40 in the last.
+	std::vector<uint32_t> counts;
+	profiler.Histogram(10.0, 5, counts);
+	const uint32_t expected[] = { 0, 0, 9, 10, 81 };
+	CHECK(counts == std::vector<uint32_t>(expected, expected + 5));
+}
+
+TEST_CASE(FrameProfiler_CSVQuotesScopeNames)
+{
+	FrameProfiler profiler(4, FakeClock);
+	FrameProfiler::ScopeId scope = profiler.AddScope("Cull, \"near\"");
+	RecordFrames(profiler, scope, 1, 2);
+
+	std::string path = (std::filesystem::temp_directory_path() / "FrameProfilerTests.csv").string();
+	std::string error;
+	CHECK(profiler.WriteCSV(path.c_str(), &error));
+
+	std::string text;
+	FILE* file = std::fopen(path.c_str(), "r");
+	CHECK(file != 0);
+	if(file)
+	{
+		char buffer[256];
+		while(std::fgets(buffer, sizeof(buffer), file))
+			text += buffer;
+		std::fclose(file);
+	}
+	std::remove(path.c_str());
+
+	CHECK_EQUAL(text, std::string("frame,frame_ms,\"Cull, \"\"near\"\"\"\n0,1.0000,0.5000\n1,2.0000,0.5000\n"));
+}
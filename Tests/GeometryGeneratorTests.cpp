@@ -0,0 +1,47 @@
+#include <algorithm>
+#include <vector>
+
+#include "GeometryGenerator.h"
+#include "Test.h"
+
+namespace
+{
+	bool Less(const Vec3& a, const Vec3& b)
+	{
+		if(a.x != b.x)
+			return a.x < b.x;
+		if(a.y != b.y)
+			return a.y < b.y;
+		return a.z < b.z;
+	}
+}
+
+TEST_CASE(GeometryGenerator_GeosphereSharesEveryMidpoint)
+{
+	GeometryGenerator geoGen;
+	size_t faces = 20;
+	for(uint32_t level = 0; level <= 6; ++level, faces *= 4)
+	{
+		// 20*4^n faces over 10*4^n+2 vertices: each edge's midpoint is made once and
+		// shared by both its triangles.
+		GeometryGenerator::MeshData mesh;
+		geoGen.CreateGeosphere(1.0f, level, mesh);
+		CHECK_EQUAL(mesh.Indices.size(), 3*faces);
+		CHECK_EQUAL(mesh.Vertices.size(), faces/2 + 2);
+
+		size_t outOfRange = 0;
+		for(size_t i = 0; i < mesh.Indices.size(); ++i)
+			outOfRange += mesh.Indices[i] >= mesh.Vertices.size();
+		CHECK_EQUAL(outOfRange, size_t(0));
+
+		// No two vertices in the same place.
+		std::vector<Vec3> positions;
+		for(size_t i = 0; i < mesh.Vertices.size(); ++i)
+			positions.push_back(mesh.Vertices[i].Position);
+		std::sort(positions.begin(), positions.end(), Less);
+		size_t duplicates = 0;
+		for(size_t i = 1; i < positions.size(); ++i)
+			duplicates += !Less(positions[i - 1], positions[i]);
+		CHECK_EQUAL(duplicates, size_t(0));
+	}
+}
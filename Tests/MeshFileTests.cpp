@@ -0,0 +1,256 @@
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "MeshFile.h"
+#include "Test.h"
+
+// A square pyramid: five vertices, so the index blob needs padding to align.
+static MeshFile::MeshData MakePyramid()
+{
+	const float positions[5][3] = { { -1, 0, -1 }, { 1, 0, -1 }, { 1, 0, 1 }, { -1, 0, 1 }, { 0, 2, 0 } };
+	const uint32_t indices[] = { 0, 1, 4, 1, 2, 4, 2, 3, 4, 3, 0, 4, 0, 2, 1, 0, 3, 2 };
+
+	MeshFile::MeshData mesh;
+	mesh.Vertices.resize(5);
+	for(size_t i = 0; i < mesh.Vertices.size(); ++i)
+	{
+		for(int c = 0; c < 3; ++c)
+		{
+			mesh.Vertices[i].Position[c] = positions[i][c];
+			mesh.Vertices[i].Normal[c] = 0.25f*(float)(i + c);
+		}
+	}
+	mesh.Indices.assign(indices, indices + sizeof(indices) / sizeof(indices[0]));
+	return mesh;
+}
+
+static bool SameMesh(const MeshFile& file, const MeshFile::MeshData& mesh)
+{
+	return file.VertexCount() == mesh.Vertices.size() && file.IndexCount() == mesh.Indices.size() &&
+		std::memcmp(file.Vertices(), mesh.Vertices.data(), mesh.Vertices.size()*sizeof(MeshFile::Vertex)) == 0 &&
+		std::memcmp(file.Indices(), mesh.Indices.data(), mesh.Indices.size()*sizeof(uint32_t)) == 0;
+}
+
+// The bytes of a written .mesh, in words so LoadFromMemory gets them 4-byte aligned.
+static std::vector<uint32_t> ReadImage(const std::string& path, size_t& size)
+{
+	std::vector<uint32_t> words;
+	size = 0;
+	FILE* file = std::fopen(path.c_str(), "rb");
+	if(!file)
+		return words;
+	uint8_t buffer[256];
+	std::vector<uint8_t> bytes;
+	for(size_t read; (read = std::fread(buffer, 1, sizeof(buffer), file)) > 0; )
+		bytes.insert(bytes.end(), buffer, buffer + read);
+	std::fclose(file);
+
+	size = bytes.size();
+	words.resize((size + 3) / 4);
+	if(size)
+		std::memcpy(words.data(), bytes.data(), size);
+	return words;
+}
+
+TEST_CASE(MeshFile_WriteAndLoadRoundTrip)
+{
+	MeshFile::MeshData mesh = MakePyramid();
+	std::string path = (std::filesystem::temp_directory_path() / "MeshFileTests.mesh").string();
+
+	std::string error;
+	CHECK(MeshFile::Write(path.c_str(), mesh, &error));
+
+	{
+		MeshFile file;
+		CHECK(file.Load(path.c_str(), &error));
+		CHECK(SameMesh(file, mesh));
+
+		// Both blobs aligned, the header's bounds those of the positions.
+		const MeshFileHeader& header = file.Header();
+		CHECK_EQUAL(header.VertexOffset % MeshFile::BlobAlignment, uint64_t(0));
+		CHECK_EQUAL(header.IndexOffset % MeshFile::BlobAlignment, uint64_t(0));
+		CHECK(header.IndexOffset >= header.VertexOffset + mesh.Vertices.size()*sizeof(MeshFile::Vertex));
+		CHECK_EQUAL(header.BoundsMin[0], -1.0f);
+		CHECK_EQUAL(header.BoundsMin[1], 0.0f);
+		CHECK_EQUAL(header.BoundsMax[1], 2.0f);
+		CHECK_EQUAL(header.BoundsMax[2], 1.0f);
+	}
+
+	// The same image from memory.
+	size_t size = 0;
+	std::vector<uint32_t> image = ReadImage(path, size);
+	std::remove(path.c_str());
+	MeshFile file;
+	CHECK(file.LoadFromMemory(reinterpret_cast<const uint8_t*>(image.data()), size, &error));
+	CHECK(SameMesh(file, mesh));
+
+	// A mesh with no vertices round-trips too.
+	MeshFile::MeshData empty;
+	CHECK(MeshFile::Write(path.c_str(), empty, &error));
+	CHECK(file.Load(path.c_str(), &error));
+	CHECK_EQUAL(file.VertexCount(), uint32_t(0));
+	CHECK_EQUAL(file.IndexCount(), uint32_t(0));
+	std::remove(path.c_str());
+
+	CHECK(!file.Load(path.c_str(), &error));
+	CHECK_EQUAL(error, std::string("cannot open file"));
+}
+
+TEST_CASE(MeshFile_LoadRejectsDamagedImages)
+{
+	MeshFile::MeshData mesh = MakePyramid();
+	std::string path = (std::filesystem::temp_directory_path() / "MeshFileTests.mesh").string();
+	CHECK(MeshFile::Write(path.c_str(), mesh));
+	size_t size = 0;
+	const std::vector<uint32_t> image = ReadImage(path, size);
+	std::remove(path.c_str());
+	CHECK(size > sizeof(MeshFileHeader));
+
+	MeshFileHeader header;
+	std::memcpy(&header, image.data(), sizeof(header));
+
+	// Loads image with the header edited, and returns the error.
+	struct
+	{
+		std::vector<uint32_t> Image;
+		size_t Size;
+
+		std::string Load(const MeshFileHeader& edited)
+		{
+			std::vector<uint32_t> damaged = Image;
+			std::memcpy(damaged.data(), &edited, sizeof(edited));
+			MeshFile file;
+			std::string error;
+			if(file.LoadFromMemory(reinterpret_cast<const uint8_t*>(damaged.data()), Size, &error))
+				return "loaded";
+			CHECK(file.Vertices() == 0 && file.Indices() == 0 && file.VertexCount() == 0);
+			return error;
+		}
+	} load = { image, size };
+	CHECK_EQUAL(load.Load(header), std::string("loaded"));
+
+	MeshFile file;
+	std::string error;
+	const uint8_t* bytes = reinterpret_cast<const uint8_t*>(image.data());
+
+	// Short of a header, or of the index blob.
+	CHECK(!file.LoadFromMemory(bytes, sizeof(MeshFileHeader) - 1, &error));
+	CHECK_EQUAL(error, std::string("file too small for header"));
+	CHECK(!file.LoadFromMemory(bytes, size - 4, &error));
+	CHECK_EQUAL(error, std::string("index blob out of bounds"));
+
+	// Not a mesh, or not one this reader knows.
+	MeshFileHeader edited = header;
+	edited.Magic ^= 1;
+	CHECK_EQUAL(load.Load(edited), std::string("not a mesh file"));
+	edited = header;
+	edited.Version = MeshFile::Version + 1;
+	CHECK_EQUAL(load.Load(edited), std::string("unsupported mesh file version"));
+	edited = header;
+	edited.VertexStride = 12;
+	CHECK_EQUAL(load.Load(edited), std::string("unsupported vertex format"));
+	edited = header;
+	edited.IndexCount -= 1;
+	CHECK_EQUAL(load.Load(edited), std::string("index count is not a multiple of 3"));
+
+	// Offsets off the 16-byte grid.
+	edited = header;
+	edited.VertexOffset += 4;
+	CHECK_EQUAL(load.Load(edited), std::string("misaligned blob offset"));
+	edited = header;
+	edited.IndexOffset += 8;
+	CHECK_EQUAL(load.Load(edited), std::string("misaligned blob offset"));
+
+	// Blobs inside the header, past the end, or counts that run off it.
+	edited = header;
+	edited.VertexOffset = 0;
+	CHECK_EQUAL(load.Load(edited), std::string("vertex blob out of bounds"));
+	edited = header;
+	edited.VertexOffset = 0xFFFFFFFFFFFFFFF0ull;
+	CHECK_EQUAL(load.Load(edited), std::string("vertex blob out of bounds"));
+	edited = header;
+	edited.VertexCount = 0xFFFFFFFFu;
+	CHECK_EQUAL(load.Load(edited), std::string("vertex blob out of bounds"));
+	edited = header;
+	edited.IndexOffset += MeshFile::BlobAlignment;
+	CHECK_EQUAL(load.Load(edited), std::string("index blob out of bounds"));
+	edited = header;
+	edited.IndexCount = 0xFFFFFFFFu;
+	CHECK_EQUAL(load.Load(edited), std::string("index blob out of bounds"));
+
+	// An index at or past VertexCount.
+	edited = header;
+	edited.VertexCount = 4;
+	CHECK_EQUAL(load.Load(edited), std::string("index out of range"));
+
+	// And the image itself must be 4-byte aligned.
+	std::vector<uint32_t> shifted(image.size() + 1);
+	uint8_t* unaligned = reinterpret_cast<uint8_t*>(shifted.data()) + 1;
+	std::memcpy(unaligned, image.data(), size);
+	CHECK(!file.LoadFromMemory(unaligned, size, &error));
+	CHECK_EQUAL(error, std::string("mesh image is not 4-byte aligned"));
+}
+
+TEST_CASE(MeshFile_ParseText)
+{
+	const std::string text =
+		"VertexCount: 3\n"
+		"TriangleCount: 1\n"
+		"VertexList (pos, normal)\n"
+		"{\n"
+		"\t0 0 0 0 1 0\n"
+		"\t1 0 0 0 1 0\n"
+		"\t0 0 1.5 0 1 -0.25\n"
+		"}\n"
+		"TriangleList\n"
+		"{\n"
+		"\t0 2 1\n"
+		"}\n";
+
+	MeshFile::MeshData mesh;
+	std::string error;
+	CHECK(MeshFile::ParseText(text.data(), text.size(), mesh, &error));
+	CHECK_EQUAL(mesh.Vertices.size(), size_t(3));
+	CHECK_EQUAL(mesh.Indices.size(), size_t(3));
+	CHECK_EQUAL(mesh.Vertices[2].Position[2], 1.5f);
+	CHECK_EQUAL(mesh.Vertices[2].Normal[2], -0.25f);
+	CHECK_EQUAL(mesh.Indices[1], uint32_t(2));
+
+	// Text need not be terminated: cut short of the last brace, it fails there.
+	CHECK(!MeshFile::ParseText(text.data(), text.size() - 2, mesh, &error));
+	CHECK_EQUAL(error, std::string("expected end of TriangleList"));
+
+	// Each edit and the error it gives.
+	struct Case
+	{
+		const char* From;
+		const char* To;
+		const char* Error;
+	};
+	const Case cases[] =
+	{
+		{ "VertexCount: 3", "VertexCount: x", "expected VertexCount" },
+		{ "VertexCount: 3", "VertexCount: 99999999999", "expected VertexCount" },
+		{ "TriangleCount: 1", "Triangles: 1", "expected TriangleCount" },
+		{ "TriangleCount: 1", "TriangleCount: 1431655766", "too many triangles" },
+		{ "VertexCount: 3", "VertexCount: 300", "counts exceed file size" },
+		{ "TriangleCount: 1", "TriangleCount: 100", "counts exceed file size" },
+		{ "VertexList", "Vertices", "expected VertexList" },
+		{ "\t1 0 0 0 1 0\n", "\t1 0 0 0 1\n", "bad vertex" },
+		{ "\t1 0 0 0 1 0\n", "\t1 0 zero 0 1 0\n", "bad vertex" },
+		{ "TriangleList", "Triangles", "expected TriangleList" },
+		{ "\t0 2 1\n", "\t0 2\n", "bad index" },
+		{ "\t0 2 1\n", "\t0 3 1\n", "index out of range" },
+	};
+	for(size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i)
+	{
+		std::string edited = text;
+		edited.replace(edited.find(cases[i].From), std::strlen(cases[i].From), cases[i].To);
+		error.clear();
+		CHECK(!MeshFile::ParseText(edited.data(), edited.size(), mesh, &error));
+		CHECK_EQUAL(error, std::string(cases[i].Error));
+	}
+}
@@ -0,0 +1,187 @@
+#include <algorithm>
+#include <cfloat>
+#include <vector>
+
+#include "GeometryGenerator.h"
+#include "MeshOptimizer.h"
+#include "Test.h"
+#include "TerrainWorld.h"
+
+namespace
+{
+	// Triangles as sorted position triples, so orderings can be compared.
+	struct Triangle
+	{
+		float Key[9];
+		bool operator<(const Triangle& rhs)const { return std::lexicographical_compare(Key, Key + 9, rhs.Key, rhs.Key + 9); }
+		bool operator==(const Triangle& rhs)const { return std::equal(Key, Key + 9, rhs.Key); }
+	};
+
+	std::vector<Triangle> Triangles(const std::vector<Vec3>& positions, const std::vector<uint32_t>& indices)
+	{
+		std::vector<Triangle> result;
+		for(size_t t = 0; t + 2 < indices.size(); t += 3)
+		{
+			// Rotate so the smallest corner comes first; winding is kept.
+			size_t first = 0;
+			for(size_t k = 1; k < 3; ++k)
+			{
+				const Vec3& a = positions[indices[t + k]];
+				const Vec3& b = positions[indices[t + first]];
+				if(a.x < b.x || (a.x == b.x && (a.y < b.y || (a.y == b.y && a.z < b.z))))
+					first = k;
+			}
+			Triangle tri;
+			for(size_t k = 0; k < 3; ++k)
+			{
+				const Vec3& p = positions[indices[t + (first + k) % 3]];
+				tri.Key[3*k + 0] = p.x;
+				tri.Key[3*k + 1] = p.y;
+				tri.Key[3*k + 2] = p.z;
+			}
+			result.push_back(tri);
+		}
+		std::sort(result.begin(), result.end());
+		return result;
+	}
+}
+
+TEST_CASE(MeshOptimizer_CacheMetrics)
+{
+	// A strip of n quads in a good order: every triangle after the first costs one
+	// transform, each vertex is transformed once.
+	std::vector<uint32_t> strip;
+	const uint32_t quads = 8;
+	for(uint32_t q = 0; q < quads; ++q)
+	{
+		uint32_t a = 2*q, b = a + 1, c = a + 2, d = a + 3;
+		uint32_t tri[6] = { a, b, c, c, b, d };
+		strip.insert(strip.end(), tri, tri + 6);
+	}
+	MeshOptimizer::CacheStats stats = MeshOptimizer::AnalyzeVertexCache(strip.data(), strip.size(), 2*quads + 2);
+	CHECK_EQUAL(stats.Transforms, 2*quads + 2);
+	CHECK_NEAR(stats.ACMR, (2.0f*quads + 2.0f) / (2.0f*quads), 1e-6f);
+	CHECK_NEAR(stats.ATVR, 1.0f, 1e-6f);
+
+	// A one-vertex cache only hits the repeated index inside each quad.
+	stats = MeshOptimizer::AnalyzeVertexCache(strip.data(), strip.size(), 2*quads + 2, 1);
+	CHECK_NEAR(stats.ACMR, 2.5f, 1e-6f);
+}
+
+TEST_CASE(MeshOptimizer_GridImproves)
+{
+	// Row-by-row order transforms each interior vertex about twice.
+	GeometryGenerator geoGen;
+	GeometryGenerator::MeshData grid;
+	geoGen.CreateGrid(160.0f, 160.0f, 50, 50, grid);
+
+	std::vector<Vec3> positions;
+	for(size_t i = 0; i < grid.Vertices.size(); ++i)
+		positions.push_back(grid.Vertices[i].Position);
+	std::vector<Triangle> before = Triangles(positions, grid.Indices);
+
+	MeshOptimizer::Report report;
+	geoGen.OptimizeMesh(grid, &report);
+
+	// The report matches an independent analysis, and the reorder pays off.
+	MeshOptimizer::CacheStats after = MeshOptimizer::AnalyzeVertexCache(grid.Indices.data(),
+		grid.Indices.size(), grid.Vertices.size());
+	CHECK_NEAR(report.After.ACMR, after.ACMR, 1e-6f);
+	CHECK(report.Before.ACMR > 1.0f);
+	CHECK(report.After.ACMR < 0.75f);
+	CHECK(report.After.ATVR < 0.7f*report.Before.ATVR);
+
+	positions.clear();
+	for(size_t i = 0; i < grid.Vertices.size(); ++i)
+		positions.push_back(grid.Vertices[i].Position);
+	CHECK(Triangles(positions, grid.Indices) == before);
+}
+
+TEST_CASE(TerrainWorld_SurfaceChunksOptimized)
+{
+	TerrainWorld::Settings settings;
+	settings.WaveRows = 20;
+	settings.WaveColumns = 20;
+	TerrainWorld world(settings);
+	world.Build();
+
+	const TerrainChunkMesh& surface = world.SurfaceMesh();
+	const MeshOptimizer::Report& report = world.SurfaceReport();
+	CHECK(!surface.Indices.empty());
+	CHECK(report.After.ACMR < report.Before.ACMR);
+	CHECK(report.After.ATVR <= report.Before.ATVR);
+
+	// The surface is the chunks back to back, measured as reported.
+	std::vector<uint32_t> concatenated;
+	size_t triangles = 0;
+	uint32_t chunkTransforms = 0;
+	for(size_t c = 0; c < world.Chunks().size(); ++c)
+	{
+		const std::vector<uint32_t>& indices = world.ChunkSurfaceIndices(c);
+		concatenated.insert(concatenated.end(), indices.begin(), indices.end());
+		chunkTransforms += MeshOptimizer::AnalyzeVertexCache(indices.data(), indices.size(), surface.Positions.size()).Transforms;
+		triangles += indices.size() / 3;
+	}
+	CHECK(concatenated == surface.Indices);
+	MeshOptimizer::CacheStats stats = MeshOptimizer::AnalyzeVertexCache(concatenated.data(), concatenated.size(),
+		surface.Positions.size());
+	CHECK_NEAR(stats.ACMR, report.After.ACMR, 1e-6f);
+
+	// Drawn one chunk at a time (a cold cache per draw), the reordered chunks still beat
+	// the extraction order of the whole surface.
+	CHECK((float)chunkTransforms / triangles < report.Before.ACMR);
+
+	// Vertices come in the order the chunks first use them, with none unused.
+	uint32_t next = 0;
+	for(size_t i = 0; i < concatenated.size(); ++i)
+	{
+		CHECK(concatenated[i] <= next);
+		if(concatenated[i] == next)
+			++next;
+	}
+	CHECK_EQUAL((size_t)next, surface.Positions.size());
+	CHECK_EQUAL(surface.Normals.size(), surface.Positions.size());
+}
+
+TEST_CASE(TerrainWorld_SurfaceTrianglesInTheirChunk)
+{
+	// Quads that do not divide into whole chunks, so the last row and column are narrow.
+	TerrainWorld::Settings settings;
+	settings.Corners = 35;
+	settings.ChunkQuads = 4;
+	TerrainWorld world(settings);
+	world.Build();
+
+	// Every triangle's centroid lies in its chunk's columns: the chunk's slab boxes less
+	// their one-voxel pad, widened a little at the world's edge where the surface closes.
+	const TerrainChunkMesh& surface = world.SurfaceMesh();
+	const CullBoxes& boxes = world.SlabBoxes();
+	const Vec3 voxel = world.VoxelSize();
+	const float half = 0.5f*settings.Extent;
+	const float eps = 1e-4f;
+	size_t triangles = 0, outside = 0;
+	for(size_t c = 0; c < world.Chunks().size(); ++c)
+	{
+		size_t box = c*world.VoxelLayers();
+		float minX = boxes.Center(0)[box] - boxes.Extent(0)[box] + voxel.x;
+		float maxX = boxes.Center(0)[box] + boxes.Extent(0)[box] - voxel.x;
+		float minZ = boxes.Center(2)[box] - boxes.Extent(2)[box] + voxel.z;
+		float maxZ = boxes.Center(2)[box] + boxes.Extent(2)[box] - voxel.z;
+		minX = minX <= -half + eps ? -FLT_MAX : minX;
+		minZ = minZ <= -half + eps ? -FLT_MAX : minZ;
+		maxX = maxX >= half - eps ? FLT_MAX : maxX;
+		maxZ = maxZ >= half - eps ? FLT_MAX : maxZ;
+
+		const std::vector<uint32_t>& indices = world.ChunkSurfaceIndices(c);
+		for(size_t t = 0; t + 2 < indices.size(); t += 3)
+		{
+			Vec3 centroid = (surface.Positions[indices[t]] + surface.Positions[indices[t + 1]] +
+				surface.Positions[indices[t + 2]])*(1.0f / 3.0f);
+			outside += centroid.x < minX - eps || centroid.x > maxX + eps ||
+				centroid.z < minZ - eps || centroid.z > maxZ + eps;
+			++triangles;
+		}
+	}
+	CHECK_EQUAL(triangles, surface.Indices.size() / 3);
+	CHECK_EQUAL(outside, size_t(0));
+}
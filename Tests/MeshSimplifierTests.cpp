@@ -0,0 +1,97 @@
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "MeshSimplifier.h"
+#include "Test.h"
+#include "TerrainWorld.h"
+
+namespace
+{
+	typedef std::pair<Vec3, Vec3> Edge;
+
+	bool Less(const Vec3& a, const Vec3& b)
+	{
+		if(a.x != b.x)
+			return a.x < b.x;
+		if(a.y != b.y)
+			return a.y < b.y;
+		return a.z < b.z;
+	}
+
+	bool EdgeLess(const Edge& a, const Edge& b)
+	{
+		if(Less(a.first, b.first) || Less(b.first, a.first))
+			return Less(a.first, b.first);
+		return Less(a.second, b.second);
+	}
+
+	bool EdgeEqual(const Edge& a, const Edge& b)
+	{
+		return !EdgeLess(a, b) && !EdgeLess(b, a);
+	}
+
+	// The open edges (used by one triangle) of the triangles, by their end positions,
+	// sorted.  Positions are compared exactly: a simplified mesh copies its border
+	// vertices from the source.
+	std::vector<Edge> OpenEdges(const std::vector<Vec3>& positions, const uint32_t* indices, size_t indexCount)
+	{
+		std::vector<Edge> edges;
+		for(size_t t = 0; t + 2 < indexCount; t += 3)
+		{
+			for(int e = 0; e < 3; ++e)
+			{
+				const Vec3& a = positions[indices[t + e]];
+				const Vec3& b = positions[indices[t + (e + 1) % 3]];
+				edges.push_back(Less(a, b) ? Edge(a, b) : Edge(b, a));
+			}
+		}
+		std::sort(edges.begin(), edges.end(), EdgeLess);
+
+		std::vector<Edge> open;
+		for(size_t i = 0; i < edges.size(); )
+		{
+			size_t j = i + 1;
+			while(j < edges.size() && EdgeEqual(edges[i], edges[j]))
+				++j;
+			if(j - i == 1)
+				open.push_back(edges[i]);
+			i = j;
+		}
+		return open;
+	}
+}
+
+TEST_CASE(MeshSimplifier_FarLodBordersMatchFullResolution)
+{
+	TerrainWorld::Settings settings;
+	settings.Corners = 33;
+	settings.ChunkQuads = 4;
+	TerrainWorld world(settings);
+	world.Build();
+
+	// Each far LOD's open edges are its full-resolution chunk's, vertex for vertex, so
+	// it meets a neighbour at either resolution without a crack.
+	const TerrainChunkMesh& surface = world.SurfaceMesh();
+	size_t before = 0, after = 0, borderEdges = 0, mismatched = 0;
+	for(size_t c = 0; c < world.Chunks().size(); ++c)
+	{
+		const std::vector<uint32_t>& indices = world.ChunkSurfaceIndices(c);
+		const TerrainChunkMesh& lod = world.FarLodMesh(c);
+		std::vector<Edge> full = OpenEdges(surface.Positions, indices.data(), indices.size());
+		std::vector<Edge> far = OpenEdges(lod.Positions, lod.Indices.data(), lod.Indices.size());
+
+		bool same = full.size() == far.size();
+		for(size_t e = 0; e < full.size() && same; ++e)
+			same = EdgeEqual(full[e], far[e]);
+		mismatched += !same;
+
+		borderEdges += full.size();
+		before += indices.size() / 3;
+		after += lod.Indices.size() / 3;
+	}
+
+	CHECK(borderEdges > 0);
+	CHECK(after < before);
+	CHECK_EQUAL(mismatched, size_t(0));
+}
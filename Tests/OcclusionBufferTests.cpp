@@ -0,0 +1,167 @@
+#include <algorithm>
+#include <vector>
+
+#include "FrustumCulling.h"
+#include "OcclusionBuffer.h"
+#include "Test.h"
+#include "TerrainWorld.h"
+
+namespace
+{
+	Mat4 TestViewProj()
+	{
+		return MatrixLookAtLH(Vec3(0.0f, 0.0f, -10.0f), Vec3(0.0f, 0.0f, 0.0f), Vec3(0.0f, 1.0f, 0.0f))*
+			MatrixPerspectiveFovLH(0.25f*3.1415926535f, 2.0f, 1.0f, 100.0f);
+	}
+
+	// True if q is inside the view volume of viewProj.
+	bool InView(const Mat4& viewProj, const Vec3& q)
+	{
+		float clip[4];
+		for(int c = 0; c < 4; ++c)
+			clip[c] = q.x*viewProj.m[0][c] + q.y*viewProj.m[1][c] + q.z*viewProj.m[2][c] + viewProj.m[3][c];
+		return clip[3] > 0.0f && clip[0] >= -clip[3] && clip[0] <= clip[3] &&
+			clip[1] >= -clip[3] && clip[1] <= clip[3] && clip[2] >= 0.0f && clip[2] <= clip[3];
+	}
+}
+
+TEST_CASE(OcclusionBuffer_WallHidesBoxesBehindIt)
+{
+	// A 4x4 wall at z = 0 facing the camera.
+	const Vec3 wall[4] = { Vec3(-2.0f, -2.0f, 0.0f), Vec3(2.0f, -2.0f, 0.0f), Vec3(2.0f, 2.0f, 0.0f), Vec3(-2.0f, 2.0f, 0.0f) };
+	const uint32_t indices[6] = { 0, 1, 2, 0, 2, 3 };
+
+	Mat4 viewProj = TestViewProj();
+	OcclusionBuffer buffer;
+	buffer.Begin(viewProj.Data());
+	buffer.AddOccluder(wall, indices, 6);
+	buffer.Render();
+
+	CHECK(!buffer.TestAABB(AABB(Vec3(-1.0f, -1.0f, 2.0f), Vec3(1.0f, 1.0f, 4.0f))));
+	CHECK(buffer.TestAABB(AABB(Vec3(-1.0f, -1.0f, -2.0f), Vec3(1.0f, 1.0f, -1.0f))));
+	// Peeks out past the wall's edge.
+	CHECK(buffer.TestAABB(AABB(Vec3(1.0f, -1.0f, 2.0f), Vec3(4.0f, 1.0f, 4.0f))));
+	// Shows in the left half of a pixel whose center a wall covers: the wall's left
+	// edge projects to x = 158.45 pixels and the box to [158.16, 158.38].
+	const Vec3 edge[4] = { Vec3(1.97075f, -2.0f, 0.0f), Vec3(6.0f, -2.0f, 0.0f), Vec3(6.0f, 2.0f, 0.0f), Vec3(1.97075f, 2.0f, 0.0f) };
+	OcclusionBuffer edgeBuffer;
+	edgeBuffer.Begin(viewProj.Data());
+	edgeBuffer.AddOccluder(edge, indices, 6);
+	edgeBuffer.Render();
+	CHECK(edgeBuffer.TestAABB(AABB(Vec3(2.34f, -1.0f, 2.0f), Vec3(2.355f, 1.0f, 2.01f))));
+	CHECK(!edgeBuffer.TestAABB(AABB(Vec3(3.0f, -1.0f, 2.0f), Vec3(4.0f, 1.0f, 2.01f))));
+	CHECK_EQUAL(buffer.GetStats().TrianglesBinned, size_t(2));
+
+	// Rendering the same occluders again gives the same depth.
+	std::vector<float> depth(buffer.Depth(), buffer.Depth() + size_t(buffer.Width())*buffer.Height());
+	buffer.Begin(viewProj.Data());
+	buffer.AddOccluder(wall, indices, 6);
+	buffer.Render();
+	CHECK(std::equal(depth.begin(), depth.end(), buffer.Depth()));
+}
+
+TEST_CASE(OcclusionBuffer_ManyBinsMatchOne)
+{
+	// Enough triangles for several binning ranges: a field of small quads at varying
+	// depths, rendered at once and then one quad at a time.
+	std::vector<Vec3> positions;
+	std::vector<uint32_t> indices;
+	for(int y = 0; y < 64; ++y)
+	{
+		for(int x = 0; x < 64; ++x)
+		{
+			uint32_t base = (uint32_t)positions.size();
+			float z = 0.1f*((x*7 + y*13) % 17);
+			float px = -3.2f + 0.1f*x, py = -3.2f + 0.1f*y;
+			positions.push_back(Vec3(px, py, z));
+			positions.push_back(Vec3(px + 0.12f, py, z));
+			positions.push_back(Vec3(px + 0.12f, py + 0.12f, z));
+			positions.push_back(Vec3(px, py + 0.12f, z));
+			const uint32_t quad[6] = { base, base + 1, base + 2, base, base + 2, base + 3 };
+			indices.insert(indices.end(), quad, quad + 6);
+		}
+	}
+
+	Mat4 viewProj = TestViewProj();
+	OcclusionBuffer together;
+	together.Begin(viewProj.Data());
+	together.AddOccluder(positions.data(), indices.data(), indices.size());
+	together.Render();
+
+	OcclusionBuffer separate;
+	separate.Begin(viewProj.Data());
+	for(size_t i = 0; i < indices.size(); i += 6)
+		separate.AddOccluder(positions.data(), &indices[i], 6);
+	separate.Render();
+
+	size_t pixels = size_t(together.Width())*together.Height();
+	CHECK(std::equal(together.Depth(), together.Depth() + pixels, separate.Depth()));
+	CHECK_EQUAL(together.GetStats().TrianglesBinned, indices.size() / 3);
+}
+
+TEST_CASE(OcclusionBuffer_TerrainCullIsConservative)
+{
+	// A slab draws the surface inside its box, so a slab the occlusion pass hides must
+	// have no surface triangle whose centroid is in view with a clear line of sight.
+	// Collision keeps every surface triangle, so a capsule of negligible radius from the
+	// eye, stopped just short of the centroid, is a line of sight against the drawn mesh.
+	TerrainWorld::Settings settings;
+	settings.Corners = 33;
+	settings.ChunkQuads = 4;
+	settings.CollisionWeld = 0.0f;
+	settings.OccluderRange = 200.0f;
+	TerrainWorld world(settings);
+	world.Build();
+
+	const CullBoxes& boxes = world.SlabBoxes();
+	const TerrainChunkMesh& surface = world.SurfaceMesh();
+	std::vector<Vec3> centroids;
+	for(size_t t = 0; t + 2 < surface.Indices.size(); t += 3)
+	{
+		centroids.push_back((surface.Positions[surface.Indices[t]] + surface.Positions[surface.Indices[t + 1]] +
+			surface.Positions[surface.Indices[t + 2]])*(1.0f / 3.0f));
+	}
+
+	size_t occluded = 0, leaks = 0;
+	const float phis[] = { 0.35f, 0.45f };
+	for(int view = 0; view < 6; ++view)
+	{
+		OrbitCamera& camera = world.Camera();
+		camera.Theta = 0.7f + 1.05f*view;
+		camera.Phi = phis[view % 2]*3.1415926535f;
+		camera.Radius = 90.0f;
+		world.Cull();
+
+		Mat4 viewProj = world.ViewProj();
+		Frustum frustum;
+		FrustumCulling::ExtractPlanes(viewProj, frustum);
+		std::vector<uint8_t> inFrustum(boxes.Count(), 1);
+		FrustumCulling::Cull(frustum, boxes, inFrustum.data());
+
+		Vec3 eye = camera.Eye();
+		for(size_t i = 0; i < boxes.Count(); ++i)
+		{
+			if(!inFrustum[i] || world.SlabVisible()[i])
+				continue;
+			++occluded;
+
+			Vec3 c(boxes.Center(0)[i], boxes.Center(1)[i], boxes.Center(2)[i]);
+			Vec3 e(boxes.Extent(0)[i], boxes.Extent(1)[i], boxes.Extent(2)[i]);
+			AABB box(c - e, c + e);
+			bool seen = false;
+			for(size_t t = 0; t < centroids.size() && !seen; ++t)
+			{
+				const Vec3& q = centroids[t];
+				if(q.x < box.Min.x || q.y < box.Min.y || q.z < box.Min.z ||
+				   q.x > box.Max.x || q.y > box.Max.y || q.z > box.Max.z || !InView(viewProj, q))
+					continue;
+				Vec3 end = q - Normalize(q - eye)*0.05f;
+				seen = !world.Collision().OverlapCapsule(eye, end, 1.0e-3f);
+			}
+			leaks += seen;
+		}
+	}
+
+	CHECK(occluded > 0);
+	CHECK_EQUAL(leaks, size_t(0));
+}
@@ -0,0 +1,82 @@
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "GeometryGenerator.h"
+#include "ParallelFor.h"
+#include "Test.h"
+
+TEST_CASE(ParallelFor_CoversEveryIndexOnce)
+{
+	const size_t counts[] = { 0, 1, 7, 1000, 100003 };
+	for(size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); ++c)
+	{
+		std::vector<std::atomic<int> > hits(counts[c]);
+		for(size_t i = 0; i < hits.size(); ++i)
+			hits[i] = 0;
+
+		ParallelFor(counts[c], 1, [&](size_t begin, size_t end)
+		{
+			for(size_t i = begin; i < end; ++i)
+				++hits[i];
+		});
+
+		size_t wrong = 0;
+		for(size_t i = 0; i < hits.size(); ++i)
+			wrong += hits[i] != 1;
+		CHECK_EQUAL(wrong, size_t(0));
+	}
+}
+
+TEST_CASE(ParallelFor_NestedAndConcurrentCalls)
+{
+	// Ranges that call ParallelFor themselves, from several threads at once, must
+	// neither deadlock nor lose work.
+	std::atomic<size_t> total(0);
+	std::vector<std::thread> threads;
+	for(int t = 0; t < 4; ++t)
+	{
+		threads.emplace_back([&total]()
+		{
+			for(int round = 0; round < 20; ++round)
+			{
+				ParallelFor(16, 1, [&total](size_t begin, size_t end)
+				{
+					for(size_t i = begin; i < end; ++i)
+						ParallelFor(64, 1, [&total](size_t b, size_t e) { total += e - b; });
+				});
+			}
+		});
+	}
+	for(size_t t = 0; t < threads.size(); ++t)
+		threads[t].join();
+
+	CHECK_EQUAL(total.load(), size_t(4*20*16*64));
+}
+
+TEST_CASE(GeometryGenerator_SharedInstanceIsReentrant)
+{
+	GeometryGenerator geoGen;
+	GeometryGenerator::MeshData expected;
+	geoGen.CreateGeosphere(2.0f, 4, expected);
+	geoGen.OptimizeMesh(expected);
+
+	std::vector<GeometryGenerator::MeshData> meshes(4);
+	std::vector<std::thread> threads;
+	for(size_t t = 0; t < meshes.size(); ++t)
+	{
+		threads.emplace_back([&geoGen, &meshes, t]()
+		{
+			geoGen.CreateGeosphere(2.0f, 4, meshes[t]);
+			geoGen.OptimizeMesh(meshes[t]);
+		});
+	}
+	for(size_t t = 0; t < threads.size(); ++t)
+		threads[t].join();
+
+	for(size_t t = 0; t < meshes.size(); ++t)
+	{
+		CHECK(meshes[t].Indices == expected.Indices);
+		CHECK_EQUAL(meshes[t].Vertices.size(), expected.Vertices.size());
+	}
+}
@@ -0,0 +1,359 @@
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "TerrainCollision.h"
+#include "TerrainWorld.h"
+#include "Test.h"
+
+namespace
+{
+	// A rolling height field of size x size unit quads with a cliff across the middle,
+	// so sweeps meet gentle slopes, steep faces and the edges between them.
+	CollisionMesh MakeTerrain(int size, float phase)
+	{
+		CollisionMesh mesh;
+		for(int z = 0; z <= size; ++z)
+		{
+			for(int x = 0; x <= size; ++x)
+			{
+				float y = 2.0f*std::sin(0.7f*x + phase)*std::cos(0.5f*z) + (2*x > size ? 3.0f : 0.0f);
+				mesh.Positions.push_back(Vec3((float)x, y, (float)z));
+			}
+		}
+		uint32_t row = (uint32_t)size + 1;
+		for(uint32_t z = 0; z < (uint32_t)size; ++z)
+		{
+			for(uint32_t x = 0; x < (uint32_t)size; ++x)
+			{
+				uint32_t i = z*row + x;
+				uint32_t quad[6] = { i, i + row, i + 1, i + 1, i + row, i + row + 1 };
+				mesh.Indices.insert(mesh.Indices.end(), quad, quad + 6);
+			}
+		}
+		return mesh;
+	}
+
+	// Every triangle in a collider of its own: the queries with no tree to walk.
+	class BruteForce
+	{
+	public:
+		explicit BruteForce(const CollisionMesh& mesh)
+			: mTriangles(mesh.TriangleCount())
+		{
+			for(size_t t = 0; t < mTriangles.size(); ++t)
+			{
+				CollisionMesh one;
+				for(int k = 0; k < 3; ++k)
+				{
+					one.Positions.push_back(mesh.Positions[mesh.Indices[t*3 + k]]);
+					one.Indices.push_back((uint32_t)k);
+				}
+				mTriangles[t].Build(one);
+			}
+		}
+
+		bool Overlap(const Vec3& a, const Vec3& b, float radius)const
+		{
+			for(size_t t = 0; t < mTriangles.size(); ++t)
+			{
+				if(mTriangles[t].OverlapCapsule(a, b, radius))
+					return true;
+			}
+			return false;
+		}
+
+		bool Sweep(const Vec3& a, const Vec3& b, float radius, const Vec3& direction, float maxDistance, CollisionHit& hit)const
+		{
+			hit = CollisionHit();
+			for(size_t t = 0; t < mTriangles.size(); ++t)
+			{
+				CollisionHit one;
+				if(mTriangles[t].SweepCapsule(a, b, radius, direction, maxDistance, one) && (!hit.Hit || one.Distance < hit.Distance))
+					hit = one;
+			}
+			return hit.Hit;
+		}
+
+	private:
+		std::vector<CollisionBVH> mTriangles;
+	};
+
+	struct Query
+	{
+		Vec3 A, B, Direction;
+		float Radius;
+	};
+
+	// Capsules and spheres above and around a size x size field, sweeping mostly down
+	// but also sideways into the cliff.
+	std::vector<Query> MakeQueries(int size, size_t count, uint32_t seed)
+	{
+		std::minstd_rand rng(seed);
+		std::uniform_real_distribution<float> across(-1.0f, size + 1.0f), height(-2.0f, 8.0f), unit(-1.0f, 1.0f);
+		std::vector<Query> queries(count);
+		for(size_t i = 0; i < count; ++i)
+		{
+			Query& q = queries[i];
+			q.A = Vec3(across(rng), height(rng), across(rng));
+			q.B = i % 3 == 0 ? q.A : q.A + Vec3(0.3f*unit(rng), 1.0f + unit(rng), 0.3f*unit(rng));
+			q.Radius = 0.2f + 0.3f*(unit(rng) + 1.0f);
+			q.Direction = i % 2 == 0 ? Vec3(0.3f*unit(rng), -1.0f, 0.3f*unit(rng)) : Vec3(unit(rng), 0.2f*unit(rng), unit(rng));
+			q.Direction = Normalize(q.Direction);
+		}
+		return queries;
+	}
+
+	// Where a sweep stops the shape touches within SweepTolerance and does not overlap.
+	bool Touches(const CollisionBVH& bvh, const Query& q, float distance)
+	{
+		const float tolerance = CollisionBVH::SweepTolerance;
+		Vec3 a = q.A + q.Direction*distance, b = q.B + q.Direction*distance;
+		return bvh.OverlapCapsule(a, b, q.Radius + 2.0f*tolerance) && (distance == 0.0f || !bvh.OverlapCapsule(a, b, q.Radius - tolerance));
+	}
+
+	// Counts the queries where the tree's answers differ from the brute force ones.
+	void CompareWithBruteForce(const CollisionBVH& bvh, const BruteForce& brute, const std::vector<Query>& queries,
+		size_t& overlapMismatches, size_t& sweepMismatches, size_t& hits)
+	{
+		const float maxDistance = 12.0f;
+		for(size_t i = 0; i < queries.size(); ++i)
+		{
+			const Query& q = queries[i];
+			if(bvh.OverlapCapsule(q.A, q.B, q.Radius) != brute.Overlap(q.A, q.B, q.Radius))
+				++overlapMismatches;
+
+			CollisionHit hit, expected;
+			bool found = bvh.SweepCapsule(q.A, q.B, q.Radius, q.Direction, maxDistance, hit);
+			bool expectedFound = brute.Sweep(q.A, q.B, q.Radius, q.Direction, maxDistance, expected);
+			if(found != expectedFound || found != hit.Hit)
+				++sweepMismatches;
+			else if(found)
+			{
+				++hits;
+				if(std::fabs(hit.Distance - expected.Distance) > 2.0f*CollisionBVH::SweepTolerance || !Touches(bvh, q, hit.Distance) ||
+					std::fabs(Length(hit.Normal) - 1.0f) > 1e-3f)
+					++sweepMismatches;
+			}
+		}
+	}
+}
+
+TEST_CASE(CollisionBVH_MatchesBruteForce)
+{
+	const int size = 16;
+	CollisionMesh mesh = MakeTerrain(size, 0.0f);
+	CollisionBVH bvh;
+	bvh.Build(mesh);
+	BruteForce brute(mesh);
+
+	CHECK_EQUAL(bvh.Mesh().TriangleCount(), mesh.TriangleCount());
+	CHECK(bvh.Depth() <= CollisionBVH::MaxDepth);
+
+	size_t overlapMismatches = 0, sweepMismatches = 0, hits = 0;
+	std::vector<Query> queries = MakeQueries(size, 400, 7);
+	CompareWithBruteForce(bvh, brute, queries, overlapMismatches, sweepMismatches, hits);
+	CHECK_EQUAL(overlapMismatches, size_t(0));
+	CHECK_EQUAL(sweepMismatches, size_t(0));
+	CHECK(hits > queries.size() / 3);
+}
+
+TEST_CASE(CollisionBVH_RefitMatchesBruteForce)
+{
+	const int size = 16;
+	CollisionBVH bvh;
+	bvh.Build(MakeTerrain(size, 0.0f));
+
+	// Moving every vertex keeps the triangle count, so the tree is refitted, not rebuilt.
+	size_t overlapMismatches = 0, sweepMismatches = 0, hits = 0;
+	for(int step = 1; step <= 3; ++step)
+	{
+		CollisionMesh moved = MakeTerrain(size, 0.4f*step);
+		bvh.Refit(moved);
+		CompareWithBruteForce(bvh, BruteForce(moved), MakeQueries(size, 150, 11 + step), overlapMismatches, sweepMismatches, hits);
+	}
+	CHECK_EQUAL(overlapMismatches, size_t(0));
+	CHECK_EQUAL(sweepMismatches, size_t(0));
+	CHECK(hits > 0);
+
+	// The refitted boxes are as tight as a fresh build's at the root.
+	CollisionMesh last = MakeTerrain(size, 1.2f);
+	CollisionBVH fresh;
+	fresh.Build(last);
+	CHECK_NEAR(bvh.Bounds().Min.y, fresh.Bounds().Min.y, 1e-5f);
+	CHECK_NEAR(bvh.Bounds().Max.y, fresh.Bounds().Max.y, 1e-5f);
+}
+
+TEST_CASE(CollisionBVH_SweepAgreesWithMarch)
+{
+	// Step each shape along its path in small increments with only overlap tests; the
+	// sweep must stop where the march first meets the terrain.
+	const int size = 12;
+	CollisionMesh mesh = MakeTerrain(size, 0.5f);
+	CollisionBVH bvh;
+	bvh.Build(mesh);
+
+	const float step = 0.01f, maxDistance = 12.0f;
+	std::vector<Query> queries = MakeQueries(size, 120, 3);
+	size_t mismatches = 0, hits = 0;
+	for(size_t i = 0; i < queries.size(); ++i)
+	{
+		const Query& q = queries[i];
+		float marched = -1.0f;
+		for(float t = 0.0f; t <= maxDistance; t += step)
+		{
+			if(bvh.OverlapCapsule(q.A + q.Direction*t, q.B + q.Direction*t, q.Radius))
+			{
+				marched = t;
+				break;
+			}
+		}
+
+		CollisionHit hit;
+		bool found = bvh.SweepCapsule(q.A, q.B, q.Radius, q.Direction, maxDistance, hit);
+		if(found != (marched >= 0.0f))
+		{
+			// A graze the march stepped past within its tolerance is not a mismatch.
+			if(!(found && hit.Distance > maxDistance - step))
+				++mismatches;
+		}
+		else if(found)
+		{
+			++hits;
+			if(hit.Distance > marched + CollisionBVH::SweepTolerance || hit.Distance < marched - step - CollisionBVH::SweepTolerance)
+				++mismatches;
+		}
+	}
+	CHECK_EQUAL(mismatches, size_t(0));
+	CHECK(hits > queries.size() / 3);
+}
+
+TEST_CASE(CollisionBVH_DepthIsBounded)
+{
+	// Small triangles at exponentially growing distances: the SAH peels one off per
+	// level, which alone would make a tree as deep as the triangle count.
+	CollisionMesh mesh;
+	const uint32_t count = 200;
+	float x = 1.0f;
+	for(uint32_t t = 0; t < count; ++t)
+	{
+		mesh.Positions.push_back(Vec3(x, 0.0f, 0.0f));
+		mesh.Positions.push_back(Vec3(x, 0.0f, 1.0f));
+		mesh.Positions.push_back(Vec3(x + 1.0f, 0.0f, 0.0f));
+		uint32_t tri[3] = { 3*t, 3*t + 1, 3*t + 2 };
+		mesh.Indices.insert(mesh.Indices.end(), tri, tri + 3);
+		x *= 1.52f;
+	}
+
+	CollisionBVH bvh;
+	bvh.Build(mesh);
+	CHECK(bvh.Depth() > CollisionBVH::MaxSAHDepth);
+	CHECK(bvh.Depth() <= CollisionBVH::MaxDepth);
+
+	// Every triangle is still found, the deepest included.
+	BruteForce brute(mesh);
+	size_t mismatches = 0;
+	x = 1.0f;
+	for(uint32_t t = 0; t < count; ++t, x *= 1.52f)
+	{
+		Vec3 above(x + 0.25f, 1.0f, 0.25f);
+		CollisionHit hit, expected;
+		bool found = bvh.SweepSphere(above, 0.1f, Vec3(0.0f, -1.0f, 0.0f), 2.0f, hit);
+		if(!found || !brute.Sweep(above, above, 0.1f, Vec3(0.0f, -1.0f, 0.0f), 2.0f, expected) ||
+			std::fabs(hit.Distance - expected.Distance) > CollisionBVH::SweepTolerance ||
+			!bvh.OverlapSphere(above - Vec3(0.0f, 0.95f, 0.0f), 0.1f))
+			++mismatches;
+	}
+	CHECK_EQUAL(mismatches, size_t(0));
+}
+
+TEST_CASE(TerrainCollision_MatchesEveryChunk)
+{
+	TerrainWorld::Settings settings;
+	settings.Corners = 17;
+	settings.ChunkQuads = 4;
+	TerrainWorld world(settings);
+	world.Build();
+
+	// The tree over the chunks must find what testing every chunk's collider finds.
+	const TerrainCollision& collision = world.Collision();
+	CHECK(collision.ChunkCount() > 4);
+
+	std::minstd_rand rng(5);
+	float half = 0.5f*settings.Extent;
+	std::uniform_real_distribution<float> across(-half, half), height(0.0f, settings.Extent), unit(-1.0f, 1.0f);
+	size_t mismatches = 0, hits = 0;
+	for(int i = 0; i < 300; ++i)
+	{
+		Vec3 a(across(rng), height(rng), across(rng));
+		Vec3 b = a + Vec3(0.0f, 1.5f, 0.0f);
+		float radius = 0.5f + unit(rng)*0.25f;
+		Vec3 direction = Normalize(i % 2 == 0 ? Vec3(0.2f*unit(rng), -1.0f, 0.2f*unit(rng)) : Vec3(unit(rng), 0.3f*unit(rng), unit(rng)));
+		float maxDistance = settings.Extent;
+
+		bool overlaps = false;
+		CollisionHit expected;
+		size_t expectedChunk = 0;
+		for(size_t c = 0; c < collision.ChunkCount(); ++c)
+		{
+			TerrainCollision::Collider collider = collision.Chunk(c);
+			if(!collider)
+				continue;
+			overlaps = overlaps || collider->OverlapCapsule(a, b, radius);
+			CollisionHit one;
+			if(collider->SweepCapsule(a, b, radius, direction, maxDistance, one) && (!expected.Hit || one.Distance < expected.Distance))
+			{
+				expected = one;
+				expectedChunk = c;
+			}
+		}
+
+		CollisionHit hit;
+		size_t hitChunk = 0;
+		if(collision.OverlapCapsule(a, b, radius) != overlaps ||
+			collision.SweepCapsule(a, b, radius, direction, maxDistance, hit, &hitChunk) != expected.Hit)
+			++mismatches;
+		else if(hit.Hit)
+		{
+			++hits;
+			if(std::fabs(hit.Distance - expected.Distance) > 2.0f*CollisionBVH::SweepTolerance ||
+				(hit.Distance == expected.Distance && hitChunk != expectedChunk))
+				++mismatches;
+		}
+	}
+	CHECK_EQUAL(mismatches, size_t(0));
+	CHECK(hits > 100);
+}
+
+TEST_CASE(TerrainCollision_SetChunkUpdatesTree)
+{
+	TerrainCollision collision(2);
+	CHECK(!collision.OverlapCapsule(Vec3(0.0f, 0.0f, 0.0f), Vec3(0.0f, 0.0f, 0.0f), 100.0f));
+
+	// Two fields side by side.
+	CollisionMesh near = MakeTerrain(4, 0.0f), far = MakeTerrain(4, 0.0f);
+	for(size_t v = 0; v < far.Positions.size(); ++v)
+		far.Positions[v].x += 20.0f;
+	collision.UpdateChunk(0, near);
+	collision.UpdateChunk(1, far);
+
+	Vec3 aboveFar(22.0f, 10.0f, 2.0f), down(0.0f, -1.0f, 0.0f);
+	CollisionHit hit;
+	size_t chunk = 9;
+	CHECK(collision.SweepCapsule(aboveFar, aboveFar, 0.5f, down, 20.0f, hit, &chunk));
+	CHECK_EQUAL(chunk, size_t(1));
+
+	// Moving the far field up moves its contact: the tree was refitted with it.
+	for(size_t v = 0; v < far.Positions.size(); ++v)
+		far.Positions[v].y += 2.0f;
+	float before = hit.Distance;
+	collision.UpdateChunk(1, far);
+	CHECK(collision.SweepCapsule(aboveFar, aboveFar, 0.5f, down, 20.0f, hit, &chunk));
+	CHECK_NEAR(hit.Distance, before - 2.0f, 2.0f*CollisionBVH::SweepTolerance);
+
+	// Removing it leaves nothing below.
+	collision.SetChunk(1, TerrainCollision::Collider());
+	CHECK(!collision.SweepCapsule(aboveFar, aboveFar, 0.5f, down, 20.0f, hit, &chunk));
+	CHECK(collision.SweepCapsule(Vec3(2.0f, 10.0f, 2.0f), Vec3(2.0f, 10.0f, 2.0f), 0.5f, down, 20.0f, hit, &chunk));
+	CHECK_EQUAL(chunk, size_t(0));
+}
@@ -0,0 +1,124 @@
+#include <cstring>
+#include <vector>
+
+#include "MathHelper.h"
+#include "TerrainEffectConstants.h"
+#include "Test.h"
+
+namespace
+{
+	size_t UploadsTo(const RecordingConstantBufferBackend& backend, uint32_t slot)
+	{
+		size_t count = 0;
+		for(size_t i = 0; i < backend.Records.size(); ++i)
+			count += backend.Records[i].Slot == slot ? 1 : 0;
+		return count;
+	}
+
+	// Everything TerrainApp::SetTerrainConstants sets each frame, for a camera orbiting
+	// at angle.  Only the camera depends on the frame.  Returns the world-view-projection.
+	Mat4 SetFrame(TerrainEffectConstants& constants, float angle)
+	{
+		uint8_t lights[TerrainEffectConstants::LightCount*TerrainEffectConstants::LightSize];
+		uint8_t material[TerrainEffectConstants::MaterialSize];
+		for(size_t i = 0; i < sizeof(lights); ++i)
+			lights[i] = uint8_t(i);
+		for(size_t i = 0; i < sizeof(material); ++i)
+			material[i] = uint8_t(3*i + 1);
+
+		Mat4 texTransform;
+		texTransform.m[0][0] = texTransform.m[1][1] = 4.0f;
+		Vec3 eye(100.0f*std::cos(angle), 60.0f, 100.0f*std::sin(angle));
+		Mat4 viewProj = MatrixLookAtLH(eye, Vec3(0.0f, 0.0f, 0.0f), Vec3(0.0f, 1.0f, 0.0f))*
+			MatrixPerspectiveFovLH(0.25f*MathHelper::Pi, 4.0f / 3.0f, 1.0f, 1000.0f);
+
+		constants.SetTexTransform(texTransform);
+		constants.SetCornerHeight(33);
+		constants.SetVoxelSize(Vec3(5.0f, 5.0f, 5.0f));
+		constants.SetMaterial(material);
+
+		constants.SetDirLights(lights);
+		constants.SetEyePosW(eye);
+		constants.SetViewProj(viewProj);
+
+		Mat4 world;
+		constants.SetWorld(world);
+		constants.SetWorldViewProj(world*viewProj);
+		return world*viewProj;
+	}
+}
+
+TEST_CASE(TerrainEffectConstants_StaticUploadedOnce)
+{
+	TerrainEffectConstants constants;
+	RecordingConstantBufferBackend backend;
+
+	const int frames = 10;
+	for(int frame = 0; frame < frames; ++frame)
+	{
+		SetFrame(constants, 0.1f*frame);
+		constants.Flush(backend);
+	}
+
+	// The static fields are set every frame but only the first one uploads them, whole.
+	CHECK_EQUAL(UploadsTo(backend, TerrainEffectConstants::StaticSlot), size_t(1));
+	CHECK_EQUAL(backend.Records[0].Slot, uint32_t(TerrainEffectConstants::StaticSlot));
+	CHECK_EQUAL(backend.Records[0].Size, sizeof(TerrainEffectConstants::StaticConstants));
+
+	// The camera moves every frame.
+	CHECK_EQUAL(UploadsTo(backend, TerrainEffectConstants::PerFrameSlot), size_t(frames));
+	CHECK_EQUAL(UploadsTo(backend, TerrainEffectConstants::PerObjectSlot), size_t(frames));
+
+	const ConstantBufferCache::Stats& stats = constants.Cache().GetStats();
+	CHECK_EQUAL(stats.UploadsByFrequency[ConstantBufferCache::Static], size_t(1));
+	CHECK_EQUAL(stats.UploadsByFrequency[ConstantBufferCache::PerFrame], size_t(frames));
+
+	// After the first frame only the camera's ranges go: the eye and view-projection,
+	// not the lights in front of them.
+	for(size_t i = 3; i < backend.Records.size(); ++i)
+	{
+		const RecordingConstantBufferBackend::Record& record = backend.Records[i];
+		if(record.Slot == TerrainEffectConstants::PerFrameSlot)
+			CHECK(record.Offset >= offsetof(TerrainEffectConstants::PerFrameConstants, EyePosW));
+	}
+
+	// A still camera uploads nothing at all.
+	backend.Clear();
+	SetFrame(constants, 0.1f*(frames - 1));
+	constants.Flush(backend);
+	CHECK(backend.Records.empty());
+
+	// Lost buffers come back whole.
+	constants.InvalidateAll();
+	constants.Flush(backend);
+	CHECK_EQUAL(backend.Records.size(), size_t(TerrainEffectConstants::SlotCount));
+	CHECK_EQUAL(UploadsTo(backend, TerrainEffectConstants::StaticSlot), size_t(1));
+}
+
+TEST_CASE(TerrainEffectConstants_ShadowMatchesLayout)
+{
+	TerrainEffectConstants constants;
+	RecordingConstantBufferBackend backend;
+	Mat4 expected = SetFrame(constants, 0.0f);
+	constants.Flush(backend);
+
+	typedef TerrainEffectConstants TC;
+	const std::vector<uint8_t>& statics = backend.Contents[TC::StaticSlot];
+	CHECK_EQUAL(statics.size(), sizeof(TC::StaticConstants));
+
+	uint32_t corners = 0;
+	std::memcpy(&corners, &statics[offsetof(TC::StaticConstants, CornerHeight)], sizeof(corners));
+	CHECK_EQUAL(corners, uint32_t(33));
+
+	// The chunk box is left to the terrain draws, which each carry their own.
+	CHECK_EQUAL(backend.Contents[TC::PerObjectSlot].size(), offsetof(TC::PerObjectConstants, Chunk));
+
+	// Matrices are stored transposed, for the shader's column_major packing.
+	Mat4 wvp;
+	std::memcpy(&wvp, &backend.Contents[TC::PerObjectSlot][offsetof(TC::PerObjectConstants, WorldViewProj)], sizeof(wvp));
+	bool transposed = true;
+	for(int r = 0; r < 4; ++r)
+		for(int c = 0; c < 4; ++c)
+			transposed = transposed && wvp.m[r][c] == expected.m[c][r];
+	CHECK(transposed);
+}
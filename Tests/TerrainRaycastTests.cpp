@@ -0,0 +1,139 @@
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "TerrainRaycast.h"
+#include "TerrainWorld.h"
+#include "Test.h"
+
+namespace
+{
+	// The first point along the ray where the trilinear density turns solid, found by
+	// stepping step world units at a time through the field and bisecting the crossing.
+	bool MarchRay(const TerrainRaycaster& raycaster, const TerrainRay& ray, float step, float& distance)
+	{
+		AABB bounds = raycaster.Bounds();
+		float tEnter = 0.0f, tExit = ray.MaxDistance;
+		for(int a = 0; a < 3; ++a)
+		{
+			if(ray.Direction[a] == 0.0f)
+			{
+				if(ray.Origin[a] < bounds.Min[a] || ray.Origin[a] > bounds.Max[a])
+					return false;
+				continue;
+			}
+			float ta = (bounds.Min[a] - ray.Origin[a]) / ray.Direction[a];
+			float tb = (bounds.Max[a] - ray.Origin[a]) / ray.Direction[a];
+			tEnter = (std::max)(tEnter, (std::min)(ta, tb));
+			tExit = (std::min)(tExit, (std::max)(ta, tb));
+		}
+		if(tEnter > tExit)
+			return false;
+
+		if(raycaster.Density(ray.Origin + ray.Direction*tEnter) > 0.0f)
+		{
+			distance = tEnter;
+			return true;
+		}
+		for(float t0 = tEnter; t0 < tExit; t0 += step)
+		{
+			float t1 = (std::min)(t0 + step, tExit);
+			if(raycaster.Density(ray.Origin + ray.Direction*t1) <= 0.0f)
+				continue;
+			for(int i = 0; i < 40; ++i)
+			{
+				float t = 0.5f*(t0 + t1);
+				if(raycaster.Density(ray.Origin + ray.Direction*t) > 0.0f)
+					t1 = t;
+				else
+					t0 = t;
+			}
+			distance = t1;
+			return true;
+		}
+		return false;
+	}
+
+	Vec3 RandomDirection(std::minstd_rand& rng, float minY, float maxY)
+	{
+		std::uniform_real_distribution<float> y(minY, maxY), angle(0.0f, 6.2831853f);
+		float dy = y(rng), a = angle(rng), r = std::sqrt(1.0f - dy*dy);
+		return Vec3(r*std::cos(a), dy, r*std::sin(a));
+	}
+}
+
+TEST_CASE(TerrainRaycast_MatchesFineMarch)
+{
+	TerrainWorld::Settings settings;
+	settings.Corners = 33;
+	TerrainWorld world(settings);
+	world.Build();
+
+	const TerrainRaycaster& raycaster = world.Raycaster();
+	const AABB bounds = raycaster.Bounds();
+	const Vec3 voxel = world.VoxelSize();
+	const float step = voxel.x / 64.0f;
+	const float tolerance = 1.0e-3f*voxel.x;
+	std::minstd_rand rng(11);
+	std::uniform_real_distribution<float> u(0.0f, 1.0f);
+
+	// Rays from above the field down onto the terrain, steep and shallow.
+	size_t hits = 0, misses = 0, mismatched = 0;
+	float worst = 0.0f;
+	std::vector<TerrainRay> rays;
+	for(int i = 0; i < 400; ++i)
+	{
+		Vec3 origin(bounds.Min.x + u(rng)*(bounds.Max.x - bounds.Min.x), bounds.Max.y + 1.0f,
+			bounds.Min.z + u(rng)*(bounds.Max.z - bounds.Min.z));
+		rays.push_back(TerrainRay(origin, RandomDirection(rng, -1.0f, -0.3f), 1000.0f));
+	}
+	for(size_t i = 0; i < rays.size(); ++i)
+	{
+		TerrainRayHit hit;
+		float expected = 0.0f;
+		bool marched = MarchRay(raycaster, rays[i], step, expected);
+		bool cast = raycaster.Raycast(rays[i], hit);
+		hits += marched;
+		misses += !marched;
+		if(marched != cast)
+		{
+			++mismatched;
+			continue;
+		}
+		if(marched)
+			worst = (std::max)(worst, std::fabs(hit.Distance - expected));
+
+		// Stopped short of the surface, the same ray must miss.
+		if(marched && expected > 0.1f)
+		{
+			TerrainRay shortRay = rays[i];
+			shortRay.MaxDistance = expected - 0.05f;
+			mismatched += raycaster.Raycast(shortRay, hit) ? 1 : 0;
+		}
+	}
+	CHECK(hits > 100);
+	CHECK(misses > 0);
+	CHECK_EQUAL(mismatched, size_t(0));
+	CHECK(worst <= tolerance);
+
+	// Rays that must miss: up from above the field, back up the air a vertical ray came
+	// down through, and away from the field from outside it.
+	TerrainRay down(Vec3(0.0f, bounds.Max.y + 1.0f, 0.0f), Vec3(0.0f, -1.0f, 0.0f), 1000.0f);
+	TerrainRayHit ground;
+	CHECK(raycaster.Raycast(down, ground));
+	const TerrainRay missing[] =
+	{
+		TerrainRay(Vec3(0.0f, bounds.Max.y + 1.0f, 0.0f), Vec3(0.0f, 1.0f, 0.0f), 1000.0f),
+		TerrainRay(ground.Position + Vec3(0.0f, 0.05f*voxel.y, 0.0f), Vec3(0.0f, 1.0f, 0.0f), 1000.0f),
+		TerrainRay(Vec3(bounds.Max.x + 5.0f, 0.5f*bounds.Max.y, 0.0f), Vec3(1.0f, 0.0f, 0.0f), 1000.0f),
+		TerrainRay(Vec3(0.0f, bounds.Max.y + 1.0f, bounds.Min.z - 5.0f), Normalize(Vec3(0.0f, -1.0f, -1.0f)), 1000.0f),
+	};
+	for(size_t i = 0; i < sizeof(missing) / sizeof(missing[0]); ++i)
+	{
+		TerrainRayHit hit;
+		float expected = 0.0f;
+		CHECK(!MarchRay(raycaster, missing[i], step, expected));
+		CHECK(!raycaster.Raycast(missing[i], hit));
+	}
+}
@@ -0,0 +1,43 @@
+//***************************************************************************************
+// Test.h
+//
+// A minimal test harness for the portable core.  Each Tests/*.cpp defines its cases
+// with TEST_CASE, which registers them before main runs; TestMain.cpp runs every case
+// (or those whose name contains a filter given on the command line) and exits
+// non-zero if any check failed.  A failed CHECK reports and carries on, so one run
+// lists every failure in a case.
+//***************************************************************************************
+
+#ifndef TEST_H
+#define TEST_H
+
+#include <cmath>
+#include <cstddef>
+
+typedef void (*TestFunction)();
+
+// Adds a case to the list TestMain runs.  Used by TEST_CASE at static init time.
+struct TestRegistrar
+{
+	TestRegistrar(const char* name, TestFunction function);
+};
+
+// Records a failed check against the running case.
+void TestFail(const char* expression, const char* file, int line);
+
+#define TEST_CASE(name) \
+	static void name(); \
+	static TestRegistrar name##Registrar(#name, name); \
+	static void name()
+
+#define CHECK(condition) \
+	do { if(!(condition)) TestFail(#condition, __FILE__, __LINE__); } while(0)
+
+#define CHECK_EQUAL(a, b) \
+	do { if(!((a) == (b))) TestFail(#a " == " #b, __FILE__, __LINE__); } while(0)
+
+#define CHECK_NEAR(a, b, tolerance) \
+	do { if(!(std::fabs((double)(a) - (double)(b)) <= (double)(tolerance))) \
+		TestFail(#a " ~= " #b, __FILE__, __LINE__); } while(0)
+
+#endif // TEST_H
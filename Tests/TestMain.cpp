@@ -0,0 +1,73 @@
+//***************************************************************************************
+// TestMain.cpp
+//
+// Unit tests for the portable core.  Usage:
+//
+//   TerrainTests [filter ...]
+//
+// Runs every registered case, or only those whose name contains one of the filters,
+// and prints each failed check.  The exit code is non-zero if any check failed.
+//***************************************************************************************
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "Test.h"
+
+namespace
+{
+	struct TestCase
+	{
+		const char* Name;
+		TestFunction Function;
+	};
+
+	// Function-local so registration does not depend on static init order.
+	std::vector<TestCase>& Registry()
+	{
+		static std::vector<TestCase> cases;
+		return cases;
+	}
+
+	const char* gCurrent = 0;
+	size_t gFailures = 0;
+}
+
+TestRegistrar::TestRegistrar(const char* name, TestFunction function)
+{
+	TestCase c = { name, function };
+	Registry().push_back(c);
+}
+
+void TestFail(const char* expression, const char* file, int line)
+{
+	std::printf("%s:%d: %s: CHECK(%s) failed\n", file, line, gCurrent, expression);
+	++gFailures;
+}
+
+int main(int argc, char** argv)
+{
+	size_t run = 0, failedCases = 0;
+	const std::vector<TestCase>& cases = Registry();
+	for(size_t i = 0; i < cases.size(); ++i)
+	{
+		bool selected = argc < 2;
+		for(int a = 1; a < argc && !selected; ++a)
+			selected = std::strstr(cases[i].Name, argv[a]) != 0;
+		if(!selected)
+			continue;
+
+		gCurrent = cases[i].Name;
+		size_t before = gFailures;
+		cases[i].Function();
+		++run;
+		if(gFailures != before)
+			++failedCases;
+		std::printf("%-48s %s\n", cases[i].Name, gFailures == before ? "ok" : "FAILED");
+	}
+
+	std::printf("\n%u of %u cases passed, %u failed checks\n", (unsigned)(run - failedCases), (unsigned)run,
+		(unsigned)gFailures);
+	return gFailures == 0 && run > 0 ? 0 : 1;
+}
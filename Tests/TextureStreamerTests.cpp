@@ -0,0 +1,278 @@
+#include <cstring>
+#include <map>
+#include <vector>
+
+#include "Test.h"
+#include "TextureStreamer.h"
+
+namespace
+{
+	// Square RGBA8 DDS with a full mip chain, texels set to seed.
+	std::vector<uint8_t> MakeTexture(uint32_t size, uint8_t seed)
+	{
+		uint32_t mips = 1;
+		for(uint32_t s = size; s > 1; s /= 2)
+			++mips;
+
+		size_t texels = 0;
+		for(uint32_t s = size; ; s /= 2)
+		{
+			texels += size_t(s)*s;
+			if(s == 1)
+				break;
+		}
+
+		DDS_HEADER header;
+		std::memset(&header, 0, sizeof(header));
+		header.size = sizeof(DDS_HEADER);
+		header.flags = 0x1 | DDS_HEIGHT | DDS_WIDTH | 0x1000 | 0x20000; // CAPS, PIXELFORMAT, MIPMAPCOUNT
+		header.width = size;
+		header.height = size;
+		header.mipMapCount = mips;
+		header.ddspf.size = sizeof(DDS_PIXELFORMAT);
+		header.ddspf.flags = DDS_RGB | 0x1; // ALPHAPIXELS
+		header.ddspf.RGBBitCount = 32;
+		header.ddspf.RBitMask = 0x000000ff;
+		header.ddspf.GBitMask = 0x0000ff00;
+		header.ddspf.BBitMask = 0x00ff0000;
+		header.ddspf.ABitMask = 0xff000000;
+
+		std::vector<uint8_t> file(sizeof(uint32_t) + sizeof(header) + 4*texels, seed);
+		std::memcpy(&file[0], &DDS_MAGIC, sizeof(uint32_t));
+		std::memcpy(&file[sizeof(uint32_t)], &header, sizeof(header));
+		return file;
+	}
+
+	// Records every create and release; a texture is identified by the file its
+	// subresources point into.
+	class FakeTextureDevice : public ITextureDevice
+	{
+	public:
+		struct Call
+		{
+			size_t File;
+			size_t TopMip;
+			bool Create;
+		};
+
+		FakeTextureDevice() : mNextHandle(1), mLive(0) {}
+
+		size_t AddFile(const std::vector<uint8_t>& file)
+		{
+			mFiles.push_back(&file);
+			return mFiles.size() - 1;
+		}
+
+		void* CreateTexture(const DDSCore::TextureDesc&, size_t topMip, const DDSCore::Subresource* subresources)
+		{
+			const uint8_t* p = static_cast<const uint8_t*>(subresources[0].pSysMem);
+			size_t file = mFiles.size();
+			for(size_t f = 0; f < mFiles.size(); ++f)
+			{
+				if(p >= mFiles[f]->data() && p < mFiles[f]->data() + mFiles[f]->size())
+					file = f;
+			}
+
+			Call call = { file, topMip, true };
+			Calls.push_back(call);
+			void* handle = reinterpret_cast<void*>(mNextHandle++);
+			mHandles[handle] = call;
+			++mLive;
+			return handle;
+		}
+
+		void ReleaseTexture(void* texture)
+		{
+			Call call = mHandles[texture];
+			call.Create = false;
+			Calls.push_back(call);
+			mHandles.erase(texture);
+			--mLive;
+		}
+
+		size_t Live()const { return mLive; }
+
+		std::vector<Call> Calls;
+
+	private:
+		std::vector<const std::vector<uint8_t>*> mFiles;
+		std::map<void*, Call> mHandles;
+		uintptr_t mNextHandle;
+		size_t mLive;
+	};
+
+	// 256x256 RGBA8: 349524 bytes in all, of which mips 4 and down (1364 bytes) are
+	// the tail under a 4 KB TailBytes.
+	const uint32_t Size = 256;
+	const size_t FullBytes = 349524;
+	const size_t TailBytes = 1364;
+	const size_t TailMip = 4;
+
+	TextureStreamer::Config MakeConfig(size_t budget)
+	{
+		TextureStreamer::Config config;
+		config.MemoryBudget = budget;
+		config.UploadBytesPerFrame = 1;
+		config.TailBytes = 4096;
+		return config;
+	}
+
+	// Runs frames until nothing changes, checking the budget every frame.  Returns
+	// false if it never settles.
+	bool Settle(TextureStreamer& streamer, size_t budget)
+	{
+		for(int frame = 0; frame < 200; ++frame)
+		{
+			size_t uploads = streamer.GetStats().Uploads;
+			streamer.WaitForIO();
+			streamer.Update();
+			TextureStreamer::Stats stats = streamer.GetStats();
+			CHECK(stats.ResidentBytes <= budget);
+			if(stats.Uploads == uploads && stats.PendingIO == 0 && stats.PendingLoads == 0)
+				return true;
+		}
+		return false;
+	}
+}
+
+TEST_CASE(TextureStreamer_QueueAndTails)
+{
+	std::vector<uint8_t> a = MakeTexture(Size, 1), b = MakeTexture(Size, 2);
+	std::vector<uint8_t> bad(64, 0xcd);
+	FakeTextureDevice device;
+	device.AddFile(a);
+	device.AddFile(b);
+
+	{
+		TextureStreamer streamer(device, MakeConfig(16u << 20));
+		TextureStreamer::TextureId ia = streamer.LoadFromMemory(a.data(), a.size(), 2.0f);
+		TextureStreamer::TextureId ib = streamer.LoadFromMemory(b.data(), b.size(), 1.0f);
+		TextureStreamer::TextureId ibad = streamer.LoadFromMemory(bad.data(), bad.size());
+
+		// Nothing reaches the device until Update picks up the parsed files.
+		CHECK(streamer.GetTexture(ia) == 0);
+		CHECK_EQUAL(streamer.GetStats().PendingLoads, size_t(3));
+		CHECK(device.Calls.empty());
+
+		streamer.WaitForIO();
+		streamer.Update();
+
+		// Both tails in one frame, whatever the upload limit; the bad file fails.
+		CHECK(streamer.GetTexture(ia) != 0);
+		CHECK(streamer.GetTexture(ib) != 0);
+		CHECK_EQUAL(streamer.ResidentMip(ia), TailMip);
+		CHECK_EQUAL(streamer.ResidentMip(ib), TailMip);
+		CHECK(streamer.Failed(ibad));
+		CHECK_EQUAL(streamer.GetStats().PendingLoads, size_t(0));
+		CHECK_EQUAL(streamer.GetStats().ResidentBytes, 2*TailBytes);
+		CHECK_EQUAL(device.Calls.size(), size_t(2));
+
+		// With a one-byte upload limit each frame refines one texture by one mip, and
+		// the first refinement goes to the more important texture.
+		size_t refinements = 0;
+		size_t firstFile = ~size_t(0);
+		for(int frame = 0; frame < 40; ++frame)
+		{
+			size_t before = device.Calls.size();
+			streamer.WaitForIO();
+			streamer.Update();
+
+			size_t creates = 0;
+			for(size_t i = before; i < device.Calls.size(); ++i)
+			{
+				if(!device.Calls[i].Create)
+					continue;
+				++creates;
+				if(firstFile == ~size_t(0))
+					firstFile = device.Calls[i].File;
+			}
+			CHECK(creates <= 1);
+			refinements += creates;
+		}
+		CHECK_EQUAL(firstFile, size_t(0));
+		CHECK_EQUAL(refinements, 2*TailMip);
+		CHECK_EQUAL(streamer.ResidentMip(ia), size_t(0));
+		CHECK_EQUAL(streamer.ResidentMip(ib), size_t(0));
+		CHECK_EQUAL(streamer.GetStats().ResidentBytes, 2*FullBytes);
+		CHECK_EQUAL(streamer.GetStats().Evictions, size_t(0));
+
+		// Every refinement replaced the previous texture.
+		CHECK_EQUAL(device.Live(), size_t(2));
+	}
+	CHECK_EQUAL(device.Live(), size_t(0));
+}
+
+TEST_CASE(TextureStreamer_BudgetFollowsPriority)
+{
+	std::vector<uint8_t> a = MakeTexture(Size, 1), b = MakeTexture(Size, 2);
+	FakeTextureDevice device;
+	device.AddFile(a);
+	device.AddFile(b);
+
+	// Room for one full chain; after both tails 49112 bytes remain for the other,
+	// enough for mip 2 (20480 above its tail) but not mip 1 (86016).
+	const size_t budget = 400000;
+	TextureStreamer streamer(device, MakeConfig(budget));
+	TextureStreamer::TextureId ia = streamer.LoadFromMemory(a.data(), a.size(), 2.0f);
+	TextureStreamer::TextureId ib = streamer.LoadFromMemory(b.data(), b.size(), 1.0f);
+
+	CHECK(Settle(streamer, budget));
+	CHECK_EQUAL(streamer.ResidentMip(ia), size_t(0));
+	CHECK_EQUAL(streamer.ResidentMip(ib), size_t(2));
+	CHECK_EQUAL(streamer.GetStats().Evictions, size_t(0));
+
+	// Swapping the priorities swaps the residency: a drops a mip at a time to make room.
+	streamer.SetPriority(ia, 1.0f);
+	streamer.SetPriority(ib, 2.0f);
+	CHECK(Settle(streamer, budget));
+	CHECK_EQUAL(streamer.ResidentMip(ia), size_t(2));
+	CHECK_EQUAL(streamer.ResidentMip(ib), size_t(0));
+	CHECK_EQUAL(streamer.GetStats().Evictions, size_t(2));
+
+	// Not visible: keeps what fits but does not grow.
+	streamer.SetPriority(ia, 0.0f);
+	CHECK(Settle(streamer, budget));
+	CHECK_EQUAL(streamer.ResidentMip(ia), size_t(2));
+}
+
+TEST_CASE(TextureStreamer_EvictsLowestPriorityFirst)
+{
+	std::vector<uint8_t> low = MakeTexture(Size, 1), mid = MakeTexture(Size, 2), high = MakeTexture(Size, 3);
+	FakeTextureDevice device;
+	device.AddFile(low);
+	device.AddFile(mid);
+	device.AddFile(high);
+
+	// Two full chains fit.  With a third texture's tail as well, what is left after the
+	// two most important chains (20000 bytes) only takes the least important one to
+	// mip 3.
+	const size_t budget = 2*FullBytes + TailBytes + 20000;
+	TextureStreamer streamer(device, MakeConfig(budget));
+	TextureStreamer::TextureId il = streamer.LoadFromMemory(low.data(), low.size(), 1.0f);
+	TextureStreamer::TextureId im = streamer.LoadFromMemory(mid.data(), mid.size(), 2.0f);
+	CHECK(Settle(streamer, budget));
+	CHECK_EQUAL(streamer.ResidentMip(il), size_t(0));
+	CHECK_EQUAL(streamer.ResidentMip(im), size_t(0));
+
+	size_t before = device.Calls.size();
+	TextureStreamer::TextureId ih = streamer.LoadFromMemory(high.data(), high.size(), 3.0f);
+	CHECK(Settle(streamer, budget));
+	CHECK_EQUAL(streamer.ResidentMip(ih), size_t(0));
+	CHECK_EQUAL(streamer.ResidentMip(im), size_t(0));
+	CHECK_EQUAL(streamer.ResidentMip(il), size_t(3));
+	CHECK_EQUAL(streamer.GetStats().Evictions, size_t(3));
+
+	// Only the least important texture was recreated, one mip coarser each time.
+	size_t lastLowMip = 0;
+	for(size_t i = before; i < device.Calls.size(); ++i)
+	{
+		const FakeTextureDevice::Call& call = device.Calls[i];
+		CHECK(call.File != 1);
+		if(call.File == 0 && call.Create)
+		{
+			CHECK_EQUAL(call.TopMip, lastLowMip + 1);
+			lastLowMip = call.TopMip;
+		}
+	}
+	CHECK_EQUAL(lastLowMip, size_t(3));
+}
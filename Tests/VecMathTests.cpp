@@ -0,0 +1,68 @@
+#include "MathHelper.h"
+#include "Test.h"
+#include "VecMath.h"
+
+// p*M for a point (w = 1), returning the homogeneous result.
+static Vec4 Transform(const Vec3& p, const Mat4& m)
+{
+	float r[4];
+	for(int c = 0; c < 4; ++c)
+		r[c] = p.x*m.m[0][c] + p.y*m.m[1][c] + p.z*m.m[2][c] + m.m[3][c];
+	return Vec4(r[0], r[1], r[2], r[3]);
+}
+
+TEST_CASE(VecMath_LookAtMapsTargetOntoViewAxis)
+{
+	Vec3 eye(10.0f, 5.0f, -3.0f), target(-2.0f, 1.0f, 4.0f);
+	Mat4 view = MatrixLookAtLH(eye, target, Vec3(0.0f, 1.0f, 0.0f));
+
+	Vec4 e = Transform(eye, view);
+	CHECK_NEAR(e.x, 0.0f, 1e-4f);
+	CHECK_NEAR(e.y, 0.0f, 1e-4f);
+	CHECK_NEAR(e.z, 0.0f, 1e-4f);
+
+	Vec4 t = Transform(target, view);
+	CHECK_NEAR(t.x, 0.0f, 1e-4f);
+	CHECK_NEAR(t.y, 0.0f, 1e-4f);
+	CHECK_NEAR(t.z, Length(target - eye), 1e-4f);
+}
+
+TEST_CASE(VecMath_PerspectiveMapsNearAndFarToDepthRange)
+{
+	Mat4 proj = MatrixPerspectiveFovLH(0.25f*MathHelper::Pi, 4.0f / 3.0f, 1.0f, 1000.0f);
+
+	Vec4 nearPoint = Transform(Vec3(0.0f, 0.0f, 1.0f), proj);
+	Vec4 farPoint = Transform(Vec3(0.0f, 0.0f, 1000.0f), proj);
+	CHECK_NEAR(nearPoint.z / nearPoint.w, 0.0f, 1e-5f);
+	CHECK_NEAR(farPoint.z / farPoint.w, 1.0f, 1e-5f);
+
+	// The top of the field of view lands on y = 1.
+	float y = std::tan(0.125f*MathHelper::Pi)*10.0f;
+	Vec4 top = Transform(Vec3(0.0f, y, 10.0f), proj);
+	CHECK_NEAR(top.y / top.w, 1.0f, 1e-5f);
+}
+
+TEST_CASE(VecMath_AABB)
+{
+	AABB box;
+	CHECK(box.IsEmpty());
+	CHECK_EQUAL(box.SurfaceArea(), 0.0f);
+
+	box.Extend(Vec3(1.0f, 2.0f, 3.0f));
+	box.Extend(Vec3(-1.0f, 0.0f, 4.0f));
+	CHECK(!box.IsEmpty());
+	CHECK(box.Contains(Vec3(0.0f, 1.0f, 3.5f)));
+	CHECK(!box.Contains(Vec3(0.0f, 1.0f, 5.0f)));
+	CHECK_NEAR(box.SurfaceArea(), 2.0f*(2.0f*2.0f + 2.0f*1.0f + 1.0f*2.0f), 1e-6f);
+	CHECK(box.Overlaps(AABB(Vec3(1.0f, 2.0f, 4.0f), Vec3(3.0f, 3.0f, 5.0f))));
+	CHECK(!box.Overlaps(AABB(Vec3(1.1f, 2.0f, 4.0f), Vec3(3.0f, 3.0f, 5.0f))));
+}
+
+TEST_CASE(MathHelper_AngleFromXY)
+{
+	CHECK_NEAR(MathHelper::AngleFromXY(1.0f, 0.0f), 0.0f, 1e-6f);
+	CHECK_NEAR(MathHelper::AngleFromXY(0.0f, 1.0f), 0.5f*MathHelper::Pi, 1e-6f);
+	CHECK_NEAR(MathHelper::AngleFromXY(-1.0f, 0.0f), MathHelper::Pi, 1e-6f);
+	CHECK_NEAR(MathHelper::AngleFromXY(0.0f, -1.0f), 1.5f*MathHelper::Pi, 1e-6f);
+	CHECK_NEAR(MathHelper::AngleFromXY(1.0f, -1.0f), 1.75f*MathHelper::Pi, 1e-6f);
+}
@@ -0,0 +1,183 @@
+#include <cmath>
+#include <vector>
+
+#include "BillboardBatch.h"
+#include "Test.h"
+#include "VegetationLod.h"
+#include "VertexCompression.h"
+
+namespace
+{
+	// Nine unit trees in a row at the origin.
+	std::vector<VegetationInstance> MakeTrees()
+	{
+		std::vector<VegetationInstance> trees(9);
+		for(size_t i = 0; i < trees.size(); ++i)
+		{
+			trees[i].Position = Vec3(0.1f*i, 0.0f, 0.0f);
+			trees[i].Width = 1.0f;
+			trees[i].Height = 2.0f;
+			trees[i].Variant = 0;
+		}
+		return trees;
+	}
+
+	// What one chunk at the origin draws this frame, with the eye at x = distance.
+	struct Emitted
+	{
+		size_t Count;
+		size_t FadeIn;      // Instances of the incoming band.
+		size_t FadeOut;     // Instances of the outgoing band.
+		uint8_t InLod;
+		uint8_t InFade;
+		uint8_t OutLod;
+		uint8_t OutFade;
+		float InWidth;
+	};
+
+	Emitted Emit(VegetationLod& lod, const std::vector<VegetationInstance>& trees, float distance)
+	{
+		BillboardBatchBuilder builder;
+		builder.Clear();
+		Emitted e = { 0, 0, 0, 0, 0, 0, 0, 0.0f };
+		e.Count = lod.Emit(0, trees.data(), trees.size(), 1, builder);
+		builder.Build(Vec3(distance, 0.0f, 0.0f));
+		const std::vector<BillboardInstance>& instances = builder.Instances();
+		for(size_t i = 0; i < instances.size(); ++i)
+		{
+			if(instances[i].Lod & BillboardFadeOut)
+			{
+				++e.FadeOut;
+				e.OutLod = instances[i].Lod & ~BillboardFadeOut;
+				e.OutFade = instances[i].Fade;
+			}
+			else
+			{
+				++e.FadeIn;
+				e.InLod = instances[i].Lod;
+				e.InFade = instances[i].Fade;
+				e.InWidth = VertexCompression::HalfToFloat(instances[i].Size[0]);
+			}
+		}
+		return e;
+	}
+}
+
+TEST_CASE(VegetationLod_BandsFadeWithHysteresis)
+{
+	// Bands at 60, 110 and 200 with 5 of hysteresis, fading over four 0.125 s frames.
+	VegetationLodSettings settings;
+	settings.FadeTime = 0.5f;
+	VegetationLod lod(settings);
+	lod.Reset(1);
+
+	const std::vector<VegetationInstance> trees = MakeTrees();
+	const Vec3 center(0.0f, 0.0f, 0.0f);
+	const float dt = 0.125f;
+	struct Frame
+	{
+		float Distance;
+		VegetationBand Band;
+		bool Fading;
+	};
+	const Frame frames[] =
+	{
+		{ 100.0f, VegetationMid, false },    // The first update snaps.
+		{ 30.0f, VegetationNear, true },
+		{ 62.0f, VegetationNear, true },     // Past 60, not past 65: stays.
+		{ 62.0f, VegetationNear, true },
+		{ 62.0f, VegetationNear, true },
+		{ 62.0f, VegetationNear, false },
+		{ 66.0f, VegetationMid, true },
+		{ 57.0f, VegetationMid, true },      // Inside 60, not inside 55: stays.
+		{ 57.0f, VegetationMid, true },
+		{ 57.0f, VegetationMid, true },
+		{ 57.0f, VegetationMid, false },
+	};
+	const uint8_t fades[] = { 255, 0, 64, 128, 191, 255, 0, 64, 128, 191, 255 };
+	for(size_t f = 0; f < sizeof(frames) / sizeof(frames[0]); ++f)
+	{
+		lod.Update(&center, 1, Vec3(frames[f].Distance, 0.0f, 0.0f), dt);
+		CHECK_EQUAL(lod.Band(0), frames[f].Band);
+		CHECK_EQUAL(lod.Fading(0), frames[f].Fading);
+		CHECK_EQUAL(lod.GetStats().Transitions, size_t(frames[f].Fading ? 1 : 0));
+
+		// A fading chunk draws both bands at the same progress, the outgoing one in the
+		// complementary dither.
+		Emitted e = Emit(lod, trees, frames[f].Distance);
+		CHECK_EQUAL(e.InLod, uint8_t(frames[f].Band));
+		CHECK_EQUAL(e.InFade, fades[f]);
+		CHECK_EQUAL(e.FadeIn, trees.size());
+		CHECK_EQUAL(e.FadeOut, frames[f].Fading ? trees.size() : size_t(0));
+		if(frames[f].Fading)
+			CHECK_EQUAL(e.OutFade, fades[f]);
+	}
+
+	// Turning back three quarters of the way fades the way it came, from where it got to.
+	for(int f = 0; f < 3; ++f)
+		lod.Update(&center, 1, Vec3(54.0f, 0.0f, 0.0f), dt);
+	CHECK_EQUAL(lod.Band(0), VegetationNear);
+	lod.Update(&center, 1, Vec3(66.0f, 0.0f, 0.0f), dt);
+	CHECK_EQUAL(lod.Band(0), VegetationMid);
+	Emitted back = Emit(lod, trees, 66.0f);
+	CHECK_EQUAL(back.InFade, uint8_t(64));
+	CHECK_EQUAL(back.OutLod, uint8_t(VegetationNear));
+
+	// Far keeps one tree in three, sqrt(3) as wide, and the stats count what went out.
+	lod.Update(&center, 1, Vec3(120.0f, 0.0f, 0.0f), dt);
+	CHECK_EQUAL(lod.Band(0), VegetationFar);
+	Emitted far = Emit(lod, trees, 120.0f);
+	CHECK_EQUAL(far.FadeIn, size_t(3));
+	CHECK_EQUAL(far.FadeOut, trees.size());
+	CHECK_EQUAL(far.Count, size_t(3) + trees.size());
+	CHECK_NEAR(far.InWidth, std::sqrt(3.0f), 1e-2f);
+	CHECK_EQUAL(lod.GetStats().Instances[VegetationFar], size_t(3));
+	CHECK_EQUAL(lod.GetStats().Instances[VegetationMid], trees.size());
+
+	// Culled fades the far trees out, then draws nothing.
+	lod.Update(&center, 1, Vec3(210.0f, 0.0f, 0.0f), 1.0f);
+	lod.Update(&center, 1, Vec3(210.0f, 0.0f, 0.0f), dt);
+	CHECK_EQUAL(lod.Band(0), VegetationCulled);
+	Emitted culling = Emit(lod, trees, 210.0f);
+	CHECK_EQUAL(culling.FadeIn, size_t(0));
+	CHECK_EQUAL(culling.FadeOut, size_t(3));
+	CHECK_EQUAL(culling.OutLod, uint8_t(VegetationFar));
+	for(int f = 0; f < 4; ++f)
+		lod.Update(&center, 1, Vec3(210.0f, 0.0f, 0.0f), dt);
+	CHECK(!lod.Fading(0));
+	CHECK_EQUAL(Emit(lod, trees, 210.0f).Count, size_t(0));
+}
+
+TEST_CASE(VegetationLod_StatsCountChunksPerBand)
+{
+	VegetationLod lod;
+	const Vec3 centers[] =
+	{
+		Vec3(10.0f, 0.0f, 0.0f), Vec3(0.0f, 0.0f, 40.0f),
+		Vec3(80.0f, 0.0f, 0.0f),
+		Vec3(0.0f, 0.0f, -150.0f), Vec3(0.0f, 150.0f, 0.0f), Vec3(-120.0f, 0.0f, 0.0f),
+		Vec3(300.0f, 0.0f, 0.0f),
+	};
+	const size_t count = sizeof(centers) / sizeof(centers[0]);
+	lod.Update(centers, count, Vec3(0.0f, 0.0f, 0.0f), 0.1f);
+
+	const VegetationLod::Stats& stats = lod.GetStats();
+	CHECK_EQUAL(stats.Chunks[VegetationNear], size_t(2));
+	CHECK_EQUAL(stats.Chunks[VegetationMid], size_t(1));
+	CHECK_EQUAL(stats.Chunks[VegetationFar], size_t(3));
+	CHECK_EQUAL(stats.Chunks[VegetationCulled], size_t(1));
+	CHECK_EQUAL(stats.Transitions, size_t(0));
+
+	// Moving the eye to x = 100 takes four chunks across a boundary; the one at 300
+	// ends up 200 away, inside the cull distance but not past its hysteresis.
+	lod.Update(centers, count, Vec3(100.0f, 0.0f, 0.0f), 0.1f);
+	CHECK_EQUAL(stats.Chunks[VegetationNear], size_t(1));
+	CHECK_EQUAL(stats.Chunks[VegetationMid], size_t(2));
+	CHECK_EQUAL(stats.Chunks[VegetationFar], size_t(2));
+	CHECK_EQUAL(stats.Chunks[VegetationCulled], size_t(2));
+	CHECK_EQUAL(stats.Transitions, size_t(4));
+
+	// A change in chunk count starts over without fading.
+	lod.Update(centers, count - 1, Vec3(100.0f, 0.0f, 0.0f), 0.1f);
+	CHECK_EQUAL(stats.Transitions, size_t(0));
+}
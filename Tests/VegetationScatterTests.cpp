@@ -0,0 +1,199 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "Test.h"
+#include "VegetationScatter.h"
+
+namespace
+{
+	// Triangles for ScatterSurface, owning their arrays.
+	struct Patches
+	{
+		std::vector<Vec3> Positions;
+		std::vector<Vec3> Normals;
+		std::vector<uint32_t> Indices;
+
+		// A square of quads x quads cells of side size from (x, y, z), rising slope units
+		// of y per unit of x.
+		void Add(float x, float y, float z, float size, int quads, float slope)
+		{
+			Vec3 normal = Normalize(Vec3(-slope, 1.0f, 0.0f));
+			uint32_t base = (uint32_t)Positions.size();
+			float cell = size / quads;
+			for(int i = 0; i <= quads; ++i)
+			{
+				for(int j = 0; j <= quads; ++j)
+				{
+					Positions.push_back(Vec3(x + j*cell, y + slope*j*cell, z + i*cell));
+					Normals.push_back(normal);
+				}
+			}
+			for(int i = 0; i < quads; ++i)
+			{
+				for(int j = 0; j < quads; ++j)
+				{
+					uint32_t v = base + i*(quads + 1) + j;
+					uint32_t quad[6] = { v, v + quads + 1, v + 1, v + 1, v + quads + 1, v + quads + 2 };
+					Indices.insert(Indices.end(), quad, quad + 6);
+				}
+			}
+		}
+
+		ScatterSurface Surface()const
+		{
+			ScatterSurface surface;
+			surface.Positions = Positions.data();
+			surface.Normals = Normals.data();
+			surface.Indices = Indices.data();
+			surface.IndexCount = Indices.size();
+			return surface;
+		}
+	};
+
+	bool Same(const std::vector<VegetationInstance>& a, const std::vector<VegetationInstance>& b)
+	{
+		if(a.size() != b.size())
+			return false;
+		for(size_t i = 0; i < a.size(); ++i)
+		{
+			if(a[i].Position.x != b[i].Position.x || a[i].Position.y != b[i].Position.y ||
+				a[i].Position.z != b[i].Position.z || a[i].Width != b[i].Width ||
+				a[i].Height != b[i].Height || a[i].Variant != b[i].Variant)
+				return false;
+		}
+		return true;
+	}
+}
+
+TEST_CASE(VegetationScatter_SeedDeterminesInstances)
+{
+	Patches patches;
+	patches.Add(0.0f, 10.0f, 0.0f, 64.0f, 16, 0.0f);
+	ScatterSettings settings;
+
+	// The same seed gives the same instances, from a fresh scatter or a reused one.
+	VegetationScatter scatter, other;
+	std::vector<VegetationInstance> first, again, fresh, reseeded;
+	scatter.Scatter(patches.Surface(), settings, 7, first);
+	scatter.Scatter(patches.Surface(), settings, 7, again);
+	other.Scatter(patches.Surface(), settings, 7, fresh);
+	CHECK(first.size() > 10);
+	CHECK(Same(first, again));
+	CHECK(Same(first, fresh));
+
+	// Another seed does not.
+	scatter.Scatter(patches.Surface(), settings, 8, reseeded);
+	CHECK(!reseeded.empty());
+	CHECK(!Same(first, reseeded));
+
+	// Neither do neighbouring chunks or worlds seed alike.
+	CHECK(VegetationScatter::ChunkSeed(1, 0, 0, 0) != VegetationScatter::ChunkSeed(1, 1, 0, 0));
+	CHECK(VegetationScatter::ChunkSeed(1, 0, 0, 0) != VegetationScatter::ChunkSeed(2, 0, 0, 0));
+}
+
+TEST_CASE(VegetationScatter_KeepsSpacingWithinChunk)
+{
+	Patches patches;
+	patches.Add(0.0f, 10.0f, 0.0f, 64.0f, 16, 0.0f);
+	ScatterSettings settings;
+	settings.Density = 0.5f;
+
+	// Dense enough that most candidates are rejected: what is left is a Poisson-disk set.
+	VegetationScatter scatter;
+	std::vector<VegetationInstance> out;
+	scatter.Scatter(patches.Surface(), settings, 3, out);
+	CHECK(out.size() > 50);
+	CHECK(out.size() < size_t(64.0f*64.0f*settings.Density));
+
+	float closest = 1e30f;
+	bool inside = true, sized = true;
+	for(size_t i = 0; i < out.size(); ++i)
+	{
+		for(size_t j = i + 1; j < out.size(); ++j)
+			closest = (std::min)(closest, Length(out[i].Position - out[j].Position));
+
+		const Vec3& p = out[i].Position;
+		inside = inside && p.x >= 0.0f && p.x <= 64.0f && p.z >= 0.0f && p.z <= 64.0f &&
+			std::fabs(p.y - 10.0f) < 1e-4f;
+		sized = sized && out[i].Height >= settings.MinSize && out[i].Height <= settings.MaxSize &&
+			out[i].Width == out[i].Height*settings.Aspect && out[i].Variant < settings.VariantCount;
+	}
+	CHECK(closest >= settings.Spacing);
+	CHECK(inside);
+	CHECK(sized);
+}
+
+TEST_CASE(VegetationScatter_RejectsSlopeAndHeight)
+{
+	// Three 32x32 patches in one chunk: flat at y = 10, flat at y = 100 and steep.
+	Patches patches;
+	patches.Add(0.0f, 10.0f, 0.0f, 32.0f, 8, 0.0f);
+	patches.Add(40.0f, 100.0f, 0.0f, 32.0f, 8, 0.0f);
+	patches.Add(80.0f, 10.0f, 0.0f, 32.0f, 8, 2.0f);
+
+	ScatterSettings settings;
+	settings.Spacing = 0.0f;
+	settings.MaxHeight = 50.0f;
+
+	// With no spacing every candidate stays, and all of them land on the one flat, low
+	// patch: the expected count rounded either way.
+	VegetationScatter scatter;
+	std::vector<VegetationInstance> out;
+	scatter.Scatter(patches.Surface(), settings, 5, out);
+	const float expected = 32.0f*32.0f*settings.Density;
+	CHECK(out.size() == size_t(expected) || out.size() == size_t(expected) + 1);
+	bool onFlat = true;
+	for(size_t i = 0; i < out.size(); ++i)
+		onFlat = onFlat && out[i].Position.x <= 32.0f && std::fabs(out[i].Position.y - 10.0f) < 1e-4f;
+	CHECK(onFlat);
+
+	// Half way into the height fade, the high patch counts for half its area.
+	settings.MaxHeight = 90.0f;
+	settings.HeightFade = 20.0f;
+	scatter.Scatter(patches.Surface(), settings, 5, out);
+	const float faded = 1.5f*expected;
+	CHECK(out.size() >= size_t(faded) - 1 && out.size() <= size_t(faded) + 1);
+
+	// Nothing but the steep patch, nothing at all.
+	Patches steep;
+	steep.Add(0.0f, 10.0f, 0.0f, 32.0f, 8, 2.0f);
+	scatter.Scatter(steep.Surface(), settings, 5, out);
+	CHECK(out.empty());
+}
+
+TEST_CASE(VegetationScatter_ChunksMatchSerialScatter)
+{
+	// A 4x4 grid of chunks, each a patch of its own, scattered together and one by one.
+	const int side = 4;
+	std::vector<Patches> patches(side*side);
+	std::vector<ScatterSurface> surfaces;
+	std::vector<uint32_t> seeds;
+	for(int z = 0; z < side; ++z)
+	{
+		for(int x = 0; x < side; ++x)
+		{
+			Patches& p = patches[z*side + x];
+			p.Add(32.0f*x, 5.0f*(x + z), 32.0f*z, 32.0f, 8, 0.25f*(x - z));
+			seeds.push_back(VegetationScatter::ChunkSeed(42, x, 0, z));
+		}
+	}
+	for(size_t i = 0; i < patches.size(); ++i)
+		surfaces.push_back(patches[i].Surface());
+
+	ScatterSettings settings;
+	std::vector<std::vector<VegetationInstance> > chunks(surfaces.size());
+	VegetationScatter::ScatterChunks(surfaces.data(), seeds.data(), surfaces.size(), settings, chunks.data());
+
+	VegetationScatter scatter;
+	size_t matched = 0, total = 0;
+	for(size_t i = 0; i < surfaces.size(); ++i)
+	{
+		std::vector<VegetationInstance> serial;
+		scatter.Scatter(surfaces[i], settings, seeds[i], serial);
+		matched += Same(chunks[i], serial) ? 1 : 0;
+		total += serial.size();
+	}
+	CHECK_EQUAL(matched, surfaces.size());
+	CHECK(total > 0);
+}
@@ -0,0 +1,222 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "Test.h"
+#include "TerrainWorld.h"
+#include "VertexCompression.h"
+
+namespace
+{
+	Vec3 RandomUnit(std::minstd_rand& rng)
+	{
+		std::uniform_real_distribution<float> u(-1.0f, 1.0f);
+		for(;;)
+		{
+			Vec3 v(u(rng), u(rng), u(rng));
+			float l = Length(v);
+			if(l > 0.01f && l <= 1.0f)
+				return v * (1.0f / l);
+		}
+	}
+}
+
+TEST_CASE(VertexCompression_HalfRoundTrip)
+{
+	// Normal halves keep 11 significant bits: relative error at most 2^-11.
+	std::minstd_rand rng(3);
+	std::uniform_real_distribution<float> u(-1000.0f, 1000.0f);
+	double worst = 0.0;
+	for(int i = 0; i < 10000; ++i)
+	{
+		float f = u(rng);
+		float g = VertexCompression::HalfToFloat(VertexCompression::FloatToHalf(f));
+		if(std::fabs(f) > 1e-3f)
+			worst = std::max(worst, std::fabs((double)g - f) / std::fabs(f));
+	}
+	CHECK(worst <= 1.0 / 2048.0);
+
+	// Exact for small integers and the texture range ends.
+	const float exact[] = { 0.0f, 0.5f, 1.0f, -1.0f, 2048.0f, 0.25f };
+	for(size_t i = 0; i < sizeof(exact) / sizeof(exact[0]); ++i)
+		CHECK_EQUAL(VertexCompression::HalfToFloat(VertexCompression::FloatToHalf(exact[i])), exact[i]);
+}
+
+TEST_CASE(VertexCompression_OctNormalRoundTrip)
+{
+	// SNORM16 octahedral normals stay within a few thousandths of a degree: a chord of
+	// 1e-4 is 0.006 degrees.
+	std::minstd_rand rng(5);
+	double worst = 0.0;
+	for(int i = 0; i < 10000; ++i)
+	{
+		Vec3 n = RandomUnit(rng);
+		int16_t e[2];
+		float d[3];
+		VertexCompression::OctEncode(&n.x, e);
+		VertexCompression::OctDecode(e, d);
+		CHECK_NEAR(Length(Vec3(d[0], d[1], d[2])), 1.0f, 1e-5f);
+		double dx = (double)d[0] - n.x, dy = (double)d[1] - n.y, dz = (double)d[2] - n.z;
+		worst = std::max(worst, std::sqrt(dx*dx + dy*dy + dz*dz));
+	}
+	CHECK(worst <= 1e-4);
+
+	// The axes, including both poles, survive exactly.
+	const float axes[6][3] = { {1,0,0}, {-1,0,0}, {0,1,0}, {0,-1,0}, {0,0,1}, {0,0,-1} };
+	for(int a = 0; a < 6; ++a)
+	{
+		int16_t e[2];
+		float d[3];
+		VertexCompression::OctEncode(axes[a], e);
+		VertexCompression::OctDecode(e, d);
+		for(int c = 0; c < 3; ++c)
+			CHECK_NEAR(d[c], axes[a][c], 1e-6f);
+	}
+}
+
+TEST_CASE(VertexCompression_PositionRoundTrip)
+{
+	const float origin[3] = { -80.0f, 0.0f, -80.0f };
+	const float extent[3] = { 160.0f, 40.0f, 160.0f };
+	std::minstd_rand rng(7);
+	std::uniform_real_distribution<float> u(0.0f, 1.0f);
+	for(int i = 0; i < 10000; ++i)
+	{
+		float p[3], q[3];
+		uint16_t e[3];
+		for(int c = 0; c < 3; ++c)
+			p[c] = origin[c] + u(rng)*extent[c];
+		VertexCompression::QuantizePosition(p, origin, extent, e);
+		VertexCompression::DequantizePosition(e, origin, extent, q);
+		for(int c = 0; c < 3; ++c)
+			CHECK_NEAR(q[c], p[c], VertexCompression::PositionError(extent[c]) + 1e-5f);
+	}
+
+	// Outside the box clamps to its faces.
+	float outside[3] = { -100.0f, 50.0f, 0.0f }, q[3];
+	uint16_t e[3];
+	VertexCompression::QuantizePosition(outside, origin, extent, e);
+	VertexCompression::DequantizePosition(e, origin, extent, q);
+	CHECK_EQUAL(e[0], 0);
+	CHECK_EQUAL(e[1], 65535);
+	CHECK_NEAR(q[0], -80.0f, 1e-4f);
+	CHECK_NEAR(q[1], 40.0f, 1e-4f);
+}
+
+TEST_CASE(VertexCompression_BatchMatchesScalar)
+{
+	// Strided batches (SIMD where available) produce the scalar routines' bits, tail
+	// included.
+	struct Source { float Position[3]; float Normal[3]; float TexC[2]; };
+	struct Packed { uint16_t Position[4]; int16_t Normal[2]; uint16_t TexC[2]; };
+
+	const size_t count = 103;
+	std::minstd_rand rng(11);
+	std::uniform_real_distribution<float> u(-3.0f, 3.0f);
+	std::vector<Source> src(count);
+	for(size_t i = 0; i < count; ++i)
+	{
+		Vec3 n = RandomUnit(rng);
+		for(int c = 0; c < 3; ++c)
+			src[i].Position[c] = u(rng), src[i].Normal[c] = (&n.x)[c];
+		src[i].TexC[0] = u(rng);
+		src[i].TexC[1] = u(rng);
+	}
+
+	const float origin[3] = { -3.0f, -3.0f, -3.0f };
+	const float extent[3] = { 6.0f, 6.0f, 6.0f };
+	std::vector<Packed> packed(count);
+	std::memset(packed.data(), 0, count*sizeof(Packed));
+	VertexCompression::QuantizePositions(src[0].Position, sizeof(Source), count, origin, extent, packed[0].Position, sizeof(Packed));
+	VertexCompression::EncodeOctNormals(src[0].Normal, sizeof(Source), count, packed[0].Normal, sizeof(Packed));
+	VertexCompression::EncodeHalf2(src[0].TexC, sizeof(Source), count, packed[0].TexC, sizeof(Packed));
+
+	size_t mismatches = 0;
+	for(size_t i = 0; i < count; ++i)
+	{
+		uint16_t p[3];
+		int16_t n[2];
+		VertexCompression::QuantizePosition(src[i].Position, origin, extent, p);
+		VertexCompression::OctEncode(src[i].Normal, n);
+		mismatches += p[0] != packed[i].Position[0] || p[1] != packed[i].Position[1] || p[2] != packed[i].Position[2];
+		mismatches += n[0] != packed[i].Normal[0] || n[1] != packed[i].Normal[1];
+		mismatches += VertexCompression::FloatToHalf(src[i].TexC[0]) != packed[i].TexC[0];
+		mismatches += VertexCompression::FloatToHalf(src[i].TexC[1]) != packed[i].TexC[1];
+	}
+	CHECK_EQUAL(mismatches, size_t(0));
+
+	// And the batch decoders invert them within the scalar bounds.
+	std::vector<Source> decoded(count);
+	VertexCompression::DequantizePositions(packed[0].Position, sizeof(Packed), count, origin, extent, decoded[0].Position, sizeof(Source));
+	VertexCompression::DecodeOctNormals(packed[0].Normal, sizeof(Packed), count, decoded[0].Normal, sizeof(Source));
+	VertexCompression::DecodeHalf2(packed[0].TexC, sizeof(Packed), count, decoded[0].TexC, sizeof(Source));
+	for(size_t i = 0; i < count; ++i)
+	{
+		for(int c = 0; c < 3; ++c)
+		{
+			CHECK_NEAR(decoded[i].Position[c], src[i].Position[c], VertexCompression::PositionError(extent[c]) + 1e-6f);
+			CHECK_NEAR(decoded[i].Normal[c], src[i].Normal[c], 1e-3f);
+		}
+		CHECK_NEAR(decoded[i].TexC[0], src[i].TexC[0], std::fabs(src[i].TexC[0]) / 2048.0f);
+		CHECK_NEAR(decoded[i].TexC[1], src[i].TexC[1], std::fabs(src[i].TexC[1]) / 2048.0f);
+	}
+}
+
+TEST_CASE(TerrainWorld_CompactVerticesRoundTrip)
+{
+	TerrainWorld::Settings settings;
+	settings.Corners = 17;
+	settings.WaveRows = 20;
+	settings.WaveColumns = 20;
+	TerrainWorld world(settings);
+	world.Build();
+	world.Update(0.5f);
+
+	// The grid comes back within half a quantization step of its chunk's box from where
+	// the world built it.  Every vertex belongs to one chunk, whose box holds it.
+	std::vector<TerrainGridCompactVertex> grid;
+	world.PackGridVertices(grid);
+	const std::vector<TerrainGridVertex>& source = world.GridVertices();
+	CHECK_EQUAL(grid.size(), source.size());
+
+	const std::vector<TerrainWorld::Chunk>& chunks = world.Chunks();
+	const Vec3 gridExtent = world.GridBounds().Size();
+	size_t covered = 0;
+	for(size_t c = 0; c < chunks.size(); ++c)
+	{
+		const TerrainWorld::Chunk& chunk = chunks[c];
+		CHECK_EQUAL(chunk.BaseVertex, uint32_t(covered));
+		CHECK(chunk.Extent.x < gridExtent.x && chunk.Extent.z < gridExtent.z);
+		covered += chunk.VertexCount;
+		for(size_t i = chunk.BaseVertex; i < covered && i < grid.size(); ++i)
+		{
+			float p[3];
+			VertexCompression::DequantizePosition(grid[i].Position, &chunk.Origin.x, &chunk.Extent.x, p);
+			CHECK_NEAR(p[0], source[i].Position.x, VertexCompression::PositionError(chunk.Extent.x) + 1e-5f);
+			CHECK_NEAR(p[1], source[i].Position.y, VertexCompression::PositionError(chunk.Extent.y) + 1e-5f);
+			CHECK_NEAR(p[2], source[i].Position.z, VertexCompression::PositionError(chunk.Extent.z) + 1e-5f);
+		}
+		for(size_t i = chunk.StartIndex; i < chunk.StartIndex + chunk.IndexCount; ++i)
+			CHECK(world.GridIndices()[i] - chunk.BaseVertex < chunk.VertexCount);
+	}
+	CHECK_EQUAL(covered, grid.size());
+
+	// The waves keep their positions exactly, and their normals and uvs within the
+	// format bounds.
+	const Waves& waves = world.GetWaves();
+	std::vector<WaveCompactVertex> wave(waves.VertexCount());
+	world.PackWaveVertices(wave.data());
+	for(size_t i = 0; i < wave.size(); ++i)
+	{
+		CHECK(wave[i].Position.x == waves[(int)i].x && wave[i].Position.y == waves[(int)i].y && wave[i].Position.z == waves[(int)i].z);
+
+		float n[3];
+		VertexCompression::OctDecode(wave[i].Normal, n);
+		CHECK(Dot(Vec3(n[0], n[1], n[2]), waves.Normal((int)i)) >= 0.99999f);
+
+		float u = 0.5f + waves[(int)i].x / waves.Width();
+		CHECK_NEAR(VertexCompression::HalfToFloat(wave[i].TexC[0]), u, 1.0f / 2048.0f);
+	}
+}
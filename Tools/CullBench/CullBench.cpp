@@ -0,0 +1,267 @@
+//***************************************************************************************
+// CullBench.cpp
+//
+// Headless benchmark for FrustumCulling and ChunkOctree.  Usage:
+//
+//   CullBench [-boxes N] [-grid N] [-iterations N]
+//
+// Scatters N boxes (default 100000) through a cube around the camera, then culls them
+// against frusta looking in eight directions with CullScalar and Cull (the SIMD path
+// this build was compiled for).  It reports millions of boxes per second for each.
+//
+// It then lays out an N x N x N/4 grid of terrain-sized chunks (default N = 64, 65536
+// chunks) and compares the flat SIMD sweep with a ChunkOctree over the same chunks,
+// including the cost of streaming a tenth of them out and back in.
+//
+// The exit code is non-zero if any two paths disagree on which boxes are visible.
+//***************************************************************************************
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "ChunkOctree.h"
+#include "FrustumCulling.h"
+
+static Vec4 Plane(float a, float b, float c, float d)
+{
+	float len = std::sqrt(a*a + b*b + c*c);
+	return Vec4(a / len, b / len, c / len, d / len);
+}
+
+// Frustum of a camera at the origin looking along (sin yaw, 0, cos yaw).
+static Frustum MakeFrustum(float yaw, float fovY, float aspect, float zn, float zf)
+{
+	float ty = std::tan(0.5f*fovY);
+	float tx = ty*aspect;
+	Vec3 f(std::sin(yaw), 0.0f, std::cos(yaw));
+	Vec3 r(f.z, 0.0f, -f.x);
+	Vec3 u(0.0f, 1.0f, 0.0f);
+
+	// Side planes contain the origin; their normals point into the frustum.
+	Vec3 left   = f*tx + r;
+	Vec3 right  = f*tx - r;
+	Vec3 bottom = f*ty + u;
+	Vec3 top    = f*ty - u;
+
+	Frustum frustum;
+	frustum.Planes[0] = Plane(left.x, left.y, left.z, 0.0f);
+	frustum.Planes[1] = Plane(right.x, right.y, right.z, 0.0f);
+	frustum.Planes[2] = Plane(bottom.x, bottom.y, bottom.z, 0.0f);
+	frustum.Planes[3] = Plane(top.x, top.y, top.z, 0.0f);
+	frustum.Planes[4] = Plane(f.x, f.y, f.z, -zn);
+	frustum.Planes[5] = Plane(-f.x, -f.y, -f.z, zf);
+	return frustum;
+}
+
+static const char* SimdName()
+{
+#if defined(__AVX__)
+	return "AVX";
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	return "SSE2";
+#else
+	return "scalar";
+#endif
+}
+
+// Chunks of 16 units on a grid centered on the camera, as the terrain streamer would
+// hold them.  Returns the number of frusta for which the octree and the flat sweep
+// disagree.
+static int BenchChunkGrid(int gridSize, int iterations, const Frustum* frusta, int frustumCount)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	const float chunkSize = 16.0f;
+	const int sizeY = std::max(1, gridSize / 4);
+	float half = 0.5f*gridSize*chunkSize;
+
+	std::vector<AABB> chunks;
+	for(int y = 0; y < sizeY; ++y)
+		for(int z = 0; z < gridSize; ++z)
+			for(int x = 0; x < gridSize; ++x)
+			{
+				Vec3 mn(x*chunkSize - half, y*chunkSize - 0.5f*sizeY*chunkSize, z*chunkSize - half);
+				chunks.push_back(AABB(mn, mn + Vec3(chunkSize, chunkSize, chunkSize)));
+			}
+
+	CullBoxes flat;
+	flat.Reserve(chunks.size());
+	for(size_t i = 0; i < chunks.size(); ++i)
+		flat.Add(chunks[i]);
+
+	Clock::time_point t0 = Clock::now();
+	// Leaf cells about four chunks across.
+	int depth = 0;
+	while((half / (1 << depth)) > 2.0f*chunkSize)
+		++depth;
+	ChunkOctree octree(Vec3(0.0f, 0.0f, 0.0f), half, depth);
+	std::vector<ChunkOctree::ItemId> ids(chunks.size());
+	for(size_t i = 0; i < chunks.size(); ++i)
+		ids[i] = octree.Insert(chunks[i], (uint32_t)i);
+	Clock::time_point t1 = Clock::now();
+	double buildUs = std::chrono::duration<double, std::micro>(t1 - t0).count();
+
+	std::vector<uint8_t> flatVisible(chunks.size());
+	std::vector<uint32_t> treeVisible;
+	treeVisible.reserve(chunks.size());
+
+	int mismatches = 0;
+	ChunkOctree::CullStats stats;
+	Vec3 eye(0.0f, 0.0f, 0.0f);
+	for(int f = 0; f < frustumCount; ++f)
+	{
+		size_t n = FrustumCulling::Cull(frusta[f], flat, flatVisible.data());
+		treeVisible.clear();
+		octree.Cull(frusta[f], eye, treeVisible, &stats);
+
+		std::vector<uint8_t> fromTree(chunks.size(), 0);
+		for(size_t i = 0; i < treeVisible.size(); ++i)
+			fromTree[treeVisible[i]] = 1;
+		if(n != treeVisible.size() || fromTree != flatVisible)
+			++mismatches;
+	}
+
+	volatile size_t sink = 0;
+	Clock::time_point t2 = Clock::now();
+	for(int it = 0; it < iterations; ++it)
+	{
+		// Both paths produce the list of visible chunks a renderer would walk.
+		FrustumCulling::Cull(frusta[it % frustumCount], flat, flatVisible.data());
+		treeVisible.clear();
+		for(size_t i = 0; i < chunks.size(); ++i)
+		{
+			if(flatVisible[i])
+				treeVisible.push_back((uint32_t)i);
+		}
+		sink += treeVisible.size();
+	}
+	Clock::time_point t3 = Clock::now();
+	for(int it = 0; it < iterations; ++it)
+	{
+		treeVisible.clear();
+		octree.Cull(frusta[it % frustumCount], eye, treeVisible);
+		sink += treeVisible.size();
+	}
+	Clock::time_point t4 = Clock::now();
+
+	// Stream a tenth of the chunks out and back in, as a moving camera would.
+	std::mt19937 rng(99);
+	size_t churn = chunks.size() / 10;
+	Clock::time_point t5 = Clock::now();
+	for(size_t k = 0; k < churn; ++k)
+	{
+		size_t i = rng() % chunks.size();
+		octree.Remove(ids[i]);
+		ids[i] = octree.Insert(chunks[i], (uint32_t)i);
+	}
+	Clock::time_point t6 = Clock::now();
+
+	std::printf("\n%zu chunks, %zu octree nodes, built in %.0f us\n", chunks.size(), octree.NodeCount(), buildUs);
+	std::printf("octree per cull: %.0f nodes visited, %.0f items tested, %.0f accepted untested\n",
+		double(stats.NodesVisited) / frustumCount, double(stats.ItemsTested) / frustumCount,
+		double(stats.ItemsAccepted) / frustumCount);
+	std::printf("%-8s %10s\n", "path", "us/cull");
+	std::printf("%-8s %10.1f\n", "flat", std::chrono::duration<double, std::micro>(t3 - t2).count() / iterations);
+	std::printf("%-8s %10.1f\n", "octree", std::chrono::duration<double, std::micro>(t4 - t3).count() / iterations);
+	std::printf("remove + insert: %.0f ns per chunk\n", std::chrono::duration<double, std::nano>(t6 - t5).count() / churn);
+	return mismatches;
+}
+
+int main(int argc, char* argv[])
+{
+	size_t boxCount = 100000;
+	int gridSize = 64;
+	int iterations = 200;
+
+	for(int i = 1; i < argc; ++i)
+	{
+		if(std::strcmp(argv[i], "-boxes") == 0 && i + 1 < argc)
+			boxCount = (size_t)std::strtoul(argv[++i], 0, 10);
+		else if(std::strcmp(argv[i], "-grid") == 0 && i + 1 < argc)
+			gridSize = std::max(4, std::atoi(argv[++i]));
+		else if(std::strcmp(argv[i], "-iterations") == 0 && i + 1 < argc)
+			iterations = std::max(1, std::atoi(argv[++i]));
+		else
+		{
+			std::fprintf(stderr, "usage: CullBench [-boxes N] [-grid N] [-iterations N]\n");
+			return 2;
+		}
+	}
+
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> pos(-1000.0f, 1000.0f);
+	std::uniform_real_distribution<float> size(0.5f, 20.0f);
+
+	CullBoxes boxes;
+	boxes.Reserve(boxCount);
+	for(size_t i = 0; i < boxCount; ++i)
+	{
+		Vec3 c(pos(rng), pos(rng), pos(rng));
+		Vec3 e(size(rng), size(rng), size(rng));
+		boxes.Add(AABB(c - e, c + e));
+	}
+
+	const int frustumCount = 8;
+	Frustum frusta[frustumCount];
+	for(int f = 0; f < frustumCount; ++f)
+		frusta[f] = MakeFrustum(f*0.785398f, 1.0472f, 16.0f / 9.0f, 1.0f, 1000.0f);
+
+	std::vector<uint8_t> scalarVisible(boxCount), simdVisible(boxCount);
+
+	// Correctness first: both paths and the single-box test must agree.
+	int mismatches = 0;
+	size_t visibleTotal = 0;
+	for(int f = 0; f < frustumCount; ++f)
+	{
+		size_t a = FrustumCulling::CullScalar(frusta[f], boxes, scalarVisible.data());
+		size_t b = FrustumCulling::Cull(frusta[f], boxes, simdVisible.data());
+		visibleTotal += a;
+		if(a != b || std::memcmp(scalarVisible.data(), simdVisible.data(), boxCount) != 0)
+			++mismatches;
+
+		// Spot check the single-box test on a sample.
+		for(size_t i = 0; i < boxCount; i += 97)
+		{
+			Vec3 c(boxes.Center(0)[i], boxes.Center(1)[i], boxes.Center(2)[i]);
+			Vec3 e(boxes.Extent(0)[i], boxes.Extent(1)[i], boxes.Extent(2)[i]);
+			if(FrustumCulling::TestAABB(frusta[f], AABB(c - e, c + e)) != (scalarVisible[i] != 0))
+			{
+				++mismatches;
+				break;
+			}
+		}
+	}
+
+	typedef std::chrono::high_resolution_clock Clock;
+	volatile size_t sink = 0;
+
+	Clock::time_point t0 = Clock::now();
+	for(int it = 0; it < iterations; ++it)
+		sink += FrustumCulling::CullScalar(frusta[it % frustumCount], boxes, scalarVisible.data());
+	Clock::time_point t1 = Clock::now();
+	for(int it = 0; it < iterations; ++it)
+		sink += FrustumCulling::Cull(frusta[it % frustumCount], boxes, simdVisible.data());
+	Clock::time_point t2 = Clock::now();
+
+	double boxesTested = double(boxCount)*iterations;
+	double scalarSec = std::chrono::duration<double>(t1 - t0).count();
+	double simdSec = std::chrono::duration<double>(t2 - t1).count();
+
+	std::printf("%zu boxes, %.1f%% visible on average, %d iterations\n", boxCount,
+		100.0*visibleTotal / (double(boxCount)*frustumCount), iterations);
+	std::printf("%-8s %10s %10s\n", "path", "Mboxes/s", "us/cull");
+	std::printf("%-8s %10.1f %10.1f\n", "scalar", boxesTested / scalarSec * 1e-6, scalarSec / iterations * 1e6);
+	std::printf("%-8s %10.1f %10.1f\n", SimdName(), boxesTested / simdSec * 1e-6, simdSec / iterations * 1e6);
+
+	mismatches += BenchChunkGrid(gridSize, iterations, frusta, frustumCount);
+
+	if(mismatches)
+		std::printf("%d mismatch(es) between culling paths\n", mismatches);
+	return mismatches ? 1 : 0;
+}
@@ -0,0 +1,595 @@
+//***************************************************************************************
+// DDSBench.cpp
+//
+// Headless benchmark and regression check for the DDS parsing core.  Usage:
+//
+//   DDSBench [-iterations N] [-corpus dir] [file.dds | directory ...]
+//
+// Every .dds given (directories are searched for *.dds; the default is Textures) and a
+// set of generated edge cases are run through DDSCore::ParseDDS and FillInitData, the
+// same path CreateDDSTextureFromMemoryEx and TextureStreamer take before the device.
+// Per file it reports:
+//   parse   nanoseconds per ParseDDS + FillInitData over an in-memory copy,
+//   load    MB/s of MappedFile::Open + parse + copying the texels out, which is what a
+//           texture upload costs on the CPU (generated cases load from memory),
+//   allocs  heap allocations per load after the first.
+//
+// The exit code is non-zero if a file fails to parse or a generated case does not
+// give its expected result, so the tool can gate CI.  -corpus writes the generated
+// cases to dir as a seed corpus for DDSFuzz.cpp.
+//***************************************************************************************
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "DDSCore.h"
+#include "MappedFile.h"
+
+//---------------------------------------------------------------------------------------
+// Allocation counting.  Replacing the global operators catches every allocation made
+// by the code under test, including the standard library's.
+//---------------------------------------------------------------------------------------
+
+static std::atomic<size_t> gAllocations(0);
+
+void* operator new(size_t size)
+{
+	++gAllocations;
+	if(void* p = std::malloc(size ? size : 1))
+		return p;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+	std::free(p);
+}
+
+//---------------------------------------------------------------------------------------
+// Generated edge cases.
+//---------------------------------------------------------------------------------------
+
+namespace
+{
+	typedef std::chrono::steady_clock Clock;
+
+	// Flags from DDS.h that DDSCore.h does not need.
+	const uint32_t DDSD_CAPS        = 0x00000001;
+	const uint32_t DDSD_PIXELFORMAT = 0x00001000;
+	const uint32_t DDSD_MIPMAPCOUNT = 0x00020000;
+	const uint32_t DDS_RGBA         = 0x00000041;
+	const uint32_t MiscTextureCube  = 0x4;
+
+	struct Sample
+	{
+		std::string Name;
+		std::vector<uint8_t> Data;
+		DDSCore::Result Expected;
+	};
+
+	struct SampleDesc
+	{
+		SampleDesc()
+			: Width(1), Height(1), Depth(1), MipCount(1), ArraySize(1), Format(DXGI_FORMAT_R8G8B8A8_UNORM),
+			  Dimension(DDSCore::DIMENSION_TEXTURE2D), CubeMap(false), Legacy(false)
+		{
+		}
+
+		uint32_t Width;
+		uint32_t Height;
+		uint32_t Depth;
+		uint32_t MipCount;
+		uint32_t ArraySize;
+		DXGI_FORMAT Format;
+		uint32_t Dimension;
+		bool CubeMap;
+		bool Legacy;    // DX9 header; only R8G8B8A8_UNORM and BC1 are written this way.
+	};
+
+	// Texel bytes a well-formed file with this description carries.
+	size_t PixelBytes(const SampleDesc& desc)
+	{
+		size_t faces = desc.ArraySize * (desc.CubeMap ? 6 : 1);
+		size_t bytes = 0;
+		for(size_t face = 0; face < faces; ++face)
+		{
+			size_t w = desc.Width, h = desc.Height, d = desc.Depth;
+			for(uint32_t mip = 0; mip < desc.MipCount; ++mip)
+			{
+				size_t numBytes, rowBytes, numRows;
+				DDSCore::GetSurfaceInfo(w, h, desc.Format, &numBytes, &rowBytes, &numRows);
+				bytes += numBytes * d;
+
+				w = w > 1 ? w / 2 : 1;
+				h = h > 1 ? h / 2 : 1;
+				d = d > 1 ? d / 2 : 1;
+			}
+		}
+		return bytes;
+	}
+
+	std::vector<uint8_t> MakeDDS(const SampleDesc& desc, size_t pixelBytes)
+	{
+		DDS_HEADER header;
+		std::memset(&header, 0, sizeof(header));
+		header.size = sizeof(DDS_HEADER);
+		header.flags = DDSD_CAPS | DDS_HEIGHT | DDS_WIDTH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT;
+		header.width = desc.Width;
+		header.height = desc.Height;
+		header.depth = desc.Depth;
+		header.mipMapCount = desc.MipCount;
+		header.ddspf.size = sizeof(DDS_PIXELFORMAT);
+		if(desc.Dimension == DDSCore::DIMENSION_TEXTURE3D)
+			header.flags |= DDS_HEADER_FLAGS_VOLUME;
+
+		DDS_HEADER_DXT10 ext;
+		std::memset(&ext, 0, sizeof(ext));
+
+		if(desc.Legacy)
+		{
+			if(desc.Format == DXGI_FORMAT_BC1_UNORM)
+			{
+				header.ddspf.flags = DDS_FOURCC;
+				header.ddspf.fourCC = MAKEFOURCC('D', 'X', 'T', '1');
+			}
+			else
+			{
+				header.ddspf.flags = DDS_RGBA;
+				header.ddspf.RGBBitCount = 32;
+				header.ddspf.RBitMask = 0x000000ff;
+				header.ddspf.GBitMask = 0x0000ff00;
+				header.ddspf.BBitMask = 0x00ff0000;
+				header.ddspf.ABitMask = 0xff000000;
+			}
+			if(desc.CubeMap)
+				header.caps2 = DDS_CUBEMAP_ALLFACES;
+		}
+		else
+		{
+			header.ddspf.flags = DDS_FOURCC;
+			header.ddspf.fourCC = MAKEFOURCC('D', 'X', '1', '0');
+			ext.dxgiFormat = desc.Format;
+			ext.resourceDimension = desc.Dimension;
+			ext.miscFlag = desc.CubeMap ? MiscTextureCube : 0;
+			ext.arraySize = desc.ArraySize;
+		}
+
+		std::vector<uint8_t> data(sizeof(uint32_t) + sizeof(header) + (desc.Legacy ? 0 : sizeof(ext)) + pixelBytes);
+		uint8_t* p = data.data();
+		std::memcpy(p, &DDS_MAGIC, sizeof(uint32_t));
+		p += sizeof(uint32_t);
+		std::memcpy(p, &header, sizeof(header));
+		p += sizeof(header);
+		if(!desc.Legacy)
+		{
+			std::memcpy(p, &ext, sizeof(ext));
+			p += sizeof(ext);
+		}
+
+		for(size_t i = 0; i < pixelBytes; ++i)
+			p[i] = uint8_t(i * 31 + 7);
+
+		return data;
+	}
+
+	void AddSample(std::vector<Sample>& samples, const char* name, const SampleDesc& desc,
+		DDSCore::Result expected, long pixelByteAdjust = 0)
+	{
+		Sample sample;
+		sample.Name = name;
+		sample.Data = MakeDDS(desc, size_t(long(PixelBytes(desc)) + pixelByteAdjust));
+		sample.Expected = expected;
+		samples.push_back(sample);
+	}
+
+	std::vector<Sample> GenerateSamples()
+	{
+		std::vector<Sample> samples;
+
+		SampleDesc rgba1x1;
+		rgba1x1.Legacy = true;
+		AddSample(samples, "gen-rgba8-1x1", rgba1x1, DDSCore::DDS_OK);
+
+		SampleDesc bc1;
+		bc1.Width = 13;
+		bc1.Height = 7;
+		bc1.MipCount = 4;
+		bc1.Format = DXGI_FORMAT_BC1_UNORM;
+		AddSample(samples, "gen-bc1-13x7-mips", bc1, DDSCore::DDS_OK);
+		AddSample(samples, "gen-bc1-truncated", bc1, DDSCore::DDS_E_EOF, -1);
+
+		SampleDesc bc1Legacy = bc1;
+		bc1Legacy.Legacy = true;
+		AddSample(samples, "gen-bc1-legacy", bc1Legacy, DDSCore::DDS_OK);
+
+		SampleDesc array;
+		array.Width = 64;
+		array.Height = 64;
+		array.MipCount = 7;
+		array.ArraySize = 4;
+		array.Format = DXGI_FORMAT_BC3_UNORM;
+		AddSample(samples, "gen-bc3-array4", array, DDSCore::DDS_OK);
+
+		SampleDesc cube;
+		cube.Width = 16;
+		cube.Height = 16;
+		cube.MipCount = 5;
+		cube.CubeMap = true;
+		cube.Legacy = true;
+		AddSample(samples, "gen-cube-rgba8", cube, DDSCore::DDS_OK);
+
+		SampleDesc cubeArray = cube;
+		cubeArray.Legacy = false;
+		cubeArray.ArraySize = 2;
+		AddSample(samples, "gen-cube-array2", cubeArray, DDSCore::DDS_OK);
+
+		SampleDesc volume;
+		volume.Width = 8;
+		volume.Height = 8;
+		volume.Depth = 8;
+		volume.MipCount = 4;
+		volume.Format = DXGI_FORMAT_R8_UNORM;
+		volume.Dimension = DDSCore::DIMENSION_TEXTURE3D;
+		AddSample(samples, "gen-volume-r8", volume, DDSCore::DDS_OK);
+
+		SampleDesc volumeArray = volume;
+		volumeArray.ArraySize = 2;
+		AddSample(samples, "gen-volume-array", volumeArray, DDSCore::DDS_E_NOT_SUPPORTED);
+
+		SampleDesc line;
+		line.Width = 256;
+		line.MipCount = 9;
+		line.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+		line.Dimension = DDSCore::DIMENSION_TEXTURE1D;
+		AddSample(samples, "gen-1d-rgba32f", line, DDSCore::DDS_OK);
+
+		SampleDesc headerOnly;
+		headerOnly.Width = 64;
+		headerOnly.Height = 64;
+		headerOnly.Legacy = true;
+		AddSample(samples, "gen-header-only", headerOnly, DDSCore::DDS_E_EOF, -long(PixelBytes(headerOnly)));
+
+		SampleDesc tooLarge;
+		tooLarge.Width = 32768;
+		tooLarge.Format = DXGI_FORMAT_R8_UNORM;
+		AddSample(samples, "gen-too-large", tooLarge, DDSCore::DDS_E_NOT_SUPPORTED);
+
+		SampleDesc tooManyMips;
+		tooManyMips.Width = 16;
+		tooManyMips.Height = 16;
+		tooManyMips.MipCount = 16;
+		AddSample(samples, "gen-too-many-mips", tooManyMips, DDSCore::DDS_E_NOT_SUPPORTED, -long(PixelBytes(tooManyMips)));
+
+		SampleDesc emptyArray;
+		emptyArray.ArraySize = 0;
+		AddSample(samples, "gen-array-size-0", emptyArray, DDSCore::DDS_E_INVALID_DATA);
+
+		SampleDesc palette;
+		palette.Format = DXGI_FORMAT_P8;
+		AddSample(samples, "gen-palette", palette, DDSCore::DDS_E_NOT_SUPPORTED, 1);
+
+		Sample badMagic = samples[0];
+		badMagic.Name = "gen-bad-magic";
+		badMagic.Data[0] = 'X';
+		badMagic.Expected = DDSCore::DDS_E_FAIL;
+		samples.push_back(badMagic);
+
+		Sample badSize = samples[0];
+		badSize.Name = "gen-bad-header-size";
+		badSize.Data[4] = 123;
+		badSize.Expected = DDSCore::DDS_E_FAIL;
+		samples.push_back(badSize);
+
+		Sample shortFile = samples[0];
+		shortFile.Name = "gen-short";
+		shortFile.Data.resize(64);
+		shortFile.Expected = DDSCore::DDS_E_FAIL;
+		samples.push_back(shortFile);
+
+		return samples;
+	}
+
+	//-----------------------------------------------------------------------------------
+	// Measurement.
+	//-----------------------------------------------------------------------------------
+
+	// Runs the parser and layout.  layout is reused so steady-state loads do not allocate.
+	DDSCore::Result ParseAndLayout(const uint8_t* data, size_t size, DDSCore::TextureDesc& desc,
+		std::vector<DDSCore::Subresource>& layout)
+	{
+		DDSCore::Result result = DDSCore::ParseDDS(data, size, desc);
+		if(result != DDSCore::DDS_OK)
+			return result;
+
+		layout.resize(desc.mipCount * desc.arraySize);
+
+		size_t twidth, theight, tdepth, skipMip = 0;
+		return DDSCore::FillInitData(desc.width, desc.height, desc.depth, desc.mipCount, desc.arraySize,
+			desc.format, 0, desc.bitSize, desc.bitData, twidth, theight, tdepth, skipMip, layout.data());
+	}
+
+	// Copies the texels the way the driver would on upload.  staging is reused.
+	size_t CopyTexels(const DDSCore::TextureDesc& desc, const std::vector<DDSCore::Subresource>& layout,
+		std::vector<uint8_t>& staging)
+	{
+		staging.resize(desc.bitSize);
+
+		size_t offset = 0;
+		for(size_t slice = 0; slice < desc.arraySize; ++slice)
+		{
+			size_t d = desc.depth;
+			for(size_t mip = 0; mip < desc.mipCount; ++mip)
+			{
+				const DDSCore::Subresource& sub = layout[slice*desc.mipCount + mip];
+				size_t bytes = size_t(sub.SysMemSlicePitch) * d;
+				std::memcpy(staging.data() + offset, sub.pSysMem, bytes);
+				offset += bytes;
+				d = d > 1 ? d / 2 : 1;
+			}
+		}
+		return offset;
+	}
+
+	double Seconds(Clock::time_point start)
+	{
+		return std::chrono::duration<double>(Clock::now() - start).count();
+	}
+
+	const char* ResultName(DDSCore::Result result)
+	{
+		switch(result)
+		{
+		case DDSCore::DDS_OK:              return "ok";
+		case DDSCore::DDS_E_FAIL:          return "fail";
+		case DDSCore::DDS_E_POINTER:       return "pointer";
+		case DDSCore::DDS_E_INVALID_DATA:  return "invalid";
+		case DDSCore::DDS_E_NOT_SUPPORTED: return "unsupported";
+		case DDSCore::DDS_E_EOF:           return "eof";
+		}
+		return "?";
+	}
+
+	const char* DimensionName(const DDSCore::TextureDesc& desc)
+	{
+		switch(desc.resourceDimension)
+		{
+		case DDSCore::DIMENSION_TEXTURE1D: return "1D";
+		case DDSCore::DIMENSION_TEXTURE2D: return desc.isCubeMap ? "Cube" : "2D";
+		case DDSCore::DIMENSION_TEXTURE3D: return "3D";
+		}
+		return "?";
+	}
+
+	void PrintHeader()
+	{
+		std::printf("%-24s %-4s %-14s %4s %5s %-11s %9s %10s %7s\n",
+			"file", "dim", "size", "mips", "array", "result", "parse ns", "load MB/s", "allocs");
+	}
+
+	void PrintRow(const std::string& name, const DDSCore::TextureDesc& desc, DDSCore::Result result,
+		double parseNs, double loadMBs, double allocs)
+	{
+		char size[32] = "-";
+		if(result == DDSCore::DDS_OK)
+			std::snprintf(size, sizeof(size), "%zux%zux%zu", desc.width, desc.height, desc.depth);
+
+		if(result == DDSCore::DDS_OK)
+		{
+			std::printf("%-24s %-4s %-14s %4zu %5zu %-11s %9.1f %10.1f %7.2f\n", name.c_str(), DimensionName(desc),
+				size, desc.mipCount, desc.arraySize, ResultName(result), parseNs, loadMBs, allocs);
+		}
+		else
+		{
+			std::printf("%-24s %-4s %-14s %4s %5s %-11s %9.1f %10s %7s\n", name.c_str(), "-", size, "-", "-",
+				ResultName(result), parseNs, "-", "-");
+		}
+	}
+
+	// Times the in-memory parse of data.  Returns the result and nanoseconds per parse.
+	DDSCore::Result BenchParse(const std::vector<uint8_t>& data, int iterations, DDSCore::TextureDesc& desc,
+		std::vector<DDSCore::Subresource>& layout, double& nsPerParse)
+	{
+		DDSCore::Result result = ParseAndLayout(data.data(), data.size(), desc, layout);
+
+		Clock::time_point start = Clock::now();
+		for(int i = 0; i < iterations; ++i)
+			ParseAndLayout(data.data(), data.size(), desc, layout);
+		nsPerParse = Seconds(start) * 1e9 / iterations;
+
+		return result;
+	}
+
+	// Times load(), which parses and copies one texture and returns the texel bytes
+	// copied.  Returns MB/s; allocs receives heap allocations per call.
+	template<typename LoadFn>
+	double BenchLoad(int iterations, LoadFn load, double& allocs)
+	{
+		// Warm up once so allocations count the steady state.
+		load();
+
+		size_t bytes = 0;
+		size_t allocationsBefore = gAllocations;
+		Clock::time_point start = Clock::now();
+		for(int i = 0; i < iterations; ++i)
+			bytes += load();
+		double seconds = Seconds(start);
+
+		allocs = double(gAllocations - allocationsBefore) / iterations;
+		return seconds > 0.0 ? double(bytes) / (seconds * 1048576.0) : 0.0;
+	}
+
+	std::vector<std::string> CollectFiles(const std::vector<std::string>& args)
+	{
+		namespace fs = std::filesystem;
+
+		std::vector<std::string> files;
+		for(size_t i = 0; i < args.size(); ++i)
+		{
+			std::error_code ec;
+			if(fs::is_directory(args[i], ec))
+			{
+				std::vector<std::string> found;
+				for(fs::directory_iterator it(args[i], ec), end; !ec && it != end; it.increment(ec))
+				{
+					std::string ext = it->path().extension().string();
+					if(ext == ".dds" || ext == ".DDS")
+						found.push_back(it->path().string());
+				}
+				std::sort(found.begin(), found.end());
+				files.insert(files.end(), found.begin(), found.end());
+			}
+			else
+			{
+				files.push_back(args[i]);
+			}
+		}
+		return files;
+	}
+
+	std::string FileName(const std::string& path)
+	{
+		size_t slash = path.find_last_of("/\\");
+		return slash == std::string::npos ? path : path.substr(slash + 1);
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	int iterations = 200;
+	std::string corpusDir;
+	std::vector<std::string> inputs;
+
+	for(int i = 1; i < argc; ++i)
+	{
+		if(std::strcmp(argv[i], "-iterations") == 0 && i + 1 < argc)
+			iterations = std::max(1, std::atoi(argv[++i]));
+		else if(std::strcmp(argv[i], "-corpus") == 0 && i + 1 < argc)
+			corpusDir = argv[++i];
+		else if(argv[i][0] == '-')
+		{
+			std::fprintf(stderr, "usage: DDSBench [-iterations N] [-corpus dir] [file.dds | directory ...]\n");
+			return 2;
+		}
+		else
+			inputs.push_back(argv[i]);
+	}
+
+	if(inputs.empty())
+		inputs.push_back("Textures");
+
+	std::vector<std::string> files = CollectFiles(inputs);
+	std::vector<Sample> samples = GenerateSamples();
+
+	if(!corpusDir.empty())
+	{
+		std::error_code ec;
+		std::filesystem::create_directories(corpusDir, ec);
+		for(size_t i = 0; i < samples.size(); ++i)
+		{
+			std::string path = corpusDir + "/" + samples[i].Name + ".dds";
+			if(FILE* f = std::fopen(path.c_str(), "wb"))
+			{
+				std::fwrite(samples[i].Data.data(), 1, samples[i].Data.size(), f);
+				std::fclose(f);
+			}
+			else
+			{
+				std::fprintf(stderr, "%s: cannot write\n", path.c_str());
+				return 1;
+			}
+		}
+	}
+
+	int failures = 0;
+
+	DDSCore::TextureDesc desc;
+	std::vector<DDSCore::Subresource> layout;
+	std::vector<uint8_t> staging;
+	std::vector<uint8_t> contents;
+
+	PrintHeader();
+
+	for(size_t f = 0; f < files.size(); ++f)
+	{
+		const std::string& path = files[f];
+		std::string name = FileName(path);
+
+		MappedFile file;
+		if(!file.Open(path.c_str()))
+		{
+			std::printf("%-24s cannot open\n", name.c_str());
+			++failures;
+			continue;
+		}
+
+		contents.assign(file.Data(), file.Data() + file.Size());
+		file.Close();
+
+		double parseNs = 0.0;
+		DDSCore::Result result = BenchParse(contents, iterations, desc, layout, parseNs);
+		if(result != DDSCore::DDS_OK)
+		{
+			PrintRow(name, desc, result, parseNs, 0.0, 0.0);
+			++failures;
+			continue;
+		}
+
+		double allocs = 0.0;
+		double loadMBs = BenchLoad(iterations, [&]() -> size_t
+		{
+			size_t bytes = 0;
+			if(file.Open(path.c_str()) && ParseAndLayout(file.Data(), file.Size(), desc, layout) == DDSCore::DDS_OK)
+				bytes = CopyTexels(desc, layout, staging);
+			file.Close();
+			return bytes;
+		}, allocs);
+
+		PrintRow(name, desc, result, parseNs, loadMBs, allocs);
+	}
+
+	for(size_t s = 0; s < samples.size(); ++s)
+	{
+		const std::vector<uint8_t>& data = samples[s].Data;
+
+		double parseNs = 0.0;
+		DDSCore::Result result = BenchParse(data, iterations, desc, layout, parseNs);
+
+		double allocs = 0.0;
+		double loadMBs = 0.0;
+		if(result == DDSCore::DDS_OK)
+		{
+			loadMBs = BenchLoad(iterations, [&]() -> size_t
+			{
+				if(ParseAndLayout(data.data(), data.size(), desc, layout) != DDSCore::DDS_OK)
+					return 0;
+				return CopyTexels(desc, layout, staging);
+			}, allocs);
+		}
+
+		PrintRow(samples[s].Name, desc, result, parseNs, loadMBs, allocs);
+
+		if(result != samples[s].Expected)
+		{
+			std::printf("  expected %s\n", ResultName(samples[s].Expected));
+			++failures;
+		}
+	}
+
+	if(failures)
+		std::printf("%d failure(s)\n", failures);
+
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,78 @@
+//***************************************************************************************
+// DDSFuzz.cpp
+//
+// libFuzzer entry point for the DDS header and mip-chain parsing in DDSCore.  Build
+// with clang and run it over the seed corpus DDSBench writes:
+//
+//   clang++ -std=c++17 -g -O1 -fsanitize=fuzzer,address,undefined -I../../Common
+//       DDSFuzz.cpp ../../Common/DDSCore.cpp -o DDSFuzz
+//   DDSBench -corpus corpus ../../Chapter*/TreeBillboard/Textures
+//   ./DDSFuzz corpus ../../Chapter*/TreeBillboard/Textures
+//
+// Without libFuzzer, DDSFuzzMain.cpp drives the same entry point over mutations from
+// a fixed seed; CTest runs it that way as dds_fuzz.
+//
+// Every subresource FillInitData returns is read at its first and last byte, so a
+// layout that points outside the input is caught by AddressSanitizer even when the
+// loader itself would only hand the pointer to the driver.
+//***************************************************************************************
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "DDSCore.h"
+
+static void TouchLayout(const DDSCore::TextureDesc& desc, size_t mipCount, size_t depth,
+	const std::vector<DDSCore::Subresource>& layout)
+{
+	volatile uint8_t sink = 0;
+	for(size_t slice = 0; slice < desc.arraySize; ++slice)
+	{
+		size_t d = depth;
+		for(size_t mip = 0; mip < mipCount; ++mip)
+		{
+			const DDSCore::Subresource& sub = layout[slice*mipCount + mip];
+			const uint8_t* bytes = static_cast<const uint8_t*>(sub.pSysMem);
+			size_t size = size_t(sub.SysMemSlicePitch) * d;
+			if(size > 0)
+			{
+				sink = sink + bytes[0];
+				sink = sink + bytes[size - 1];
+			}
+			d = d > 1 ? d / 2 : 1;
+		}
+	}
+	(void)sink;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+	// Exact-size copy: the parser may assume nothing past the end, and the loader's
+	// buffers are only guaranteed the default heap alignment.
+	std::vector<uint8_t> input(data, data + size);
+
+	DDSCore::TextureDesc desc;
+	if(DDSCore::ParseDDS(input.data(), input.size(), desc) != DDSCore::DDS_OK)
+		return 0;
+
+	DDSCore::GetAlphaMode(desc.header);
+
+	std::vector<DDSCore::Subresource> layout(desc.mipCount * desc.arraySize);
+
+	// Full chain, then the feature-level retry path that skips large mips.
+	const size_t maxSizes[] = { 0, 64 };
+	for(size_t m = 0; m < sizeof(maxSizes) / sizeof(maxSizes[0]); ++m)
+	{
+		size_t twidth = 0, theight = 0, tdepth = 0, skipMip = 0;
+		DDSCore::Result result = DDSCore::FillInitData(desc.width, desc.height, desc.depth, desc.mipCount,
+			desc.arraySize, desc.format, maxSizes[m], desc.bitSize, desc.bitData,
+			twidth, theight, tdepth, skipMip, layout.data());
+
+		if(result == DDSCore::DDS_OK)
+			TouchLayout(desc, desc.mipCount - skipMip, tdepth, layout);
+	}
+
+	return 0;
+}
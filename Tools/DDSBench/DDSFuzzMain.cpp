@@ -0,0 +1,159 @@
+//***************************************************************************************
+// DDSFuzzMain.cpp
+//
+// Stand-alone driver for DDSFuzz.cpp where libFuzzer is not available, so the fuzz
+// target runs as a deterministic regression test.  Usage:
+//
+//   DDSFuzzMain [-seed N] [-iterations N] [file.dds | directory ...]
+//
+// Loads every .dds given (directories are searched for *.dds) and runs each through
+// LLVMFuzzerTestOneInput as is, then for -iterations rounds (default 2000) picks one,
+// mutates it and runs the result: bytes and 32-bit fields of the headers overwritten
+// with boundary values, random bit flips anywhere, and truncation.  The mutations come
+// from a generator seeded with -seed (default 1), so a failing run repeats exactly.
+//
+// The target only returns, so the test is that nothing crashes or trips a sanitizer;
+// build with -fsanitize=address,undefined to catch out-of-bounds reads as well.
+//***************************************************************************************
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+
+namespace
+{
+	namespace fs = std::filesystem;
+
+	// DDS magic, DDS_HEADER and DDS_HEADER_DXT10: where the parser's decisions live.
+	const size_t HeaderBytes = 4 + 124 + 20;
+
+	bool ReadFile(const std::string& path, std::vector<uint8_t>& data)
+	{
+		FILE* f = std::fopen(path.c_str(), "rb");
+		if(!f)
+			return false;
+		std::fseek(f, 0, SEEK_END);
+		long size = std::ftell(f);
+		std::fseek(f, 0, SEEK_SET);
+		data.resize(size > 0 ? (size_t)size : 0);
+		bool ok = data.empty() || std::fread(data.data(), 1, data.size(), f) == data.size();
+		std::fclose(f);
+		return ok;
+	}
+
+	void CollectFiles(const std::string& arg, std::vector<std::string>& files)
+	{
+		std::error_code ec;
+		if(!fs::is_directory(arg, ec))
+		{
+			files.push_back(arg);
+			return;
+		}
+
+		std::vector<std::string> found;
+		for(fs::directory_iterator it(arg, ec), end; !ec && it != end; it.increment(ec))
+		{
+			std::string ext = it->path().extension().string();
+			if(ext == ".dds" || ext == ".DDS")
+				found.push_back(it->path().string());
+		}
+		std::sort(found.begin(), found.end());
+		files.insert(files.end(), found.begin(), found.end());
+	}
+
+	void Mutate(std::vector<uint8_t>& data, std::minstd_rand& rng)
+	{
+		static const uint32_t interesting[] = { 0, 1, 2, 3, 4, 7, 8, 15, 16, 64, 127, 128, 255, 256,
+			0x7fff, 0x8000, 0xffff, 0x10000, 0x7fffffff, 0x80000000, 0xfffffffe, 0xffffffff };
+		const size_t interestingCount = sizeof(interesting) / sizeof(interesting[0]);
+
+		int mutations = 1 + (int)(rng() % 4);
+		for(int m = 0; m < mutations && !data.empty(); ++m)
+		{
+			size_t header = (std::min)(data.size(), HeaderBytes);
+			switch(rng() % 4)
+			{
+			case 0:
+				// One header field, aligned as the struct lays it out.
+				if(header >= 4)
+				{
+					size_t offset = (rng() % (header / 4))*4;
+					uint32_t value = interesting[rng() % interestingCount];
+					std::memcpy(&data[offset], &value, 4);
+				}
+				break;
+			case 1:
+				data[rng() % header] = (uint8_t)interesting[rng() % interestingCount];
+				break;
+			case 2:
+				data[rng() % data.size()] ^= (uint8_t)(1u << (rng() % 8));
+				break;
+			default:
+				data.resize(rng() % (data.size() + 1));
+				break;
+			}
+		}
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	uint32_t seed = 1;
+	int iterations = 2000;
+	std::vector<std::string> inputs;
+
+	for(int i = 1; i < argc; ++i)
+	{
+		if(std::strcmp(argv[i], "-seed") == 0 && i + 1 < argc)
+			seed = (uint32_t)std::strtoul(argv[++i], 0, 10);
+		else if(std::strcmp(argv[i], "-iterations") == 0 && i + 1 < argc)
+			iterations = (std::max)(0, std::atoi(argv[++i]));
+		else if(argv[i][0] == '-')
+		{
+			std::fprintf(stderr, "usage: DDSFuzzMain [-seed N] [-iterations N] [file.dds | directory ...]\n");
+			return 2;
+		}
+		else
+			CollectFiles(argv[i], inputs);
+	}
+
+	std::vector<std::vector<uint8_t> > corpus;
+	for(size_t i = 0; i < inputs.size(); ++i)
+	{
+		std::vector<uint8_t> data;
+		if(!ReadFile(inputs[i], data))
+		{
+			std::fprintf(stderr, "%s: cannot read\n", inputs[i].c_str());
+			return 1;
+		}
+		corpus.push_back(data);
+	}
+	if(corpus.empty())
+	{
+		std::fprintf(stderr, "no inputs\n");
+		return 1;
+	}
+
+	for(size_t i = 0; i < corpus.size(); ++i)
+		LLVMFuzzerTestOneInput(corpus[i].data(), corpus[i].size());
+
+	std::minstd_rand rng(seed);
+	std::vector<uint8_t> input;
+	for(int i = 0; i < iterations; ++i)
+	{
+		input = corpus[rng() % corpus.size()];
+		Mutate(input, rng);
+		LLVMFuzzerTestOneInput(input.data(), input.size());
+	}
+
+	std::printf("%u inputs, %d mutations from seed %u\n", (unsigned)corpus.size(), iterations, (unsigned)seed);
+	return 0;
+}
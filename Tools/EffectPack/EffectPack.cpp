@@ -0,0 +1,79 @@
+//***************************************************************************************
+// EffectPack.cpp
+//
+// Packs compiled effects into the archive Effects::InitAll maps at startup.  Usage:
+//
+//   EffectPack output.fxa input.fxo [input2.fxo ...]
+//   EffectPack -list archive.fxa
+//
+// Entries are named by their path as given, so run it from the directory the
+// application runs in, for example:
+//
+//   EffectPack FX/Effects.fxa FX/Basic.fxo FX/TreeSprite.fxo FX/TreeBillboard.fxo FX/buildDensity.fxo FX/marchingCubes.fxo
+//
+// -list validates an archive and prints its table of contents.
+//***************************************************************************************
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "EffectArchive.h"
+#include "MappedFile.h"
+
+static int List(const char* path)
+{
+	EffectArchive archive;
+	std::string error;
+	if(!archive.Open(path, &error))
+	{
+		std::fprintf(stderr, "%s: %s\n", path, error.c_str());
+		return 1;
+	}
+
+	for(size_t i = 0; i < archive.Count(); ++i)
+	{
+		EffectArchive::Blob blob = archive.Get(i);
+		std::printf("%-32s %8zu bytes  %016llx\n", archive.Name(i).c_str(), blob.Size,
+			(unsigned long long)EffectArchive::Hash(blob.Data, blob.Size));
+	}
+	return 0;
+}
+
+int main(int argc, char* argv[])
+{
+	if(argc == 3 && std::strcmp(argv[1], "-list") == 0)
+		return List(argv[2]);
+
+	if(argc < 3 || argv[1][0] == '-')
+	{
+		std::fprintf(stderr, "usage: EffectPack output.fxa input.fxo [input2.fxo ...]\n"
+			"       EffectPack -list archive.fxa\n");
+		return 2;
+	}
+
+	std::vector<EffectArchive::Input> inputs(argc - 2);
+	for(int i = 2; i < argc; ++i)
+	{
+		MappedFile file;
+		if(!file.Open(argv[i]))
+		{
+			std::fprintf(stderr, "%s: cannot open file\n", argv[i]);
+			return 1;
+		}
+
+		EffectArchive::Input& input = inputs[i - 2];
+		input.Name = argv[i];
+		input.Data.assign(file.Data(), file.Data() + file.Size());
+	}
+
+	std::string error;
+	if(!EffectArchive::Write(argv[1], inputs, &error))
+	{
+		std::fprintf(stderr, "%s: %s\n", argv[1], error.c_str());
+		return 1;
+	}
+
+	return List(argv[1]);
+}
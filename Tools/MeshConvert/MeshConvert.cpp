@@ -0,0 +1,108 @@
+//***************************************************************************************
+// MeshConvert.cpp
+//
+// Converts the text models in Models/*.txt to the binary .mesh container read by
+// MeshFile.  Usage:
+//
+//   MeshConvert [-optimize] input.txt [input2.txt ...]
+//
+// Each input is written next to itself with a .mesh extension.  -optimize reorders
+// the mesh for the vertex cache, overdraw and vertex fetch before writing it.
+//***************************************************************************************
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "MeshFile.h"
+#include "MeshOptimizer.h"
+
+static std::string OutputPath(const std::string& input)
+{
+	size_t dot = input.find_last_of('.');
+	size_t slash = input.find_last_of("/\\");
+	if(dot == std::string::npos || (slash != std::string::npos && dot < slash))
+		return input + ".mesh";
+	return input.substr(0, dot) + ".mesh";
+}
+
+static bool Convert(const std::string& input, bool optimize)
+{
+	typedef std::chrono::steady_clock Clock;
+
+	MeshFile::MeshData mesh;
+	std::string error;
+
+	Clock::time_point parseStart = Clock::now();
+	if(!MeshFile::LoadText(input.c_str(), mesh, &error))
+	{
+		std::fprintf(stderr, "%s: %s\n", input.c_str(), error.c_str());
+		return false;
+	}
+	double parseMs = std::chrono::duration<double, std::milli>(Clock::now() - parseStart).count();
+
+	std::printf("%s: %u vertices, %u triangles, parsed in %.2f ms\n", input.c_str(),
+		unsigned(mesh.Vertices.size()), unsigned(mesh.Indices.size() / 3), parseMs);
+
+	if(optimize && !mesh.Indices.empty())
+	{
+		std::vector<uint32_t> remap;
+		MeshOptimizer::Report report = MeshOptimizer::Optimize(mesh.Indices, mesh.Vertices.size(),
+			mesh.Vertices[0].Position, sizeof(MeshFile::Vertex), remap);
+
+		size_t vertexCount = 0;
+		for(size_t i = 0; i < remap.size(); ++i)
+			vertexCount += remap[i] != MeshOptimizer::InvalidIndex;
+		MeshOptimizer::RemapVertices(mesh.Vertices, remap.data(), vertexCount);
+
+		std::printf("  ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n",
+			report.Before.ACMR, report.After.ACMR, report.Before.ATVR, report.After.ATVR);
+	}
+
+	std::string output = OutputPath(input);
+	if(!MeshFile::Write(output.c_str(), mesh, &error))
+	{
+		std::fprintf(stderr, "%s: %s\n", output.c_str(), error.c_str());
+		return false;
+	}
+
+	Clock::time_point loadStart = Clock::now();
+	MeshFile file;
+	if(!file.Load(output.c_str(), &error))
+	{
+		std::fprintf(stderr, "%s: %s\n", output.c_str(), error.c_str());
+		return false;
+	}
+	double loadMs = std::chrono::duration<double, std::milli>(Clock::now() - loadStart).count();
+
+	std::printf("  wrote %s, loads in %.3f ms\n", output.c_str(), loadMs);
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	bool optimize = false;
+	int inputCount = 0;
+	bool ok = true;
+
+	for(int i = 1; i < argc; ++i)
+	{
+		if(std::strcmp(argv[i], "-optimize") == 0)
+		{
+			optimize = true;
+			continue;
+		}
+
+		ok = Convert(argv[i], optimize) && ok;
+		++inputCount;
+	}
+
+	if(inputCount == 0)
+	{
+		std::fprintf(stderr, "usage: MeshConvert [-optimize] input.txt [input2.txt ...]\n");
+		return 1;
+	}
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,435 @@
+//***************************************************************************************
+// TerrainHeadless.cpp
+//
+// Runs the terrain demo without a window or a GPU.  Usage:
+//
+//   TerrainHeadless [-frames N] [-dt seconds] [-spin radians] [-pipelined 0|1]
+//                   [-render-ms ms] [-rays N] [-agents N] [-csv path] [-json path]
+//
+// Builds the same TerrainWorld TerrainApp draws, then runs N frames (default 600) with
+// a fixed time step (default 1/60 s) through FrameLoop: the waves, tree LOD, culling and
+// draw recording all run as they do in the application, and the draws are submitted to
+// a NullRenderDevice.  The camera orbits by -spin radians per second (default 0.5) so
+// the culling sees a changing view.
+//
+// -pipelined 1 runs the same frames through PipelinedFrameLoop instead, simulating on
+// a second thread while the previous frame renders.  The null device costs nothing,
+// so -render-ms busy-waits that long in every Render to stand in for a real device.
+//
+// Every frame also casts -rays rays (default 4096) from the eye at a grid over the
+// terrain through TerrainRaycaster, as picking and line of sight would, and checks
+// that every hit lies on the solid side of the surface.  It drops -agents capsules
+// (default 1024) from above the volume onto the chunks' collision meshes across
+// threads, as a server moving that many agents would, and checks that each one that
+// lands touches the terrain without ending up inside a triangle.
+//
+// After building it prints how far the chunks' far LOD meshes cut their triangles
+// and memory, and the surface's vertex cache ACMR/ATVR before and after each chunk
+// was reordered.  At the end it prints the profiler summary for the frame and every
+// scope and what was submitted, and optionally writes the per-frame timings with the
+// profiler's CSV or JSON export.
+//
+// The exit code is non-zero if an export fails, a frame was not rendered, a ray hit
+// in the air or an agent came to rest off or inside the terrain.
+//***************************************************************************************
+
+#include <cstdio>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "FrameLoop.h"
+#include "NullRenderDevice.h"
+#include "ParallelFor.h"
+#include "TerrainWorld.h"
+
+// Everything Render needs from one simulated frame.
+struct FrameSnapshot
+{
+	FrameSnapshot() : TerrainDrawCount(0) {}
+
+	std::vector<WaveCompactVertex> WaveVertices;
+	std::vector<BillboardInstance> TreeInstances;
+	// One terrain list per chunk range, recorded on the workers, then the trees.
+	std::vector<DrawCommandList> TerrainDraws;
+	DrawCommandList TreeDraws;
+	std::vector<const DrawCommandList*> Lists;
+	size_t TerrainDrawCount;
+};
+
+///<summary>
+/// Simulate advances the world, culls and records the frame's draws into a snapshot;
+/// Render only uploads and submits a snapshot.  Serially, UpdateScene and DrawScene
+/// run them on slot 0; pipelined, they run on two threads over three slots.
+///</summary>
+class HeadlessClient : public IFrameClient, public IPipelinedFrameClient
+{
+public:
+	HeadlessClient(TerrainWorld& world, NullRenderDevice& device, float spin, float renderMs,
+		FrameProfiler& simProfiler, size_t rayCount, size_t agentCount)
+		: mWorld(world), mDevice(device), mSpin(spin), mRenderMs(renderMs), mSimProfiler(simProfiler),
+		mRayCount(rayCount), mRayHits(0), mBadHits(0), mAgentCount(agentCount), mAgentHits(0), mBadAgents(0)
+	{
+		mRaysScope = mSimProfiler.AddScope("Raycasts");
+		mRays.resize(mRayCount);
+		mHits.resize(mRayCount);
+		mAgentsScope = mSimProfiler.AddScope("Agent sweeps");
+		mAgentFeet.resize(mAgentCount);
+		mAgentContacts.resize(mAgentCount);
+
+		std::vector<TerrainGridCompactVertex> vertices;
+		mWorld.PackGridVertices(vertices);
+		const std::vector<uint32_t>& indices = mWorld.GridIndices();
+		mTerrainState.VertexBuffer = mDevice.CreateVertexBuffer(vertices.data(),
+			(uint32_t)(vertices.size()*sizeof(TerrainGridCompactVertex)), false);
+		mTerrainState.VertexStride = sizeof(TerrainGridCompactVertex);
+		mTerrainState.IndexBuffer = mDevice.CreateIndexBuffer(indices.data(), (uint32_t)indices.size());
+		std::vector<uint32_t> slabs;
+		mWorld.PackSlabInstances(slabs);
+		mTerrainState.InstanceBuffer = mDevice.CreateVertexBuffer(slabs.data(), (uint32_t)(slabs.size()*sizeof(uint32_t)), false);
+		mTerrainState.InstanceStride = sizeof(uint32_t);
+
+		const float corners[8] = { 0.5f, 0.0f, 0.5f, 1.0f, -0.5f, 0.0f, -0.5f, 1.0f };
+		mTreeState.Layer = 1;
+		mTreeState.VertexBuffer = mDevice.CreateVertexBuffer(corners, sizeof(corners), false);
+		mTreeState.VertexStride = 2*sizeof(float);
+		mTreeInstanceBytes = (uint32_t)((std::max)(mWorld.MaxTreeInstances(), (size_t)1)*sizeof(BillboardInstance));
+		mTreeState.InstanceBuffer = mDevice.CreateVertexBuffer(0, mTreeInstanceBytes, true);
+		mTreeState.InstanceStride = sizeof(BillboardInstance);
+
+		for(int i = 0; i < 3; ++i)
+		{
+			FrameSnapshot& frame = mSnapshots[i];
+			frame.WaveVertices.resize(mWorld.GetWaves().VertexCount());
+			frame.TerrainDraws.resize(ParallelForPool::Instance().ThreadCount());
+			for(size_t l = 0; l < frame.TerrainDraws.size(); ++l)
+				frame.Lists.push_back(&frame.TerrainDraws[l]);
+			frame.Lists.push_back(&frame.TreeDraws);
+		}
+		mWaveBuffer = mDevice.CreateVertexBuffer(0, (uint32_t)(mSnapshots[0].WaveVertices.size()*sizeof(WaveCompactVertex)), true);
+	}
+
+	void UpdateScene(float dt) { Simulate(dt, 0); }
+	void DrawScene() { Render(0); }
+
+	void Simulate(float dt, uint32_t slot)
+	{
+		FrameSnapshot& frame = mSnapshots[slot];
+
+		mWorld.Camera().Theta += mSpin*dt;
+		mWorld.Update(dt);
+
+		mWorld.PackWaveVertices(frame.WaveVertices.data());
+
+		CastRays();
+		DropAgents();
+
+		mWorld.Cull();
+		for(size_t l = 0; l < frame.TerrainDraws.size(); ++l)
+			frame.TerrainDraws[l].Clear();
+		frame.TerrainDrawCount = mWorld.RecordTerrain(frame.TerrainDraws.data(), frame.TerrainDraws.size(), mTerrainState);
+		frame.TreeDraws.Clear();
+		mWorld.RecordTrees(frame.TreeDraws, mTreeState);
+		frame.TreeInstances = mWorld.TreeBatches().Instances();
+	}
+
+	void Render(uint32_t slot)
+	{
+		const FrameSnapshot& frame = mSnapshots[slot];
+
+		const float black[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+		mDevice.Clear(black);
+
+		mDevice.WriteVertexBuffer(mWaveBuffer, frame.WaveVertices.data(),
+			(uint32_t)(frame.WaveVertices.size()*sizeof(WaveCompactVertex)));
+		if(!frame.TreeInstances.empty())
+			mDevice.WriteVertexBuffer(mTreeState.InstanceBuffer, frame.TreeInstances.data(),
+				(uint32_t)(frame.TreeInstances.size()*sizeof(BillboardInstance)));
+
+		mDrawQueue.Gather(frame.Lists.data(), frame.Lists.size());
+		mDrawQueue.Submit(mDevice.DrawBackend(), 0, frame.TerrainDrawCount);
+		mDrawQueue.Submit(mDevice.DrawBackend(), frame.TerrainDrawCount, mDrawQueue.Count());
+
+		mDevice.Present();
+
+		if(mRenderMs > 0.0f)
+		{
+			uint64_t end = FrameProfiler::SteadyClock() + (uint64_t)(mRenderMs*1.0e6f);
+			while(FrameProfiler::SteadyClock() < end)
+			{
+			}
+		}
+	}
+
+	size_t RayHits()const { return mRayHits; }
+	size_t BadHits()const { return mBadHits; }
+	size_t AgentHits()const { return mAgentHits; }
+	size_t BadAgents()const { return mBadAgents; }
+
+private:
+	void CastRays()
+	{
+		if(mRayCount == 0)
+			return;
+		FrameProfiler::Scope scope(mSimProfiler, mRaysScope);
+
+		// From the eye to a square grid of points on the floor of the volume.
+		const TerrainRaycaster& raycaster = mWorld.Raycaster();
+		Vec3 eye = mWorld.Camera().Eye();
+		float half = 0.5f*mWorld.GetSettings().Extent;
+		size_t side = (size_t)std::ceil(std::sqrt((double)mRayCount));
+		for(size_t i = 0; i < mRayCount; ++i)
+		{
+			float u = ((i % side) + 0.5f) / side;
+			float v = ((i / side) + 0.5f) / side;
+			Vec3 to = Vec3(-half + u*2.0f*half, 0.0f, -half + v*2.0f*half) - eye;
+			float length = Length(to);
+			mRays[i] = TerrainRay(eye, to*(1.0f / length), length);
+		}
+		mRayHits += raycaster.RaycastBatch(mRays.data(), mHits.data(), mRayCount);
+
+		for(size_t i = 0; i < mRayCount; ++i)
+		{
+			if(mHits[i].Hit && raycaster.Density(mHits[i].Position) < -1e-3f)
+				++mBadHits;
+		}
+	}
+
+	void DropAgents()
+	{
+		if(mAgentCount == 0)
+			return;
+
+		// Capsules a little under 2 units tall, on a grid that drifts over time.
+		const float radius = 0.4f, height = 1.8f;
+		const Vec3 down(0.0f, -1.0f, 0.0f);
+		const TerrainCollision& collision = mWorld.Collision();
+		float extent = mWorld.GetSettings().Extent;
+		float top = extent + 2.0f;
+		{
+			FrameProfiler::Scope scope(mSimProfiler, mAgentsScope);
+
+			size_t side = (size_t)std::ceil(std::sqrt((double)mAgentCount));
+			float drift = 0.01f*mWorld.TotalTime();
+			for(size_t i = 0; i < mAgentCount; ++i)
+			{
+				float u = std::fmod(((i % side) + 0.5f) / side + drift, 1.0f);
+				float v = std::fmod(((i / side) + 0.5f) / side + 0.5f*drift, 1.0f);
+				mAgentFeet[i] = Vec3((u - 0.5f)*extent, top, (v - 0.5f)*extent);
+			}
+
+			Vec3* feet = mAgentFeet.data();
+			CollisionHit* contacts = mAgentContacts.data();
+			ParallelFor(mAgentCount, 64, [&collision, feet, contacts, radius, height, down, top](size_t begin, size_t end)
+			{
+				for(size_t i = begin; i < end; ++i)
+				{
+					Vec3 a = feet[i] + Vec3(0.0f, radius, 0.0f);
+					Vec3 b = feet[i] + Vec3(0.0f, height - radius, 0.0f);
+					collision.SweepCapsule(a, b, radius, down, top + 2.0f, contacts[i]);
+				}
+			});
+		}
+
+		// Where a capsule stopped it must touch the terrain, within the sweep's
+		// tolerance, and not sink into it.  A sweep that stopped short or passed through
+		// a triangle fails one or the other.
+		const float tolerance = CollisionBVH::SweepTolerance;
+		for(size_t i = 0; i < mAgentCount; ++i)
+		{
+			if(!mAgentContacts[i].Hit)
+				continue;
+			++mAgentHits;
+			Vec3 a = mAgentFeet[i] + Vec3(0.0f, radius - mAgentContacts[i].Distance, 0.0f);
+			Vec3 b = a + Vec3(0.0f, height - 2.0f*radius, 0.0f);
+			if(!collision.OverlapCapsule(a, b, radius + 2.0f*tolerance) || collision.OverlapCapsule(a, b, radius - tolerance))
+				++mBadAgents;
+		}
+	}
+
+	TerrainWorld& mWorld;
+	NullRenderDevice& mDevice;
+	float mSpin;
+	float mRenderMs;
+
+	FrameProfiler& mSimProfiler;
+	FrameProfiler::ScopeId mRaysScope;
+	size_t mRayCount;
+	std::vector<TerrainRay> mRays;
+	std::vector<TerrainRayHit> mHits;
+	size_t mRayHits;
+	size_t mBadHits;
+
+	FrameProfiler::ScopeId mAgentsScope;
+	size_t mAgentCount;
+	std::vector<Vec3> mAgentFeet;
+	std::vector<CollisionHit> mAgentContacts;
+	size_t mAgentHits;
+	size_t mBadAgents;
+
+	DrawState mTerrainState;
+	DrawState mTreeState;
+	uint32_t mTreeInstanceBytes;
+	DrawHandle mWaveBuffer;
+
+	FrameSnapshot mSnapshots[3];
+	DrawQueue mDrawQueue;
+};
+
+static void PrintSummary(const char* name, const FrameProfiler::Summary& s)
+{
+	std::printf("%-16s mean %7.3f  p50 %7.3f  p95 %7.3f  p99 %7.3f  max %7.3f ms\n", name,
+		s.Mean, s.P50, s.P95, s.P99, s.Max);
+}
+
+int main(int argc, char** argv)
+{
+	size_t frames = 600;
+	float dt = 1.0f / 60.0f;
+	float spin = 0.5f;
+	bool pipelined = false;
+	float renderMs = 0.0f;
+	size_t rayCount = 4096;
+	size_t agentCount = 1024;
+	const char* csvPath = 0;
+	const char* jsonPath = 0;
+
+	for(int i = 1; i + 1 < argc; i += 2)
+	{
+		if(std::strcmp(argv[i], "-frames") == 0)
+			frames = (size_t)std::strtoul(argv[i + 1], 0, 10);
+		else if(std::strcmp(argv[i], "-dt") == 0)
+			dt = (float)std::atof(argv[i + 1]);
+		else if(std::strcmp(argv[i], "-spin") == 0)
+			spin = (float)std::atof(argv[i + 1]);
+		else if(std::strcmp(argv[i], "-pipelined") == 0)
+			pipelined = std::atoi(argv[i + 1]) != 0;
+		else if(std::strcmp(argv[i], "-render-ms") == 0)
+			renderMs = (float)std::atof(argv[i + 1]);
+		else if(std::strcmp(argv[i], "-rays") == 0)
+			rayCount = (size_t)std::strtoul(argv[i + 1], 0, 10);
+		else if(std::strcmp(argv[i], "-agents") == 0)
+			agentCount = (size_t)std::strtoul(argv[i + 1], 0, 10);
+		else if(std::strcmp(argv[i], "-csv") == 0)
+			csvPath = argv[i + 1];
+		else if(std::strcmp(argv[i], "-json") == 0)
+			jsonPath = argv[i + 1];
+	}
+
+	FrameProfiler profiler((std::max)(frames, (size_t)1));
+	FrameProfiler simProfiler((std::max)(frames, (size_t)1));
+
+	// Pipelined, the world is updated on the simulation thread, so it records there.
+	TerrainWorld world;
+	world.SetProfiler(pipelined ? &simProfiler : &profiler);
+	world.Build();
+	std::printf("Terrain: %u chunks, %u slabs, %u surface triangles, %u trees\n",
+		(unsigned)world.Chunks().size(), (unsigned)world.SlabBoxes().Count(),
+		(unsigned)(world.SurfaceMesh().Indices.size() / 3), (unsigned)world.TreeCount());
+
+	// Sized as TerrainCompact vertices (12 bytes) and 32-bit indices.
+	MeshSimplifier::Report lod;
+	for(size_t c = 0; c < world.Chunks().size(); ++c)
+	{
+		const MeshSimplifier::Report& r = world.FarLodReport(c);
+		lod.TrianglesBefore += r.TrianglesBefore;
+		lod.TrianglesAfter += r.TrianglesAfter;
+		lod.VerticesBefore += r.VerticesBefore;
+		lod.VerticesAfter += r.VerticesAfter;
+		lod.Error = (std::max)(lod.Error, r.Error);
+	}
+	std::printf("Far LOD: %u of %u triangles, %.1f of %.1f KB, error %.3f\n", (unsigned)lod.TrianglesAfter,
+		(unsigned)lod.TrianglesBefore, (12.0*lod.VerticesAfter + 12.0*lod.TrianglesAfter) / 1024.0,
+		(12.0*lod.VerticesBefore + 12.0*lod.TrianglesBefore) / 1024.0, lod.Error);
+	const MeshOptimizer::Report& surface = world.SurfaceReport();
+	std::printf("Surface: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", surface.Before.ACMR, surface.After.ACMR,
+		surface.Before.ATVR, surface.After.ATVR);
+
+	NullRenderDevice device;
+	HeadlessClient client(world, device, spin, renderMs, pipelined ? simProfiler : profiler, rayCount,
+		agentCount);
+
+	if(pipelined)
+	{
+		PipelinedFrameLoop loop(profiler, simProfiler);
+		loop.Run(client, frames, dt);
+	}
+	else
+	{
+		FrameLoop loop(profiler);
+		GameTimer timer;
+		loop.Run(client, timer, frames, dt);
+	}
+
+	int failures = 0;
+	std::printf("%u frames, %.3f s simulated, %s\n\n", (unsigned)device.GetStats().Frames, world.TotalTime(),
+		pipelined ? "pipelined" : "serial");
+	if(device.GetStats().Frames != frames)
+	{
+		std::printf("Expected %u rendered frames\n", (unsigned)frames);
+		++failures;
+	}
+
+	PrintSummary("Frame", profiler.FrameSummary());
+	for(size_t i = 0; i < profiler.ScopeCount(); ++i)
+		PrintSummary(profiler.ScopeName((FrameProfiler::ScopeId)i).c_str(), profiler.ScopeSummary((FrameProfiler::ScopeId)i));
+	if(pipelined)
+	{
+		std::printf("\nSimulation thread:\n");
+		PrintSummary("Frame", simProfiler.FrameSummary());
+		for(size_t i = 0; i < simProfiler.ScopeCount(); ++i)
+			PrintSummary(simProfiler.ScopeName((FrameProfiler::ScopeId)i).c_str(),
+				simProfiler.ScopeSummary((FrameProfiler::ScopeId)i));
+	}
+
+	const NullDrawBackend::Stats& draws = device.GetDrawStats();
+	const OcclusionBuffer::Stats& occlusion = world.Occlusion().GetStats();
+	std::printf("\nPer frame: %.1f draws, %.1f instances, %.1f state changes, %.1f KB written\n",
+		(double)draws.Draws / frames, (double)draws.Instances / frames, (double)draws.StateChanges / frames,
+		(double)device.GetStats().WrittenBytes / frames / 1024.0);
+	std::printf("Last frame: %u of %u slabs occluded, %u tree billboards\n", (unsigned)occlusion.BoxesOccluded,
+		(unsigned)occlusion.BoxesTested, (unsigned)world.TreeBatches().Instances().size());
+	if(rayCount > 0)
+	{
+		std::printf("Raycasts: %.1f of %u rays hit per frame\n", (double)client.RayHits() / frames, (unsigned)rayCount);
+		if(client.BadHits() > 0)
+		{
+			std::printf("%u ray hits were in the air\n", (unsigned)client.BadHits());
+			++failures;
+		}
+	}
+	if(agentCount > 0)
+	{
+		std::printf("Agents: %.1f of %u landed per frame\n", (double)client.AgentHits() / frames, (unsigned)agentCount);
+		if(client.BadAgents() > 0)
+		{
+			std::printf("%u agents came to rest off or inside the terrain\n", (unsigned)client.BadAgents());
+			++failures;
+		}
+	}
+
+	std::string error;
+	if(csvPath)
+	{
+		if(profiler.WriteCSV(csvPath, &error))
+			std::printf("Wrote %s\n", csvPath);
+		else
+		{
+			std::printf("CSV export failed: %s\n", error.c_str());
+			++failures;
+		}
+	}
+	if(jsonPath)
+	{
+		if(profiler.WriteJSON(jsonPath, &error))
+			std::printf("Wrote %s\n", jsonPath);
+		else
+		{
+			std::printf("JSON export failed: %s\n", error.c_str());
+			++failures;
+		}
+	}
+	return failures == 0 ? 0 : 1;
+}